@@ -29,17 +29,24 @@
 #include "basictokens.h"
 #include "interpreter.h"
 #include "shared.h"
+#include "heap.h"
 #include <e-lib.h>
 
 volatile static unsigned int sharedStackEntries=0, localStackEntries=0;
 volatile static unsigned char communication_data[6];
+// The heap in core memory and this core's area of the shared heap, along with the temporaries held in these
+static struct heap_definition coreHeap, sharedHeap;
+static struct heap_definition * heaps[2]={&coreHeap, &sharedHeap};
+static struct heap_temporaries heapTemporaries;
+// The scratch arena at the end of this core's shared area
+static struct scratch_arena scratchArena;
 
 static void sendData(struct value_defn, int, char);
 static struct value_defn recvData(int);
 static struct value_defn sendRecvData(struct value_defn, int);
 static struct value_defn bcastData(struct value_defn, int, int);
 static struct value_defn reduceData(struct value_defn, int, int);
-static struct value_defn getInputFromUser(void);
+static struct value_defn getInputFromUser(int, struct symbol_node*);
 static struct value_defn getInputFromUserWithString(struct value_defn, int, struct symbol_node*);
 static void displayToUser(struct value_defn, int, struct symbol_node*);
 static void garbageCollect(int, struct symbol_node*);
@@ -51,30 +58,28 @@ static struct value_defn sendRecvDataWithHostProcess(struct value_defn, int);
 static struct value_defn sendRecvDataWithDeviceCore(struct value_defn, int);
 static void performBarrier(volatile e_barrier_t[], e_barrier_t*[]);
 static char* copyStringToSharedMemoryAndSetLocation(char*, int, int, struct symbol_node*);
-static struct value_defn doGetInputFromUser();
+static struct value_defn doGetInputFromUser(int, struct symbol_node*);
 static int stringCmp(char*, char*);
-static void consolidateHeapChunks(char);
-static char * allocateChunkInHeapMemory(int, char);
-static char isMemoryAddressFound(char*, int, struct symbol_node*);
-static void performGC(int, struct symbol_node*, char);
 static struct value_defn performMathsOp(int, struct value_defn);
 static int getLargestCoreId(int);
 static struct value_defn probeForMessage(int);
 static struct value_defn test_or_wait_for_sent_message(int, char);
+static struct heap_definition * getHeapHolding(char*);
+static char isInSharedMemory(char*);
 
 void callNativeFunction(struct value_defn * value, unsigned char fnIdentifier, int numArgs, struct value_defn* parameters,
                                        int numActiveCores, int localCoreId, int currentSymbolEntries, struct symbol_node* symbolTable) {
     if (fnIdentifier==NATIVE_FN_RTL_ISHOST || fnIdentifier==NATIVE_FN_RTL_ISDEVICE) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         value->type=BOOLEAN_TYPE;
         value->dtype=SCALAR;
         int v=fnIdentifier==NATIVE_FN_RTL_ISHOST ? 0 : 1;
         cpy(value->data, &v, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_PRINT) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         displayToUser(parameters[0], currentSymbolEntries, symbolTable);
     } else if (fnIdentifier==NATIVE_FN_RTL_NUMDIMS) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         int intNDims=0;
         if (parameters[0].dtype == ARRAY) {
             char * ptr;
@@ -88,7 +93,7 @@ void callNativeFunction(struct value_defn * value, unsigned char fnIdentifier, i
         value->dtype=SCALAR;
 		cpy(value->data, &intNDims, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_DSIZE) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         int dimSize=0;
         if (parameters[0].dtype == ARRAY) {
             int lookupIndex=getInt(parameters[1].data);
@@ -105,48 +110,53 @@ void callNativeFunction(struct value_defn * value, unsigned char fnIdentifier, i
         value->dtype=SCALAR;
 		cpy(value->data, &dimSize, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_INPUT) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
-        *value=getInputFromUser();
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
+        *value=getInputFromUser(currentSymbolEntries, symbolTable);
     } else if (fnIdentifier==NATIVE_FN_RTL_INPUTPRINT) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         *value=getInputFromUserWithString(parameters[0], currentSymbolEntries, symbolTable);
     } else if (fnIdentifier==NATIVE_FN_RTL_SYNC) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         syncCores(1);
     } else if (fnIdentifier==NATIVE_FN_RTL_GC) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         garbageCollect(currentSymbolEntries, symbolTable);
     } else if (fnIdentifier==NATIVE_FN_RTL_FREE) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         char * ptr;
         cpy(&ptr, parameters[0].data, sizeof(char*));
+#ifdef INTERPRETER_REFERENCE_COUNTING
+        // Memory a variable still references is freed once the last of these no longer does
+        if (getHeapHolding(ptr) == NULL || !isReferencedInHeap(getHeapHolding(ptr), ptr)) freeMemoryInHeap(ptr);
+#else
         freeMemoryInHeap(ptr);
+#endif
     } else if (fnIdentifier==NATIVE_FN_RTL_SEND || fnIdentifier==NATIVE_FN_RTL_SEND_NB) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         sendData(parameters[0], getInt(parameters[1].data), fnIdentifier==NATIVE_FN_RTL_SEND ? 1 : 0);
     } else if (fnIdentifier==NATIVE_FN_RTL_RECV) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         *value=recvData(getInt(parameters[0].data));
     } else if (fnIdentifier==NATIVE_FN_RTL_SENDRECV) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         *value=sendRecvData(parameters[0], getInt(parameters[1].data));
     } else if (fnIdentifier==NATIVE_FN_RTL_TEST_FOR_SEND || fnIdentifier==NATIVE_FN_RTL_WAIT_FOR_SEND) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         *value=test_or_wait_for_sent_message(getInt(parameters[0].data), fnIdentifier==NATIVE_FN_RTL_WAIT_FOR_SEND ? 1 : 0);
     } else if (fnIdentifier==NATIVE_FN_RTL_BCAST) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         *value=bcastData(parameters[0], getInt(parameters[1].data), numActiveCores);
     } else if (fnIdentifier==NATIVE_FN_RTL_PROBE_FOR_MESSAGE) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         *value=probeForMessage(getInt(parameters[0].data));
     } else if (fnIdentifier==NATIVE_FN_RTL_NUMCORES || fnIdentifier==NATIVE_FN_RTL_COREID) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         value->type=INT_TYPE;
 		value->dtype=SCALAR;
         if (fnIdentifier==NATIVE_FN_RTL_NUMCORES) cpy(value->data, &numActiveCores, sizeof(int));
         if (fnIdentifier==NATIVE_FN_RTL_COREID) cpy(value->data, &localCoreId, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_REDUCE) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         *value=reduceData(parameters[0], getInt(parameters[1].data), numActiveCores);
     } else if (fnIdentifier==NATIVE_FN_RTL_ALLOCARRAY || fnIdentifier==NATIVE_FN_RTL_ALLOCSHAREDARRAY) {
         int totalDataSize=1, i;
@@ -184,7 +194,7 @@ void callNativeFunction(struct value_defn * value, unsigned char fnIdentifier, i
  */
 static void displayToUser(struct value_defn value, int currentSymbolEntries, struct symbol_node* symbolTable) {
 	sharedData->core_ctrl[myId].data[0]=value.type;
-	char* tempStr=NULL;
+	char* tempStr=NULL, * scratchMark=getScratchMark();
 	if (value.type == STRING_TYPE) {
 		char * v;
 		cpy(&v, &value.data, sizeof(char*));
@@ -196,7 +206,9 @@ static void displayToUser(struct value_defn value, int currentSymbolEntries, str
 	unsigned int pb=sharedData->core_ctrl[myId].core_busy;
 	sharedData->core_ctrl[myId].core_busy=0;
 	while (sharedData->core_ctrl[myId].core_busy==0 || sharedData->core_ctrl[myId].core_busy<=pb) { }
-	if (tempStr != NULL) freeMemoryInHeap(tempStr); // Clears up the temporary memory used
+	// Clears up the temporary memory used
+	resetScratchMemory(scratchMark);
+	if (tempStr != NULL) freeMemoryInHeap(tempStr);
 }
 
 /**
@@ -215,43 +227,51 @@ int checkStringEquality(struct value_defn str1, struct value_defn str2) {
 static struct value_defn getInputFromUserWithString(struct value_defn toDisplay, int currentSymbolEntries, struct symbol_node* symbolTable) {
 	if (toDisplay.type != STRING_TYPE) raiseError(ERR_ONLY_DISPLAY_STR_WITH_INPUT);
 	sharedData->core_ctrl[myId].data[0]=toDisplay.type;
-	char * msg=NULL;
+	char * msg=NULL, * scratchMark=getScratchMark();
 	if (toDisplay.type == STRING_TYPE) {
 		char * v;
 		cpy(&v, &toDisplay.data, sizeof(char*));
 		msg=copyStringToSharedMemoryAndSetLocation(v, 1, currentSymbolEntries, symbolTable);
+		if (msg != NULL) holdTemporary(msg);
+	}
+	struct value_defn inputValue=doGetInputFromUser(currentSymbolEntries, symbolTable);
+	resetScratchMemory(scratchMark);
+	if (msg != NULL) {
+		releaseTemporaries(1);
+		freeMemoryInHeap(msg);
 	}
-	struct value_defn inputValue=doGetInputFromUser();
-	if (msg != NULL) freeMemoryInHeap(msg);
 	return inputValue;
 }
 
 /**
  * Requests input from the host (no string to display)
  */
-static struct value_defn getInputFromUser() {
+static struct value_defn getInputFromUser(int currentSymbolEntries, struct symbol_node* symbolTable) {
 	sharedData->core_ctrl[myId].data[0]=0;
-	return doGetInputFromUser();
+	return doGetInputFromUser(currentSymbolEntries, symbolTable);
 }
 
 /**
  * Does the copying required to get input from the host, waits until this is ready and then sets the
- * type and data correctly
+ * type and data correctly. Memory for the longest string is allocated in the shared heap for the host to write any string
+ * input into, this is shrunk to the string once input or freed if a number was input instead
  */
-static struct value_defn doGetInputFromUser() {
+static struct value_defn doGetInputFromUser(int currentSymbolEntries, struct symbol_node* symbolTable) {
 	struct value_defn v;
 	v.dtype=SCALAR;
+	char * target=getHeapMemory(MAX_HOST_INPUT_LENGTH, 1, currentSymbolEntries, symbolTable);
+	unsigned int targetLocation=target-sharedData->core_ctrl[myId].shared_heap_start;
+	cpy(&sharedData->core_ctrl[myId].data[5], &targetLocation, sizeof(unsigned int));
 	sharedData->core_ctrl[myId].core_command=2;
 	unsigned int pb=sharedData->core_ctrl[myId].core_busy;
 	sharedData->core_ctrl[myId].core_busy=0;
 	while (sharedData->core_ctrl[myId].core_busy==0 || sharedData->core_ctrl[myId].core_busy<=pb) { }
 	v.type=sharedData->core_ctrl[myId].data[0];
 	if (v.type==STRING_TYPE) {
-        unsigned int relativeLocation;
-        cpy(&relativeLocation, &sharedData->core_ctrl[myId].data[1], sizeof(unsigned int));
-        char * ptr=sharedData->core_ctrl[myId].shared_heap_start + relativeLocation;
-		cpy(&v.data, &ptr, sizeof(char*));
+		shrinkInHeap(&sharedHeap, target, slength(target)+1);
+		cpy(&v.data, &target, sizeof(char*));
 	} else {
+		freeMemoryInHeap(target);
 		cpy(v.data, &sharedData->core_ctrl[myId].data[1], 4);
 	}
 	return v;
@@ -280,40 +300,80 @@ static struct value_defn performMathsOp(int operation, struct value_defn value)
 }
 
 /**
- * String concatenation performed on the host (and any needed data transformations)
+ * String concatenation performed on the host (and any needed data transformations). If scratch is set the result does not
+ * outlive the current statement so is placed in the scratch arena if it fits
  */
-struct value_defn performStringConcatenation(struct value_defn v1, struct value_defn v2, int currentSymbolEntries, struct symbol_node* symbolTable) {
+struct value_defn performStringConcatenation(struct value_defn v1, struct value_defn v2, char scratch, int currentSymbolEntries, struct symbol_node* symbolTable) {
 	struct value_defn v;
 	v.type=STRING_TYPE;
 	v.dtype=SCALAR;
 
 	sharedData->core_ctrl[myId].data[0]=v1.type;
-	char * tmpStr1, * tmpStr2;
+	sharedData->core_ctrl[myId].data[5]=v2.type;
+	char * str1=NULL, * str2=NULL, * tmpStr1=NULL, * tmpStr2=NULL, * scratchMark=getScratchMark();
+	int targetLength=1, heldTemporaries=0;
 	if (v1.type == STRING_TYPE) {
-		char * v;
-		cpy(&v, &v1.data, sizeof(char*));
-		tmpStr1=copyStringToSharedMemoryAndSetLocation(v, 1, currentSymbolEntries, symbolTable);
+		cpy(&str1, &v1.data, sizeof(char*));
+		targetLength+=slength(str1);
 	} else {
 		cpy(&sharedData->core_ctrl[myId].data[1], v1.data, 4);
+		targetLength+=MAX_HOST_NUMBER_LENGTH;
 	}
-	sharedData->core_ctrl[myId].data[5]=v2.type;
 	if (v2.type == STRING_TYPE) {
-		char * v;
-		cpy(&v, &v2.data, sizeof(char*));
-		tmpStr2=copyStringToSharedMemoryAndSetLocation(v, 6, currentSymbolEntries, symbolTable);
+		cpy(&str2, &v2.data, sizeof(char*));
+		targetLength+=slength(str2);
 	} else {
 		cpy(&sharedData->core_ctrl[myId].data[6], v2.data, 4);
+		targetLength+=MAX_HOST_NUMBER_LENGTH;
+	}
+	// Either operand might not be held by a variable, so these, the result and any copies are held whilst the others are allocated
+	if (str1 != NULL) {
+		holdTemporary(str1);
+		heldTemporaries++;
+	}
+	if (str2 != NULL) {
+		holdTemporary(str2);
+		heldTemporaries++;
+	}
+	// The host writes the concatenated string into memory allocated here for the longest it can be, which is then shrunk to fit.
+	// This is allocated before copying the operands, so that in the scratch arena the copies are above it and freed by shrinking it
+	char * ptr=scratch ? getScratchMemory(targetLength) : NULL;
+	char inScratch=ptr != NULL;
+	if (!inScratch) {
+		ptr=getHeapMemory(targetLength, 1, currentSymbolEntries, symbolTable);
+		holdTemporary(ptr);
+		heldTemporaries++;
+	}
+	if (str1 != NULL) {
+		tmpStr1=copyStringToSharedMemoryAndSetLocation(str1, 1, currentSymbolEntries, symbolTable);
+		if (tmpStr1 != NULL) {
+			holdTemporary(tmpStr1);
+			heldTemporaries++;
+		}
 	}
+	if (str2 != NULL) {
+		tmpStr2=copyStringToSharedMemoryAndSetLocation(str2, 6, currentSymbolEntries, symbolTable);
+		if (tmpStr2 != NULL) {
+			holdTemporary(tmpStr2);
+			heldTemporaries++;
+		}
+	}
+	unsigned int relativeLocation=ptr-sharedData->core_ctrl[myId].shared_heap_start;
+	cpy(&sharedData->core_ctrl[myId].data[11], &relativeLocation, sizeof(unsigned int));
 	sharedData->core_ctrl[myId].core_command=4;
 	unsigned int pb=sharedData->core_ctrl[myId].core_busy;
 	sharedData->core_ctrl[myId].core_busy=0;
 	while (sharedData->core_ctrl[myId].core_busy==0 || sharedData->core_ctrl[myId].core_busy<=pb) { }
 
 	v.type=STRING_TYPE;
-	unsigned int relativeLocation;
-    cpy(&relativeLocation, &sharedData->core_ctrl[myId].data[11], sizeof(unsigned int));
-    char * ptr=sharedData->core_ctrl[myId].shared_heap_start + relativeLocation;
+	if (inScratch) {
+		resetScratchMemory(ptr+slength(ptr)+1);
+	} else {
+		resetScratchMemory(scratchMark);
+		shrinkInHeap(&sharedHeap, ptr, slength(ptr)+1);
+	}
 	cpy(&v.data, &ptr, sizeof(char*));
+	releaseTemporaries(heldTemporaries);
 	if (tmpStr1 != NULL) freeMemoryInHeap(tmpStr1);
 	if (tmpStr2 != NULL) freeMemoryInHeap(tmpStr2);
 	return v;
@@ -334,18 +394,16 @@ void raiseError(unsigned char errorCode) {
 }
 
 /**
- * Initialises the symbol table in core memory
+ * Initialises the symbol table in core memory, along with the core and shared heaps
  */
 struct symbol_node* initialiseSymbolTable(int numberSymbols) {
-    unsigned char heapInUse=0;
-    unsigned short coreHeapChunkLength;
-    unsigned int sharedHeapChunkLength;
-    coreHeapChunkLength=LOCAL_CORE_MEMORY_MAP_TOP-((int) sharedData->core_ctrl[myId].heap_start)-(sizeof(unsigned short) + sizeof(unsigned char));
-    sharedHeapChunkLength=SHARED_HEAP_DATA_AREA_PER_CORE-(sizeof(unsigned int) + sizeof(unsigned char));
-    cpy(sharedData->core_ctrl[myId].heap_start, &coreHeapChunkLength, sizeof(unsigned short));
-    cpy(&sharedData->core_ctrl[myId].heap_start[2], &heapInUse, sizeof(unsigned char));
-    cpy(sharedData->core_ctrl[myId].shared_heap_start, &sharedHeapChunkLength, sizeof(unsigned int));
-    cpy(&sharedData->core_ctrl[myId].shared_heap_start[4], &heapInUse, sizeof(unsigned char));
+    int coreHeapSize=LOCAL_CORE_MEMORY_MAP_TOP-((int) sharedData->core_ctrl[myId].heap_start);
+    initialiseHeap(&coreHeap, sharedData->core_ctrl[myId].heap_start, coreHeapSize > 0 ? coreHeapSize : 0, sizeof(unsigned short));
+    initialiseHeap(&sharedHeap, sharedData->core_ctrl[myId].shared_heap_start, SHARED_HEAP_DATA_AREA_PER_CORE-SHARED_SCRATCH_AREA_PER_CORE,
+            sizeof(unsigned int));
+    initialiseScratchArena(&scratchArena, sharedData->core_ctrl[myId].shared_heap_start+(SHARED_HEAP_DATA_AREA_PER_CORE-SHARED_SCRATCH_AREA_PER_CORE),
+            SHARED_SCRATCH_AREA_PER_CORE);
+    heapTemporaries.number=0;
 
 	return (void*) sharedData->core_ctrl[myId].symbol_table;
 }
@@ -354,32 +412,39 @@ struct symbol_node* initialiseSymbolTable(int numberSymbols) {
  * Allocates some memory in the heap
  */
 char* getHeapMemory(int size, char isShared, int currentSymbolEntries, struct symbol_node* symbolTable) {
+#ifdef INTERPRETER_INCREMENTAL_GC
+	if (currentSymbolEntries >= 0 && symbolTable != NULL) {
+		collectGarbageIncrementally(heaps, 2, &heapTemporaries, currentSymbolEntries, symbolTable);
+	}
+#endif
 	if (sharedData->allInSharedMemory || isShared) {
-		char * dS=allocateChunkInHeapMemory(size, 1);
+		char * dS=allocateInHeap(&sharedHeap, size);
 		if (dS == NULL) {
             if (currentSymbolEntries >= 0 && symbolTable != NULL) {
-                performGC(currentSymbolEntries, symbolTable, 1);
-                dS=allocateChunkInHeapMemory(size, 1);
+                collectGarbage(heaps, 2, &heapTemporaries, currentSymbolEntries, symbolTable);
+                dS=allocateInHeap(&sharedHeap, size);
             }
             if (dS == NULL) raiseError(ERR_OUT_OF_SHARED_HEAP_MEM);
 		}
 		return dS;
 	} else {
-		char * dS=allocateChunkInHeapMemory(size, 0);
+		char * dS=allocateInHeap(&coreHeap, size);
 		if (dS == NULL) {
             if (currentSymbolEntries >= 0 && symbolTable != NULL) {
-                performGC(currentSymbolEntries, symbolTable, 0);
-                dS=allocateChunkInHeapMemory(size, 0);
+                collectGarbage(heaps, 2, &heapTemporaries, currentSymbolEntries, symbolTable);
+                dS=allocateInHeap(&coreHeap, size);
+#ifdef INTERPRETER_COMPACTING_GC
+                // The core heap might hold enough free memory but not in one piece, rather than spill into the slower shared
+                // heap it is compacted
+                if (dS == NULL && compactHeap(&coreHeap, size, &heapTemporaries, currentSymbolEntries, symbolTable)) {
+                    dS=allocateInHeap(&coreHeap, size);
+                }
+#endif
             }
             if (dS == NULL) {
-                dS=allocateChunkInHeapMemory(size, 1);
-                if (dS == NULL) {
-                    if (currentSymbolEntries >= 0 && symbolTable != NULL) {
-                        performGC(currentSymbolEntries, symbolTable, 1);
-                        dS=allocateChunkInHeapMemory(size, 1);
-                    }
-                    if (dS == NULL) raiseError(ERR_OUT_OF_CORE_SHARED_HEAP_MEM);
-                }
+                // Garbage has already been collected in both heaps so there is no more to free
+                dS=allocateInHeap(&sharedHeap, size);
+                if (dS == NULL) raiseError(ERR_OUT_OF_CORE_SHARED_HEAP_MEM);
             }
 		}
 		return dS;
@@ -387,179 +452,83 @@ char* getHeapMemory(int size, char isShared, int currentSymbolEntries, struct sy
 }
 
 void freeMemoryInHeap(void * addr) {
-    unsigned chunkInUse=0;
     char * address=(char*) addr;
-    cpy(address-1, &chunkInUse, sizeof(unsigned char));
-    consolidateHeapChunks((int) address > LOCAL_CORE_MEMORY_MAP_TOP);
+    freeInHeap((int) address > LOCAL_CORE_MEMORY_MAP_TOP ? &sharedHeap : &coreHeap, address);
 }
 
+/**
+ * Collects the garbage in both heaps, in the incremental build this is only the next step of collecting it
+ */
 static void garbageCollect(int currentSymbolEntries, struct symbol_node* symbolTable) {
-    performGC(currentSymbolEntries, symbolTable, 0);
-    performGC(currentSymbolEntries, symbolTable, 1);
+#ifdef INTERPRETER_INCREMENTAL_GC
+    collectGarbageIncrementally(heaps, 2, &heapTemporaries, currentSymbolEntries, symbolTable);
+#else
+    collectGarbage(heaps, 2, &heapTemporaries, currentSymbolEntries, symbolTable);
+#endif
 }
 
-static void performGC(int currentSymbolEntries, struct symbol_node* symbolTable, char inSharedMemory) {
-    unsigned char chunkInUse, freedMem=0;
-    unsigned short coreChunkLength;
-    unsigned int chunkLength;
-    char * heapPtr;
+/**
+ * Counts a further variable referencing some memory if it is in the heap, or if permanently then it is held somewhere uncounted
+ */
+void retainHeapMemory(char * address, char permanently) {
+    struct heap_definition * heap=getHeapHolding(address);
+    if (heap != NULL) retainInHeap(heap, address, permanently);
+}
 
-    size_t headersize, lenStride;
-    if (inSharedMemory) {
-        heapPtr=sharedData->core_ctrl[myId].shared_heap_start;
-        headersize=sizeof(unsigned char) + sizeof(unsigned int);
-        lenStride=sizeof(unsigned int);
-    } else {
-        heapPtr=sharedData->core_ctrl[myId].heap_start;
-        headersize=sizeof(unsigned short) + sizeof(unsigned char);
-        lenStride=sizeof(unsigned short);
-    }
-    while (1==1) {
-        if (inSharedMemory) {
-            cpy(&chunkLength, heapPtr, sizeof(unsigned int));
-        } else {
-            cpy(&coreChunkLength, heapPtr, sizeof(unsigned short));
-            chunkLength=coreChunkLength;
-        }
-        cpy(&chunkInUse, &heapPtr[lenStride], sizeof(unsigned char));
-        if (chunkInUse && !isMemoryAddressFound(&heapPtr[headersize], currentSymbolEntries, symbolTable)) {
-            chunkInUse=0;
-            cpy(&heapPtr[lenStride], &chunkInUse, sizeof(unsigned char));
-            freedMem=1;
-        }
-        heapPtr+=chunkLength + headersize;
-        if (inSharedMemory && heapPtr  >= sharedData->core_ctrl[myId].shared_heap_start + SHARED_HEAP_DATA_AREA_PER_CORE) {
-            break;
-        } else if ((int) heapPtr  >= LOCAL_CORE_MEMORY_MAP_TOP) {
-            break;
-        }
-    }
-    if (freedMem) consolidateHeapChunks(inSharedMemory);
+/**
+ * Counts a variable no longer referencing some memory if it is in the heap, if reclaim is set then the memory is freed once
+ * nothing references it
+ */
+void releaseHeapMemory(char * address, char reclaim) {
+    struct heap_definition * heap=getHeapHolding(address);
+    if (heap != NULL) releaseInHeap(heap, address, &heapTemporaries, reclaim);
 }
 
-static char isMemoryAddressFound(char * address, int currentSymbolEntries, struct symbol_node* symbolTable) {
-    int i;
-    char * ptr;
-    for (i=0;i<=currentSymbolEntries;i++) {
-        if (symbolTable[i].state==ALLOCATED && (symbolTable[i].value.dtype==ARRAY || symbolTable[i].value.type==STRING_TYPE)) {
-            cpy(&ptr, symbolTable[i].value.data, sizeof(char*));
-            if (address == ptr) return 1;
-        }
-    }
-    return 0;
-}
-
-static void consolidateHeapChunks(char inSharedMemory) {
-    unsigned char chunkInUse;
-    unsigned short coreChunkLength, nextCoreChunkLength;
-    unsigned int chunkLength, nextChunkLength;
-    size_t headersize, lenStride;
-    char * heapPtr;
-    if (inSharedMemory) {
-        heapPtr=sharedData->core_ctrl[myId].shared_heap_start;
-        headersize=sizeof(unsigned int) + sizeof(unsigned char);
-        lenStride=sizeof(unsigned int);
-    } else {
-        heapPtr=sharedData->core_ctrl[myId].heap_start;
-        headersize=sizeof(unsigned short) + sizeof(unsigned char);
-        lenStride=sizeof(unsigned short);
-    }
-    while (1==1) {
-        if (inSharedMemory) {
-            cpy(&chunkLength, heapPtr, sizeof(unsigned int));
-        } else {
-            cpy(&coreChunkLength, heapPtr, sizeof(unsigned short));
-            chunkLength=coreChunkLength;
-        }
-        cpy(&chunkInUse, &heapPtr[lenStride], sizeof(unsigned char));
-        while (!chunkInUse) {
-            if (inSharedMemory && heapPtr + chunkLength + headersize +lenStride >= sharedData->core_ctrl[myId].shared_heap_start + SHARED_HEAP_DATA_AREA_PER_CORE) {
-                break;
-            } else if ((int) heapPtr + chunkLength + headersize +lenStride >= LOCAL_CORE_MEMORY_MAP_TOP) {
-                break;
-            }
-            cpy(&chunkInUse, &heapPtr[chunkLength + headersize +lenStride], sizeof(unsigned char));
-            if (!chunkInUse) {
-                if (inSharedMemory) {
-                    cpy(&nextChunkLength, &heapPtr[chunkLength + headersize], sizeof(unsigned int));
-                } else {
-                    cpy(&nextCoreChunkLength, &heapPtr[chunkLength + headersize], sizeof(unsigned short));
-                    nextChunkLength=nextCoreChunkLength;
-                }
-                chunkLength+=nextChunkLength+headersize;
-                if (inSharedMemory) {
-                    cpy(heapPtr, &chunkLength, sizeof(unsigned int));
-                } else {
-                    coreChunkLength=chunkLength;
-                    cpy(heapPtr, &coreChunkLength, sizeof(unsigned short));
-                }
-            }
-        }
-        heapPtr+=chunkLength + headersize;
-        if (inSharedMemory && heapPtr  >= sharedData->core_ctrl[myId].shared_heap_start + SHARED_HEAP_DATA_AREA_PER_CORE) {
-            break;
-        } else if ((int) heapPtr  >= LOCAL_CORE_MEMORY_MAP_TOP) {
-            break;
-        }
-    }
+/**
+ * Gets the heap holding some memory, or NULL if it is not in either heap (such as a string literal in the byte code)
+ */
+static struct heap_definition * getHeapHolding(char * address) {
+    if (isAddressInHeap(&coreHeap, address)) return &coreHeap;
+    if (isAddressInHeap(&sharedHeap, address)) return &sharedHeap;
+    return NULL;
 }
 
-static char * allocateChunkInHeapMemory(int size, char inSharedMemory) {
-    unsigned char chunkInUse;
-    unsigned short coreChunkLength;
-    unsigned int chunkLength;
-    char * heapPtr;
+/**
+ * Allocates some memory in the scratch arena, returning NULL if the arena is full
+ */
+char* getScratchMemory(int size) {
+    return allocateInScratchArena(&scratchArena, size);
+}
 
-    size_t headersize, lenStride;
-    if (inSharedMemory) {
-        heapPtr=sharedData->core_ctrl[myId].shared_heap_start;
-        headersize=sizeof(unsigned char) + sizeof(unsigned int);
-        lenStride=sizeof(unsigned int);
-    } else {
-        heapPtr=sharedData->core_ctrl[myId].heap_start;
-        headersize=sizeof(unsigned short) + sizeof(unsigned char);
-        lenStride=sizeof(unsigned short);
-    }
-    while (1==1) {
-        if (inSharedMemory) {
-            cpy(&chunkLength, heapPtr, sizeof(unsigned int));
-        } else {
-            cpy(&coreChunkLength, heapPtr, sizeof(unsigned short));
-            chunkLength=coreChunkLength;
-        }
-        cpy(&chunkInUse, &heapPtr[lenStride], sizeof(unsigned char));
-        if (!chunkInUse && chunkLength >= (size + headersize)) {
-            char * splitChunk=(char*) (heapPtr + ((chunkLength + headersize) - (size + headersize)));
-
-            chunkLength=chunkLength - size - headersize;
-            if (inSharedMemory) {
-                cpy(heapPtr, &chunkLength, sizeof(unsigned int));
-            } else {
-                coreChunkLength=chunkLength;
-                cpy(heapPtr, &coreChunkLength, sizeof(unsigned short));
-            }
+/**
+ * Gets the top of the scratch arena, which the arena is later reset to in order to free everything allocated in it since
+ */
+char* getScratchMark(void) {
+    return scratchArena.top;
+}
 
-            chunkLength=size;
-            if (inSharedMemory) {
-                cpy(splitChunk, &chunkLength, sizeof(unsigned int));
-            } else {
-                coreChunkLength=chunkLength;
-                cpy(splitChunk, &coreChunkLength, sizeof(unsigned short));
-            }
-            chunkInUse=1;
-            cpy(&splitChunk[lenStride], &chunkInUse, sizeof(unsigned char));
+void resetScratchMemory(char * mark) {
+    scratchArena.top=mark;
+}
 
-            return splitChunk + headersize;
-        } else {
-            heapPtr+=chunkLength + headersize;
-            if (inSharedMemory && heapPtr  >= sharedData->core_ctrl[myId].shared_heap_start + SHARED_HEAP_DATA_AREA_PER_CORE) {
-                break;
-            } else if ((int) heapPtr  >= LOCAL_CORE_MEMORY_MAP_TOP) {
-                break;
-            }
-        }
-    }
-    return NULL;
+/**
+ * Determines whether some memory is in this core's area of shared memory, the shared heap or scratch arena
+ */
+static char isInSharedMemory(char * address) {
+    return address >= sharedData->core_ctrl[myId].shared_heap_start &&
+            address < sharedData->core_ctrl[myId].shared_heap_start+SHARED_HEAP_DATA_AREA_PER_CORE;
+}
+
+/**
+ * Holds some heap memory that is not held by a variable, such as the operand of an expression, so that collecting garbage does
+ * not free it before it is used. Temporaries are released in the reverse order to that held
+ */
+void holdTemporary(char * address) {
+    holdHeapTemporary(&heapTemporaries, address);
+}
+
+void releaseTemporaries(int number) {
+    releaseHeapTemporaries(&heapTemporaries, number);
 }
 
 /**
@@ -583,6 +552,16 @@ char* getStackMemory(int size, char isShared) {
 		}
 }
 
+/**
+ * Determines whether the C stack has at least some number of bytes free, it grows down from the top of the interpreter's area of
+ * core memory towards the end of its data (end is provided by the linker script)
+ */
+int hasCStackSpace(int size) {
+	extern char end;
+	char marker;
+	return (unsigned int) &marker >= (unsigned int) &end + size;
+}
+
 /**
  * Removes items from the stack which are no longer needed (i.e. the reference has been removed due to the function returning.)
  */
@@ -904,16 +883,27 @@ void cpy(volatile void* to, volatile void * from, unsigned int size) {
 }
 
 /**
- * Copies some string into shared memory and sets the location in the data core area
+ * Sets the location in the data core area of some string for the host to read, copying it into shared memory unless it is
+ * already there. The copy is only needed until the host has read it so is made in the scratch arena, which the caller resets,
+ * if there is room and otherwise in the shared heap, in which case it is returned for the caller to free. The string is held
+ * whilst heap memory is allocated as it might not be held by a variable
  */
 static char* copyStringToSharedMemoryAndSetLocation(char * string, int start, int currentSymbolEntries, struct symbol_node* symbolTable) {
-	int len=slength(string)+1;
-	char* ptr=getHeapMemory(len, 1, currentSymbolEntries, symbolTable);
+	char * ptr=string, * heapCopy=NULL;
+	if (!isInSharedMemory(string)) {
+		int len=slength(string)+1;
+		ptr=getScratchMemory(len);
+		if (ptr == NULL) {
+			holdTemporary(string);
+			heapCopy=ptr=getHeapMemory(len, 1, currentSymbolEntries, symbolTable);
+			releaseTemporaries(1);
+		}
+		cpy(ptr, string, len);
+	}
 	unsigned int relativeLocation;
-	cpy(ptr, string, len);
 	relativeLocation=ptr-sharedData->core_ctrl[myId].shared_heap_start;
 	cpy(&sharedData->core_ctrl[myId].data[start], &relativeLocation, sizeof(unsigned int));
-	return ptr;
+	return heapCopy;
 }
 
 /**
@@ -0,0 +1,32 @@
+/*
+Stresses the heap, repeatedly allocating and freeing arrays of varying sizes whilst others remain live and building up strings, which
+are only reclaimed by the garbage collector. The checksum printed at the end is the same however the heap is implemented
+To run: epython heapstress.py
+*/
+
+from memory import *
+
+checksum=0
+i=0
+while i<20000:
+  size=(i*7)%64+1
+  a=[i]*size
+  b=[0]*(size*2)
+  c=[size]*((i%5)+1)
+  a[size-1]=size
+  b[size]=a[size-1]
+  checksum+=a[0]%7+b[size]+c[0]
+  free(a)
+  if i%3==0:
+    free(c)
+  free(b)
+  if i%100==0:
+    s="heap"
+    j=0
+    while j<10:
+      s=s+str(j)
+      j+=1
+    checksum+=size
+    gc()
+  i+=1
+print "Checksum is "+str(checksum)
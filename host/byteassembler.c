@@ -34,7 +34,18 @@
 #include "byteassembler.h"
 #include "misc.h"
 
-#define RECURSION_VAR_DEPTH 10
+#define UNKNOWN_VARIABLE_SLOT 0xFFFF
+// A postfix expression starts with the token, the operand stack depth it needs and the length of its body
+#define POSTFIX_HEADER_SIZE (sizeof(unsigned char)*2+sizeof(unsigned short))
+// An if/elif chain comparing a variable against at least this many distinct integer constants is assembled as a switch
+#define SWITCH_MIN_ARMS 3
+// A comparison of a variable against an integer constant, the token, variable token and slot then integer token and constant
+#define CONSTANT_COMPARISON_SIZE (sizeof(unsigned char)*3+sizeof(unsigned short)+sizeof(int))
+// A conditional starts with its token, the comparison and the length of its then block
+#define CONSTANT_CONDITIONAL_HEADER_SIZE (sizeof(unsigned char)+CONSTANT_COMPARISON_SIZE+sizeof(unsigned short))
+#define GOTO_SIZE (sizeof(unsigned char)+sizeof(unsigned short))
+// A call starts with its token, the location of the function and the number of arguments, followed by the slot of each argument
+#define FNCALL_HEADER_SIZE (sizeof(unsigned char)+sizeof(unsigned short)*2)
 
 /*
  * Node for holding a specific scope information - the variables that belong to
@@ -48,22 +59,41 @@ struct scope_info {
 };
 
 /*
- * Information about a specific variable, mapping it to a unique ID that will be
- * represented in the symbol table
+ * Information about a specific variable, mapping it to the slot that it occupies in
+ * the symbol table. This is either a global slot or a slot in the frame of a function
  */
 struct variable_node {
 	char * name;
-	unsigned short id;
+	unsigned short slot;
 	struct variable_node * next;
 };
 
+/*
+ * The conditional most recently assembled, if it compares a variable against an integer constant, described as the arms of an
+ * if/elif chain so that the conditional before it in the chain can extend it. Each arm is the block run for one constant, held
+ * as its location and length in the conditional's memory along with the else block, and the labels are those of the gotos in
+ * the chain which jump to its end
+ */
+struct conditional_chain {
+	struct memorycontainer * container;
+	unsigned short slot, numberArms, numberLabels;
+	int * keys, * labels;
+	unsigned int * armStarts, * armLengths;
+	unsigned int elseStart, elseLength;
+};
+
 // The current for line, this is is used in conjunction with GOTO to code for repetition
 int currentForLine=-1;
-int currentSymbolTableId, isFnRecursive;
+int isFnRecursive;
 char * currentFunctionName=NULL;
 
-static unsigned short current_var_id=1; // Current variable id (unique for each unique variable)
+static unsigned short current_global_slot=0; // Next free global slot (variables of the main code)
+static unsigned short current_local_slot=0; // Next free slot in the frame of the function being assembled
+static char * assignedLocals=NULL; // Whether each slot in the frame of the function being assembled is assigned to
+static unsigned short numberAssignedLocals=0;
+static int postfixExpressions=0; // Whether arithmetic is emitted as flat postfix blocks rather than prefix trees
 static struct scope_info * scope=NULL; // Scope stack
+static struct conditional_chain conditionalChain; // The most recently assembled conditional, if it could be part of a switch
 struct function_call_tree_node *currentCall=NULL; // The current function call tree state
 
 static unsigned short addVariable(char*);
@@ -73,13 +103,36 @@ static int areStringsEqualIgnoreCase(char*, char*);
 static unsigned short getVariableId(char*, int);
 static struct memorycontainer* createUnaryExpression(unsigned char token, struct memorycontainer*);
 static struct memorycontainer* createExpression(unsigned char, struct memorycontainer*, struct memorycontainer*);
+static struct memorycontainer* createShortCircuitExpression(unsigned char, struct memorycontainer*, struct memorycontainer*);
+static struct memorycontainer* createArithmeticExpression(unsigned char, struct memorycontainer*, struct memorycontainer*);
+static unsigned char getPostfixDepth(struct memorycontainer*);
+static unsigned int appendPostfixOperand(struct memorycontainer*, struct memorycontainer*, unsigned int, unsigned int);
 static struct memorycontainer* appendLetIfNoAliasStatement(char *, struct memorycontainer*);
+static struct memorycontainer* createOperatorAssignStatement(unsigned short, struct memorycontainer*);
+static unsigned int appendConditional(struct memorycontainer*, unsigned char, struct memorycontainer*, unsigned int);
+static int isArithmeticToken(unsigned char);
+static int isSimpleIndexExpression(struct memorycontainer*);
+static int getConstantComparison(struct memorycontainer*, unsigned short*, int*);
+static int isConditionalChainKey(int);
+static void recordConditionalChain(struct memorycontainer*, unsigned short, int, unsigned int, unsigned int, unsigned int, unsigned int, int);
+static void addConditionalChainLabel(int);
+static void clearConditionalChain(void);
+static struct memorycontainer* createIfElseStatement(struct memorycontainer*, struct memorycontainer*, struct memorycontainer*, int);
+static struct memorycontainer* createSwitchStatement(int, struct memorycontainer*, struct memorycontainer*);
+static struct memorycontainer* createRangeForStatement(char*, struct memorycontainer*, struct memorycontainer*);
+static struct lineDefinition* findRangeCall(struct memorycontainer*);
+static unsigned short getCallArgumentSlot(struct memorycontainer*, unsigned int, unsigned short);
+static void removeLineDefinition(struct memorycontainer*, struct lineDefinition*);
+static void removeCalledFunction(char*);
+static struct memorycontainer* createSlotExpression(unsigned short);
+static void markVariableAssigned(unsigned short);
 
 /**
  * Function entry, used for tracking recursive functions and the call tree
  */
 void enterFunction(char* fn_name) {
-	currentSymbolTableId=current_var_id;
+	current_local_slot=0;
+	if (assignedLocals != NULL) memset(assignedLocals, 0, numberAssignedLocals);
 	isFnRecursive=0;
 	currentFunctionName=(char*) malloc(strlen(fn_name) + 1);
 	strcpy(currentFunctionName, fn_name);
@@ -89,21 +142,51 @@ void enterFunction(char* fn_name) {
 }
 
 /**
- * Gets the total number of entries in the symbol table
+ * Gets the total number of entries in the symbol table, recursive functions have room for a frame at every level of the call
+ * stack. This is capped at the largest size the table can be given, a deeper call then raises an error in the interpreter
  */
 unsigned short getNumberEntriesInSymbolTable() {
-	return (current_var_id - getNumberOfSymbolEntriesNotUsed()) + (getNumberSymbolTableEntriesForRecursion()*(RECURSION_VAR_DEPTH-1));
+	int entries=current_global_slot + getNumberSymbolTableEntriesForFunctions() +
+			(getNumberSymbolTableEntriesForRecursion()*(MAX_CALL_STACK_DEPTH-1));
+	return entries > 0xFFFF ? 0xFFFF : (unsigned short) entries;
+}
+
+/**
+ * Adds global slots beyond those of the main code's variables, which the optimiser uses to hold values it has computed
+ */
+void addGlobalSlots(unsigned short number) {
+	current_global_slot+=number;
+}
+
+/**
+ * Sets whether arithmetic expressions are to be emitted in postfix form, evaluated by the interpreter on an operand stack
+ */
+void setPostfixExpressions(int enabled) {
+	postfixExpressions=enabled;
 }
 
 /**
  * Sets the total number of entries in the symbol table
  */
 void setNumberEntriesInSymbolTable(unsigned short e) {
-	current_var_id=e;
+	current_global_slot=e;
+}
+
+/**
+ * Creates the header of the program, which is the number of global slots that the interpreter must initialise
+ */
+struct memorycontainer* createProgramHeader(void) {
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
+	memoryContainer->length=sizeof(unsigned short);
+	memoryContainer->data=(char*) malloc(memoryContainer->length);
+	memoryContainer->lineDefns=NULL;
+
+	appendVariable(memoryContainer, current_global_slot, 0);
+	return memoryContainer;
 }
 
 struct memorycontainer* appendNativeCallFunctionStatement(char* functionName, struct stack_t* args, struct memorycontainer* singleArg) {
-    struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+    struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=(sizeof(unsigned char)*2) + sizeof(unsigned short);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -179,42 +262,50 @@ struct memorycontainer* appendNativeCallFunctionStatement(char* functionName, st
 
 /**
  * Appends and returns a call function, this is added as a placeholder and then resolved at the end to point to the absolute byte code location
- * which is needed as the function might appear at any point
+ * which is needed as the function might appear at any point. An argument which is a variable is passed as its slot (and aliased by the
+ * function if it assigns to it), any other is passed by value with its expression following the slots of the arguments
  */
 struct memorycontainer* appendCallFunctionStatement(char* functionName, struct stack_t* args) {
 	char * last_dot=strrchr(functionName,'.');
 	if (last_dot != NULL) functionName=last_dot+1;
 	if (currentFunctionName != NULL && strcmp(currentFunctionName, functionName) == 0) isFnRecursive=1;
 
-	struct memorycontainer* assignmentContainer=NULL;
+	// The arguments of range and xrange which are not variables are still assigned to hidden variables first, so that a for loop
+	// over the call can be assembled as a counted loop reading its start, stop and step from these
+	int isCallVariable=doesVariableExist(functionName);
+	int isRangeCall=!isCallVariable && (strcmp(functionName, "range") == 0 || strcmp(functionName, "xrange") == 0);
+	struct memorycontainer* assignmentContainer=NULL, *valuesContainer=NULL;
 	unsigned short numArgs=(unsigned short) getStackSize(args);
-	char *isArgIdentifier=(char*) malloc(numArgs);
-	unsigned short *varIds=(unsigned short*) malloc(sizeof(unsigned short) * numArgs);
+	unsigned short *varIds=(unsigned short*) malloc(sizeof(unsigned short) * (numArgs > 0 ? numArgs : 1));
 	char * varname=(char*) malloc(strlen(functionName)+5);
 	int i;
 	for (i=0;i<numArgs;i++) {
 		struct memorycontainer* expression=getExpressionAt(args, i);
 		unsigned char command=((unsigned char*) expression->data)[0];
-		if (command != IDENTIFIER_TOKEN) {
-			isArgIdentifier[i]=0;
+		if (command == LOAD_SLOT_TOKEN) {
+			// The function might assign to its argument, which is then an assignment of this variable
+			varIds[i]=*((unsigned short*) (&((char*) expression->data)[1]));
+			markVariableAssigned(varIds[i]);
+			free(expression->data);
+		} else if (isRangeCall) {
 			sprintf(varname,"%s#%d", functionName, i);
 			if (assignmentContainer == NULL) {
-				assignmentContainer=appendLetStatement(varname, getExpressionAt(args, i));
+				assignmentContainer=appendLetStatement(varname, expression);
 			} else {
-				assignmentContainer=concatenateMemory(assignmentContainer, appendLetStatement(varname, getExpressionAt(args, i)));
+				assignmentContainer=concatenateMemory(assignmentContainer, appendLetStatement(varname, expression));
 			}
+			varIds[i]=getVariableId(varname, 0);
 		} else {
-			isArgIdentifier[i]=1;
-			varIds[i]=*((unsigned short*) (&((char*) expression->data)[1]));
-			free(expression->data);
+			varIds[i]=VALUE_ARGUMENT_SLOT;
+			valuesContainer=valuesContainer == NULL ? expression : concatenateMemory(valuesContainer, expression);
 		}
 	}
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned short)*(2+numArgs)+sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
     unsigned int position=0;
 
-	if (doesVariableExist(functionName)) {
+	if (isCallVariable) {
         memoryContainer->lineDefns=NULL;
         position=appendStatement(memoryContainer, FNCALL_BY_VAR_TOKEN, position);
         position=appendVariable(memoryContainer, getVariableId(functionName, 0), position);
@@ -234,17 +325,10 @@ struct memorycontainer* appendCallFunctionStatement(char* functionName, struct s
 	}
 	position=appendVariable(memoryContainer, numArgs, position);
 
-	for (i=0;i<numArgs;i++) {
-		if (isArgIdentifier[i]) {
-			position=appendVariable(memoryContainer, varIds[i], position);
-		} else {
-			sprintf(varname,"%s#%d", functionName, i);
-			position=appendVariable(memoryContainer, getVariableId(varname, 0), position);
-		}
-	}
+	for (i=0;i<numArgs;i++) position=appendVariable(memoryContainer, varIds[i], position);
+	if (valuesContainer != NULL) memoryContainer=concatenateMemory(memoryContainer, valuesContainer);
 	clearStack(args);
 	free(varname);
-	free(isArgIdentifier);
 	free(varIds);
 	if (currentCall==NULL) {
 		mainCodeCallTree.calledFunctions[mainCodeCallTree.number_of_calls]=(char*)malloc(strlen(functionName)+1);
@@ -267,7 +351,7 @@ struct memorycontainer* appendCallFunctionStatement(char* functionName, struct s
  */
 struct memorycontainer* appendGotoStatement(int lineNumber) {
 	struct lineDefinition * defn = (struct lineDefinition*) malloc(sizeof(struct lineDefinition));
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned short)+sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 
@@ -286,11 +370,13 @@ struct memorycontainer* appendGotoStatement(int lineNumber) {
  * termination check at each iteration along with jumping to next iteration if applicable
  */
 struct memorycontainer* appendForStatement(char * identifier, struct memorycontainer* exp, struct memorycontainer* block) {
+	struct memorycontainer* rangeLoop=createRangeForStatement(identifier, exp, block);
+	if (rangeLoop != NULL) return rangeLoop;
 	struct memorycontainer* initialLet=appendLetStatement("epy_i_ctr", createIntegerExpression(0));
 	struct memorycontainer* variantLet=appendLetStatement(identifier, createIntegerExpression(0));
 	struct memorycontainer* incrementLet=appendLetStatement("epy_i_ctr", createAddExpression(createIdentifierExpression("epy_i_ctr"), createIntegerExpression(1)));
 
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char)*2+sizeof(unsigned short) * 4 + exp->length + (block != NULL ? block->length : 0) +
 			initialLet->length + variantLet->length + incrementLet->length;
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
@@ -328,19 +414,171 @@ struct memorycontainer* appendForStatement(char * identifier, struct memoryconta
 	return memoryContainer;
 }
 
+/**
+ * If a for loop iterates over a call to range or xrange then creates a counted loop instead, this evaluates the start, stop and
+ * step once into hidden variables and counts between them rather than allocating the array of values. Returns NULL if the
+ * expression is not solely such a call
+ */
+static struct memorycontainer* createRangeForStatement(char * identifier, struct memorycontainer* exp, struct memorycontainer* block) {
+	struct lineDefinition * callDefn=findRangeCall(exp);
+	if (callDefn == NULL) return NULL;
+	unsigned int callPoint=callDefn->currentpoint-sizeof(unsigned char);
+	unsigned short numArgs, argSlots[3], i;
+	memcpy(&numArgs, &exp->data[callPoint+sizeof(unsigned char)+sizeof(unsigned short)], sizeof(unsigned short));
+	for (i=0;i<numArgs;i++) argSlots[i]=getCallArgumentSlot(exp, callPoint, i);
+	removeCalledFunction(callDefn->name);
+	removeLineDefinition(exp, callDefn);
+
+	// What is left of the expression assigns the arguments which are not variables, each bound is then copied into a hidden
+	// variable so that the loop is unaffected by the body changing the variable it came from
+	exp->length=callPoint;
+	struct memorycontainer* initialLets=concatenateMemory(exp, appendLetStatement("epy_i_ctr",
+			numArgs == 1 ? createIntegerExpression(0) : createSlotExpression(argSlots[0])));
+	initialLets=concatenateMemory(initialLets, appendLetStatement("epy_i_stop", createSlotExpression(argSlots[numArgs == 1 ? 0 : 1])));
+	initialLets=concatenateMemory(initialLets, appendLetStatement("epy_i_step",
+			numArgs == 3 ? createSlotExpression(argSlots[2]) : createIntegerExpression(1)));
+	// The loop variable starts as the counter, so it is of the same type whether or not the body has run
+	initialLets=concatenateMemory(initialLets, appendLetStatement(identifier, createSlotExpression(getVariableId("epy_i_ctr", 0))));
+
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
+	memoryContainer->length=sizeof(unsigned char)*2+sizeof(unsigned short) * 6 + initialLets->length + (block != NULL ? block->length : 0);
+	memoryContainer->data=(char*) malloc(memoryContainer->length);
+	memoryContainer->lineDefns=NULL;
+
+	unsigned int position=0;
+
+	struct lineDefinition * defn = (struct lineDefinition*) malloc(sizeof(struct lineDefinition));
+	defn->next=memoryContainer->lineDefns;
+	defn->type=0;
+	defn->linenumber=currentForLine;
+	defn->currentpoint=initialLets->length;
+	memoryContainer->lineDefns=defn;
+
+	position=appendMemory(memoryContainer, initialLets, position);
+	position=appendStatement(memoryContainer, FOR_RANGE_TOKEN, position);
+	position=appendVariable(memoryContainer, getVariableId(identifier, 0), position);
+	position=appendVariable(memoryContainer, getVariableId("epy_i_ctr", 0), position);
+	position=appendVariable(memoryContainer, getVariableId("epy_i_stop", 0), position);
+	position=appendVariable(memoryContainer, getVariableId("epy_i_step", 0), position);
+	unsigned short length=(unsigned short) (block != NULL ? block->length : 0);
+	memcpy(&memoryContainer->data[position], &length, sizeof(unsigned short));
+	position+=sizeof(unsigned short);
+	if (block != NULL) position=appendMemory(memoryContainer, block, position);
+	position=appendStatement(memoryContainer, GOTO_TOKEN, position);
+	defn = (struct lineDefinition*) malloc(sizeof(struct lineDefinition));
+	defn->next=memoryContainer->lineDefns;
+	defn->type=1;
+	defn->linenumber=currentForLine;
+	defn->currentpoint=position;
+	memoryContainer->lineDefns=defn;
+	currentForLine--;
+	return memoryContainer;
+}
+
+/**
+ * Finds the call to range or xrange if an expression is solely this, it then consists of the assignments of those arguments
+ * which are not variables followed by the call itself. Returns NULL if the expression is anything else
+ */
+static struct lineDefinition* findRangeCall(struct memorycontainer* expression) {
+	struct lineDefinition * defn;
+	unsigned short numArgs, slot, i;
+	for (defn=expression->lineDefns;defn != NULL;defn=defn->next) {
+		if (defn->type != 3) continue;
+		int isXRange=strcmp(defn->name, "xrange") == 0;
+		if (!isXRange && strcmp(defn->name, "range") != 0) continue;
+		unsigned int callPoint=defn->currentpoint-sizeof(unsigned char);
+		if (((unsigned char*) expression->data)[callPoint] != FNCALL_TOKEN) continue;
+		memcpy(&numArgs, &expression->data[callPoint+sizeof(unsigned char)+sizeof(unsigned short)], sizeof(unsigned short));
+		if (numArgs < 1 || numArgs > 3 || (isXRange && numArgs != 2)) continue;
+		if (callPoint+FNCALL_HEADER_SIZE+sizeof(unsigned short)*numArgs != expression->length) continue;
+		if (callPoint == 0) return defn;
+		// Otherwise the call is at the end of something else unless what comes before it is assigning one of its arguments
+		if (((unsigned char*) expression->data)[0] != STORE_SLOT_TOKEN) continue;
+		memcpy(&slot, &expression->data[sizeof(unsigned char)], sizeof(unsigned short));
+		for (i=0;i<numArgs;i++) {
+			if (getCallArgumentSlot(expression, callPoint, i) == slot) return defn;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Retrieves the slot of an argument passed to the call at some point in memory
+ */
+static unsigned short getCallArgumentSlot(struct memorycontainer* memoryContainer, unsigned int callPoint, unsigned short argument) {
+	unsigned short slot;
+	memcpy(&slot, &memoryContainer->data[callPoint+FNCALL_HEADER_SIZE+sizeof(unsigned short)*argument], sizeof(unsigned short));
+	return slot;
+}
+
+/**
+ * Removes the line definition of a call from some memory, for a call which has been replaced by something else
+ */
+static void removeLineDefinition(struct memorycontainer* memoryContainer, struct lineDefinition* defn) {
+	struct lineDefinition ** entry=&memoryContainer->lineDefns;
+	while (*entry != defn) entry=&(*entry)->next;
+	*entry=defn->next;
+	free(defn->name);
+	free(defn);
+}
+
+/**
+ * Removes the most recent record of a function being called from the current function (or the main code), for a call which
+ * has been replaced by something else
+ */
+static void removeCalledFunction(char * functionName) {
+	struct function_call_tree_node * callTree=currentCall == NULL ? &mainCodeCallTree : currentCall;
+	int i;
+	for (i=callTree->number_of_calls-1;i>=0;i--) {
+		if (strcmp(callTree->calledFunctions[i], functionName) == 0) {
+			free(callTree->calledFunctions[i]);
+			memmove(&callTree->calledFunctions[i], &callTree->calledFunctions[i+1], sizeof(char*) * (callTree->number_of_calls-i-1));
+			callTree->number_of_calls--;
+			return;
+		}
+	}
+}
+
+/**
+ * Creates an expression reading the variable in some slot
+ */
+static struct memorycontainer* createSlotExpression(unsigned short slot) {
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
+	memoryContainer->length=sizeof(unsigned char)+sizeof(unsigned short);
+	memoryContainer->data=(char*) malloc(memoryContainer->length);
+	memoryContainer->lineDefns=NULL;
+	appendVariable(memoryContainer, slot, appendStatement(memoryContainer, LOAD_SLOT_TOKEN, 0));
+	return memoryContainer;
+}
+
+/**
+ * Records that a variable is assigned to, if it is in the frame of a function then should it be an argument that argument
+ * aliases the variable passed by the caller
+ */
+static void markVariableAssigned(unsigned short slot) {
+	if (currentFunctionName == NULL || !(slot & LOCAL_SLOT_FLAG)) return;
+	unsigned short local=slot & ~LOCAL_SLOT_FLAG;
+	if (local >= numberAssignedLocals) {
+		unsigned short previousNumber=numberAssignedLocals;
+		numberAssignedLocals=local+16;
+		assignedLocals=(char*) realloc(assignedLocals, numberAssignedLocals);
+		memset(&assignedLocals[previousNumber], 0, numberAssignedLocals-previousNumber);
+	}
+	assignedLocals[local]=1;
+}
+
 /**
  * Appends in a do while statement, which assembles down to an if statement with jump at the end of the block
  * to retest the condition and either do another iteration or not
  */
 struct memorycontainer* appendWhileStatement(struct memorycontainer* expression, struct memorycontainer* block) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char)+sizeof(unsigned short) * 3 + expression->length + (block != NULL ? block->length : 0);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
 
 	unsigned int position=0;
-	position=appendStatement(memoryContainer, IF_TOKEN, position);
-	position=appendMemory(memoryContainer, expression, position);
+	position=appendConditional(memoryContainer, IF_TOKEN, expression, position);
 	if (block != NULL) {
 		unsigned short blockLen=(unsigned short) block->length + 4;
 		memcpy(&memoryContainer->data[position], &blockLen, sizeof(unsigned short));
@@ -375,15 +613,16 @@ struct memorycontainer* appendWhileStatement(struct memorycontainer* expression,
  * Appends and returns a conditional, this is without an else statement so sets that to be zero
  */
 struct memorycontainer* appendIfStatement(struct memorycontainer* expressionContainer, struct memorycontainer* thenBlock) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	unsigned short slot;
+	int key, isConstantComparison=getConstantComparison(expressionContainer, &slot, &key);
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char)+sizeof(unsigned short) + expressionContainer->length +
 			(thenBlock != NULL ? thenBlock->length : 0);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
 
 	unsigned int position=0;
-	position=appendStatement(memoryContainer, IF_TOKEN, position);
-	position=appendMemory(memoryContainer, expressionContainer, position);
+	position=appendConditional(memoryContainer, IF_TOKEN, expressionContainer, position);
 	if (thenBlock != NULL) {
 		unsigned short len=(unsigned short) thenBlock->length;
 		memcpy(&memoryContainer->data[position], &len, sizeof(unsigned short));
@@ -393,6 +632,11 @@ struct memorycontainer* appendIfStatement(struct memorycontainer* expressionCont
 		unsigned short emptyLen=0;
 		memcpy(&memoryContainer->data[position], &emptyLen, sizeof(unsigned short));
 	}
+	clearConditionalChain();
+	if (isConstantComparison) {
+		recordConditionalChain(memoryContainer, slot, key, CONSTANT_CONDITIONAL_HEADER_SIZE,
+				memoryContainer->length-CONSTANT_CONDITIONAL_HEADER_SIZE, memoryContainer->length, 0, 0);
+	}
 	return memoryContainer;
 }
 
@@ -402,15 +646,47 @@ struct memorycontainer* appendIfStatement(struct memorycontainer* expressionCont
  */
 struct memorycontainer* appendIfElseStatement(struct memorycontainer* expressionContainer, struct memorycontainer* thenBlock,
 		struct memorycontainer* elseBlock) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	return createIfElseStatement(expressionContainer, thenBlock, elseBlock, 0);
+}
+
+/**
+ * Appends and returns a conditional whose else block is an elif (itself a conditional), if this continues a chain comparing
+ * the same variable against distinct integer constants and the chain is long enough then it is assembled as a switch
+ */
+struct memorycontainer* appendIfElifStatement(struct memorycontainer* expressionContainer, struct memorycontainer* thenBlock,
+		struct memorycontainer* elifBlock) {
+	unsigned short slot;
+	int key;
+	// The elif was the last conditional assembled, so it is the chain if the chain is recorded at all
+	if (conditionalChain.container == elifBlock && getConstantComparison(expressionContainer, &slot, &key) &&
+			slot == conditionalChain.slot && !isConditionalChainKey(key)) {
+		if (conditionalChain.numberArms+1 >= SWITCH_MIN_ARMS) {
+			free(expressionContainer->data);
+			free(expressionContainer);
+			return createSwitchStatement(key, thenBlock, elifBlock);
+		}
+		return createIfElseStatement(expressionContainer, thenBlock, elifBlock, 1);
+	}
+	return createIfElseStatement(expressionContainer, thenBlock, elifBlock, 0);
+}
+
+/**
+ * Creates a conditional with else block, if this extends the conditional chain (the else block being an elif of it) then
+ * it is recorded as the first arm of that chain
+ */
+static struct memorycontainer* createIfElseStatement(struct memorycontainer* expressionContainer, struct memorycontainer* thenBlock,
+		struct memorycontainer* elseBlock, int extendsChain) {
+	unsigned short slot;
+	int key, isConstantComparison=getConstantComparison(expressionContainer, &slot, &key);
+	unsigned int thenLength=thenBlock != NULL ? thenBlock->length : 0, elseLength=elseBlock != NULL ? elseBlock->length : 0;
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char)*2+sizeof(unsigned short)*2 + expressionContainer->length +
 			(thenBlock != NULL ? thenBlock->length : 0) + (elseBlock != NULL ? elseBlock->length : 0);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
 
 	unsigned int position=0;
-	position=appendStatement(memoryContainer, IFELSE_TOKEN, position);
-	position=appendMemory(memoryContainer, expressionContainer, position);
+	position=appendConditional(memoryContainer, IFELSE_TOKEN, expressionContainer, position);
 
 	unsigned short combinedThenGotoLength=(unsigned short) (thenBlock != NULL ? thenBlock->length : 0)+3;	// add for goto and line num
 	memcpy(&memoryContainer->data[position], &combinedThenGotoLength, sizeof(unsigned short));
@@ -436,6 +712,12 @@ struct memorycontainer* appendIfElseStatement(struct memorycontainer* expression
 	defn->currentpoint=position;
 	memoryContainer->lineDefns=defn;
 
+	if (!extendsChain) clearConditionalChain();
+	if (isConstantComparison) {
+		recordConditionalChain(memoryContainer, slot, key, CONSTANT_CONDITIONAL_HEADER_SIZE, thenLength,
+				CONSTANT_CONDITIONAL_HEADER_SIZE+thenLength+GOTO_SIZE, elseLength, extendsChain);
+		addConditionalChainLabel(currentForLine);
+	}
 	currentForLine--;
 	return memoryContainer;
 }
@@ -456,19 +738,22 @@ void appendNewFunctionStatement(char* functionName, struct stack_t * args, struc
 	fn->called=0;
 
 	unsigned short numberArgs=(unsigned short) getStackSize(args);
-	struct memorycontainer* numberArgsContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
-	numberArgsContainer->length=sizeof(unsigned short) * (numberArgs + 1);
-	numberArgsContainer->data=(char*) malloc(sizeof(unsigned short) * (numberArgs + 1));
+	struct memorycontainer* numberArgsContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
+	numberArgsContainer->length=sizeof(unsigned short) * (numberArgs + 2);
+	numberArgsContainer->data=(char*) malloc(sizeof(unsigned short) * (numberArgs + 2));
 	numberArgsContainer->lineDefns=NULL;
 
-	((unsigned short *) numberArgsContainer->data)[0]=numberArgs;
+	// The function header is the size of its frame, then the number of arguments and the slot of each. The local flag is only kept
+	// on the slots of arguments which the function assigns to, these alias the caller's variable whereas values are copied to others
+	((unsigned short *) numberArgsContainer->data)[0]=current_local_slot;
+	((unsigned short *) numberArgsContainer->data)[1]=numberArgs;
 
 	struct memorycontainer* assignmentContainer=NULL;
 
 	int i;
 	for (i=0;i<numberArgs;i++) {
 		if (getTypeAt(args, i) == 2) {
-			((unsigned short *) numberArgsContainer->data)[i+1]=getVariableId(getIdentifierAt(args, i), 1);
+			((unsigned short *) numberArgsContainer->data)[i+2]=getVariableId(getIdentifierAt(args, i), 1);
 		} else {
 			struct identifier_exp * idexp=getExpressionIdentifierAt(args, i);
 			if (assignmentContainer == NULL) {
@@ -476,7 +761,11 @@ void appendNewFunctionStatement(char* functionName, struct stack_t * args, struc
 			} else {
 				assignmentContainer=concatenateMemory(assignmentContainer, appendLetIfNoAliasStatement(idexp->identifier, idexp->exp));
 			}
-			((unsigned short *) numberArgsContainer->data)[i+1]=getVariableId(idexp->identifier, 1);
+			((unsigned short *) numberArgsContainer->data)[i+2]=getVariableId(idexp->identifier, 1);
+		}
+		unsigned short local=((unsigned short *) numberArgsContainer->data)[i+2] & ~LOCAL_SLOT_FLAG;
+		if (local >= numberAssignedLocals || !assignedLocals[local]) {
+			((unsigned short *) numberArgsContainer->data)[i+2]=local;
 		}
 	}
 
@@ -496,7 +785,7 @@ void appendNewFunctionStatement(char* functionName, struct stack_t * args, struc
 	completedFunction->lineDefns=defn;
 
 	fn->contents=completedFunction;
-	fn->numberEntriesInSymbolTable=current_var_id - currentSymbolTableId;
+	fn->numberEntriesInSymbolTable=current_local_slot;
 	fn->recursive=isFnRecursive;
 	fn->number_of_fn_calls=currentCall->number_of_calls;
 	if (currentCall->number_of_calls == 0) {
@@ -516,17 +805,18 @@ void appendNewFunctionStatement(char* functionName, struct stack_t * args, struc
  */
 struct memorycontainer* appendArraySetStatement( char* identifier, struct stack_t* indexContainer,
 		struct memorycontainer* expressionContainer) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=(sizeof(unsigned char)*2)+sizeof(unsigned short);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
 
 	unsigned int position=0;
 
-	position=appendStatement(memoryContainer, ARRAYSET_TOKEN, position);
+	unsigned char numIndexes=(unsigned char) getStackSize(indexContainer);
+	position=appendStatement(memoryContainer, numIndexes == 1 && isSimpleIndexExpression(getExpressionAt(indexContainer, 0)) ?
+			ARRAYSET_1D_TOKEN : ARRAYSET_TOKEN, position);
 	position=appendVariable(memoryContainer, getVariableId(identifier, 1), position);
 
-	unsigned char numIndexes=(unsigned char) getStackSize(indexContainer);
 	memcpy(&memoryContainer->data[position], &numIndexes, sizeof(unsigned char));
     position+=sizeof(unsigned char);
 	int i;
@@ -554,7 +844,7 @@ struct memorycontainer* appendLetWithOperatorStatement(char * identifier, struct
 	} else {
 		fprintf(stderr, "Can not find operator with id of %c\n", operator);
 	}
-	struct memorycontainer* rhs=createExpression(token, createIdentifierExpression(identifier), expressionContainer);
+	struct memorycontainer* rhs=createArithmeticExpression(token, createIdentifierExpression(identifier), expressionContainer);
 	if (operator == 6) {
 		// Floor
 		struct memorycontainer* mathCommand=createIntegerExpression(FLOOR_MATHS_OP);
@@ -570,21 +860,86 @@ struct memorycontainer* appendLetWithOperatorStatement(char * identifier, struct
  * Appends and returns a let statement which sets and declares scalars
  */
 struct memorycontainer* appendLetStatement(char * identifier, struct memorycontainer* expressionContainer) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	unsigned short slot=getVariableId(identifier, 1);
+	markVariableAssigned(slot);
+	struct memorycontainer* memoryContainer=createOperatorAssignStatement(slot, expressionContainer);
+	if (memoryContainer != NULL) return memoryContainer;
+
+	memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char)+sizeof(unsigned short) + expressionContainer->length;
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
 
 	unsigned int position=0;
 
-	position=appendStatement(memoryContainer, LET_TOKEN, position);
-	position=appendVariable(memoryContainer, getVariableId(identifier, 1), position);
+	position=appendStatement(memoryContainer, STORE_SLOT_TOKEN, position);
+	position=appendVariable(memoryContainer, slot, position);
 	appendMemory(memoryContainer, expressionContainer, position);
 	return memoryContainer;
 }
 
+/**
+ * If an assignment sets a variable to itself combined with some other operand (i.e. x=x+y, which is also what x+=y produces)
+ * then creates the fused superinstruction for this, either incrementing by a constant or the operator assignment. Handles
+ * both prefix and postfix arithmetic, returns NULL if the assignment is not of this shape
+ */
+static struct memorycontainer* createOperatorAssignStatement(unsigned short slot, struct memorycontainer* expressionContainer) {
+	unsigned char * data=(unsigned char*) expressionContainer->data, operator;
+	unsigned int operandStart, operandEnd;
+	if (isArithmeticToken(data[0]) && expressionContainer->length > sizeof(unsigned char)*2+sizeof(unsigned short) &&
+			data[1] == LOAD_SLOT_TOKEN && *((unsigned short*) &data[2]) == slot) {
+		operator=data[0];
+		operandStart=sizeof(unsigned char)*2+sizeof(unsigned short);
+		operandEnd=expressionContainer->length;
+	} else if (data[0] == POSTFIX_TOKEN && data[POSTFIX_HEADER_SIZE] == LOAD_SLOT_TOKEN &&
+			*((unsigned short*) &data[POSTFIX_HEADER_SIZE+1]) == slot) {
+		// The remainder of the body must be a single operand followed by the operator
+		operator=data[expressionContainer->length-1];
+		operandStart=POSTFIX_HEADER_SIZE+sizeof(unsigned char)+sizeof(unsigned short);
+		operandEnd=expressionContainer->length-1;
+		unsigned int operandLength=operandEnd-operandStart;
+		unsigned char operandToken=data[operandStart];
+		if (!(operandToken == LOAD_SLOT_TOKEN && operandLength == sizeof(unsigned char)+sizeof(unsigned short)) &&
+				!((operandToken == INTEGER_TOKEN || operandToken == REAL_TOKEN) && operandLength == sizeof(unsigned char)+sizeof(int)) &&
+				!(operandToken == POSTFIX_TOKEN && operandLength == POSTFIX_HEADER_SIZE+*((unsigned short*) &data[operandStart+2]))) {
+			return NULL;
+		}
+	} else {
+		return NULL;
+	}
+
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
+	memoryContainer->lineDefns=NULL;
+	unsigned int position=0;
+	if ((operator == ADD_TOKEN || operator == SUB_TOKEN) && data[operandStart] == INTEGER_TOKEN &&
+			operandEnd-operandStart == sizeof(unsigned char)+sizeof(int)) {
+		memoryContainer->length=sizeof(unsigned char)*2+sizeof(unsigned short)+sizeof(int);
+		memoryContainer->data=(char*) malloc(memoryContainer->length);
+		position=appendStatement(memoryContainer, INC_SLOT_TOKEN, position);
+		position=appendVariable(memoryContainer, slot, position);
+		position=appendStatement(memoryContainer, operator, position);
+		memcpy(&memoryContainer->data[position], &data[operandStart+1], sizeof(int));
+	} else {
+		memoryContainer->length=sizeof(unsigned char)*2+sizeof(unsigned short)+operandEnd-operandStart;
+		memoryContainer->data=(char*) malloc(memoryContainer->length);
+		position=appendStatement(memoryContainer, OP_ASSIGN_TOKEN, position);
+		position=appendVariable(memoryContainer, slot, position);
+		position=appendStatement(memoryContainer, operator, position);
+		memcpy(&memoryContainer->data[position], &data[operandStart], operandEnd-operandStart);
+		struct lineDefinition * root=expressionContainer->lineDefns;
+		while (root != NULL) {
+			root->currentpoint+=position-operandStart;
+			root=root->next;
+		}
+		memoryContainer->lineDefns=expressionContainer->lineDefns;
+	}
+	free(expressionContainer->data);
+	free(expressionContainer);
+	return memoryContainer;
+}
+
 static struct memorycontainer* appendLetIfNoAliasStatement(char * identifier, struct memorycontainer* expressionContainer) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char)+sizeof(unsigned short) + expressionContainer->length;
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -598,7 +953,7 @@ static struct memorycontainer* appendLetIfNoAliasStatement(char * identifier, st
 }
 
 struct memorycontainer* appendReturnStatementWithExpression(struct memorycontainer* expressionContainer) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char)+expressionContainer->length;
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -613,7 +968,7 @@ struct memorycontainer* appendReturnStatementWithExpression(struct memorycontain
  * Appends a return statement
  */
 struct memorycontainer* appendReturnStatement(void) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -626,7 +981,7 @@ struct memorycontainer* appendReturnStatement(void) {
  * Appends and returns a stop statement
  */
 struct memorycontainer* appendStopStatement() {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -639,7 +994,7 @@ struct memorycontainer* appendStopStatement() {
  * Creates an expression from a string
  */
 struct memorycontainer* createStringExpression(char * string) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=strlen(string)-1+sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -659,7 +1014,7 @@ struct memorycontainer* createStringExpression(char * string) {
  * Creates an expression containing an integer
  */
 struct memorycontainer* createIntegerExpression(int number) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(int) + sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -670,7 +1025,7 @@ struct memorycontainer* createIntegerExpression(int number) {
 }
 
 struct memorycontainer* createBooleanExpression(int booleanVal) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(int) + sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -692,7 +1047,7 @@ struct memorycontainer* createArrayExpression(struct stack_t* arrayVals, struct
 		}
 	}
 
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char)*2 + sizeof(int);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -707,7 +1062,7 @@ struct memorycontainer* createArrayExpression(struct stack_t* arrayVals, struct
 }
 
 struct memorycontainer* createNoneExpression(void) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -720,7 +1075,7 @@ struct memorycontainer* createNoneExpression(void) {
  * Creates an expression wrapping a real number
  */
 struct memorycontainer* createRealExpression(float number) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(float) + sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
@@ -734,13 +1089,13 @@ struct memorycontainer* createRealExpression(float number) {
  * Creates an expression wrapping an identifier
  */
 struct memorycontainer* createIdentifierExpression(char * identifier) {
-    struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+    struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
     if (doesVariableExist(identifier)) {
         memoryContainer->length=sizeof(unsigned char)+sizeof(unsigned short);
         memoryContainer->data=(char*) malloc(memoryContainer->length);
         memoryContainer->lineDefns=NULL;
 
-        int location=appendStatement(memoryContainer, IDENTIFIER_TOKEN, 0);
+        int location=appendStatement(memoryContainer, LOAD_SLOT_TOKEN, 0);
         appendVariable(memoryContainer, getVariableId(identifier, 0), location);
     } else {
         memoryContainer->length=sizeof(unsigned char)+sizeof(unsigned short);
@@ -775,14 +1130,15 @@ struct memorycontainer* createIdentifierExpression(char * identifier) {
 struct memorycontainer* createIdentifierArrayAccessExpression(char* identifier, struct stack_t* index_expressions) {
     int lenOfIndexes=getStackSize(index_expressions);
 
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=sizeof(unsigned short)+(sizeof(unsigned char)*2);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 	memoryContainer->lineDefns=NULL;
 
 	unsigned int position=0;
 
-	position=appendStatement(memoryContainer, ARRAYACCESS_TOKEN, position);
+	position=appendStatement(memoryContainer, lenOfIndexes == 1 && isSimpleIndexExpression(getExpressionAt(index_expressions, 0)) ?
+			ARRAYACCESS_1D_TOKEN : ARRAYACCESS_TOKEN, position);
 	position=appendVariable(memoryContainer, getVariableId(identifier, 1), position);
 	unsigned char packageNumDims=(unsigned char) lenOfIndexes;
     memcpy(&memoryContainer->data[position], &packageNumDims, sizeof(unsigned char));
@@ -800,11 +1156,11 @@ struct memorycontainer* createNotExpression(struct memorycontainer* expression)
 }
 
 struct memorycontainer* createOrExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	return createExpression(OR_TOKEN, expression1, expression2);
+	return createShortCircuitExpression(OR_TOKEN, expression1, expression2);
 }
 
 struct memorycontainer* createAndExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	return createExpression(AND_TOKEN, expression1, expression2);
+	return createShortCircuitExpression(AND_TOKEN, expression1, expression2);
 }
 
 struct memorycontainer* createEqExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
@@ -839,27 +1195,27 @@ struct memorycontainer* createLeqExpression(struct memorycontainer* expression1,
 }
 
 struct memorycontainer* createAddExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	return createExpression(ADD_TOKEN, expression1, expression2);
+	return createArithmeticExpression(ADD_TOKEN, expression1, expression2);
 }
 
 struct memorycontainer* createPowExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	return createExpression(POW_TOKEN, expression1, expression2);
+	return createArithmeticExpression(POW_TOKEN, expression1, expression2);
 }
 
 struct memorycontainer* createSubExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	return createExpression(SUB_TOKEN, expression1, expression2);
+	return createArithmeticExpression(SUB_TOKEN, expression1, expression2);
 }
 
 struct memorycontainer* createMulExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	return createExpression(MUL_TOKEN, expression1, expression2);
+	return createArithmeticExpression(MUL_TOKEN, expression1, expression2);
 }
 
 struct memorycontainer* createDivExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	return createExpression(DIV_TOKEN, expression1, expression2);
+	return createArithmeticExpression(DIV_TOKEN, expression1, expression2);
 }
 
 struct memorycontainer* createFloorDivExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-    struct memorycontainer* divExpr=createExpression(DIV_TOKEN, expression1, expression2);
+    struct memorycontainer* divExpr=createArithmeticExpression(DIV_TOKEN, expression1, expression2);
     struct memorycontainer* mathCommand=createIntegerExpression(FLOOR_MATHS_OP);
     struct stack_t * argStack=getNewStack();
     pushExpression(argStack, mathCommand);
@@ -869,7 +1225,7 @@ struct memorycontainer* createFloorDivExpression(struct memorycontainer* express
 }
 
 struct memorycontainer* createModExpression(struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	return createExpression(MOD_TOKEN, expression1, expression2);
+	return createArithmeticExpression(MOD_TOKEN, expression1, expression2);
 }
 
 /**
@@ -898,8 +1254,222 @@ void leaveScope() {
 	free(oldScope);
 }
 
+/**
+ * Creates a switch from the arm of a constant and its then block, extending the elif chain most recently assembled. The constants
+ * are sorted, each followed by the block length leading to its arm and then the length leading to the else block. Each arm ends
+ * with a goto to the end of the switch
+ */
+static struct memorycontainer* createSwitchStatement(int key, struct memorycontainer* thenBlock, struct memorycontainer* chainContainer) {
+	struct conditional_chain * chain=&conditionalChain;
+	unsigned short i, j, numberArms=chain->numberArms+1;
+	int * keys=(int*) malloc(sizeof(int) * numberArms);
+	unsigned int * armStarts=(unsigned int*) malloc(sizeof(unsigned int) * numberArms);
+	unsigned int * armLengths=(unsigned int*) malloc(sizeof(unsigned int) * numberArms);
+	unsigned short * order=(unsigned short*) malloc(sizeof(unsigned short) * numberArms);
+	keys[0]=key;
+	armLengths[0]=thenBlock != NULL ? thenBlock->length : 0;
+	for (i=1;i<numberArms;i++) {
+		keys[i]=chain->keys[i-1];
+		armLengths[i]=chain->armLengths[i-1];
+	}
+	// Arms are laid out in the order of the chain, but indexed by constant in ascending order
+	for (i=0;i<numberArms;i++) {
+		for (j=i;j>0 && keys[order[j-1]] > keys[i];j--) order[j]=order[j-1];
+		order[j]=i;
+	}
+	unsigned int headerLength=sizeof(unsigned char)+sizeof(unsigned short)*2+(sizeof(int)+sizeof(unsigned short))*numberArms+
+			sizeof(unsigned short);
+	unsigned int position=headerLength;
+	for (i=0;i<numberArms;i++) {
+		armStarts[i]=position;
+		position+=armLengths[i]+GOTO_SIZE;
+	}
+	unsigned int elseStart=position;
+
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
+	memoryContainer->length=elseStart+chain->elseLength;
+	memoryContainer->data=(char*) malloc(memoryContainer->length);
+	memoryContainer->lineDefns=NULL;
+
+	position=appendStatement(memoryContainer, SWITCH_TOKEN, 0);
+	position=appendVariable(memoryContainer, chain->slot, position);
+	position=appendVariable(memoryContainer, numberArms, position);
+	for (i=0;i<numberArms;i++) {
+		memcpy(&memoryContainer->data[position], &keys[order[i]], sizeof(int));
+		position+=sizeof(int);
+	}
+	for (i=0;i<=numberArms;i++) {
+		unsigned int target=i < numberArms ? armStarts[order[i]] : elseStart;
+		position=appendVariable(memoryContainer, (unsigned short) (target-(position+sizeof(unsigned short))), position);
+	}
+
+	struct lineDefinition * defn, * root=chainContainer->lineDefns, *r2;
+	for (i=0;i<numberArms;i++) {
+		if (i == 0) {
+			if (thenBlock != NULL) appendMemory(memoryContainer, thenBlock, armStarts[0]);
+		} else {
+			memcpy(&memoryContainer->data[armStarts[i]], &chainContainer->data[chain->armStarts[i-1]], armLengths[i]);
+		}
+		position=appendStatement(memoryContainer, GOTO_TOKEN, armStarts[i]+armLengths[i]);
+		defn = (struct lineDefinition*) malloc(sizeof(struct lineDefinition));
+		defn->next=memoryContainer->lineDefns;
+		defn->type=1;
+		defn->linenumber=currentForLine;
+		defn->currentpoint=position;
+		memoryContainer->lineDefns=defn;
+	}
+	memcpy(&memoryContainer->data[elseStart], &chainContainer->data[chain->elseStart], chain->elseLength);
+
+	// Line definitions within the arms and else block of the chain move with them, the chain's own gotos to its end are dropped
+	while (root != NULL) {
+		r2=root->next;
+		int moved=0;
+		if (root->type != 0 && root->type != 1) {
+			moved=1;
+		} else {
+			for (i=0;i<chain->numberLabels;i++) {
+				if (chain->labels[i] == root->linenumber) break;
+			}
+			moved=i == chain->numberLabels;
+		}
+		if (moved) {
+			unsigned int point=(unsigned int) root->currentpoint;
+			for (i=0;i<chain->numberArms;i++) {
+				if (point >= chain->armStarts[i] && point <= chain->armStarts[i]+chain->armLengths[i]) {
+					root->currentpoint=(int) (armStarts[i+1]+(point-chain->armStarts[i]));
+					break;
+				}
+			}
+			if (i == chain->numberArms) root->currentpoint=(int) (elseStart+(point-chain->elseStart));
+			root->next=memoryContainer->lineDefns;
+			memoryContainer->lineDefns=root;
+		} else {
+			free(root);
+		}
+		root=r2;
+	}
+	defn = (struct lineDefinition*) malloc(sizeof(struct lineDefinition));
+	defn->next=memoryContainer->lineDefns;
+	defn->type=0;
+	defn->linenumber=currentForLine;
+	defn->currentpoint=memoryContainer->length;
+	memoryContainer->lineDefns=defn;
+
+	unsigned int elseLength=chain->elseLength;
+	unsigned short slot=chain->slot;
+	free(chainContainer->data);
+	free(chainContainer);
+	clearConditionalChain();
+	// Arms are recorded from the last, as the chain is extended from its end, and their locations are already in the switch
+	for (i=numberArms;i>0;i--) {
+		recordConditionalChain(memoryContainer, slot, keys[i-1], armStarts[i-1], armLengths[i-1], i == numberArms ? elseStart : 0,
+				elseLength, i < numberArms);
+	}
+	addConditionalChainLabel(currentForLine);
+	free(keys);
+	free(armStarts);
+	free(armLengths);
+	free(order);
+	currentForLine--;
+	return memoryContainer;
+}
+
+/**
+ * Determines whether an expression compares a variable against an integer constant (i.e. x == 2), if so the slot and constant
+ * are retrieved
+ */
+static int getConstantComparison(struct memorycontainer* expression, unsigned short * slot, int * key) {
+	unsigned char * data=(unsigned char*) expression->data;
+	if (expression->length != CONSTANT_COMPARISON_SIZE || data[0] != EQ_TOKEN || data[1] != LOAD_SLOT_TOKEN ||
+			data[sizeof(unsigned char)*2+sizeof(unsigned short)] != INTEGER_TOKEN) return 0;
+	memcpy(slot, &data[sizeof(unsigned char)*2], sizeof(unsigned short));
+	memcpy(key, &data[sizeof(unsigned char)*3+sizeof(unsigned short)], sizeof(int));
+	return 1;
+}
+
+static int isConditionalChainKey(int key) {
+	int i;
+	for (i=0;i<conditionalChain.numberArms;i++) {
+		if (conditionalChain.keys[i] == key) return 1;
+	}
+	return 0;
+}
+
+/**
+ * Records an arm as the first of the conditional chain held in some memory. The chain is either extended, in which case its
+ * existing arms and else block have moved by the else location given, or started with the given else block
+ */
+static void recordConditionalChain(struct memorycontainer* container, unsigned short slot, int key, unsigned int armStart,
+		unsigned int armLength, unsigned int elseStart, unsigned int elseLength, int extendsChain) {
+	struct conditional_chain * chain=&conditionalChain;
+	int i;
+	if (extendsChain) {
+		for (i=0;i<chain->numberArms;i++) chain->armStarts[i]+=elseStart;
+		chain->elseStart+=elseStart;
+	} else {
+		clearConditionalChain();
+		chain->slot=slot;
+		chain->elseStart=elseStart;
+		chain->elseLength=elseLength;
+	}
+	chain->container=container;
+	chain->keys=(int*) realloc(chain->keys, sizeof(int) * (chain->numberArms+1));
+	chain->armStarts=(unsigned int*) realloc(chain->armStarts, sizeof(unsigned int) * (chain->numberArms+1));
+	chain->armLengths=(unsigned int*) realloc(chain->armLengths, sizeof(unsigned int) * (chain->numberArms+1));
+	for (i=chain->numberArms;i>0;i--) {
+		chain->keys[i]=chain->keys[i-1];
+		chain->armStarts[i]=chain->armStarts[i-1];
+		chain->armLengths[i]=chain->armLengths[i-1];
+	}
+	chain->keys[0]=key;
+	chain->armStarts[0]=armStart;
+	chain->armLengths[0]=armLength;
+	chain->numberArms++;
+}
+
+static void addConditionalChainLabel(int label) {
+	conditionalChain.labels=(int*) realloc(conditionalChain.labels, sizeof(int) * (conditionalChain.numberLabels+1));
+	conditionalChain.labels[conditionalChain.numberLabels++]=label;
+}
+
+static void clearConditionalChain(void) {
+	free(conditionalChain.keys);
+	free(conditionalChain.labels);
+	free(conditionalChain.armStarts);
+	free(conditionalChain.armLengths);
+	memset(&conditionalChain, 0, sizeof(struct conditional_chain));
+}
+
+/**
+ * Appends a conditional token and its expression, if the expression compares a variable against something then the conditional
+ * is replaced by the comparison superinstruction which has the same layout
+ */
+static unsigned int appendConditional(struct memorycontainer* memoryContainer, unsigned char token, struct memorycontainer* expression,
+		unsigned int position) {
+	unsigned char comparison=((unsigned char*) expression->data)[0];
+	if ((comparison == EQ_TOKEN || comparison == NEQ_TOKEN || comparison == LT_TOKEN || comparison == GT_TOKEN ||
+			comparison == LEQ_TOKEN || comparison == GEQ_TOKEN) && ((unsigned char*) expression->data)[1] == LOAD_SLOT_TOKEN) {
+		token=CMP_JUMP_TOKEN;
+	}
+	position=appendStatement(memoryContainer, token, position);
+	return appendMemory(memoryContainer, expression, position);
+}
+
+static int isArithmeticToken(unsigned char token) {
+	return token == ADD_TOKEN || token == SUB_TOKEN || token == MUL_TOKEN || token == DIV_TOKEN || token == MOD_TOKEN ||
+			token == POW_TOKEN;
+}
+
+/**
+ * Whether an array index is a variable or integer constant, which can be read without side effects by the single index superinstructions
+ */
+static int isSimpleIndexExpression(struct memorycontainer* expression) {
+	unsigned char token=((unsigned char*) expression->data)[0];
+	return token == LOAD_SLOT_TOKEN || token == INTEGER_TOKEN;
+}
+
 static struct memorycontainer* createUnaryExpression(unsigned char token, struct memorycontainer* expression) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=expression->length + sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 
@@ -908,6 +1478,11 @@ static struct memorycontainer* createUnaryExpression(unsigned char token, struct
 	memcpy(&memoryContainer->data[location], expression->data, expression->length);
 
 	memoryContainer->lineDefns=expression->lineDefns;
+	struct lineDefinition * root=memoryContainer->lineDefns;
+	while (root != NULL) {
+		root->currentpoint+=sizeof(unsigned char);
+		root=root->next;
+	}
 
 	// Free up the expression memory
 	free(expression->data);
@@ -919,7 +1494,7 @@ static struct memorycontainer* createUnaryExpression(unsigned char token, struct
  * Creates an expression from two other expressions with some operator (such as add, equality test etc...)
  */
 static struct memorycontainer* createExpression(unsigned char token, struct memorycontainer* expression1, struct memorycontainer* expression2) {
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	memoryContainer->length=expression1->length + expression2->length + sizeof(unsigned char);
 	memoryContainer->data=(char*) malloc(memoryContainer->length);
 
@@ -952,6 +1527,87 @@ static struct memorycontainer* createExpression(unsigned char token, struct memo
 	return memoryContainer;
 }
 
+/**
+ * Creates a logical and or or expression, the length of the second operand follows the first so that the interpreter can branch
+ * over it when the first operand has already decided the result
+ */
+static struct memorycontainer* createShortCircuitExpression(unsigned char token, struct memorycontainer* expression1, struct memorycontainer* expression2) {
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
+	memoryContainer->length=expression1->length + expression2->length + sizeof(unsigned char) + sizeof(unsigned short);
+	memoryContainer->data=(char*) malloc(memoryContainer->length);
+	memoryContainer->lineDefns=NULL;
+
+	unsigned short secondLength=(unsigned short) expression2->length;
+	unsigned int position=0;
+	position=appendStatement(memoryContainer, token, position);
+	position=appendMemory(memoryContainer, expression1, position);
+	memcpy(&memoryContainer->data[position], &secondLength, sizeof(unsigned short));
+	position+=sizeof(unsigned short);
+	appendMemory(memoryContainer, expression2, position);
+	return memoryContainer;
+}
+
+/**
+ * Creates an arithmetic expression from two other expressions. By default this is a prefix tree, the same as other expressions,
+ * but if postfix expressions are enabled then it is a block of the operands followed by the operator. The bodies of operands
+ * which are themselves postfix are merged into this one, unless that would exceed the depth of the interpreter's operand stack
+ */
+static struct memorycontainer* createArithmeticExpression(unsigned char token, struct memorycontainer* expression1, struct memorycontainer* expression2) {
+	if (!postfixExpressions) return createExpression(token, expression1, expression2);
+	unsigned char depth1=getPostfixDepth(expression1), depth2=getPostfixDepth(expression2);
+	int mergeExpression2=depth2 < POSTFIX_STACK_DEPTH;
+	if (!mergeExpression2) depth2=1;
+	unsigned char depth=depth1 > depth2+1 ? depth1 : depth2+1;
+
+	struct memorycontainer* memoryContainer = (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
+	unsigned int headerToSkip1=((unsigned char*) expression1->data)[0] == POSTFIX_TOKEN ? POSTFIX_HEADER_SIZE : 0;
+	unsigned int headerToSkip2=mergeExpression2 && ((unsigned char*) expression2->data)[0] == POSTFIX_TOKEN ? POSTFIX_HEADER_SIZE : 0;
+	memoryContainer->length=POSTFIX_HEADER_SIZE + expression1->length-headerToSkip1 + expression2->length-headerToSkip2 + sizeof(unsigned char);
+	memoryContainer->data=(char*) malloc(memoryContainer->length);
+	memoryContainer->lineDefns=NULL;
+
+	unsigned short bodyLength=(unsigned short) (memoryContainer->length-POSTFIX_HEADER_SIZE);
+	unsigned int position=0;
+	position=appendStatement(memoryContainer, POSTFIX_TOKEN, position);
+	position=appendStatement(memoryContainer, depth, position);
+	memcpy(&memoryContainer->data[position], &bodyLength, sizeof(unsigned short));
+	position+=sizeof(unsigned short);
+	position=appendPostfixOperand(memoryContainer, expression1, position, headerToSkip1);
+	position=appendPostfixOperand(memoryContainer, expression2, position, headerToSkip2);
+	appendStatement(memoryContainer, token, position);
+	return memoryContainer;
+}
+
+/**
+ * Returns the depth of operand stack needed to evaluate an expression, anything other than a postfix expression is a single operand
+ */
+static unsigned char getPostfixDepth(struct memorycontainer* expression) {
+	if (((unsigned char*) expression->data)[0] != POSTFIX_TOKEN) return 1;
+	return ((unsigned char*) expression->data)[1];
+}
+
+/**
+ * Appends an operand to a postfix expression, skipping some bytes from its start (the header of a postfix operand being merged)
+ */
+static unsigned int appendPostfixOperand(struct memorycontainer* memoryContainer, struct memorycontainer* operand, unsigned int position, unsigned int offset) {
+	memcpy(&memoryContainer->data[position], &operand->data[offset], operand->length-offset);
+
+	struct lineDefinition * root=operand->lineDefns, *r2;
+	while (root != NULL) {
+		root->currentpoint+=position-offset;
+		r2=root->next;
+		root->next=memoryContainer->lineDefns;
+		memoryContainer->lineDefns=root;
+		root=r2;
+	}
+	position+=operand->length-offset;
+
+	// Free up the operand memory
+	free(operand->data);
+	free(operand);
+	return position;
+}
+
 /**
  * Adds a variable to the symbol table if it is not already present
  */
@@ -960,14 +1616,14 @@ void addVariableIfNeeded( char * name) {
 }
 
 /**
- * Retrieves the ID of a variable from the symbol table, with a flag whether we are to allow adding the variable in
+ * Retrieves the slot of a variable from the symbol table, with a flag whether we are to allow adding the variable in
  * if it can not be found
  */
 static unsigned short getVariableId(char * name, int allowAdd) {
 	struct scope_info * scopeNode=scope;
 	while (scopeNode != NULL) {
-		unsigned short id=findVariable(scopeNode->variables, name);
-		if (id >= 1) return id;
+		unsigned short slot=findVariable(scopeNode->variables, name);
+		if (slot != UNKNOWN_VARIABLE_SLOT) return slot;
 		scopeNode=scopeNode->next;
 	}
 
@@ -982,22 +1638,21 @@ static unsigned short getVariableId(char * name, int allowAdd) {
 static int doesVariableExist(char* name) {
     struct scope_info * scopeNode=scope;
 	while (scopeNode != NULL) {
-		unsigned short id=findVariable(scopeNode->variables, name);
-		if (id >= 1) return 1;
+		if (findVariable(scopeNode->variables, name) != UNKNOWN_VARIABLE_SLOT) return 1;
 		scopeNode=scopeNode->next;
 	}
 	return 0;
 }
 
 /**
- * Finds a variable in a specific variable list or returns -1 for no variable found
+ * Finds a variable in a specific variable list or returns UNKNOWN_VARIABLE_SLOT for no variable found
  */
 static unsigned short findVariable(struct variable_node * root,  char * name) {
 	while (root != NULL) {
-		if (areStringsEqualIgnoreCase(root->name, name)) return root->id;
+		if (areStringsEqualIgnoreCase(root->name, name)) return root->slot;
 		root=root->next;
 	}
-	return 0;
+	return UNKNOWN_VARIABLE_SLOT;
 }
 
 /**
@@ -1013,14 +1668,24 @@ static int areStringsEqualIgnoreCase(char * s1, char * s2) {
 }
 
 /**
- * Adds a variable to the variable list at the top of the scope stack, allocates the ID to be the next free one
+ * Adds a variable to the variable list at the top of the scope stack, allocates the slot to be the next free one in
+ * the current function's frame or, if in the main code, the next free global slot
  */
 static unsigned short addVariable(char * name) {
 	struct variable_node * newNode=(struct variable_node*) malloc(sizeof(struct variable_node));
 	newNode->name=(char*) malloc(strlen(name) + 1);
 	strcpy(newNode->name, name);
-	newNode->id = current_var_id++;
+	// The last local slot is never allocated, as with the flag set it is VALUE_ARGUMENT_SLOT
+	if (current_global_slot >= LOCAL_SLOT_FLAG || current_local_slot >= LOCAL_SLOT_FLAG-1) {
+		fprintf(stderr, "Too many variables at line %d\n", line_num);
+		exit(0);
+	}
+	if (currentFunctionName != NULL) {
+		newNode->slot=LOCAL_SLOT_FLAG | current_local_slot++;
+	} else {
+		newNode->slot=current_global_slot++;
+	}
 	newNode->next=scope->variables;
 	scope->variables=newNode;
-	return newNode->id;
+	return newNode->slot;
 }
@@ -73,7 +73,9 @@ struct function_call_tree_node {
 
 // A memory container, containing some bytecode, the length of the code and line definitions that relate to it
 struct memorycontainer {
-	unsigned int length;
+	// Capacity is the number of bytes allocated for the data when this has been grown by concatenation, otherwise it is zero
+	// and exactly the length is allocated
+	unsigned int length, capacity;
 	char * data;
 	struct lineDefinition * lineDefns;
 };
@@ -89,6 +91,9 @@ struct functionDefinition {
 void enterFunction(char*);
 unsigned short getNumberEntriesInSymbolTable(void);
 void setNumberEntriesInSymbolTable(unsigned short);
+void addGlobalSlots(unsigned short);
+void setPostfixExpressions(int);
+struct memorycontainer* createProgramHeader(void);
 void appendNewFunctionStatement(char*, struct stack_t*, struct memorycontainer*);
 void appendArgument(char*);
 struct memorycontainer* appendCallFunctionStatement(char*, struct stack_t*);
@@ -98,6 +103,7 @@ struct memorycontainer* appendWhileStatement(struct memorycontainer*, struct mem
 struct memorycontainer* appendForStatement(char *, struct memorycontainer*, struct memorycontainer*);
 struct memorycontainer* appendIfStatement(struct memorycontainer*, struct memorycontainer*);
 struct memorycontainer* appendIfElseStatement(struct memorycontainer*, struct memorycontainer*, struct memorycontainer*);
+struct memorycontainer* appendIfElifStatement(struct memorycontainer*, struct memorycontainer*, struct memorycontainer*);
 struct memorycontainer* appendArraySetStatement(char*, struct stack_t*, struct memorycontainer*);
 struct memorycontainer* appendLetStatement(char*, struct memorycontainer*);
 struct memorycontainer* appendLetWithOperatorStatement(char*, struct memorycontainer*, unsigned char);
@@ -51,7 +51,9 @@ struct interpreterconfiguration* readConfiguration(int argc, char *argv[]) {
 	configuration->intentActive=(char*) malloc(TOTAL_CORES);
 	for (i=0;i<TOTAL_CORES;i++) configuration->intentActive[i]=1;
 	configuration->displayStats=configuration->displayTiming=configuration->forceCodeOnCore=
-			configuration->forceCodeOnShared=configuration->forceDataOnShared=configuration->displayPPCode=0;
+			configuration->forceCodeOnShared=configuration->forceDataOnShared=configuration->displayPPCode=
+			configuration->postfixExpressions=0;
+	configuration->optimisationLevel=1;
 	configuration->filename=configuration->compiledByteFilename=configuration->loadByteFilename=configuration->pipedInContents=NULL;
 	parseCommandLineArguments(configuration, argc, argv);
 	return configuration;
@@ -80,6 +82,14 @@ static void parseCommandLineArguments(struct interpreterconfiguration* configura
 				configuration->displayStats=1;
 			} else if (areStringsEqualIgnoreCase(argv[i], "-pp")) {
 				configuration->displayPPCode=1;
+			} else if (areStringsEqualIgnoreCase(argv[i], "-postfix")) {
+				configuration->postfixExpressions=1;
+			} else if (areStringsEqualIgnoreCase(argv[i], "-O0")) {
+				configuration->optimisationLevel=0;
+			} else if (areStringsEqualIgnoreCase(argv[i], "-O1")) {
+				configuration->optimisationLevel=1;
+			} else if (areStringsEqualIgnoreCase(argv[i], "-O2")) {
+				configuration->optimisationLevel=2;
                         } else if (areStringsEqualIgnoreCase(argv[i], "-srec")) {
 				configuration->loadElf=0;
 		                configuration->loadSrec=1;
@@ -235,6 +245,8 @@ static void displayHelp() {
 #endif
 	printf("-s             Display parse statistics\n");
 	printf("-pp            Display preprocessed code\n");
+	printf("-postfix       Compile arithmetic to postfix form, evaluated on an operand stack\n");
+	printf("-O0 -O1 -O2    Optimisation level of the compiled byte code, -O0 disables optimisation (default -O1)\n");
 	printf("-o filename    Write out the compiled byte representation of processed Python code and exits (does not run code)\n");
 	printf("-l filename    Loads from compiled byte representation of code and runs this\n");
 	printf("-help          Display this help and quit\n");
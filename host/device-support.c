@@ -68,7 +68,7 @@ static void performMathsOp(struct core_ctrl*);
 static int getTypeOfInput(char*);
 static char* getEpiphanyExecutableFile(struct interpreterconfiguration*);
 static int doesFileExist(char*);
-static char * allocateChunkInSharedHeapMemory(size_t, struct core_ctrl *);
+static void copyStringToCoreSharedHeap(char*, int, struct core_ctrl*);
 
 /**
  * Loads up the code onto the appropriate Epiphany cores, sets up the state (Python bytecode, symbol table, data area etc)
@@ -404,41 +404,20 @@ static void __attribute__((optimize("O0"))) stringConcatenate(int coreId, struct
 			sprintf(newString,"%f%s", f, str2);
 		}
 	}
-	char * target=allocateChunkInSharedHeapMemory(strlen(newString) + 1, core);
-	strcpy(target, newString);
-	relativeLocation=target-core->host_shared_data_start;
-	memcpy(&core->data[11], &relativeLocation, sizeof(unsigned int));
+	copyStringToCoreSharedHeap(newString, 11, core);
 	free(newString);
 }
 
-static char * allocateChunkInSharedHeapMemory(size_t size, struct core_ctrl * core) {
-    unsigned char chunkInUse;
-    unsigned int chunkLength, splitChunkLength;
-    char * heapPtr=core->host_shared_data_start;
-
-    size_t headersize=sizeof(unsigned char) + sizeof(unsigned int);
-    size_t lenStride=sizeof(unsigned int);
-    while (1==1) {
-        memcpy(&chunkLength, heapPtr, sizeof(unsigned int));
-        memcpy(&chunkInUse, &heapPtr[lenStride], sizeof(unsigned char));
-        if (!chunkInUse && chunkLength >= size) {
-            char * splitChunk=(char*) (heapPtr + size + headersize);
-            splitChunkLength=chunkLength - size - headersize;
-            memcpy(splitChunk, &splitChunkLength, sizeof(unsigned int));
-            memcpy(&splitChunk[lenStride], &chunkInUse, sizeof(unsigned char));
-            chunkLength=size;
-            memcpy(heapPtr, &chunkLength, sizeof(unsigned int));
-            chunkInUse=1;
-            memcpy(&heapPtr[lenStride], &chunkInUse, sizeof(unsigned char));
-            return heapPtr + headersize;
-        } else {
-            heapPtr+=chunkLength + headersize;
-            if (heapPtr  >= core->host_shared_data_start + SHARED_HEAP_DATA_AREA_PER_CORE) {
-                break;
-            }
-        }
-    }
-    return NULL;
+/**
+ * Copies a string into memory which the core has allocated in its shared heap for it, the location of which is in the core's
+ * data area. The string is truncated to the length of this memory, which is held in the header of its heap chunk
+ */
+static void copyStringToCoreSharedHeap(char * string, int start, struct core_ctrl * core) {
+	unsigned int relativeLocation, chunkLength;
+	memcpy(&relativeLocation, &core->data[start], sizeof(unsigned int));
+	char * target=core->host_shared_data_start+relativeLocation;
+	memcpy(&chunkLength, target-(sizeof(unsigned int) + sizeof(unsigned char)), sizeof(unsigned int));
+	snprintf(target, chunkLength, "%s", string);
 }
 
 /**
@@ -458,7 +437,7 @@ static void raiseError(int coreId, struct core_ctrl * core) {
  * Inputs a message from the user, with some optional displayed message.
  */
 static void __attribute__((optimize("O0"))) inputCoreMessage(int coreId, struct core_ctrl * core) {
-	char inputvalue[1000];
+	char inputvalue[MAX_HOST_INPUT_LENGTH];
 	unsigned int relativeLocation;
 	if (core->data[0] == STRING_TYPE) {
 		memcpy(&relativeLocation, &core->data[1], sizeof(unsigned int));
@@ -483,10 +462,7 @@ static void __attribute__((optimize("O0"))) inputCoreMessage(int coreId, struct
 		memcpy(&core->data[1], &fv, sizeof(float));
 	} else {
 		core->data[0]=STRING_TYPE;
-		char * target=allocateChunkInSharedHeapMemory(strlen(inputvalue) + 1, core);
-		strcpy(target, inputvalue);
-		relativeLocation=target-core->host_shared_data_start;
-		memcpy(&core->data[1], &relativeLocation, sizeof(unsigned int));
+		copyStringToCoreSharedHeap(inputvalue, 5, core);
 	}
 }
 
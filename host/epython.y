@@ -80,7 +80,7 @@ statement
 	| WHILE expression COLON codeblock { $$=appendWhileStatement($2, $4); }	
 	| IF expression COLON codeblock { $$=appendIfStatement($2, $4); }
 	| IF expression COLON codeblock ELSE COLON codeblock { $$=appendIfElseStatement($2, $4, $7); }
-	| IF expression COLON codeblock elifblock { $$=appendIfElseStatement($2, $4, $5); }		
+	| IF expression COLON codeblock elifblock { $$=appendIfElifStatement($2, $4, $5); }		
 	| IF expression COLON statements { $$=appendIfStatement($2, $4); }
 	| ELIF expression COLON codeblock { $$=appendIfStatement($2, $4); }		
     	| ident ASSGN expression { $$=appendLetStatement($1, $3); }
@@ -142,7 +142,7 @@ declareident
 elifblock
 	: ELIF expression COLON codeblock { $$=appendIfStatement($2, $4); }
 	| ELIF expression COLON codeblock ELSE COLON codeblock { $$=appendIfElseStatement($2, $4, $7); }
-	| ELIF expression COLON codeblock elifblock { $$=appendIfElseStatement($2, $4, $5); }
+	| ELIF expression COLON codeblock elifblock { $$=appendIfElifStatement($2, $4, $5); }
 ;
 
 expression
@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Constant folding and propagation passes of the optimiser. Folding evaluates expressions whose operands are all literals, calls
+ * to functions which just return a literal and conditionals whose outcome is then known. Propagation replaces reads of variables
+ * known to hold a literal, both module level constants (globals assigned a literal once at the start of the main code) and, within
+ * a block, variables reloaded after being assigned a literal. Evaluation follows the interpreter exactly, so anything whose result
+ * depends on the types seen at run time (or which would raise an error) is left alone
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include "folding.h"
+#include "basictokens.h"
+
+// Largest integer power which is folded, as the interpreter computes these by repeated multiplication
+#define MAX_FOLDED_POWER 64
+
+// A variable known to hold a literal value whilst propagating within a block
+struct known_value {
+	unsigned short slot;
+	struct ir_expression * value;
+};
+
+struct known_values {
+	int number, capacity;
+	struct known_value * values;
+};
+
+static void foldBlock(struct ir_block*);
+static struct ir_expression* foldExpression(struct ir_expression*);
+static struct ir_expression* foldArithmetic(struct ir_expression*);
+static struct ir_expression* foldComparison(struct ir_expression*);
+static struct ir_expression* foldShortCircuit(struct ir_expression*);
+static struct ir_expression* getConstantReturnValue(struct ir_function*);
+static int areExpressionsPure(int, struct ir_expression**);
+static int isLiteralTrue(struct ir_expression*);
+static int isBooleanExpression(struct ir_expression*);
+static int isNumericLiteral(struct ir_expression*);
+static struct ir_expression* createIntegerLiteral(unsigned char, int);
+static struct ir_expression* createRealLiteral(float);
+static void propagateWithinBlock(struct ir_function*, struct ir_block*);
+static int isFunctionArgument(struct ir_function*, unsigned short);
+static void propagateModuleConstants(struct ir_program*);
+static int replaceLoads(struct ir_expression**, unsigned short, struct ir_expression*, int);
+static int replaceStatementLoads(struct ir_statement*, unsigned short, struct ir_expression*);
+static void forgetWrittenByExpression(struct ir_function*, struct known_values*, struct ir_expression*);
+static void forgetWrittenValue(struct ir_function*, struct known_values*, unsigned short);
+static void forgetValue(struct known_values*, unsigned short);
+static void forgetGlobalValues(struct known_values*);
+static void rememberValue(struct known_values*, unsigned short, struct ir_expression*);
+static int doesStatementCall(struct ir_statement*);
+static int doesExpressionCall(struct ir_expression*);
+static void countSlotAccesses(struct ir_program*, int*, int*);
+static void countExpressionAccesses(struct ir_expression*, int*, int*, unsigned short);
+static void countSlotAccess(int*, unsigned short, unsigned short);
+static int isStatementLiteralStore(struct ir_statement*);
+
+/**
+ * Folds every expression, then removes conditionals whose outcome is known (and those which lead to the same place either way),
+ * along with calls to functions which just return a literal made as statements
+ */
+void foldConstants(struct ir_program * program) {
+	struct ir_function * function;
+	struct ir_block * block;
+	for (function=program->functions;function != NULL;function=function->next) {
+		for (block=function->blocks;block != NULL;block=block->next) foldBlock(block);
+	}
+}
+
+/**
+ * Propagates literals held in variables into where those are read, then folds what this exposes
+ */
+void propagateConstants(struct ir_program * program) {
+	struct ir_function * function;
+	struct ir_block * block;
+	propagateModuleConstants(program);
+	for (function=program->functions;function != NULL;function=function->next) {
+		for (block=function->blocks;block != NULL;block=block->next) propagateWithinBlock(function, block);
+	}
+	foldConstants(program);
+}
+
+static void foldBlock(struct ir_block * block) {
+	int i;
+	struct ir_statement * statement=block->statements, * next;
+	while (statement != NULL) {
+		next=statement->next;
+		for (i=0;i<statement->numberExpressions;i++) statement->expressions[i]=foldExpression(statement->expressions[i]);
+		if (statement->token == FNCALL_TOKEN && getConstantReturnValue(statement->function) != NULL &&
+				areExpressionsPure(statement->numberExpressions, statement->expressions)) {
+			removeIRStatement(block, statement);
+		} else if (next == NULL && (statement->token == IF_TOKEN || statement->token == IFELSE_TOKEN || statement->token == CMP_JUMP_TOKEN)) {
+			struct ir_expression * condition=statement->expressions[0];
+			if (isLiteralExpression(condition)) {
+				if (!isLiteralTrue(condition)) block->fallthrough=statement->targets[0];
+				removeIRStatement(block, statement);
+			} else if (statement->targets[0] == block->fallthrough && isExpressionPure(condition)) {
+				removeIRStatement(block, statement);
+			}
+		}
+		statement=next;
+	}
+}
+
+/**
+ * Folds an expression, returning what replaces it (which might be the same expression with its operands folded)
+ */
+static struct ir_expression* foldExpression(struct ir_expression * expression) {
+	int i;
+	struct ir_expression * folded=NULL;
+	for (i=0;i<expression->numberChildren;i++) expression->children[i]=foldExpression(expression->children[i]);
+	if (isArithmeticExpression(expression)) {
+		folded=foldArithmetic(expression);
+	} else if (isComparisonExpression(expression) && expression->token != IS_TOKEN) {
+		folded=foldComparison(expression);
+	} else if (expression->token == NOT_TOKEN) {
+		struct ir_expression * operand=expression->children[0];
+		if (operand->token == INTEGER_TOKEN || operand->token == BOOLEAN_TOKEN) {
+			folded=createIntegerLiteral(BOOLEAN_TOKEN, !(operand->literal.integer > 0));
+		}
+	} else if (expression->token == AND_TOKEN || expression->token == OR_TOKEN) {
+		folded=foldShortCircuit(expression);
+	} else if (expression->token == FNCALL_TOKEN && areExpressionsPure(expression->numberChildren, expression->children)) {
+		struct ir_expression * returned=getConstantReturnValue(expression->function);
+		if (returned != NULL) folded=copyIRExpression(returned);
+	}
+	if (folded == NULL) return expression;
+	freeIRExpression(expression);
+	return folded;
+}
+
+/**
+ * Folds arithmetic on two numeric literals, as the interpreter does integers stay integers and otherwise the result is real
+ */
+static struct ir_expression* foldArithmetic(struct ir_expression * expression) {
+	struct ir_expression * first=expression->children[0], * second=expression->children[1];
+	unsigned char operator=getGenericOperator(expression->token);
+	int i;
+	if (!isNumericLiteral(first) || !isNumericLiteral(second)) return NULL;
+	if (first->token == INTEGER_TOKEN && second->token == INTEGER_TOKEN) {
+		// Done unsigned so that overflow wraps, as on the cores
+		int value1=first->literal.integer, value2=second->literal.integer;
+		unsigned int result=0;
+		if (operator == ADD_TOKEN) result=(unsigned int) value1 + (unsigned int) value2;
+		if (operator == SUB_TOKEN) result=(unsigned int) value1 - (unsigned int) value2;
+		if (operator == MUL_TOKEN) result=(unsigned int) value1 * (unsigned int) value2;
+		if (operator == DIV_TOKEN || operator == MOD_TOKEN) {
+			if (value2 == 0 || (value1 == INT_MIN && value2 == -1)) return NULL;
+			result=(unsigned int) (operator == DIV_TOKEN ? value1 / value2 : value1 % value2);
+		}
+		if (operator == POW_TOKEN) {
+			if (value2 > MAX_FOLDED_POWER) return NULL;
+			result=value2 == 0 ? 1 : (unsigned int) value1;
+			for (i=1;i<value2;i++) result=result * (unsigned int) value1;
+		}
+		return createIntegerLiteral(INTEGER_TOKEN, (int) result);
+	}
+	float value1=first->token == INTEGER_TOKEN ? (float) first->literal.integer : first->literal.real;
+	float value2=second->token == INTEGER_TOKEN ? (float) second->literal.integer : second->literal.real;
+	float result;
+	if (operator == ADD_TOKEN) {
+		result=value1+value2;
+	} else if (operator == SUB_TOKEN) {
+		result=value1-value2;
+	} else if (operator == MUL_TOKEN) {
+		result=value1*value2;
+	} else if (operator == DIV_TOKEN && value2 != 0) {
+		result=value1/value2;
+	} else if (operator == POW_TOKEN && second->token == INTEGER_TOKEN && second->literal.integer <= MAX_FOLDED_POWER) {
+		result=second->literal.integer == 0 ? 1 : value1;
+		for (i=1;i<second->literal.integer;i++) result=result*value1;
+	} else {
+		// Real modulus and powers are not defined by the interpreter
+		return NULL;
+	}
+	return createRealLiteral(result);
+}
+
+static struct ir_expression* foldComparison(struct ir_expression * expression) {
+	struct ir_expression * first=expression->children[0], * second=expression->children[1];
+	unsigned char operator=getGenericOperator(expression->token);
+	int result=0;
+	if (!isNumericLiteral(first) || !isNumericLiteral(second)) return NULL;
+	if (first->token == INTEGER_TOKEN && second->token == INTEGER_TOKEN) {
+		int value1=first->literal.integer, value2=second->literal.integer;
+		if (operator == EQ_TOKEN) result=value1 == value2;
+		if (operator == NEQ_TOKEN) result=value1 != value2;
+		if (operator == GT_TOKEN) result=value1 > value2;
+		if (operator == GEQ_TOKEN) result=value1 >= value2;
+		if (operator == LT_TOKEN) result=value1 < value2;
+		if (operator == LEQ_TOKEN) result=value1 <= value2;
+	} else {
+		float value1=first->token == INTEGER_TOKEN ? (float) first->literal.integer : first->literal.real;
+		float value2=second->token == INTEGER_TOKEN ? (float) second->literal.integer : second->literal.real;
+		if (operator == EQ_TOKEN) result=value1 == value2;
+		if (operator == NEQ_TOKEN) result=value1 != value2;
+		if (operator == GT_TOKEN) result=value1 > value2;
+		if (operator == GEQ_TOKEN) result=value1 >= value2;
+		if (operator == LT_TOKEN) result=value1 < value2;
+		if (operator == LEQ_TOKEN) result=value1 <= value2;
+	}
+	return createIntegerLiteral(BOOLEAN_TOKEN, result);
+}
+
+/**
+ * Folds an and or an or whose first operand is a literal, either this decides the result or the result is that of the second
+ * operand. The second operand can only replace the whole if it always gives a boolean, as any other value is tested differently
+ * as a condition than when it is the value of an expression
+ */
+static struct ir_expression* foldShortCircuit(struct ir_expression * expression) {
+	struct ir_expression * first=expression->children[0], * second=expression->children[1];
+	if (!isLiteralExpression(first)) return NULL;
+	int firstValue=isLiteralTrue(first);
+	if ((firstValue && expression->token == OR_TOKEN) || (!firstValue && expression->token == AND_TOKEN)) {
+		return createIntegerLiteral(BOOLEAN_TOKEN, firstValue);
+	}
+	if (isLiteralExpression(second)) return createIntegerLiteral(BOOLEAN_TOKEN, isLiteralTrue(second));
+	if (isBooleanExpression(second)) {
+		expression->children[1]=NULL;
+		return second;
+	}
+	return NULL;
+}
+
+/**
+ * If a function does nothing but return a literal then this gets that literal, otherwise NULL
+ */
+static struct ir_expression* getConstantReturnValue(struct ir_function * function) {
+	struct ir_statement * statement=function->blocks->statements;
+	if (statement == NULL || statement->next != NULL || statement->token != RETURN_EXP_TOKEN) return NULL;
+	statement->expressions[0]=foldExpression(statement->expressions[0]);
+	return isLiteralExpression(statement->expressions[0]) ? statement->expressions[0] : NULL;
+}
+
+/**
+ * Whether the values passed to a call are all pure, so the call can be dropped without losing anything they do
+ */
+static int areExpressionsPure(int number, struct ir_expression ** expressions) {
+	int i;
+	for (i=0;i<number;i++) {
+		if (!isExpressionPure(expressions[i])) return 0;
+	}
+	return 1;
+}
+
+/**
+ * Whether a literal is true when tested as a condition, only booleans and integers greater than zero are
+ */
+static int isLiteralTrue(struct ir_expression * expression) {
+	return expression->token != REAL_TOKEN && expression->literal.integer > 0;
+}
+
+static int isBooleanExpression(struct ir_expression * expression) {
+	return expression->token == BOOLEAN_TOKEN || isComparisonExpression(expression) || expression->token == NOT_TOKEN ||
+			expression->token == AND_TOKEN || expression->token == OR_TOKEN;
+}
+
+static int isNumericLiteral(struct ir_expression * expression) {
+	return expression->token == INTEGER_TOKEN || expression->token == REAL_TOKEN;
+}
+
+static struct ir_expression* createIntegerLiteral(unsigned char token, int value) {
+	struct ir_expression * literal=createIRExpression(token, 0);
+	literal->literal.integer=value;
+	return literal;
+}
+
+static struct ir_expression* createRealLiteral(float value) {
+	struct ir_expression * literal=createIRExpression(REAL_TOKEN, 0);
+	literal->literal.real=value;
+	return literal;
+}
+
+/**
+ * Within a block, a variable assigned a literal and then read again has the literal used in its place until the variable is
+ * assigned again or a function is called which might assign it (a global, or any variable passed as an argument as these are
+ * passed by reference.) The function's own arguments are not tracked, as they refer to the caller's variables which may be
+ * assigned under another name, and for the same reason assigning one of them forgets every global
+ */
+static void propagateWithinBlock(struct ir_function * function, struct ir_block * block) {
+	int i, j;
+	struct known_values known;
+	struct ir_statement * statement;
+	known.number=0;
+	known.capacity=8;
+	known.values=(struct known_value*) malloc(sizeof(struct known_value) * known.capacity);
+	for (statement=block->statements;statement != NULL;statement=statement->next) {
+		// Assignments and calls within the statement's expressions happen before anything else that they read
+		for (i=0;i<statement->numberExpressions;i++) forgetWrittenByExpression(function, &known, statement->expressions[i]);
+		for (j=0;j<known.number;j++) replaceStatementLoads(statement, known.values[j].slot, known.values[j].value);
+		for (i=0;i<statement->numberExpressions;i++) statement->expressions[i]=foldExpression(statement->expressions[i]);
+		if (statement->token == FNCALL_TOKEN || statement->token == FNCALL_BY_VAR_TOKEN) {
+			forgetGlobalValues(&known);
+			for (i=0;i<statement->numberArguments;i++) forgetValue(&known, statement->argumentSlots[i]);
+		}
+		if (statement->token == STORE_SLOT_TOKEN || statement->token == LETNOALIAS_TOKEN || statement->token == OP_ASSIGN_TOKEN ||
+				statement->token == INC_SLOT_TOKEN || statement->token == ARRAYSET_TOKEN || statement->token == ARRAYSET_1D_TOKEN ||
+				statement->token == FOR_TOKEN || statement->token == FOR_RANGE_TOKEN) {
+			forgetWrittenValue(function, &known, statement->slot);
+			if (statement->token == FOR_TOKEN || statement->token == FOR_RANGE_TOKEN) {
+				forgetWrittenValue(function, &known, statement->secondSlot);
+			}
+		}
+		if (isStatementLiteralStore(statement) && !isFunctionArgument(function, statement->slot)) {
+			rememberValue(&known, statement->slot, statement->expressions[0]);
+		}
+	}
+	free(known.values);
+}
+
+/**
+ * Module level constants, globals which are only ever assigned once, with a literal, in the straight line code at the start of the
+ * program (before any function is called.) Every read after the assignment uses the literal instead and if none is left then the
+ * assignment itself is removed
+ */
+static void propagateModuleConstants(struct ir_program * program) {
+	int i, callSeen=0;
+	int * reads=(int*) calloc(program->numberGlobals+1, sizeof(int));
+	int * writes=(int*) calloc(program->numberGlobals+1, sizeof(int));
+	struct ir_expression ** constants=(struct ir_expression**) calloc(program->numberGlobals+1, sizeof(struct ir_expression*));
+	struct ir_statement ** constantStores=(struct ir_statement**) calloc(program->numberGlobals+1, sizeof(struct ir_statement*));
+	struct ir_block * entry=program->functions->blocks, * block;
+	struct ir_function * function;
+	struct ir_statement * statement, * next;
+	countSlotAccesses(program, reads, writes);
+
+	// Reads in the entry block only see the constant once it has been assigned, everywhere else runs after the entry block
+	for (statement=entry->statements;statement != NULL;statement=statement->next) {
+		for (i=0;i<program->numberGlobals;i++) {
+			if (constants[i] != NULL) replaceStatementLoads(statement, (unsigned short) i, constants[i]);
+		}
+		if (isStatementLiteralStore(statement) && !callSeen && !(statement->slot & LOCAL_SLOT_FLAG) &&
+				statement->slot < program->numberGlobals && writes[statement->slot] == 1) {
+			constants[statement->slot]=statement->expressions[0];
+			constantStores[statement->slot]=statement;
+		}
+		if (doesStatementCall(statement)) callSeen=1;
+	}
+	for (function=program->functions;function != NULL;function=function->next) {
+		for (block=function->blocks;block != NULL;block=block->next) {
+			if (block == entry) continue;
+			for (statement=block->statements;statement != NULL;statement=statement->next) {
+				for (i=0;i<program->numberGlobals;i++) {
+					if (constants[i] != NULL) replaceStatementLoads(statement, (unsigned short) i, constants[i]);
+				}
+			}
+		}
+	}
+
+	for (i=0;i<program->numberGlobals;i++) reads[i]=writes[i]=0;
+	countSlotAccesses(program, reads, writes);
+	for (statement=entry->statements;statement != NULL;statement=next) {
+		next=statement->next;
+		if (isStatementLiteralStore(statement) && statement->slot < program->numberGlobals &&
+				constantStores[statement->slot] == statement && reads[statement->slot] == 0) {
+			removeIRStatement(entry, statement);
+		}
+	}
+	free(reads);
+	free(writes);
+	free(constants);
+	free(constantStores);
+}
+
+/**
+ * Replaces reads of a variable with a literal throughout an expression, returning the number replaced. Where the read is tested
+ * directly as a condition an integer literal is not substituted, as the interpreter tests an integer variable differently to an
+ * integer literal there
+ */
+static int replaceLoads(struct ir_expression ** position, unsigned short slot, struct ir_expression * value, int isCondition) {
+	int i, replaced=0;
+	struct ir_expression * expression=*position;
+	if (expression->token == LOAD_SLOT_TOKEN && expression->slot == slot) {
+		if (isCondition && value->token == INTEGER_TOKEN) return 0;
+		*position=copyIRExpression(value);
+		freeIRExpression(expression);
+		return 1;
+	}
+	for (i=0;i<expression->numberChildren;i++) {
+		replaced+=replaceLoads(&expression->children[i], slot, value, expression->token == AND_TOKEN || expression->token == OR_TOKEN);
+	}
+	return replaced;
+}
+
+static int replaceStatementLoads(struct ir_statement * statement, unsigned short slot, struct ir_expression * value) {
+	int i, replaced=0;
+	for (i=0;i<statement->numberExpressions;i++) {
+		replaced+=replaceLoads(&statement->expressions[i], slot, value,
+				statement->token == IF_TOKEN || statement->token == IFELSE_TOKEN);
+	}
+	return replaced;
+}
+
+/**
+ * Forgets any values assigned by an expression, or every global if it calls a function
+ */
+static void forgetWrittenByExpression(struct ir_function * function, struct known_values * known, struct ir_expression * expression) {
+	int i;
+	if (expression->token == STORE_SLOT_TOKEN) forgetWrittenValue(function, known, expression->slot);
+	if (expression->token == FNCALL_TOKEN || expression->token == FNCALL_BY_VAR_TOKEN) {
+		forgetGlobalValues(known);
+		for (i=0;i<expression->numberArguments;i++) forgetValue(known, expression->argumentSlots[i]);
+	}
+	for (i=0;i<expression->numberChildren;i++) forgetWrittenByExpression(function, known, expression->children[i]);
+}
+
+/**
+ * Forgets the value of a variable which is assigned, if this is one of the function's arguments then it may be a global under
+ * another name so every global is forgotten too
+ */
+static void forgetWrittenValue(struct ir_function * function, struct known_values * known, unsigned short slot) {
+	forgetValue(known, slot);
+	if (isFunctionArgument(function, slot)) forgetGlobalValues(known);
+}
+
+static void forgetValue(struct known_values * known, unsigned short slot) {
+	int i;
+	for (i=0;i<known->number;i++) {
+		if (known->values[i].slot == slot) known->values[i--]=known->values[--known->number];
+	}
+}
+
+static void forgetGlobalValues(struct known_values * known) {
+	int i;
+	for (i=0;i<known->number;i++) {
+		if (!(known->values[i].slot & LOCAL_SLOT_FLAG)) known->values[i--]=known->values[--known->number];
+	}
+}
+
+static void rememberValue(struct known_values * known, unsigned short slot, struct ir_expression * value) {
+	if (known->number == known->capacity) {
+		known->capacity*=2;
+		known->values=(struct known_value*) realloc(known->values, sizeof(struct known_value) * known->capacity);
+	}
+	known->values[known->number].slot=slot;
+	known->values[known->number++].value=value;
+}
+
+static int doesStatementCall(struct ir_statement * statement) {
+	int i;
+	if (statement->token == FNCALL_TOKEN || statement->token == FNCALL_BY_VAR_TOKEN) return 1;
+	for (i=0;i<statement->numberExpressions;i++) {
+		if (doesExpressionCall(statement->expressions[i])) return 1;
+	}
+	return 0;
+}
+
+static int doesExpressionCall(struct ir_expression * expression) {
+	int i;
+	if (expression->token == FNCALL_TOKEN || expression->token == FNCALL_BY_VAR_TOKEN) return 1;
+	for (i=0;i<expression->numberChildren;i++) {
+		if (doesExpressionCall(expression->children[i])) return 1;
+	}
+	return 0;
+}
+
+/**
+ * Counts the reads and writes of each global throughout the program. Arguments are passed by reference, so a variable passed to a
+ * function counts as both read and written by the call
+ */
+static void countSlotAccesses(struct ir_program * program, int * reads, int * writes) {
+	int i;
+	unsigned short numberGlobals=program->numberGlobals;
+	struct ir_function * function;
+	struct ir_block * block;
+	struct ir_statement * statement;
+	for (function=program->functions;function != NULL;function=function->next) {
+		for (i=0;i<function->numberArguments;i++) countSlotAccess(writes, function->argumentSlots[i], numberGlobals);
+		for (block=function->blocks;block != NULL;block=block->next) {
+			for (statement=block->statements;statement != NULL;statement=statement->next) {
+				unsigned char token=statement->token;
+				if (token == STORE_SLOT_TOKEN || token == LETNOALIAS_TOKEN || token == OP_ASSIGN_TOKEN || token == INC_SLOT_TOKEN ||
+						token == FOR_TOKEN || token == FOR_RANGE_TOKEN) {
+					countSlotAccess(writes, statement->slot, numberGlobals);
+					if (token == FOR_TOKEN || token == FOR_RANGE_TOKEN) countSlotAccess(writes, statement->secondSlot, numberGlobals);
+				}
+				if (token == FOR_RANGE_TOKEN) {
+					countSlotAccess(reads, statement->secondSlot, numberGlobals);
+					countSlotAccess(reads, statement->stopSlot, numberGlobals);
+					countSlotAccess(reads, statement->stepSlot, numberGlobals);
+				}
+				if (token == OP_ASSIGN_TOKEN || token == INC_SLOT_TOKEN || token == ARRAYSET_TOKEN || token == ARRAYSET_1D_TOKEN ||
+						token == SWITCH_TOKEN || token == FNCALL_BY_VAR_TOKEN) {
+					countSlotAccess(reads, statement->slot, numberGlobals);
+				}
+				for (i=0;i<statement->numberArguments;i++) {
+					countSlotAccess(reads, statement->argumentSlots[i], numberGlobals);
+					countSlotAccess(writes, statement->argumentSlots[i], numberGlobals);
+				}
+				for (i=0;i<statement->numberExpressions;i++) {
+					countExpressionAccesses(statement->expressions[i], reads, writes, numberGlobals);
+				}
+			}
+		}
+	}
+}
+
+static void countExpressionAccesses(struct ir_expression * expression, int * reads, int * writes, unsigned short numberGlobals) {
+	int i;
+	if (expression->token == STORE_SLOT_TOKEN) {
+		countSlotAccess(writes, expression->slot, numberGlobals);
+	} else if (expression->token == LOAD_SLOT_TOKEN || expression->token == ARRAYACCESS_TOKEN ||
+			expression->token == ARRAYACCESS_1D_TOKEN || expression->token == FNCALL_BY_VAR_TOKEN) {
+		countSlotAccess(reads, expression->slot, numberGlobals);
+	}
+	for (i=0;i<expression->numberArguments;i++) {
+		countSlotAccess(reads, expression->argumentSlots[i], numberGlobals);
+		countSlotAccess(writes, expression->argumentSlots[i], numberGlobals);
+	}
+	for (i=0;i<expression->numberChildren;i++) countExpressionAccesses(expression->children[i], reads, writes, numberGlobals);
+}
+
+static void countSlotAccess(int * counts, unsigned short slot, unsigned short numberGlobals) {
+	if (!(slot & LOCAL_SLOT_FLAG) && slot < numberGlobals) counts[slot]++;
+}
+
+/**
+ * Whether a statement assigns a literal to a variable, a default argument's assignment is not included as it only happens if the
+ * argument was not passed
+ */
+static int isStatementLiteralStore(struct ir_statement * statement) {
+	return statement->token == STORE_SLOT_TOKEN && isLiteralExpression(statement->expressions[0]);
+}
+
+static int isFunctionArgument(struct ir_function * function, unsigned short slot) {
+	int i;
+	for (i=0;i<function->numberArguments;i++) {
+		if (function->argumentSlots[i] == slot) return 1;
+	}
+	return 0;
+}
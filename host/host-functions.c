@@ -38,6 +38,12 @@
 #include "host-functions.h"
 #include "device-support.h"
 #include "misc.h"
+#include "heap.h"
+
+// Size of the heap of each process, any memory that does not fit in this is malloced and tracked individually
+#define HOST_HEAP_SIZE 1048576
+// Size of the scratch arena of each process, for strings and arrays which do not outlive the statement creating them
+#define HOST_SCRATCH_SIZE 65536
 
 struct hostHeapNodes {
     char* ptr;
@@ -45,6 +51,9 @@ struct hostHeapNodes {
 };
 
 volatile struct hostHeapNodes ** rootHeapNode;
+struct heap_definition * hostHeaps;
+struct heap_temporaries * hostTemporaries;
+struct scratch_arena * hostScratchArenas;
 volatile unsigned char **sharedComm, **syncValues;
 volatile struct shared_basic * basicState;
 volatile int total_threads, hostCoresBasePid;
@@ -55,12 +64,12 @@ volatile int * flip_barrier_array, * flop_barrier_array;
 volatile unsigned int * pb;
 #endif
 
-static struct value_defn getInputFromUser(int);
-static struct value_defn getInputFromUserWithString(struct value_defn, int);
+static struct value_defn getInputFromUser(int, struct symbol_node*, int);
+static struct value_defn getInputFromUserWithString(struct value_defn, int, struct symbol_node*, int);
 static void displayToUser(struct value_defn, int);
 static void garbageCollect(int, struct symbol_node*, int);
 static int getTypeOfInput(char*);
-static struct value_defn performGetInputFromUser(char*, int);
+static struct value_defn performGetInputFromUser(char*, int, struct symbol_node*, int);
 static void sendDataToDeviceCore(struct value_defn, int, int, int);
 static void sendDataToHostProcess(struct value_defn, int, char, int);
 static struct value_defn recvDataFromDeviceCore(int, int, int);
@@ -70,7 +79,7 @@ static struct value_defn sendRecvDataWithHostProcess(struct value_defn, int, int
 static void syncWithDevice();
 static char removehostHeapNode(char*, int);
 static struct hostHeapNodes * findHeapNode(char*, int);
-static char isMemoryAddressFound(char*, int, struct symbol_node*);
+static char isMemoryAddressFound(char*, int, struct symbol_node*, int);
 static struct value_defn performMathsOp(int, struct value_defn);
 static struct value_defn probeForMessage(int, int, int);
 static struct value_defn test_or_wait_for_sent_message(int, char, int);
@@ -83,10 +92,16 @@ void initHostCommunicationData(int total_number_threads, struct shared_basic * p
 	int i, j;
 	basicState=parallelBasicState;
 	rootHeapNode=(volatile struct hostHeapNodes **) malloc(sizeof(struct hostHeapNodes*)*total_number_threads);
+	hostHeaps=(struct heap_definition*) malloc(sizeof(struct heap_definition)*total_number_threads);
+	hostTemporaries=(struct heap_temporaries*) malloc(sizeof(struct heap_temporaries)*total_number_threads);
+	hostScratchArenas=(struct scratch_arena*) malloc(sizeof(struct scratch_arena)*total_number_threads);
 	sharedComm=(volatile unsigned char**) malloc(sizeof(unsigned char*)*total_number_threads);
 	syncValues=(volatile unsigned char**) malloc(sizeof(unsigned char*)*total_number_threads);
 	for (i=0;i<total_number_threads;i++) {
         rootHeapNode[i]=NULL;
+        initialiseHeap(&hostHeaps[i], (char*) malloc(HOST_HEAP_SIZE), HOST_HEAP_SIZE, sizeof(unsigned int));
+        hostTemporaries[i].number=0;
+        initialiseScratchArena(&hostScratchArenas[i], (char*) malloc(HOST_SCRATCH_SIZE), HOST_SCRATCH_SIZE);
 		sharedComm[i]=(unsigned char*) malloc(total_number_threads*6);
 		syncValues[i]=(unsigned char*) malloc(total_number_threads);
 		for (j=0;j<total_number_threads;j++) {
@@ -107,22 +122,22 @@ void initHostCommunicationData(int total_number_threads, struct shared_basic * p
 void callNativeFunction(struct value_defn * value, unsigned char fnIdentifier, int numArgs, struct value_defn* parameters,
                                        int numActiveCores, int localCoreId, int currentSymbolEntries, struct symbol_node* symbolTable, int threadId) {
     if (fnIdentifier==NATIVE_FN_RTL_ISHOST || fnIdentifier==NATIVE_FN_RTL_ISDEVICE) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         value->type=BOOLEAN_TYPE;
         value->dtype=SCALAR;
         int v=fnIdentifier==NATIVE_FN_RTL_ISHOST ? 1 : 0;
         cpy(value->data, &v, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_ISDEVICE) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         value->type=BOOLEAN_TYPE;
         value->dtype=SCALAR;
         int v=0;
         cpy(value->data, &v, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_PRINT) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         displayToUser(parameters[0], threadId);
     } else if (fnIdentifier==NATIVE_FN_RTL_NUMDIMS) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         int intNDims=0;
         if (parameters[0].dtype == ARRAY) {
             char * ptr;
@@ -136,7 +151,7 @@ void callNativeFunction(struct value_defn * value, unsigned char fnIdentifier, i
         value->dtype=SCALAR;
 		cpy(value->data, &intNDims, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_DSIZE) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         int dimSize=0;
         if (parameters[0].dtype == ARRAY) {
             int lookupIndex=getInt(parameters[1].data);
@@ -153,48 +168,53 @@ void callNativeFunction(struct value_defn * value, unsigned char fnIdentifier, i
         value->dtype=SCALAR;
 		cpy(value->data, &dimSize, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_INPUT) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
-        *value=getInputFromUser(threadId);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
+        *value=getInputFromUser(currentSymbolEntries, symbolTable, threadId);
     } else if (fnIdentifier==NATIVE_FN_RTL_INPUTPRINT) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
-        *value=getInputFromUserWithString(parameters[0], threadId);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
+        *value=getInputFromUserWithString(parameters[0], currentSymbolEntries, symbolTable, threadId);
     } else if (fnIdentifier==NATIVE_FN_RTL_SYNC) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         syncCores(1, threadId);
     } else if (fnIdentifier==NATIVE_FN_RTL_GC) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         garbageCollect(currentSymbolEntries, symbolTable, threadId);
     } else if (fnIdentifier==NATIVE_FN_RTL_FREE) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         char * ptr;
         cpy(&ptr, parameters[0].data, sizeof(char*));
+#ifdef INTERPRETER_REFERENCE_COUNTING
+        // Memory a variable still references is freed once the last of these no longer does
+        if (!isAddressInHeap(&hostHeaps[threadId], ptr) || !isReferencedInHeap(&hostHeaps[threadId], ptr)) freeMemoryInHeap(ptr, threadId);
+#else
         freeMemoryInHeap(ptr, threadId);
+#endif
     } else if (fnIdentifier==NATIVE_FN_RTL_SEND || fnIdentifier==NATIVE_FN_RTL_SEND_NB) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         sendData(parameters[0], getInt(parameters[1].data), fnIdentifier==NATIVE_FN_RTL_SEND ? 1 : 0, threadId, hostCoresBasePid);
     } else if (fnIdentifier==NATIVE_FN_RTL_RECV) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         *value=recvData(getInt(parameters[0].data), threadId, hostCoresBasePid);
     } else if (fnIdentifier==NATIVE_FN_RTL_PROBE_FOR_MESSAGE) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         *value=probeForMessage(getInt(parameters[0].data), threadId, hostCoresBasePid);
     } else if (fnIdentifier==NATIVE_FN_RTL_TEST_FOR_SEND || fnIdentifier==NATIVE_FN_RTL_WAIT_FOR_SEND) {
-        if (numArgs != 1) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 1);
         *value=test_or_wait_for_sent_message(getInt(parameters[0].data), fnIdentifier==NATIVE_FN_RTL_WAIT_FOR_SEND ? 1 : 0, threadId);
     } else if (fnIdentifier==NATIVE_FN_RTL_SENDRECV) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         *value=sendRecvData(parameters[0], getInt(parameters[1].data), threadId, hostCoresBasePid);
     } else if (fnIdentifier==NATIVE_FN_RTL_BCAST) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         *value=bcastData(parameters[0], getInt(parameters[1].data), threadId, numActiveCores, hostCoresBasePid);
     } else if (fnIdentifier==NATIVE_FN_RTL_NUMCORES || fnIdentifier==NATIVE_FN_RTL_COREID) {
-        if (numArgs != 0) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 0);
         value->type=INT_TYPE;
 		value->dtype=SCALAR;
         if (fnIdentifier==NATIVE_FN_RTL_NUMCORES) cpy(value->data, &numActiveCores, sizeof(int));
         if (fnIdentifier==NATIVE_FN_RTL_COREID) cpy(value->data, &localCoreId, sizeof(int));
     } else if (fnIdentifier==NATIVE_FN_RTL_REDUCE) {
-        if (numArgs != 2) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS);
+        CHECK_NATIVE_ARGUMENTS(numArgs, 2);
         *value=reduceData(parameters[0], getInt(parameters[1].data), threadId, numActiveCores, hostCoresBasePid);
     } else if (fnIdentifier==NATIVE_FN_RTL_ALLOCARRAY || fnIdentifier==NATIVE_FN_RTL_ALLOCSHAREDARRAY) {
         int totalDataSize=1, i;
@@ -202,7 +222,7 @@ void callNativeFunction(struct value_defn * value, unsigned char fnIdentifier, i
             totalDataSize*=getInt(parameters[i].data);
         }
         char * address=getHeapMemory(sizeof(unsigned char) + (sizeof(int)*(totalDataSize+numArgs)),
-                                     fnIdentifier==NATIVE_FN_RTL_ALLOCSHAREDARRAY, threadId);
+                                     fnIdentifier==NATIVE_FN_RTL_ALLOCSHAREDARRAY, currentSymbolEntries, symbolTable, threadId);
         value->type=INT_TYPE;
         value->dtype=ARRAY;
         cpy(value->data, &address, sizeof(char*));
@@ -265,24 +285,25 @@ int checkStringEquality(struct value_defn str1, struct value_defn str2) {
 /**
  * Called when running on the host, will get input from user displaying a message string
  */
-static struct value_defn getInputFromUserWithString(struct value_defn toDisplay, int threadId) {
+static struct value_defn getInputFromUserWithString(struct value_defn toDisplay, int currentSymbolEntries, struct symbol_node* symbolTable,
+		int threadId) {
 	if (toDisplay.type != STRING_TYPE) raiseError(ERR_ONLY_DISPLAY_STR_WITH_INPUT);
 	char *c;
 	cpy(&c, &toDisplay.data, sizeof(char*));
-	return performGetInputFromUser(c, threadId);
+	return performGetInputFromUser(c, currentSymbolEntries, symbolTable, threadId);
 }
 
 /**
  * Called when running on the host, will get input from the user
  */
-static struct value_defn getInputFromUser(int threadId) {
-	return performGetInputFromUser(NULL, threadId);
+static struct value_defn getInputFromUser(int currentSymbolEntries, struct symbol_node* symbolTable, int threadId) {
+	return performGetInputFromUser(NULL, currentSymbolEntries, symbolTable, threadId);
 }
 
 /**
  * Actually gets the input from the user and puts this in the appropriate data area
  */
-static struct value_defn performGetInputFromUser(char * toDisplay, int threadId) {
+static struct value_defn performGetInputFromUser(char * toDisplay, int currentSymbolEntries, struct symbol_node* symbolTable, int threadId) {
 	struct value_defn v;
 	v.dtype=SCALAR;
 	char inputvalue[1000];
@@ -303,7 +324,7 @@ static struct value_defn performGetInputFromUser(char * toDisplay, int threadId)
 		cpy(v.data, &fval, sizeof(float));
 	} else {
 		v.type=STRING_TYPE;
-		char * newString=getHeapMemory(strlen(inputvalue)+1, 0, threadId);
+		char * newString=getHeapMemory(strlen(inputvalue)+1, 0, currentSymbolEntries, symbolTable, threadId);
 		strcpy(newString, inputvalue);
 		cpy(&v.data, &newString, sizeof(char*));
 	}
@@ -331,25 +352,42 @@ static int getTypeOfInput(char * input) {
 }
 
 /**
- * Called when running on the host, concatenates two strings (or a string with integer/real)
+ * Called when running on the host, concatenates two strings (or a string with integer/real). If scratch is set the result does
+ * not outlive the current statement so is placed in the scratch arena if it fits
  */
-struct value_defn performStringConcatenation(struct value_defn v1, struct value_defn v2, int threadId) {
+struct value_defn performStringConcatenation(struct value_defn v1, struct value_defn v2, char scratch, int currentSymbolEntries,
+		struct symbol_node* symbolTable, int threadId) {
 	struct value_defn result;
+	char * operand;
+	int heldTemporaries=0;
 	result.type=STRING_TYPE;
 	result.dtype=SCALAR;
+	// Either operand might not be held by a variable, so these are held whilst the result is allocated
+	if (v1.type==STRING_TYPE) {
+		cpy(&operand, &v1.data, sizeof(char*));
+		holdTemporary(operand, threadId);
+		heldTemporaries++;
+	}
+	if (v2.type==STRING_TYPE) {
+		cpy(&operand, &v2.data, sizeof(char*));
+		holdTemporary(operand, threadId);
+		heldTemporaries++;
+	}
 	if (v1.type==STRING_TYPE && v2.type==STRING_TYPE) {
 		char *str1, *str2;
 		cpy(&str1, &v1.data, sizeof(char*));
 		cpy(&str2, &v2.data, sizeof(char*));
 		int totalLen=strlen(str1)+strlen(str2)+1;
-		char * newString=getHeapMemory(totalLen, 0, threadId);
+		char * newString=scratch ? getScratchMemory(totalLen, threadId) : NULL;
+		if (newString == NULL) newString=getHeapMemory(totalLen, 0, currentSymbolEntries, symbolTable, threadId);
 		sprintf(newString,"%s%s", str1, str2);
 		cpy(&result.data, &newString, sizeof(char*));
 	} else if (v1.type==STRING_TYPE) {
 		char *str1;
 		cpy(&str1, &v1.data, sizeof(char*));
 		int totalLen=strlen(str1)+21;
-		char * newString=getHeapMemory(totalLen, 0, threadId);
+		char * newString=scratch ? getScratchMemory(totalLen, threadId) : NULL;
+		if (newString == NULL) newString=getHeapMemory(totalLen, 0, currentSymbolEntries, symbolTable, threadId);
 		if (v2.type==INT_TYPE) {
 			int int_v;
 			cpy(&int_v, v2.data, sizeof(int));
@@ -370,7 +408,8 @@ struct value_defn performStringConcatenation(struct value_defn v1, struct value_
 		char *str2;
 		cpy(&str2, &v2.data, sizeof(char*));
 		int totalLen=strlen(str2)+21;
-		char * newString=getHeapMemory(totalLen, 0, threadId);
+		char * newString=scratch ? getScratchMemory(totalLen, threadId) : NULL;
+		if (newString == NULL) newString=getHeapMemory(totalLen, 0, currentSymbolEntries, symbolTable, threadId);
 		if (v1.type==INT_TYPE) {
 			int int_v;
 			cpy(&int_v, v1.data, sizeof(int));
@@ -388,6 +427,7 @@ struct value_defn performStringConcatenation(struct value_defn v1, struct value_
 		}
 		cpy(&result.data, &newString, sizeof(char*));
 	}
+	releaseTemporaries(heldTemporaries, threadId);
 	return result;
 }
 
@@ -398,23 +438,42 @@ struct symbol_node* initialiseSymbolTable(int numberSymbols) {
 	return (struct symbol_node*) malloc(sizeof(struct symbol_node) * numberSymbols);
 }
 
+/**
+ * Collects the garbage in the heap of the process (in the incremental build only the next step of this) and then in the
+ * memory malloced once that heap was full
+ */
 static void garbageCollect(int currentSymbolEntries, struct symbol_node* symbolTable, int threadId) {
     volatile struct hostHeapNodes * head=rootHeapNode[threadId];
+    struct heap_definition * heap=&hostHeaps[threadId];
     char * ptr;
+#ifdef INTERPRETER_INCREMENTAL_GC
+    collectGarbageIncrementally(&heap, 1, &hostTemporaries[threadId], currentSymbolEntries, symbolTable);
+#else
+    collectGarbage(&heap, 1, &hostTemporaries[threadId], currentSymbolEntries, symbolTable);
+#endif
     while (head != NULL) {
         ptr=head->ptr;
         head=head->next;
-        if (!isMemoryAddressFound(ptr, currentSymbolEntries, symbolTable)) {
+        if (!isMemoryAddressFound(ptr, currentSymbolEntries, symbolTable, threadId)) {
             removehostHeapNode(ptr, threadId);
         }
     }
 }
 
-static char isMemoryAddressFound(char * address, int currentSymbolEntries, struct symbol_node* symbolTable) {
+/**
+ * Determines whether some malloced memory is held by a variable or temporary, there is only any of this once the heap of the
+ * process is full so the roots are searched directly
+ */
+static char isMemoryAddressFound(char * address, int currentSymbolEntries, struct symbol_node* symbolTable, int threadId) {
     int i;
     char * ptr;
+    // If more temporaries have been held than the addresses recorded then any memory might be one of these
+    if (hostTemporaries[threadId].number > HEAP_TEMPORARY_ROOTS) return 1;
+    for (i=0;i<hostTemporaries[threadId].number;i++) {
+        if (address == hostTemporaries[threadId].addresses[i]) return 1;
+    }
     for (i=0;i<=currentSymbolEntries;i++) {
-        if (symbolTable[i].state==ALLOCATED && (symbolTable[i].value.dtype==ARRAY || symbolTable[i].value.type==STRING_TYPE)) {
+        if ((symbolTable[i].state==ALLOCATED || symbolTable[i].state==ARGUMENT) && (symbolTable[i].value.dtype==ARRAY || symbolTable[i].value.type==STRING_TYPE)) {
             cpy(&ptr, symbolTable[i].value.data, sizeof(char*));
             if (address == ptr) return 1;
         }
@@ -423,18 +482,81 @@ static char isMemoryAddressFound(char * address, int currentSymbolEntries, struc
 }
 
 /**
- * Called when running on the host, will get the memory address to store some array into
+ * Called when running on the host, will get the memory address to store some array into. This is allocated in the heap of
+ * the process if it fits, otherwise it is malloced and tracked
  */
-char* getHeapMemory(int size, char shared, int threadId) {
-    char * ptr=(char*) malloc(size);
+char* getHeapMemory(int size, char shared, int currentSymbolEntries, struct symbol_node* symbolTable, int threadId) {
+    struct heap_definition * heap=&hostHeaps[threadId];
+    char * ptr=allocateInHeap(heap, size);
+    if (ptr != NULL) return ptr;
+#ifdef INTERPRETER_COMPACTING_GC
+    // The heap might hold enough free memory but not in one piece, so as on the device garbage is collected and the heap
+    // compacted before falling back to malloc
+    if (currentSymbolEntries >= 0 && symbolTable != NULL) {
+        collectGarbage(&heap, 1, &hostTemporaries[threadId], currentSymbolEntries, symbolTable);
+        ptr=allocateInHeap(heap, size);
+        if (ptr == NULL && compactHeap(heap, size, &hostTemporaries[threadId], currentSymbolEntries, symbolTable)) {
+            ptr=allocateInHeap(heap, size);
+        }
+        if (ptr != NULL) return ptr;
+    }
+#endif
+    ptr=(char*) malloc(size);
     struct hostHeapNodes * newNode=(struct hostHeapNodes*) malloc(sizeof(struct hostHeapNodes));
     newNode->ptr=ptr;
     newNode->next=(struct hostHeapNodes *) rootHeapNode[threadId];
     newNode->prev=NULL;
+    if (newNode->next != NULL) newNode->next->prev=newNode;
     rootHeapNode[threadId]=newNode;
 	return ptr;
 }
 
+/**
+ * Allocates some memory in the scratch arena of the process, returning NULL if the arena is full
+ */
+char* getScratchMemory(int size, int threadId) {
+    return allocateInScratchArena(&hostScratchArenas[threadId], size);
+}
+
+/**
+ * Gets the top of the scratch arena, which the arena is later reset to in order to free everything allocated in it since
+ */
+char* getScratchMark(int threadId) {
+    return hostScratchArenas[threadId].top;
+}
+
+void resetScratchMemory(char * mark, int threadId) {
+    hostScratchArenas[threadId].top=mark;
+}
+
+/**
+ * Counts a further variable referencing some memory if it is in the heap of the process (malloced memory is not counted and
+ * only freed by collecting garbage), or if permanently then it is held somewhere uncounted
+ */
+void retainHeapMemory(char * address, char permanently, int threadId) {
+    if (isAddressInHeap(&hostHeaps[threadId], address)) retainInHeap(&hostHeaps[threadId], address, permanently);
+}
+
+/**
+ * Counts a variable no longer referencing some memory if it is in the heap of the process, if reclaim is set then the memory is
+ * freed once nothing references it
+ */
+void releaseHeapMemory(char * address, char reclaim, int threadId) {
+    if (isAddressInHeap(&hostHeaps[threadId], address)) releaseInHeap(&hostHeaps[threadId], address, &hostTemporaries[threadId], reclaim);
+}
+
+/**
+ * Holds some heap memory that is not held by a variable, such as the operand of an expression, so that collecting garbage does
+ * not free it before it is used. Temporaries are released in the reverse order to that held
+ */
+void holdTemporary(char * address, int threadId) {
+    holdHeapTemporary(&hostTemporaries[threadId], address);
+}
+
+void releaseTemporaries(int number, int threadId) {
+    releaseHeapTemporaries(&hostTemporaries[threadId], number);
+}
+
 static char removehostHeapNode(char* ptr, int threadId) {
     struct hostHeapNodes * toDelete=findHeapNode(ptr, threadId);
     if (toDelete != NULL) {
@@ -462,7 +584,9 @@ char* getStackMemory(int size, char shared) {
 
 void freeMemoryInHeap(void* addr, int threadId) {
     char * address=(char*) addr;
-    if (removehostHeapNode(address, threadId)) {
+    if (isAddressInHeap(&hostHeaps[threadId], address)) {
+        freeInHeap(&hostHeaps[threadId], address);
+    } else if (removehostHeapNode(address, threadId)) {
         free(address);
     } else {
         raiseError(ERR_FREE_ON_NON_HEAP);
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Inlining pass of the optimiser, which replaces calls to small functions with their bodies. This is aimed at the wrappers which
+ * the modules provide around native functions, such as coreid() or sqrt(x), where the call and return cost far more than the
+ * native itself. A function is inlined if it does nothing but return an expression (or, where called as a statement, run native
+ * functions and then return) which reads only globals and its arguments and does not call any other function, so it can never
+ * be recursive. Reading an argument in the inlined body is then a read of the variable which the caller passed or, for an argument
+ * passed by value, of the expression giving that value. The body never assigns so this is only done if these expressions are pure
+ */
+
+#include <stdlib.h>
+#include "inlining.h"
+#include "basictokens.h"
+
+// Largest body, in expression nodes, which is inlined
+#define MAX_INLINED_SIZE 16
+
+static void inlineExpressionCalls(struct ir_expression**);
+static void inlineStatementCall(struct ir_block*, struct ir_statement*);
+static struct ir_expression* getInlinedReturnValue(struct ir_function*, unsigned short*);
+static int isCallInlinable(struct ir_function*, unsigned short, int, struct ir_expression**);
+static int getInlinableSize(struct ir_expression*, struct ir_function*, unsigned short*);
+static struct ir_expression** getArgumentValues(unsigned short, unsigned short*, struct ir_expression**);
+static struct ir_expression* copyInlinedExpression(struct ir_expression*, struct ir_function*, unsigned short*, struct ir_expression**);
+static void mapArguments(struct ir_expression**, struct ir_function*, unsigned short*, struct ir_expression**);
+static struct ir_statement* createNativeStatement(unsigned char, int, struct ir_expression**, struct ir_function*, unsigned short*,
+		struct ir_expression**);
+
+/**
+ * Inlines the calls throughout the program to functions which are small enough, these functions are then only written out if
+ * something else still calls them
+ */
+void inlineFunctions(struct ir_program * program) {
+	int i;
+	struct ir_function * function;
+	struct ir_block * block;
+	struct ir_statement * statement, * next;
+	for (function=program->functions;function != NULL;function=function->next) {
+		for (block=function->blocks;block != NULL;block=block->next) {
+			for (statement=block->statements;statement != NULL;statement=next) {
+				next=statement->next;
+				for (i=0;i<statement->numberExpressions;i++) inlineExpressionCalls(&statement->expressions[i]);
+				if (statement->token == FNCALL_TOKEN) inlineStatementCall(block, statement);
+			}
+		}
+	}
+}
+
+/**
+ * Replaces calls within an expression to functions which just return an expression with a copy of that expression, reading
+ * what the caller passed in place of the arguments
+ */
+static void inlineExpressionCalls(struct ir_expression ** position) {
+	int i;
+	struct ir_expression * expression=*position;
+	for (i=0;i<expression->numberChildren;i++) inlineExpressionCalls(&expression->children[i]);
+	if (expression->token != FNCALL_TOKEN ||
+			!isCallInlinable(expression->function, expression->numberArguments, expression->numberChildren, expression->children)) return;
+	struct ir_expression * returned=getInlinedReturnValue(expression->function, expression->argumentSlots);
+	if (returned == NULL) return;
+	struct ir_expression ** values=getArgumentValues(expression->numberArguments, expression->argumentSlots, expression->children);
+	*position=copyInlinedExpression(returned, expression->function, expression->argumentSlots, values);
+	free(values);
+	freeIRExpression(expression);
+}
+
+/**
+ * Replaces a call made as a statement with the native functions which the called function runs, including the one whose value
+ * it returns as that value is not used here. Anything else which is returned must be pure so can just be dropped
+ */
+static void inlineStatementCall(struct ir_block * block, struct ir_statement * call) {
+	int size=0;
+	struct ir_function * function=call->function;
+	struct ir_statement * statement, * inlined=NULL, * last=NULL, * created;
+	if (!isCallInlinable(function, call->numberArguments, call->numberExpressions, call->expressions)) return;
+	last=getLastStatement(function->blocks);
+	if (last == NULL || (last->token != RETURN_TOKEN && last->token != RETURN_EXP_TOKEN)) return;
+	last=NULL;
+	for (statement=function->blocks->statements;statement != NULL;statement=statement->next) {
+		if (statement->token == NATIVE_TOKEN) {
+			int i;
+			for (i=0;i<statement->numberExpressions;i++) {
+				int expressionSize=getInlinableSize(statement->expressions[i], function, call->argumentSlots);
+				if (expressionSize < 0) return;
+				size+=expressionSize;
+			}
+		} else if (statement->token == RETURN_EXP_TOKEN && statement->next == NULL) {
+			int expressionSize=getInlinableSize(statement->expressions[0], function, call->argumentSlots);
+			if (expressionSize < 0 || (statement->expressions[0]->token != NATIVE_TOKEN && !isExpressionPure(statement->expressions[0]))) {
+				return;
+			}
+			size+=expressionSize;
+		} else if (statement->token != RETURN_TOKEN || statement->next != NULL) {
+			return;
+		}
+	}
+	if (size > MAX_INLINED_SIZE) return;
+
+	struct ir_expression ** values=getArgumentValues(call->numberArguments, call->argumentSlots, call->expressions);
+	for (statement=function->blocks->statements;statement != NULL;statement=statement->next) {
+		created=NULL;
+		if (statement->token == NATIVE_TOKEN) {
+			created=createNativeStatement(statement->code, statement->numberExpressions, statement->expressions, function,
+					call->argumentSlots, values);
+		} else if (statement->token == RETURN_EXP_TOKEN && statement->expressions[0]->token == NATIVE_TOKEN) {
+			struct ir_expression * native=statement->expressions[0];
+			created=createNativeStatement(native->code, native->numberChildren, native->children, function, call->argumentSlots,
+					values);
+		}
+		if (created != NULL) {
+			if (last == NULL) {
+				inlined=created;
+			} else {
+				last->next=created;
+			}
+			last=created;
+		}
+	}
+	free(values);
+	if (last == NULL) {
+		removeIRStatement(block, call);
+		return;
+	}
+	last->next=call->next;
+	call->next=inlined;
+	removeIRStatement(block, call);
+}
+
+/**
+ * Gets the expression which a function returns if this is all that it does and the expression can be inlined, otherwise NULL
+ */
+static struct ir_expression* getInlinedReturnValue(struct ir_function * function, unsigned short * argumentSlots) {
+	struct ir_statement * statement=function->blocks->statements;
+	if (statement == NULL || statement->next != NULL || statement->token != RETURN_EXP_TOKEN) return NULL;
+	int size=getInlinableSize(statement->expressions[0], function, argumentSlots);
+	return size >= 0 && size <= MAX_INLINED_SIZE ? statement->expressions[0] : NULL;
+}
+
+/**
+ * A call can only be inlined if every argument is passed, as otherwise the function assigns its default values, and the values
+ * passed are pure as they are then evaluated wherever the argument is read rather than once
+ */
+static int isCallInlinable(struct ir_function * function, unsigned short numberArguments, int numberValues, struct ir_expression ** values) {
+	int i;
+	if (function->isMain || numberArguments != function->numberArguments) return 0;
+	for (i=0;i<numberValues;i++) {
+		if (!isExpressionPure(values[i])) return 0;
+	}
+	return 1;
+}
+
+/**
+ * Gets the number of nodes in an expression which could be inlined from a function, or -1 if it can not be. It must not call
+ * any function or assign any variable and must only read globals or the function's arguments, with those indexed as arrays
+ * being passed as variables by the call
+ */
+static int getInlinableSize(struct ir_expression * expression, struct ir_function * function, unsigned short * argumentSlots) {
+	int i, size=1;
+	unsigned char token=expression->token;
+	if (token == FNCALL_TOKEN || token == FNCALL_BY_VAR_TOKEN || token == STORE_SLOT_TOKEN) return -1;
+	if ((token == LOAD_SLOT_TOKEN || token == ARRAYACCESS_TOKEN || token == ARRAYACCESS_1D_TOKEN) && (expression->slot & LOCAL_SLOT_FLAG)) {
+		for (i=0;i<function->numberArguments && function->argumentSlots[i] != expression->slot;i++);
+		if (i == function->numberArguments) return -1;
+		if (token != LOAD_SLOT_TOKEN && argumentSlots[i] == VALUE_ARGUMENT_SLOT) return -1;
+	}
+	for (i=0;i<expression->numberChildren;i++) {
+		int childSize=getInlinableSize(expression->children[i], function, argumentSlots);
+		if (childSize < 0) return -1;
+		size+=childSize;
+	}
+	return size;
+}
+
+/**
+ * Gets the expression passed for each argument of a call, NULL for those passed as a variable
+ */
+static struct ir_expression** getArgumentValues(unsigned short numberArguments, unsigned short * argumentSlots,
+		struct ir_expression ** valueExpressions) {
+	int i, j=0;
+	struct ir_expression ** values=(struct ir_expression**) calloc(numberArguments > 0 ? numberArguments : 1, sizeof(struct ir_expression*));
+	for (i=0;i<numberArguments;i++) {
+		if (argumentSlots[i] == VALUE_ARGUMENT_SLOT) values[i]=valueExpressions[j++];
+	}
+	return values;
+}
+
+/**
+ * Copies an expression from a function being inlined, where it reads one of the function's arguments it instead reads the
+ * variable which the caller passed or a copy of the value's expression
+ */
+static struct ir_expression* copyInlinedExpression(struct ir_expression * expression, struct ir_function * function,
+		unsigned short * argumentSlots, struct ir_expression ** values) {
+	struct ir_expression * copy=copyIRExpression(expression);
+	mapArguments(&copy, function, argumentSlots, values);
+	return copy;
+}
+
+static void mapArguments(struct ir_expression ** position, struct ir_function * function, unsigned short * argumentSlots,
+		struct ir_expression ** values) {
+	int i;
+	struct ir_expression * expression=*position;
+	if (expression->slot & LOCAL_SLOT_FLAG) {
+		for (i=0;i<function->numberArguments;i++) {
+			if (function->argumentSlots[i] == expression->slot) {
+				if (values[i] != NULL) {
+					*position=copyIRExpression(values[i]);
+					freeIRExpression(expression);
+					return;
+				}
+				expression->slot=argumentSlots[i];
+				break;
+			}
+		}
+	}
+	for (i=0;i<expression->numberChildren;i++) mapArguments(&expression->children[i], function, argumentSlots, values);
+}
+
+/**
+ * Creates a statement running a native function with some arguments from a function being inlined
+ */
+static struct ir_statement* createNativeStatement(unsigned char code, int numberArguments, struct ir_expression ** arguments,
+		struct ir_function * function, unsigned short * argumentSlots, struct ir_expression ** values) {
+	int i;
+	struct ir_statement * statement=(struct ir_statement*) calloc(1, sizeof(struct ir_statement));
+	statement->token=NATIVE_TOKEN;
+	statement->code=code;
+	statement->numberExpressions=numberArguments;
+	if (numberArguments > 0) {
+		statement->expressions=(struct ir_expression**) malloc(sizeof(struct ir_expression*) * numberArguments);
+		for (i=0;i<numberArguments;i++) statement->expressions[i]=copyInlinedExpression(arguments[i], function, argumentSlots, values);
+	}
+	return statement;
+}
@@ -0,0 +1,1189 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Builds the intermediate representation from assembled byte code and writes it back out. The byte code is walked by following
+ * control flow from the main code and into each function called (as the predecoder does), the statement at each location reached
+ * is decoded and statements are then grouped into basic blocks, which start at the target of any jump or after any statement that
+ * transfers control. Writing out lays each function's blocks out in order, jumps which can not be encoded as they are (for
+ * instance a conditional whose false target is now behind it) go via gotos
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "ir.h"
+#include "basictokens.h"
+
+#define GOTO_SIZE (sizeof(unsigned char)+sizeof(unsigned short))
+
+// Byte code being built from, the statement decoded at each location and the functions and blocks which start at each location
+struct ir_build_state {
+	char * code;
+	unsigned int length;
+	struct ir_program * program;
+	struct ir_statement ** statementAt;
+	unsigned int * nextAt, ** targetsAt;
+	unsigned char * isLeader;
+	struct ir_function ** functionAt;
+	struct ir_block ** blockAt;
+};
+
+// Byte code being written out, if a jump needed to go via gotos then it is written again as this moves locations
+struct ir_writer {
+	char * data;
+	unsigned int length, capacity;
+	int checkJumps, jumpsChanged, locationsChanged;
+	struct ir_program * program;
+};
+
+static struct ir_function* getFunctionAt(struct ir_build_state*, unsigned int, int);
+static void buildFunction(struct ir_build_state*, struct ir_function*);
+static unsigned int buildStatement(struct ir_build_state*, unsigned int, struct ir_statement**);
+static unsigned int buildExpression(struct ir_build_state*, unsigned int, struct ir_expression**);
+static unsigned int buildExpressions(struct ir_build_state*, unsigned int, int, struct ir_expression**);
+static unsigned int buildArgumentSlots(struct ir_build_state*, unsigned int, unsigned short*, unsigned short**);
+static unsigned int* createTargets(int);
+static unsigned short getCodeUShort(struct ir_build_state*, unsigned int);
+static int compareLocations(const void*, const void*);
+static void writeFunction(struct ir_writer*, struct ir_function*);
+static void writeBlock(struct ir_writer*, struct ir_block*, struct ir_block*);
+static int writeStatement(struct ir_writer*, struct ir_statement*, struct ir_block*);
+static void writeExpression(struct ir_writer*, struct ir_expression*);
+static void writePostfixBody(struct ir_writer*, struct ir_expression*);
+static unsigned char getPostfixDepth(struct ir_expression*);
+static int isSimpleIndexExpression(struct ir_expression*);
+static int getIndexOffset(struct ir_expression*, unsigned short*, int*);
+static void checkJump(struct ir_writer*, struct ir_statement*, int);
+static void writeJump(struct ir_writer*, struct ir_block*, unsigned int);
+static void writeGoto(struct ir_writer*, struct ir_block*);
+static void markReachableFunctions(struct ir_program*);
+static void markCalledFunctions(struct ir_expression*, struct ir_function**, int*);
+static void markReachableBlocks(struct ir_block*);
+static struct ir_block* getNextWrittenBlock(struct ir_block*);
+static unsigned int reserveBytes(struct ir_writer*, unsigned int);
+static void writeByte(struct ir_writer*, unsigned char);
+static void writeUShort(struct ir_writer*, unsigned short);
+static void writeInt(struct ir_writer*, int);
+static void setUShort(struct ir_writer*, unsigned int, unsigned short);
+static int isArithmeticToken(unsigned char);
+static void freeFunction(struct ir_function*);
+static void malformedByteCode(char*, unsigned int);
+
+/**
+ * Builds the IR of some byte code, the main code and every function which it may call
+ */
+struct ir_program* buildProgramIR(char * code, unsigned int length) {
+	struct ir_build_state state;
+	state.code=code;
+	state.length=length;
+	state.statementAt=(struct ir_statement**) calloc(length+1, sizeof(struct ir_statement*));
+	state.nextAt=(unsigned int*) calloc(length+1, sizeof(unsigned int));
+	state.targetsAt=(unsigned int**) calloc(length+1, sizeof(unsigned int*));
+	state.isLeader=(unsigned char*) calloc(length+1, sizeof(unsigned char));
+	state.functionAt=(struct ir_function**) calloc(length+1, sizeof(struct ir_function*));
+	state.blockAt=(struct ir_block**) calloc(length+1, sizeof(struct ir_block*));
+	state.program=(struct ir_program*) calloc(1, sizeof(struct ir_program));
+
+	// The program header, which is the number of global slots, is followed by the main code
+	state.program->numberGlobals=getCodeUShort(&state, 0);
+	struct ir_function * function=getFunctionAt(&state, sizeof(unsigned short), 1);
+	// Functions are added onto the end of the list as they are found to be called, so this also builds those
+	while (function != NULL) {
+		buildFunction(&state, function);
+		function=function->next;
+	}
+	free(state.statementAt);
+	free(state.nextAt);
+	free(state.targetsAt);
+	free(state.isLeader);
+	free(state.functionAt);
+	free(state.blockAt);
+	return state.program;
+}
+
+/**
+ * Writes a program's IR out as byte code, returning this and setting its length
+ */
+char* writeProgramIR(struct ir_program * program, unsigned int * length) {
+	struct ir_writer writer;
+	struct ir_function * function;
+	writer.capacity=1024;
+	writer.data=(char*) malloc(writer.capacity);
+	writer.program=program;
+	markReachableFunctions(program);
+
+	// The first pass lays the code out, then it is written until the locations are stable and every jump can be encoded
+	int laidOut;
+	writer.checkJumps=0;
+	do {
+		writer.length=0;
+		writer.jumpsChanged=0;
+		writer.locationsChanged=0;
+		writeUShort(&writer, program->numberGlobals);
+		for (function=program->functions;function != NULL;function=function->next) {
+			if (function->visited) writeFunction(&writer, function);
+		}
+		laidOut=writer.checkJumps;
+		writer.checkJumps=1;
+	} while (!laidOut || writer.jumpsChanged || writer.locationsChanged);
+	if (writer.length > 0xFFFF) {
+		fprintf(stderr, "Byte code of %d bytes is too large, locations in it are limited to 65535\n", writer.length);
+		exit(EXIT_FAILURE);
+	}
+	*length=writer.length;
+	return writer.data;
+}
+
+void freeProgramIR(struct ir_program * program) {
+	struct ir_function * function=program->functions, * nextFunction;
+	while (function != NULL) {
+		nextFunction=function->next;
+		freeFunction(function);
+		function=nextFunction;
+	}
+	free(program);
+}
+
+/**
+ * Removes a statement from a block and frees it
+ */
+void removeIRStatement(struct ir_block * block, struct ir_statement * statement) {
+	if (block->statements == statement) {
+		block->statements=statement->next;
+	} else {
+		struct ir_statement * previous=block->statements;
+		while (previous->next != statement) previous=previous->next;
+		previous->next=statement->next;
+	}
+	freeIRStatement(statement);
+}
+
+struct ir_statement* getLastStatement(struct ir_block * block) {
+	struct ir_statement * statement=block->statements;
+	if (statement == NULL) return NULL;
+	while (statement->next != NULL) statement=statement->next;
+	return statement;
+}
+
+/**
+ * Whether a statement of some token ends a basic block, because it may transfer control somewhere other than the next statement
+ */
+int isBlockTerminator(unsigned char token) {
+	return token == GOTO_TOKEN || token == IF_TOKEN || token == IFELSE_TOKEN || token == CMP_JUMP_TOKEN || token == FOR_TOKEN ||
+			token == FOR_RANGE_TOKEN || token == SWITCH_TOKEN || token == RETURN_TOKEN || token == RETURN_EXP_TOKEN ||
+			token == STOP_TOKEN;
+}
+
+/**
+ * Whether control may run on from a statement into the next, for a conditional or loop this is when the test passes
+ */
+int canStatementFallThrough(struct ir_statement * statement) {
+	unsigned char token=statement->token;
+	return token != GOTO_TOKEN && token != SWITCH_TOKEN && token != RETURN_TOKEN && token != RETURN_EXP_TOKEN && token != STOP_TOKEN;
+}
+
+int isLiteralExpression(struct ir_expression * expression) {
+	return expression->token == INTEGER_TOKEN || expression->token == REAL_TOKEN || expression->token == BOOLEAN_TOKEN;
+}
+
+int isArithmeticExpression(struct ir_expression * expression) {
+	return isArithmeticToken(expression->token);
+}
+
+int isComparisonExpression(struct ir_expression * expression) {
+	unsigned char token=getGenericOperator(expression->token);
+	return (token >= EQ_TOKEN && token <= GEQ_TOKEN) || token == IS_TOKEN;
+}
+
+/**
+ * Gets the generic operator which a quickened arithmetic or comparison token specialises, any other token is returned as is
+ */
+unsigned char getGenericOperator(unsigned char token) {
+	if (token >= INT_ADD_TOKEN && token <= INT_DIV_TOKEN) return ADD_TOKEN+(token-INT_ADD_TOKEN);
+	if (token >= REAL_ADD_TOKEN && token <= REAL_DIV_TOKEN) return ADD_TOKEN+(token-REAL_ADD_TOKEN);
+	if (token >= INT_EQ_TOKEN && token <= INT_GEQ_TOKEN) return EQ_TOKEN+(token-INT_EQ_TOKEN);
+	if (token >= REAL_EQ_TOKEN && token <= REAL_GEQ_TOKEN) return EQ_TOKEN+(token-REAL_EQ_TOKEN);
+	return token;
+}
+
+/**
+ * Whether an expression only reads variables and computes with them, so can be removed or reordered without changing behaviour
+ */
+int isExpressionPure(struct ir_expression * expression) {
+	int i;
+	if (expression->token == FNCALL_TOKEN || expression->token == FNCALL_BY_VAR_TOKEN || expression->token == NATIVE_TOKEN ||
+			expression->token == STORE_SLOT_TOKEN || expression->token == ARRAY_TOKEN) return 0;
+	for (i=0;i<expression->numberChildren;i++) {
+		if (!isExpressionPure(expression->children[i])) return 0;
+	}
+	return 1;
+}
+
+/**
+ * Gets the number of arguments of a call which are passed by value, these are the call's expressions
+ */
+int getNumberValueArguments(unsigned short numberArguments, unsigned short * argumentSlots) {
+	int i, number=0;
+	for (i=0;i<numberArguments;i++) {
+		if (argumentSlots[i] == VALUE_ARGUMENT_SLOT) number++;
+	}
+	return number;
+}
+
+struct ir_expression* createIRExpression(unsigned char token, int numberChildren) {
+	struct ir_expression * expression=(struct ir_expression*) calloc(1, sizeof(struct ir_expression));
+	expression->token=token;
+	expression->numberChildren=numberChildren;
+	if (numberChildren > 0) expression->children=(struct ir_expression**) calloc(numberChildren, sizeof(struct ir_expression*));
+	return expression;
+}
+
+struct ir_expression* copyIRExpression(struct ir_expression * expression) {
+	int i;
+	struct ir_expression * copy=createIRExpression(expression->token, expression->numberChildren);
+	copy->code=expression->code;
+	copy->slot=expression->slot;
+	copy->literal=expression->literal;
+	copy->function=expression->function;
+	if (expression->string != NULL) {
+		copy->string=(char*) malloc(strlen(expression->string)+1);
+		strcpy(copy->string, expression->string);
+	}
+	copy->numberArguments=expression->numberArguments;
+	if (expression->argumentSlots != NULL) {
+		copy->argumentSlots=(unsigned short*) malloc(sizeof(unsigned short) * expression->numberArguments);
+		memcpy(copy->argumentSlots, expression->argumentSlots, sizeof(unsigned short) * expression->numberArguments);
+	}
+	for (i=0;i<expression->numberChildren;i++) copy->children[i]=copyIRExpression(expression->children[i]);
+	return copy;
+}
+
+void freeIRExpression(struct ir_expression * expression) {
+	int i;
+	if (expression == NULL) return;
+	for (i=0;i<expression->numberChildren;i++) freeIRExpression(expression->children[i]);
+	free(expression->children);
+	free(expression->string);
+	free(expression->argumentSlots);
+	free(expression);
+}
+
+/**
+ * Whether two expressions are the same, so compute the same value if nothing they read has changed in between
+ */
+int isSameIRExpression(struct ir_expression * first, struct ir_expression * second) {
+	int i;
+	if (first->token != second->token || first->code != second->code || first->slot != second->slot ||
+			first->literal.integer != second->literal.integer || first->function != second->function ||
+			first->numberChildren != second->numberChildren || first->numberArguments != second->numberArguments) return 0;
+	if ((first->string == NULL) != (second->string == NULL) || (first->string != NULL && strcmp(first->string, second->string) != 0)) {
+		return 0;
+	}
+	for (i=0;i<first->numberArguments;i++) {
+		if (first->argumentSlots[i] != second->argumentSlots[i]) return 0;
+	}
+	for (i=0;i<first->numberChildren;i++) {
+		if (!isSameIRExpression(first->children[i], second->children[i])) return 0;
+	}
+	return 1;
+}
+
+/**
+ * Whether an array index is read directly by one of the single index superinstructions, which the access is written as
+ */
+int isDirectIndexExpression(struct ir_expression * index) {
+	unsigned short slot;
+	int offset;
+	return isSimpleIndexExpression(index) || getIndexOffset(index, &slot, &offset);
+}
+
+/**
+ * Creates a new global slot for the optimiser to hold a value in, returning -1 if there are no more slots
+ */
+int createTemporarySlot(struct ir_program * program) {
+	if (program->numberGlobals >= LOCAL_SLOT_FLAG-1) return -1;
+	return program->numberGlobals++;
+}
+
+void freeIRStatement(struct ir_statement * statement) {
+	int i;
+	for (i=0;i<statement->numberExpressions;i++) freeIRExpression(statement->expressions[i]);
+	free(statement->expressions);
+	free(statement->targets);
+	free(statement->keys);
+	free(statement->argumentSlots);
+	free(statement);
+}
+
+/**
+ * Gets the function whose header (or for the main code, its first statement) is at some location, creating it if it has not
+ * yet been found
+ */
+static struct ir_function* getFunctionAt(struct ir_build_state * state, unsigned int location, int isMain) {
+	if (location >= state->length) malformedByteCode("a function is called", location);
+	if (state->functionAt[location] != NULL) return state->functionAt[location];
+	struct ir_function * function=(struct ir_function*) calloc(1, sizeof(struct ir_function));
+	function->isMain=isMain;
+	function->location=location;
+	state->functionAt[location]=function;
+	if (state->program->functions == NULL) {
+		state->program->functions=function;
+	} else {
+		struct ir_function * last=state->program->functions;
+		while (last->next != NULL) last=last->next;
+		last->next=function;
+	}
+	return function;
+}
+
+/**
+ * Builds a function, its statements are found by walking from its entry and following each jump. These are then ordered by
+ * location and grouped into blocks, with the targets of jumps resolved to the blocks at those locations
+ */
+static void buildFunction(struct ir_build_state * state, struct ir_function * function) {
+	unsigned int point=function->location, i, j;
+	if (!function->isMain) {
+		// The function header is the size of its frame, then the number of arguments and the slot of each. Only those the function
+		// assigns are flagged as local, so the flag is held separately here and every argument's slot is local as it is in the code
+		function->numberLocals=getCodeUShort(state, point);
+		point+=sizeof(unsigned short);
+		point=buildArgumentSlots(state, point, &function->numberArguments, &function->argumentSlots);
+		if (function->numberArguments > 0) function->isReferenceArgument=(char*) malloc(function->numberArguments);
+		for (i=0;i<function->numberArguments;i++) {
+			function->isReferenceArgument[i]=(function->argumentSlots[i] & REFERENCE_PARAMETER_FLAG) != 0;
+			function->argumentSlots[i]|=LOCAL_SLOT_FLAG;
+		}
+	}
+	unsigned int entry=point, numberLocations=0, workListSize=0, capacity=16;
+	unsigned int * locations=(unsigned int*) malloc(sizeof(unsigned int) * capacity);
+	unsigned int * workList=(unsigned int*) malloc(sizeof(unsigned int) * capacity);
+	workList[workListSize++]=entry;
+	state->isLeader[entry]=1;
+	while (workListSize > 0) {
+		point=workList[--workListSize];
+		while (state->statementAt[point] == NULL) {
+			struct ir_statement * statement;
+			unsigned int next=buildStatement(state, point, &statement);
+			if (numberLocations + workListSize + statement->numberTargets + 1 >= capacity) {
+				capacity=(capacity + statement->numberTargets + 1) * 2;
+				locations=(unsigned int*) realloc(locations, sizeof(unsigned int) * capacity);
+				workList=(unsigned int*) realloc(workList, sizeof(unsigned int) * capacity);
+			}
+			state->statementAt[point]=statement;
+			state->nextAt[point]=next;
+			locations[numberLocations++]=point;
+			for (i=0;i<(unsigned int) statement->numberTargets;i++) {
+				unsigned int target=state->targetsAt[point][i];
+				if (target >= state->length) malformedByteCode("a jump leads", target);
+				state->isLeader[target]=1;
+				workList[workListSize++]=target;
+			}
+			if (!canStatementFallThrough(statement)) break;
+			if (next >= state->length) malformedByteCode("control runs on", next);
+			// Control runs on from a conditional or loop, or into a statement already walked, which must then start a block
+			if (isBlockTerminator(statement->token) || state->statementAt[next] != NULL) state->isLeader[next]=1;
+			point=next;
+		}
+	}
+	qsort(locations, numberLocations, sizeof(unsigned int), compareLocations);
+
+	struct ir_block * block=NULL, * lastBlock=NULL;
+	struct ir_statement * lastStatement=NULL;
+	for (i=0;i<numberLocations;i++) {
+		point=locations[i];
+		if (block == NULL || state->isLeader[point] || state->nextAt[locations[i-1]] != point) {
+			block=(struct ir_block*) calloc(1, sizeof(struct ir_block));
+			block->location=point;
+			state->blockAt[point]=block;
+			if (lastBlock == NULL) {
+				function->blocks=block;
+			} else {
+				lastBlock->next=block;
+			}
+			lastBlock=block;
+			lastStatement=NULL;
+		}
+		if (lastStatement == NULL) {
+			block->statements=state->statementAt[point];
+		} else {
+			lastStatement->next=state->statementAt[point];
+		}
+		lastStatement=state->statementAt[point];
+	}
+	for (i=0;i<numberLocations;i++) {
+		point=locations[i];
+		struct ir_statement * statement=state->statementAt[point];
+		for (j=0;j<(unsigned int) statement->numberTargets;j++) {
+			statement->targets[j]=state->blockAt[state->targetsAt[point][j]];
+		}
+		free(state->targetsAt[point]);
+	}
+	// Link each block to the one control runs on into from its last statement
+	for (i=0;i<numberLocations;i++) {
+		point=locations[i];
+		if (state->blockAt[point] != NULL) block=state->blockAt[point];
+		struct ir_statement * statement=state->statementAt[point];
+		if (statement->next == NULL && canStatementFallThrough(statement)) block->fallthrough=state->blockAt[state->nextAt[point]];
+	}
+	free(locations);
+	free(workList);
+}
+
+/**
+ * Builds the statement at some location, returning the location after it. Any jumps are recorded by the location they lead to,
+ * which is resolved to a block once all the function's blocks are known
+ */
+static unsigned int buildStatement(struct ir_build_state * state, unsigned int point, struct ir_statement ** builtStatement) {
+	unsigned int statementPoint=point;
+	unsigned short i;
+	if (point >= state->length) malformedByteCode("a statement is read", point);
+	struct ir_statement * statement=(struct ir_statement*) calloc(1, sizeof(struct ir_statement));
+	*builtStatement=statement;
+	statement->token=(unsigned char) state->code[point];
+	point+=sizeof(unsigned char);
+	switch (statement->token) {
+	case STORE_SLOT_TOKEN:
+	case LETNOALIAS_TOKEN:
+	case OP_ASSIGN_TOKEN:
+		statement->slot=getCodeUShort(state, point);
+		point+=sizeof(unsigned short);
+		if (statement->token == OP_ASSIGN_TOKEN) {
+			statement->code=(unsigned char) state->code[point];
+			point+=sizeof(unsigned char);
+		}
+		statement->numberExpressions=1;
+		break;
+	case INC_SLOT_TOKEN:
+		statement->slot=getCodeUShort(state, point);
+		point+=sizeof(unsigned short);
+		statement->code=(unsigned char) state->code[point];
+		point+=sizeof(unsigned char);
+		memcpy(&statement->integer, &state->code[point], sizeof(int));
+		point+=sizeof(int);
+		break;
+	case ARRAYSET_TOKEN:
+	case ARRAYSET_1D_TOKEN:
+		statement->slot=getCodeUShort(state, point);
+		point+=sizeof(unsigned short);
+		statement->code=(unsigned char) state->code[point];
+		point+=sizeof(unsigned char);
+		// The indexes and then the value being set
+		statement->numberExpressions=statement->code+1;
+		break;
+	case IF_TOKEN:
+	case IFELSE_TOKEN:
+	case CMP_JUMP_TOKEN:
+	case FOR_TOKEN:
+		if (statement->token == FOR_TOKEN) {
+			// The loop variable and the hidden slot holding the range, then the range as per a conditional's condition
+			statement->slot=getCodeUShort(state, point);
+			statement->secondSlot=getCodeUShort(state, point+sizeof(unsigned short));
+			point+=sizeof(unsigned short)*2;
+		}
+		statement->numberExpressions=1;
+		statement->expressions=(struct ir_expression**) malloc(sizeof(struct ir_expression*));
+		point=buildExpression(state, point, &statement->expressions[0]);
+		statement->numberTargets=1;
+		state->targetsAt[statementPoint]=createTargets(1);
+		// A loop's block length also skips over the goto at the end of its block
+		state->targetsAt[statementPoint][0]=point+sizeof(unsigned short)+getCodeUShort(state, point)+
+				(statement->token == FOR_TOKEN ? GOTO_SIZE : 0);
+		point+=sizeof(unsigned short);
+		break;
+	case FOR_RANGE_TOKEN:
+		// The loop variable, the hidden counter, stop and step then the block length which also skips the goto at its end
+		statement->slot=getCodeUShort(state, point);
+		statement->secondSlot=getCodeUShort(state, point+sizeof(unsigned short));
+		statement->stopSlot=getCodeUShort(state, point+sizeof(unsigned short)*2);
+		statement->stepSlot=getCodeUShort(state, point+sizeof(unsigned short)*3);
+		point+=sizeof(unsigned short)*4;
+		statement->numberTargets=1;
+		state->targetsAt[statementPoint]=createTargets(1);
+		state->targetsAt[statementPoint][0]=point+sizeof(unsigned short)+getCodeUShort(state, point)+GOTO_SIZE;
+		point+=sizeof(unsigned short);
+		break;
+	case SWITCH_TOKEN: {
+		statement->slot=getCodeUShort(state, point);
+		unsigned short numberArms=getCodeUShort(state, point+sizeof(unsigned short));
+		point+=sizeof(unsigned short)*2;
+		statement->keys=(int*) malloc(sizeof(int) * numberArms);
+		memcpy(statement->keys, &state->code[point], sizeof(int) * numberArms);
+		point+=sizeof(int) * numberArms;
+		statement->numberTargets=numberArms+1;
+		state->targetsAt[statementPoint]=createTargets(numberArms+1);
+		for (i=0;i<=numberArms;i++) {
+			state->targetsAt[statementPoint][i]=point+sizeof(unsigned short)+getCodeUShort(state, point);
+			point+=sizeof(unsigned short);
+		}
+		break;
+	}
+	case GOTO_TOKEN:
+		statement->numberTargets=1;
+		state->targetsAt[statementPoint]=createTargets(1);
+		state->targetsAt[statementPoint][0]=getCodeUShort(state, point);
+		point+=sizeof(unsigned short);
+		break;
+	case FNCALL_TOKEN:
+		statement->function=getFunctionAt(state, getCodeUShort(state, point), 0);
+		point=buildArgumentSlots(state, point+sizeof(unsigned short), &statement->numberArguments, &statement->argumentSlots);
+		statement->numberExpressions=getNumberValueArguments(statement->numberArguments, statement->argumentSlots);
+		break;
+	case FNCALL_BY_VAR_TOKEN:
+		statement->slot=getCodeUShort(state, point);
+		point=buildArgumentSlots(state, point+sizeof(unsigned short), &statement->numberArguments, &statement->argumentSlots);
+		statement->numberExpressions=getNumberValueArguments(statement->numberArguments, statement->argumentSlots);
+		break;
+	case NATIVE_TOKEN:
+		statement->code=(unsigned char) state->code[point];
+		statement->numberExpressions=getCodeUShort(state, point+sizeof(unsigned char));
+		point+=sizeof(unsigned char)+sizeof(unsigned short);
+		break;
+	case RETURN_EXP_TOKEN:
+		statement->numberExpressions=1;
+		break;
+	}
+	// Any other token (return, stop and those which do nothing) is just the token
+	if (statement->numberExpressions > 0 && statement->expressions == NULL) {
+		statement->expressions=(struct ir_expression**) malloc(sizeof(struct ir_expression*) * statement->numberExpressions);
+		point=buildExpressions(state, point, statement->numberExpressions, statement->expressions);
+	}
+	if (statement->numberTargets > 0) statement->targets=(struct ir_block**) calloc(statement->numberTargets, sizeof(struct ir_block*));
+	return point;
+}
+
+/**
+ * Builds the expression at some location, returning the location after it. Postfix arithmetic is evaluated on a stack of
+ * expressions into the equivalent tree
+ */
+static unsigned int buildExpression(struct ir_build_state * state, unsigned int point, struct ir_expression ** builtExpression) {
+	if (point >= state->length) malformedByteCode("an expression is read", point);
+	unsigned char token=(unsigned char) state->code[point];
+	struct ir_expression * expression;
+	point+=sizeof(unsigned char);
+	switch (token) {
+	case INTEGER_TOKEN:
+	case REAL_TOKEN:
+	case BOOLEAN_TOKEN:
+		expression=createIRExpression(token, 0);
+		memcpy(&expression->literal, &state->code[point], sizeof(int));
+		point+=sizeof(int);
+		break;
+	case STRING_TOKEN:
+		expression=createIRExpression(token, 0);
+		expression->string=(char*) malloc(strlen(&state->code[point])+1);
+		strcpy(expression->string, &state->code[point]);
+		point+=strlen(expression->string)+1;
+		break;
+	case NONE_TOKEN:
+		expression=createIRExpression(token, 0);
+		break;
+	case FN_ADDR_TOKEN:
+		expression=createIRExpression(token, 0);
+		expression->function=getFunctionAt(state, getCodeUShort(state, point), 0);
+		point+=sizeof(unsigned short);
+		break;
+	case LOAD_SLOT_TOKEN:
+		expression=createIRExpression(token, 0);
+		expression->slot=getCodeUShort(state, point);
+		point+=sizeof(unsigned short);
+		break;
+	case STORE_SLOT_TOKEN:
+		// An assignment within an expression, the value stored then the value of the expression
+		expression=createIRExpression(token, 2);
+		expression->slot=getCodeUShort(state, point);
+		point=buildExpressions(state, point+sizeof(unsigned short), 2, expression->children);
+		break;
+	case ARRAY_TOKEN: {
+		int numberItems;
+		memcpy(&numberItems, &state->code[point], sizeof(int));
+		unsigned char hasRepetition=(unsigned char) state->code[point+sizeof(int)];
+		point+=sizeof(int)+sizeof(unsigned char);
+		expression=createIRExpression(token, numberItems+(hasRepetition ? 1 : 0));
+		expression->code=hasRepetition;
+		point=buildExpressions(state, point, expression->numberChildren, expression->children);
+		break;
+	}
+	case FNCALL_TOKEN:
+	case FNCALL_BY_VAR_TOKEN:
+		expression=createIRExpression(token, 0);
+		if (token == FNCALL_TOKEN) {
+			expression->function=getFunctionAt(state, getCodeUShort(state, point), 0);
+		} else {
+			expression->slot=getCodeUShort(state, point);
+		}
+		point=buildArgumentSlots(state, point+sizeof(unsigned short), &expression->numberArguments, &expression->argumentSlots);
+		expression->numberChildren=getNumberValueArguments(expression->numberArguments, expression->argumentSlots);
+		if (expression->numberChildren > 0) {
+			expression->children=(struct ir_expression**) calloc(expression->numberChildren, sizeof(struct ir_expression*));
+			point=buildExpressions(state, point, expression->numberChildren, expression->children);
+		}
+		break;
+	case NATIVE_TOKEN:
+		expression=createIRExpression(token, getCodeUShort(state, point+sizeof(unsigned char)));
+		expression->code=(unsigned char) state->code[point];
+		point=buildExpressions(state, point+sizeof(unsigned char)+sizeof(unsigned short), expression->numberChildren, expression->children);
+		break;
+	case ARRAYACCESS_TOKEN:
+	case ARRAYACCESS_1D_TOKEN:
+		expression=createIRExpression(token, (unsigned char) state->code[point+sizeof(unsigned short)]);
+		expression->slot=getCodeUShort(state, point);
+		expression->code=(unsigned char) expression->numberChildren;
+		point=buildExpressions(state, point+sizeof(unsigned short)+sizeof(unsigned char), expression->numberChildren, expression->children);
+		break;
+	case ARRAYACCESS_OFFSET_TOKEN: {
+		// Held as an access whose index adds the constant to the variable, the writer chooses the superinstruction again
+		struct ir_expression * index=createIRExpression(INT_ADD_TOKEN, 2);
+		index->children[0]=createIRExpression(LOAD_SLOT_TOKEN, 0);
+		index->children[0]->slot=getCodeUShort(state, point+sizeof(unsigned short));
+		index->children[1]=createIRExpression(INTEGER_TOKEN, 0);
+		memcpy(&index->children[1]->literal.integer, &state->code[point+sizeof(unsigned short)*2], sizeof(int));
+		expression=createIRExpression(ARRAYACCESS_TOKEN, 1);
+		expression->slot=getCodeUShort(state, point);
+		expression->code=1;
+		expression->children[0]=index;
+		point+=sizeof(unsigned short)*2+sizeof(int);
+		break;
+	}
+	case NOT_TOKEN:
+		expression=createIRExpression(token, 1);
+		point=buildExpression(state, point, &expression->children[0]);
+		break;
+	case AND_TOKEN:
+	case OR_TOKEN:
+		// The length of the second operand, which is skipped when short circuiting, is recalculated when written out
+		expression=createIRExpression(token, 2);
+		point=buildExpression(state, point, &expression->children[0]);
+		point=buildExpression(state, point+sizeof(unsigned short), &expression->children[1]);
+		break;
+	case POSTFIX_TOKEN: {
+		unsigned int end=point+sizeof(unsigned char)+sizeof(unsigned short)+getCodeUShort(state, point+sizeof(unsigned char));
+		int stackSize=0, stackCapacity=POSTFIX_STACK_DEPTH;
+		struct ir_expression ** stack=(struct ir_expression**) malloc(sizeof(struct ir_expression*) * stackCapacity);
+		point+=sizeof(unsigned char)+sizeof(unsigned short);
+		while (point < end) {
+			unsigned char postfixToken=(unsigned char) state->code[point];
+			if (isArithmeticToken(postfixToken)) {
+				if (stackSize < 2) malformedByteCode("a postfix operator is read", point);
+				struct ir_expression * operation=createIRExpression(postfixToken, 2);
+				operation->children[1]=stack[--stackSize];
+				operation->children[0]=stack[--stackSize];
+				stack[stackSize++]=operation;
+				point+=sizeof(unsigned char);
+			} else {
+				if (stackSize == stackCapacity) {
+					stackCapacity*=2;
+					stack=(struct ir_expression**) realloc(stack, sizeof(struct ir_expression*) * stackCapacity);
+				}
+				point=buildExpression(state, point, &stack[stackSize++]);
+			}
+		}
+		if (stackSize != 1) malformedByteCode("a postfix expression ends", point);
+		expression=stack[0];
+		free(stack);
+		break;
+	}
+	default:
+		if (!isArithmeticToken(token) && !(token >= EQ_TOKEN && token <= GEQ_TOKEN) && token != IS_TOKEN &&
+				!(token >= INT_EQ_TOKEN && token <= REAL_GEQ_TOKEN)) {
+			malformedByteCode("an unknown expression is read", point-sizeof(unsigned char));
+		}
+		expression=createIRExpression(token, 2);
+		point=buildExpressions(state, point, 2, expression->children);
+		break;
+	}
+	*builtExpression=expression;
+	return point;
+}
+
+static unsigned int buildExpressions(struct ir_build_state * state, unsigned int point, int number, struct ir_expression ** expressions) {
+	int i;
+	for (i=0;i<number;i++) point=buildExpression(state, point, &expressions[i]);
+	return point;
+}
+
+/**
+ * Builds the number of arguments and slot of each argument which follow a function's header or a call
+ */
+static unsigned int buildArgumentSlots(struct ir_build_state * state, unsigned int point, unsigned short * numberArguments,
+		unsigned short ** argumentSlots) {
+	int i;
+	*numberArguments=getCodeUShort(state, point);
+	point+=sizeof(unsigned short);
+	*argumentSlots=NULL;
+	if (*numberArguments > 0) {
+		*argumentSlots=(unsigned short*) malloc(sizeof(unsigned short) * *numberArguments);
+		for (i=0;i<*numberArguments;i++) {
+			(*argumentSlots)[i]=getCodeUShort(state, point);
+			point+=sizeof(unsigned short);
+		}
+	}
+	return point;
+}
+
+static unsigned int* createTargets(int number) {
+	return (unsigned int*) malloc(sizeof(unsigned int) * number);
+}
+
+static unsigned short getCodeUShort(struct ir_build_state * state, unsigned int point) {
+	unsigned short value;
+	if (point+sizeof(unsigned short) > state->length) malformedByteCode("an operand is read", point);
+	memcpy(&value, &state->code[point], sizeof(unsigned short));
+	return value;
+}
+
+static int compareLocations(const void * a, const void * b) {
+	unsigned int first=*((unsigned int*) a), second=*((unsigned int*) b);
+	return first < second ? -1 : first > second;
+}
+
+/**
+ * Writes out a function, its header (unless it is the main code) and then each block which can be reached in order
+ */
+static void writeFunction(struct ir_writer * writer, struct ir_function * function) {
+	int i;
+	struct ir_block * block;
+	if (function->location != writer->length) writer->locationsChanged=1;
+	function->location=writer->length;
+	if (!function->isMain) {
+		writeUShort(writer, function->numberLocals);
+		writeUShort(writer, function->numberArguments);
+		for (i=0;i<function->numberArguments;i++) {
+			writeUShort(writer, function->isReferenceArgument[i] ? function->argumentSlots[i] :
+					function->argumentSlots[i] & ~REFERENCE_PARAMETER_FLAG);
+		}
+	}
+	for (block=function->blocks;block != NULL;block=block->next) {
+		if (block->visited) writeBlock(writer, block, getNextWrittenBlock(block));
+	}
+}
+
+/**
+ * Writes out a block, if control runs off its end into a block which is not written next then this is via a goto
+ */
+static void writeBlock(struct ir_writer * writer, struct ir_block * block, struct ir_block * nextBlock) {
+	struct ir_statement * statement;
+	int fallthroughWritten=0;
+	if (block->location != writer->length) writer->locationsChanged=1;
+	block->location=writer->length;
+	for (statement=block->statements;statement != NULL;statement=statement->next) {
+		fallthroughWritten=writeStatement(writer, statement, block);
+	}
+	if (block->fallthrough != NULL && !fallthroughWritten && block->fallthrough != nextBlock) writeGoto(writer, block->fallthrough);
+}
+
+/**
+ * Writes out a statement, returning whether this has already sent control to the block's fallthrough (when its jump went via gotos)
+ */
+static int writeStatement(struct ir_writer * writer, struct ir_statement * statement, struct ir_block * block) {
+	int i;
+	unsigned int start;
+	unsigned char token=statement->token;
+	if (token == CMP_JUMP_TOKEN || token == IF_TOKEN) {
+		// The fused compare and jump is used whenever the condition is of the shape it handles
+		struct ir_expression * condition=statement->expressions[0];
+		unsigned char operator=getGenericOperator(condition->token);
+		token=operator >= EQ_TOKEN && operator <= GEQ_TOKEN && condition->children[0]->token == LOAD_SLOT_TOKEN ?
+				CMP_JUMP_TOKEN : IF_TOKEN;
+	} else if (token == ARRAYSET_TOKEN || token == ARRAYSET_1D_TOKEN) {
+		token=statement->code == 1 && isSimpleIndexExpression(statement->expressions[0]) ? ARRAYSET_1D_TOKEN : ARRAYSET_TOKEN;
+	}
+	writeByte(writer, token);
+	switch (token) {
+	case STORE_SLOT_TOKEN:
+	case LETNOALIAS_TOKEN:
+	case OP_ASSIGN_TOKEN:
+	case INC_SLOT_TOKEN:
+	case ARRAYSET_TOKEN:
+	case ARRAYSET_1D_TOKEN:
+		writeUShort(writer, statement->slot);
+		if (token == OP_ASSIGN_TOKEN || token == INC_SLOT_TOKEN || token == ARRAYSET_TOKEN || token == ARRAYSET_1D_TOKEN) {
+			writeByte(writer, statement->code);
+		}
+		if (token == INC_SLOT_TOKEN) writeInt(writer, statement->integer);
+		break;
+	case FOR_TOKEN:
+	case FOR_RANGE_TOKEN:
+		writeUShort(writer, statement->slot);
+		writeUShort(writer, statement->secondSlot);
+		if (token == FOR_RANGE_TOKEN) {
+			writeUShort(writer, statement->stopSlot);
+			writeUShort(writer, statement->stepSlot);
+		}
+		break;
+	case SWITCH_TOKEN:
+		writeUShort(writer, statement->slot);
+		writeUShort(writer, statement->numberTargets-1);
+		for (i=0;i<statement->numberTargets-1;i++) writeInt(writer, statement->keys[i]);
+		// If any arm is not ahead of the table then each goes via a goto placed after the table
+		start=writer->length;
+		for (i=0;i<statement->numberTargets;i++) {
+			checkJump(writer, statement, statement->targets[i]->location < start+sizeof(unsigned short)*(i+1));
+		}
+		if (statement->jumpsViaGotos) {
+			for (i=0;i<statement->numberTargets;i++) {
+				writeUShort(writer, (statement->numberTargets-i-1)*sizeof(unsigned short) + i*GOTO_SIZE);
+			}
+			for (i=0;i<statement->numberTargets;i++) writeGoto(writer, statement->targets[i]);
+		} else {
+			for (i=0;i<statement->numberTargets;i++) writeJump(writer, statement->targets[i], 0);
+		}
+		return 0;
+	case GOTO_TOKEN:
+		writeUShort(writer, statement->targets[0]->location);
+		return 0;
+	case FNCALL_TOKEN:
+	case FNCALL_BY_VAR_TOKEN:
+		writeUShort(writer, token == FNCALL_TOKEN ? statement->function->location : statement->slot);
+		writeUShort(writer, statement->numberArguments);
+		for (i=0;i<statement->numberArguments;i++) writeUShort(writer, statement->argumentSlots[i]);
+		break;
+	case NATIVE_TOKEN:
+		writeByte(writer, statement->code);
+		writeUShort(writer, statement->numberExpressions);
+		break;
+	}
+	if (token == CMP_JUMP_TOKEN) {
+		// The comparison's token and first operand are read directly by the fused statement so are never postfix
+		struct ir_expression * condition=statement->expressions[0];
+		writeByte(writer, condition->token);
+		writeExpression(writer, condition->children[0]);
+		writeExpression(writer, condition->children[1]);
+	} else {
+		for (i=0;i<statement->numberExpressions;i++) writeExpression(writer, statement->expressions[i]);
+	}
+	if (statement->numberTargets == 1) {
+		// A conditional or loop, when its target is behind it the block length instead leads to gotos to the true and false paths
+		unsigned int loopGoto=token == FOR_TOKEN || token == FOR_RANGE_TOKEN ? GOTO_SIZE : 0;
+		checkJump(writer, statement, statement->targets[0]->location < writer->length+sizeof(unsigned short)+loopGoto);
+		if (statement->jumpsViaGotos) {
+			writeUShort(writer, GOTO_SIZE - loopGoto);
+			writeGoto(writer, block->fallthrough);
+			writeGoto(writer, statement->targets[0]);
+			return 1;
+		}
+		writeJump(writer, statement->targets[0], loopGoto);
+	}
+	return 0;
+}
+
+/**
+ * Writes out an expression, arithmetic is written as a postfix block if that is enabled
+ */
+static void writeExpression(struct ir_writer * writer, struct ir_expression * expression) {
+	int i, offset;
+	unsigned int start;
+	unsigned short indexSlot;
+	unsigned char token=expression->token;
+	if (writer->program->postfixExpressions && isArithmeticToken(token)) {
+		writeByte(writer, POSTFIX_TOKEN);
+		writeByte(writer, getPostfixDepth(expression));
+		start=reserveBytes(writer, sizeof(unsigned short));
+		writePostfixBody(writer, expression);
+		setUShort(writer, start, writer->length-(start+sizeof(unsigned short)));
+		return;
+	}
+	if (token == ARRAYACCESS_TOKEN || token == ARRAYACCESS_1D_TOKEN) {
+		// The single index superinstructions are used whenever the index is of a shape they handle
+		if (expression->numberChildren == 1 && getIndexOffset(expression->children[0], &indexSlot, &offset)) {
+			writeByte(writer, ARRAYACCESS_OFFSET_TOKEN);
+			writeUShort(writer, expression->slot);
+			writeUShort(writer, indexSlot);
+			writeInt(writer, offset);
+			return;
+		}
+		token=expression->numberChildren == 1 && isSimpleIndexExpression(expression->children[0]) ?
+				ARRAYACCESS_1D_TOKEN : ARRAYACCESS_TOKEN;
+	}
+	writeByte(writer, token);
+	switch (token) {
+	case INTEGER_TOKEN:
+	case REAL_TOKEN:
+	case BOOLEAN_TOKEN:
+		writeInt(writer, expression->literal.integer);
+		return;
+	case STRING_TOKEN:
+		start=reserveBytes(writer, strlen(expression->string)+1);
+		strcpy(&writer->data[start], expression->string);
+		return;
+	case NONE_TOKEN:
+		return;
+	case FN_ADDR_TOKEN:
+		writeUShort(writer, expression->function->location);
+		return;
+	case LOAD_SLOT_TOKEN:
+	case STORE_SLOT_TOKEN:
+		writeUShort(writer, expression->slot);
+		break;
+	case ARRAY_TOKEN:
+		writeInt(writer, expression->numberChildren-(expression->code ? 1 : 0));
+		writeByte(writer, expression->code);
+		break;
+	case FNCALL_TOKEN:
+	case FNCALL_BY_VAR_TOKEN:
+		writeUShort(writer, expression->token == FNCALL_TOKEN ? expression->function->location : expression->slot);
+		writeUShort(writer, expression->numberArguments);
+		for (i=0;i<expression->numberArguments;i++) writeUShort(writer, expression->argumentSlots[i]);
+		break;
+	case NATIVE_TOKEN:
+		writeByte(writer, expression->code);
+		writeUShort(writer, expression->numberChildren);
+		break;
+	case ARRAYACCESS_TOKEN:
+	case ARRAYACCESS_1D_TOKEN:
+		writeUShort(writer, expression->slot);
+		writeByte(writer, expression->numberChildren);
+		break;
+	case AND_TOKEN:
+	case OR_TOKEN:
+		// The first operand then the length of the second, which is skipped when short circuiting
+		writeExpression(writer, expression->children[0]);
+		start=reserveBytes(writer, sizeof(unsigned short));
+		writeExpression(writer, expression->children[1]);
+		setUShort(writer, start, writer->length-(start+sizeof(unsigned short)));
+		return;
+	}
+	for (i=0;i<expression->numberChildren;i++) writeExpression(writer, expression->children[i]);
+}
+
+/**
+ * Writes the body of a postfix block, arithmetic operands are merged into it as the assembler does (the first always and the
+ * second if it fits in the operand stack) and any other operands written as expressions
+ */
+static void writePostfixBody(struct ir_writer * writer, struct ir_expression * expression) {
+	struct ir_expression * first=expression->children[0], * second=expression->children[1];
+	if (isArithmeticToken(first->token)) {
+		writePostfixBody(writer, first);
+	} else {
+		writeExpression(writer, first);
+	}
+	if (isArithmeticToken(second->token) && getPostfixDepth(second) < POSTFIX_STACK_DEPTH) {
+		writePostfixBody(writer, second);
+	} else {
+		writeExpression(writer, second);
+	}
+	writeByte(writer, expression->token);
+}
+
+/**
+ * Whether an array index is a variable or integer constant, which the single index superinstructions read directly
+ */
+static int isSimpleIndexExpression(struct ir_expression * index) {
+	return index->token == LOAD_SLOT_TOKEN || index->token == INTEGER_TOKEN;
+}
+
+/**
+ * Whether an array index adds a constant to or subtracts one from a variable which type inference has proven is an integer
+ * (the operator is then quickened), if so the variable and constant added are retrieved
+ */
+static int getIndexOffset(struct ir_expression * index, unsigned short * slot, int * offset) {
+	if (index->token != INT_ADD_TOKEN && index->token != INT_SUB_TOKEN) return 0;
+	struct ir_expression * variable=index->children[0], * constant=index->children[1];
+	if (index->token == INT_ADD_TOKEN && variable->token == INTEGER_TOKEN) {
+		variable=index->children[1];
+		constant=index->children[0];
+	}
+	if (variable->token != LOAD_SLOT_TOKEN || constant->token != INTEGER_TOKEN) return 0;
+	if (index->token == INT_SUB_TOKEN && constant->literal.integer == INT_MIN) return 0;
+	*slot=variable->slot;
+	*offset=index->token == INT_SUB_TOKEN ? -constant->literal.integer : constant->literal.integer;
+	return 1;
+}
+
+/**
+ * The operand stack depth needed to evaluate an expression as the body of a postfix block
+ */
+static unsigned char getPostfixDepth(struct ir_expression * expression) {
+	if (!isArithmeticToken(expression->token)) return 1;
+	unsigned char firstDepth=getPostfixDepth(expression->children[0]);
+	unsigned char secondDepth=getPostfixDepth(expression->children[1]);
+	if (secondDepth >= POSTFIX_STACK_DEPTH) secondDepth=1;
+	return firstDepth > secondDepth+1 ? firstDepth : secondDepth+1;
+}
+
+/**
+ * Once the code has been laid out, records that a statement's jumps must go via gotos if one of them can not be encoded. This is
+ * never undone, so the code only grows as it is written again and the locations settle
+ */
+static void checkJump(struct ir_writer * writer, struct ir_statement * statement, int notEncodable) {
+	if (writer->checkJumps && notEncodable && !statement->jumpsViaGotos) {
+		statement->jumpsViaGotos=1;
+		writer->jumpsChanged=1;
+	}
+}
+
+/**
+ * Writes the block length of a conditional, loop or switch arm which leads to some block
+ */
+static void writeJump(struct ir_writer * writer, struct ir_block * target, unsigned int extraSkipped) {
+	writeUShort(writer, (unsigned short) (target->location-(writer->length+sizeof(unsigned short)+extraSkipped)));
+}
+
+static void writeGoto(struct ir_writer * writer, struct ir_block * target) {
+	writeByte(writer, GOTO_TOKEN);
+	writeUShort(writer, target->location);
+}
+
+/**
+ * Marks the functions which can be called from the main code, directly or via their address, only these are written out
+ */
+static void markReachableFunctions(struct ir_program * program) {
+	int i, workListSize=0, numberFunctions=0;
+	struct ir_function * function;
+	struct ir_block * block;
+	struct ir_statement * statement;
+	for (function=program->functions;function != NULL;function=function->next) {
+		function->visited=0;
+		numberFunctions++;
+	}
+	// Each function is placed on the work list at most once
+	struct ir_function ** workList=(struct ir_function**) malloc(sizeof(struct ir_function*) * numberFunctions);
+	workList[workListSize++]=program->functions;
+	program->functions->visited=1;
+	while (workListSize > 0) {
+		function=workList[--workListSize];
+		markReachableBlocks(function->blocks);
+		for (block=function->blocks;block != NULL;block=block->next) {
+			if (!block->visited) continue;
+			for (statement=block->statements;statement != NULL;statement=statement->next) {
+				if (statement->token == FNCALL_TOKEN && !statement->function->visited) {
+					statement->function->visited=1;
+					workList[workListSize++]=statement->function;
+				}
+				for (i=0;i<statement->numberExpressions;i++) markCalledFunctions(statement->expressions[i], workList, &workListSize);
+			}
+		}
+	}
+	free(workList);
+}
+
+static void markCalledFunctions(struct ir_expression * expression, struct ir_function ** workList, int * workListSize) {
+	int i;
+	if ((expression->token == FNCALL_TOKEN || expression->token == FN_ADDR_TOKEN) && !expression->function->visited) {
+		expression->function->visited=1;
+		workList[(*workListSize)++]=expression->function;
+	}
+	for (i=0;i<expression->numberChildren;i++) markCalledFunctions(expression->children[i], workList, workListSize);
+}
+
+/**
+ * Marks the blocks which control can reach from a function's entry, only these are written out
+ */
+static void markReachableBlocks(struct ir_block * entry) {
+	int i;
+	struct ir_block * block;
+	for (block=entry;block != NULL;block=block->next) block->visited=0;
+	int workListSize=0, capacity=16;
+	struct ir_block ** workList=(struct ir_block**) malloc(sizeof(struct ir_block*) * capacity);
+	workList[workListSize++]=entry;
+	entry->visited=1;
+	while (workListSize > 0) {
+		block=workList[--workListSize];
+		struct ir_statement * last=getLastStatement(block);
+		int numberTargets=last != NULL ? last->numberTargets : 0;
+		if (workListSize + numberTargets + 1 >= capacity) {
+			capacity=(capacity + numberTargets + 1) * 2;
+			workList=(struct ir_block**) realloc(workList, sizeof(struct ir_block*) * capacity);
+		}
+		for (i=0;i<numberTargets;i++) {
+			if (!last->targets[i]->visited) {
+				last->targets[i]->visited=1;
+				workList[workListSize++]=last->targets[i];
+			}
+		}
+		if (block->fallthrough != NULL && !block->fallthrough->visited) {
+			block->fallthrough->visited=1;
+			workList[workListSize++]=block->fallthrough;
+		}
+	}
+	free(workList);
+}
+
+static struct ir_block* getNextWrittenBlock(struct ir_block * block) {
+	for (block=block->next;block != NULL;block=block->next) {
+		if (block->visited) return block;
+	}
+	return NULL;
+}
+
+/**
+ * Reserves some bytes at the end of the code being written, returning where these start
+ */
+static unsigned int reserveBytes(struct ir_writer * writer, unsigned int size) {
+	unsigned int start=writer->length;
+	if (writer->length + size > writer->capacity) {
+		while (writer->length + size > writer->capacity) writer->capacity*=2;
+		writer->data=(char*) realloc(writer->data, writer->capacity);
+	}
+	writer->length+=size;
+	return start;
+}
+
+static void writeByte(struct ir_writer * writer, unsigned char value) {
+	unsigned int location=reserveBytes(writer, sizeof(unsigned char));
+	writer->data[location]=value;
+}
+
+static void writeUShort(struct ir_writer * writer, unsigned short value) {
+	setUShort(writer, reserveBytes(writer, sizeof(unsigned short)), value);
+}
+
+static void writeInt(struct ir_writer * writer, int value) {
+	unsigned int location=reserveBytes(writer, sizeof(int));
+	memcpy(&writer->data[location], &value, sizeof(int));
+}
+
+static void setUShort(struct ir_writer * writer, unsigned int location, unsigned short value) {
+	memcpy(&writer->data[location], &value, sizeof(unsigned short));
+}
+
+static int isArithmeticToken(unsigned char token) {
+	return (token >= ADD_TOKEN && token <= MOD_TOKEN) || token == POW_TOKEN || (token >= INT_ADD_TOKEN && token <= REAL_DIV_TOKEN);
+}
+
+static void freeFunction(struct ir_function * function) {
+	struct ir_block * block=function->blocks, * nextBlock;
+	while (block != NULL) {
+		struct ir_statement * statement=block->statements, * nextStatement;
+		while (statement != NULL) {
+			nextStatement=statement->next;
+			freeIRStatement(statement);
+			statement=nextStatement;
+		}
+		nextBlock=block->next;
+		free(block);
+		block=nextBlock;
+	}
+	free(function->argumentSlots);
+	free(function->isReferenceArgument);
+	free(function);
+}
+
+static void malformedByteCode(char * where, unsigned int location) {
+	fprintf(stderr, "Malformed byte code where %s at location %d, can not optimise it\n", where, location);
+	exit(EXIT_FAILURE);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IR_H_
+#define IR_H_
+
+/*
+ * The intermediate representation which the optimiser works upon. The assembled byte code is built into this, with each function
+ * a list of basic blocks holding statements whose operands are expression trees, and then written back out as byte code. Variables
+ * are referenced by their slot and jumps by the block or function they lead to, so nothing depends on where code is located
+ */
+
+/*
+ * An expression node, the token is that of the byte code (postfix arithmetic is held as a tree of arithmetic nodes, written back
+ * out in postfix form if that is enabled.) The children are the operand expressions, i.e. both sides of an operator, the indexes
+ * of an array access, the items of an array literal (preceded by its repetition if it has one), the arguments of a native call
+ * or those arguments of a function call which are passed by value (in order, their slot is VALUE_ARGUMENT_SLOT)
+ */
+struct ir_expression {
+	unsigned char token, code; // The code is the native function, number of array indexes or whether an array literal repeats
+	unsigned short slot;
+	union {
+		int integer;
+		float real;
+	} literal;
+	char * string;
+	struct ir_function * function; // Function called or whose address is taken
+	unsigned short numberArguments, * argumentSlots; // Slots holding the arguments of a function call
+	int numberChildren;
+	struct ir_expression ** children;
+};
+
+/*
+ * A statement, of which the last in a block may transfer control. The expressions are the operands (the value assigned, the
+ * condition tested and so on) and the targets are the blocks control may go to other than falling through, for a goto its
+ * destination, for a conditional where it goes if the test is false, for a loop where it goes on exit and for a switch each arm
+ * then the else block
+ */
+struct ir_statement {
+	unsigned char token, code; // The code is the operator of an assignment, native function or number of array indexes
+	unsigned short slot, secondSlot;
+	unsigned short stopSlot, stepSlot; // The hidden slots holding the stop and step of a counted range loop
+	int integer;
+	struct ir_function * function;
+	unsigned short numberArguments, * argumentSlots; // As for a call expression, with the values as the expressions
+	int numberExpressions, numberTargets;
+	struct ir_expression ** expressions;
+	struct ir_block ** targets;
+	int * keys; // Constant of each switch arm
+	int jumpsViaGotos; // Set whilst writing out if a jump can not be encoded directly, it then leads to gotos
+	struct ir_statement * next;
+};
+
+/*
+ * A basic block, control enters at the first statement and if it runs off the end of the last goes to the fallthrough block
+ * (NULL if it can not.) Blocks are kept in the order they are laid out in
+ */
+struct ir_block {
+	struct ir_statement * statements;
+	struct ir_block * fallthrough, * next;
+	unsigned int location; // Used whilst building and writing out, and by passes to number the blocks
+	int visited;
+};
+
+/*
+ * A function, or the main code, with the header which the interpreter reads on entry
+ */
+struct ir_function {
+	int isMain;
+	unsigned short numberLocals, numberArguments, * argumentSlots;
+	char * isReferenceArgument; // Whether the function assigns each argument, which then aliases the variable passed
+	struct ir_block * blocks;
+	struct ir_function * next;
+	unsigned int location; // Used whilst building and writing out
+	int visited;
+};
+
+struct ir_program {
+	unsigned short numberGlobals;
+	int postfixExpressions; // Whether arithmetic is to be written out in postfix form
+	struct ir_function * functions; // The main code followed by each function it may call
+};
+
+struct ir_program* buildProgramIR(char*, unsigned int);
+char* writeProgramIR(struct ir_program*, unsigned int*);
+void freeProgramIR(struct ir_program*);
+struct ir_statement* getLastStatement(struct ir_block*);
+void removeIRStatement(struct ir_block*, struct ir_statement*);
+int isBlockTerminator(unsigned char);
+int canStatementFallThrough(struct ir_statement*);
+int isLiteralExpression(struct ir_expression*);
+int isArithmeticExpression(struct ir_expression*);
+int isComparisonExpression(struct ir_expression*);
+unsigned char getGenericOperator(unsigned char);
+int isExpressionPure(struct ir_expression*);
+int getNumberValueArguments(unsigned short, unsigned short*);
+struct ir_expression* createIRExpression(unsigned char, int);
+struct ir_expression* copyIRExpression(struct ir_expression*);
+int isSameIRExpression(struct ir_expression*, struct ir_expression*);
+int isDirectIndexExpression(struct ir_expression*);
+int createTemporarySlot(struct ir_program*);
+void freeIRExpression(struct ir_expression*);
+void freeIRStatement(struct ir_statement*);
+
+#endif /* IR_H_ */
@@ -0,0 +1,692 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Loop optimisation pass. The natural loops of each function are found from its control flow, a loop being the blocks which
+ * lead back to a block (its header) that dominates them. Working from the outermost loop inwards, arithmetic giving the same
+ * value on every iteration is computed once before the loop, and the multiplication of an induction variable (one which the
+ * loop only ever increments by a constant) by a constant is replaced by a variable incremented alongside it. Throughout the
+ * code small integer powers become multiplications and the division of a real by a power of two becomes a multiplication.
+ *
+ * Values computed before a loop are held in new global slots, so in functions this is only done for loops which call nothing
+ * (a call might run the same function again.) As the loop might not run at all, only arithmetic which type inference has
+ * proven to be on integers or reals, and so can not raise an error, is moved out of it
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "loops.h"
+#include "typeinference.h"
+#include "basictokens.h"
+
+// Largest integer power which is replaced by multiplication
+#define MAX_REDUCED_POWER 3
+
+struct natural_loop {
+	struct ir_block * header;
+	unsigned char * inLoop; // Indexed by the number of the block, those created since the loops were found are in none
+	int size;
+};
+
+// A value computed before the loop and the slot it is held in
+struct hoisted_value {
+	struct ir_expression * value;
+	unsigned short slot;
+};
+
+// An induction variable multiplied by a constant, and the slot this is maintained in
+struct induction_value {
+	unsigned short inductionSlot, slot;
+	int factor;
+};
+
+struct loop_state {
+	struct ir_program * program;
+	struct ir_function * function;
+	struct natural_loop * loop;
+	int numberBlocks, numberGlobals, numberSlots, hasCall, aliasedWrites;
+	int * writeCounts; // Indexed by the slot's position, globals followed by locals
+	struct ir_statement ** increments; // The increment of each slot by a constant, if it has one in the loop
+	struct ir_block * preheader;
+	int numberHoisted, numberInductions;
+	struct hoisted_value * hoisted;
+	struct induction_value * inductions;
+};
+
+static void optimiseFunctionLoops(struct ir_program*, struct ir_function*);
+static int findNaturalLoops(struct ir_block**, int, struct natural_loop**);
+static int getNumberSuccessors(struct ir_block*);
+static struct ir_block* getSuccessor(struct ir_block*, int);
+static int dominates(int, int, int*);
+static int intersectDominators(int, int, int*, int*);
+static int compareLoopSizes(const void*, const void*);
+static void optimiseLoop(struct loop_state*);
+static int isBlockInLoop(struct loop_state*, struct ir_block*);
+static void findLoopWrites(struct loop_state*);
+static void findExpressionWrites(struct loop_state*, struct ir_expression*);
+static void markCall(struct loop_state*, unsigned short, unsigned short*);
+static void markWritten(struct loop_state*, unsigned short);
+static int getSlotIndex(struct loop_state*, unsigned short);
+static int isSlotAliased(struct ir_function*, unsigned short);
+static int isSlotInvariant(struct loop_state*, unsigned short);
+static int isInductionVariable(struct loop_state*, unsigned short);
+static void hoistInvariants(struct loop_state*, struct ir_expression**, int);
+static int isHoistable(struct loop_state*, struct ir_expression*);
+static int getHoistedSlot(struct loop_state*, struct ir_expression*);
+static void reduceInductions(struct loop_state*, struct ir_expression**, int);
+static int getInductionSlot(struct loop_state*, unsigned short, int);
+static void appendToPreheader(struct loop_state*, struct ir_statement*);
+static void reduceStrength(struct ir_program*, struct ir_expression**, int, int*);
+static struct ir_expression* createPowerMultiplication(struct ir_expression*, int);
+static int getReciprocal(struct ir_expression*, float*);
+static int isConditionStatement(struct ir_statement*);
+static struct ir_expression* createLoadExpression(unsigned short);
+static struct ir_statement* createStoreStatement(unsigned short, struct ir_expression*);
+
+/**
+ * Optimises the loops of each function then reduces the strength of arithmetic throughout, finally the types are inferred
+ * again so that the values computed by this are known and the multiplications it creates are quickened
+ */
+void optimiseLoops(struct ir_program * program) {
+	int i, powerSlot=-1;
+	struct ir_function * function;
+	struct ir_block * block;
+	struct ir_statement * statement;
+	for (function=program->functions;function != NULL;function=function->next) optimiseFunctionLoops(program, function);
+	for (function=program->functions;function != NULL;function=function->next) {
+		for (block=function->blocks;block != NULL;block=block->next) {
+			for (statement=block->statements;statement != NULL;statement=statement->next) {
+				float reciprocal;
+				for (i=0;i<statement->numberExpressions;i++) {
+					reduceStrength(program, &statement->expressions[i], isConditionStatement(statement), &powerSlot);
+				}
+				if (statement->token == OP_ASSIGN_TOKEN && getGenericOperator(statement->code) == DIV_TOKEN &&
+						getReciprocal(statement->expressions[0], &reciprocal)) {
+					statement->code=statement->code == DIV_TOKEN ? MUL_TOKEN : REAL_MUL_TOKEN;
+					statement->expressions[0]->literal.real=reciprocal;
+				}
+			}
+		}
+	}
+	inferTypes(program);
+}
+
+/**
+ * Finds the natural loops of a function and optimises each, outermost first so that a value which is the same throughout
+ * nested loops is computed before the outermost of them
+ */
+static void optimiseFunctionLoops(struct ir_program * program, struct ir_function * function) {
+	int i, numberBlocks=0, numberLoops;
+	struct ir_block * block, ** blocks;
+	struct natural_loop * loops;
+	struct loop_state state;
+	for (block=function->blocks;block != NULL;block=block->next) block->location=numberBlocks++;
+	blocks=(struct ir_block**) malloc(sizeof(struct ir_block*) * numberBlocks);
+	for (block=function->blocks;block != NULL;block=block->next) blocks[block->location]=block;
+	numberLoops=findNaturalLoops(blocks, numberBlocks, &loops);
+	qsort(loops, numberLoops, sizeof(struct natural_loop), compareLoopSizes);
+	for (i=0;i<numberLoops;i++) {
+		memset(&state, 0, sizeof(struct loop_state));
+		state.program=program;
+		state.function=function;
+		state.loop=&loops[i];
+		state.numberBlocks=numberBlocks;
+		optimiseLoop(&state);
+		free(loops[i].inLoop);
+	}
+	free(loops);
+	free(blocks);
+}
+
+/**
+ * Finds the natural loops amongst some blocks, the first of which is the entry. The dominators are found as in Cooper, Harvey
+ * and Kennedy's "A Simple, Fast Dominance Algorithm", over the blocks in reverse postorder, then every edge to a block which
+ * dominates where it comes from is a loop's back edge. The loop is the blocks which reach that edge without passing through
+ * the header, with all of the back edges to a header forming one loop
+ */
+static int findNaturalLoops(struct ir_block ** blocks, int numberBlocks, struct natural_loop ** builtLoops) {
+	int i, j, changed=1, numberOrdered=0, stackSize=0, numberLoops=0;
+	int * order=(int*) malloc(sizeof(int) * numberBlocks), * orderIndex=(int*) malloc(sizeof(int) * numberBlocks);
+	int * dominator=(int*) malloc(sizeof(int) * numberBlocks), * stack=(int*) malloc(sizeof(int) * numberBlocks);
+	int * nextSuccessor=(int*) calloc(numberBlocks, sizeof(int)), * numberPredecessors=(int*) calloc(numberBlocks, sizeof(int));
+	int ** predecessors=(int**) malloc(sizeof(int*) * numberBlocks);
+	unsigned char * visited=(unsigned char*) calloc(numberBlocks, sizeof(unsigned char));
+	struct natural_loop * loops=NULL;
+
+	// Postorder of the blocks reachable from the entry, which is then reversed
+	stack[stackSize++]=0;
+	visited[0]=1;
+	while (stackSize > 0) {
+		int current=stack[stackSize-1];
+		if (nextSuccessor[current] < getNumberSuccessors(blocks[current])) {
+			int successor=getSuccessor(blocks[current], nextSuccessor[current]++)->location;
+			if (!visited[successor]) {
+				visited[successor]=1;
+				stack[stackSize++]=successor;
+			}
+		} else {
+			order[numberOrdered++]=current;
+			stackSize--;
+		}
+	}
+	for (i=0;i<numberOrdered/2;i++) {
+		int swap=order[i];
+		order[i]=order[numberOrdered-1-i];
+		order[numberOrdered-1-i]=swap;
+	}
+	for (i=0;i<numberBlocks;i++) {
+		orderIndex[i]=-1;
+		dominator[i]=-1;
+		predecessors[i]=NULL;
+	}
+	for (i=0;i<numberOrdered;i++) orderIndex[order[i]]=i;
+	for (i=0;i<numberOrdered;i++) {
+		for (j=0;j<getNumberSuccessors(blocks[order[i]]);j++) {
+			int successor=getSuccessor(blocks[order[i]], j)->location;
+			predecessors[successor]=(int*) realloc(predecessors[successor], sizeof(int) * (numberPredecessors[successor]+1));
+			predecessors[successor][numberPredecessors[successor]++]=order[i];
+		}
+	}
+
+	dominator[0]=0;
+	while (changed) {
+		changed=0;
+		for (i=1;i<numberOrdered;i++) {
+			int current=order[i], newDominator=-1;
+			for (j=0;j<numberPredecessors[current];j++) {
+				int predecessor=predecessors[current][j];
+				if (dominator[predecessor] == -1) continue;
+				newDominator=newDominator == -1 ? predecessor : intersectDominators(predecessor, newDominator, dominator, orderIndex);
+			}
+			if (dominator[current] != newDominator) {
+				dominator[current]=newDominator;
+				changed=1;
+			}
+		}
+	}
+
+	for (i=0;i<numberOrdered;i++) {
+		int latch=order[i];
+		for (j=0;j<getNumberSuccessors(blocks[latch]);j++) {
+			int header=getSuccessor(blocks[latch], j)->location, k;
+			if (!dominates(header, latch, dominator)) continue;
+			for (k=0;k<numberLoops && loops[k].header != blocks[header];k++);
+			if (k == numberLoops) {
+				loops=(struct natural_loop*) realloc(loops, sizeof(struct natural_loop) * (numberLoops+1));
+				loops[k].header=blocks[header];
+				loops[k].inLoop=(unsigned char*) calloc(numberBlocks, sizeof(unsigned char));
+				loops[k].inLoop[header]=1;
+				loops[k].size=1;
+				numberLoops++;
+			}
+			// Walks back from the latch to the header, which every block on the way must be reached through
+			stackSize=0;
+			if (!loops[k].inLoop[latch]) {
+				loops[k].inLoop[latch]=1;
+				loops[k].size++;
+				stack[stackSize++]=latch;
+			}
+			while (stackSize > 0) {
+				int current=stack[--stackSize], l;
+				for (l=0;l<numberPredecessors[current];l++) {
+					int predecessor=predecessors[current][l];
+					if (!loops[k].inLoop[predecessor]) {
+						loops[k].inLoop[predecessor]=1;
+						loops[k].size++;
+						stack[stackSize++]=predecessor;
+					}
+				}
+			}
+		}
+	}
+	for (i=0;i<numberBlocks;i++) free(predecessors[i]);
+	free(predecessors);
+	free(numberPredecessors);
+	free(nextSuccessor);
+	free(stack);
+	free(dominator);
+	free(orderIndex);
+	free(order);
+	free(visited);
+	*builtLoops=loops;
+	return numberLoops;
+}
+
+/**
+ * The successors of a block are the targets of its last statement followed by where it falls through to
+ */
+static int getNumberSuccessors(struct ir_block * block) {
+	struct ir_statement * last=getLastStatement(block);
+	return (last != NULL ? last->numberTargets : 0) + (block->fallthrough != NULL ? 1 : 0);
+}
+
+static struct ir_block* getSuccessor(struct ir_block * block, int index) {
+	struct ir_statement * last=getLastStatement(block);
+	int numberTargets=last != NULL ? last->numberTargets : 0;
+	return index < numberTargets ? last->targets[index] : block->fallthrough;
+}
+
+/**
+ * Whether one block dominates another, by walking up the dominator tree from the second block to the entry
+ */
+static int dominates(int dominating, int block, int * dominator) {
+	while (block != dominating && block != 0) block=dominator[block];
+	return block == dominating;
+}
+
+static int intersectDominators(int first, int second, int * dominator, int * orderIndex) {
+	while (first != second) {
+		while (orderIndex[first] > orderIndex[second]) first=dominator[first];
+		while (orderIndex[second] > orderIndex[first]) second=dominator[second];
+	}
+	return first;
+}
+
+static int compareLoopSizes(const void * first, const void * second) {
+	return ((struct natural_loop*) second)->size - ((struct natural_loop*) first)->size;
+}
+
+/**
+ * Optimises a loop, first moving out the arithmetic which is the same on every iteration and then reducing the multiplication
+ * of induction variables
+ */
+static void optimiseLoop(struct loop_state * state) {
+	int i;
+	struct ir_block * block;
+	struct ir_statement * statement;
+	findLoopWrites(state);
+	if (state->function->isMain || !state->hasCall) {
+		for (block=state->function->blocks;block != NULL;block=block->next) {
+			if (!isBlockInLoop(state, block)) continue;
+			for (statement=block->statements;statement != NULL;statement=statement->next) {
+				for (i=0;i<statement->numberExpressions;i++) {
+					hoistInvariants(state, &statement->expressions[i], isConditionStatement(statement));
+				}
+			}
+		}
+		for (block=state->function->blocks;block != NULL;block=block->next) {
+			if (!isBlockInLoop(state, block)) continue;
+			for (statement=block->statements;statement != NULL;statement=statement->next) {
+				for (i=0;i<statement->numberExpressions;i++) {
+					reduceInductions(state, &statement->expressions[i], isConditionStatement(statement));
+				}
+			}
+		}
+	}
+	free(state->writeCounts);
+	free(state->increments);
+	free(state->hoisted);
+	free(state->inductions);
+}
+
+static int isBlockInLoop(struct loop_state * state, struct ir_block * block) {
+	return block->location < (unsigned int) state->numberBlocks && state->loop->inLoop[block->location];
+}
+
+/**
+ * Finds the variables which the loop may assign, whether it calls any function and the constant increments of variables
+ */
+static void findLoopWrites(struct loop_state * state) {
+	int i;
+	struct ir_block * block;
+	struct ir_statement * statement;
+	// Slots created whilst optimising the loop are beyond these, so are treated as unknown
+	state->numberGlobals=state->program->numberGlobals;
+	state->numberSlots=state->numberGlobals + state->function->numberLocals;
+	state->writeCounts=(int*) calloc(state->numberSlots+1, sizeof(int));
+	state->increments=(struct ir_statement**) calloc(state->numberSlots+1, sizeof(struct ir_statement*));
+	for (block=state->function->blocks;block != NULL;block=block->next) {
+		if (!isBlockInLoop(state, block)) continue;
+		for (statement=block->statements;statement != NULL;statement=statement->next) {
+			unsigned char token=statement->token;
+			for (i=0;i<statement->numberExpressions;i++) findExpressionWrites(state, statement->expressions[i]);
+			if (token == FNCALL_TOKEN || token == FNCALL_BY_VAR_TOKEN) markCall(state, statement->numberArguments, statement->argumentSlots);
+			if (token == STORE_SLOT_TOKEN || token == LETNOALIAS_TOKEN || token == OP_ASSIGN_TOKEN || token == INC_SLOT_TOKEN ||
+					token == ARRAYSET_TOKEN || token == ARRAYSET_1D_TOKEN || token == FOR_TOKEN || token == FOR_RANGE_TOKEN) {
+				markWritten(state, statement->slot);
+				if (token == FOR_TOKEN || token == FOR_RANGE_TOKEN) markWritten(state, statement->secondSlot);
+			}
+			if (token == INC_SLOT_TOKEN && getSlotIndex(state, statement->slot) >= 0) {
+				state->increments[getSlotIndex(state, statement->slot)]=statement;
+			}
+		}
+	}
+}
+
+static void findExpressionWrites(struct loop_state * state, struct ir_expression * expression) {
+	int i;
+	if (expression->token == STORE_SLOT_TOKEN) markWritten(state, expression->slot);
+	if (expression->token == FNCALL_TOKEN || expression->token == FNCALL_BY_VAR_TOKEN) {
+		markCall(state, expression->numberArguments, expression->argumentSlots);
+	}
+	for (i=0;i<expression->numberChildren;i++) findExpressionWrites(state, expression->children[i]);
+}
+
+/**
+ * A call might assign any global and, as arguments are passed by reference, any variable passed to it
+ */
+static void markCall(struct loop_state * state, unsigned short numberArguments, unsigned short * argumentSlots) {
+	int i;
+	state->hasCall=1;
+	if (state->function->numberArguments > 0) state->aliasedWrites++;
+	for (i=0;i<numberArguments;i++) markWritten(state, argumentSlots[i]);
+}
+
+static void markWritten(struct loop_state * state, unsigned short slot) {
+	int index=getSlotIndex(state, slot);
+	if (index >= 0) state->writeCounts[index]++;
+	if (isSlotAliased(state->function, slot)) state->aliasedWrites++;
+}
+
+/**
+ * Gets the position of a variable amongst the globals followed by the function's locals, -1 if it is neither
+ */
+static int getSlotIndex(struct loop_state * state, unsigned short slot) {
+	if (slot & LOCAL_SLOT_FLAG) {
+		int local=slot & ~LOCAL_SLOT_FLAG;
+		return local < state->function->numberLocals ? state->numberGlobals + local : -1;
+	}
+	return slot < state->numberGlobals ? slot : -1;
+}
+
+/**
+ * Whether a variable might be referred to under another name, which is the case for the globals and arguments of a function
+ * with arguments (these refer to the caller's variables)
+ */
+static int isSlotAliased(struct ir_function * function, unsigned short slot) {
+	int i;
+	if (function->numberArguments == 0) return 0;
+	if (!(slot & LOCAL_SLOT_FLAG)) return 1;
+	for (i=0;i<function->numberArguments;i++) {
+		if (function->argumentSlots[i] == slot) return 1;
+	}
+	return 0;
+}
+
+/**
+ * Whether a variable holds the same value throughout the loop
+ */
+static int isSlotInvariant(struct loop_state * state, unsigned short slot) {
+	int index=getSlotIndex(state, slot);
+	if (index < 0 || state->writeCounts[index] > 0) return 0;
+	if (!(slot & LOCAL_SLOT_FLAG) && state->hasCall) return 0;
+	return !(isSlotAliased(state->function, slot) && state->aliasedWrites > 0);
+}
+
+/**
+ * Whether a variable is only ever changed in the loop by a single increment of a constant
+ */
+static int isInductionVariable(struct loop_state * state, unsigned short slot) {
+	int index=getSlotIndex(state, slot);
+	if (index < 0 || state->writeCounts[index] != 1 || state->increments[index] == NULL) return 0;
+	if (!(slot & LOCAL_SLOT_FLAG) && state->hasCall) return 0;
+	return !(isSlotAliased(state->function, slot) && state->aliasedWrites > 1);
+}
+
+/**
+ * Replaces arithmetic within an expression which is the same on every iteration with a variable holding its value, computed
+ * before the loop. This is not done where the expression is tested directly as a condition, as a variable is tested
+ * differently to arithmetic there
+ */
+static void hoistInvariants(struct loop_state * state, struct ir_expression ** position, int isCondition) {
+	int i;
+	struct ir_expression * expression=*position;
+	if (!isCondition && expression->token >= INT_ADD_TOKEN && expression->token <= REAL_DIV_TOKEN && isHoistable(state, expression)) {
+		int slot=getHoistedSlot(state, expression);
+		if (slot >= 0) {
+			*position=createLoadExpression((unsigned short) slot);
+			freeIRExpression(expression);
+		}
+		return;
+	}
+	for (i=0;i<expression->numberChildren;i++) {
+		hoistInvariants(state, &expression->children[i], expression->token == AND_TOKEN || expression->token == OR_TOKEN);
+	}
+}
+
+/**
+ * Whether an expression is the same on every iteration of the loop and can be evaluated before it without raising an error,
+ * only quickened arithmetic is known to be on integers or reals and integer division must be by a constant which is safe
+ */
+static int isHoistable(struct loop_state * state, struct ir_expression * expression) {
+	int i;
+	unsigned char token=expression->token;
+	if (token == INTEGER_TOKEN || token == REAL_TOKEN) return 1;
+	if (token == LOAD_SLOT_TOKEN) return isSlotInvariant(state, expression->slot);
+	if (token == NATIVE_TOKEN) {
+		return expression->numberChildren == 0 && (expression->code == NATIVE_FN_RTL_NUMCORES || expression->code == NATIVE_FN_RTL_COREID ||
+				expression->code == NATIVE_FN_RTL_ISHOST || expression->code == NATIVE_FN_RTL_ISDEVICE);
+	}
+	if (token < INT_ADD_TOKEN || token > REAL_DIV_TOKEN) return 0;
+	if (token == INT_DIV_TOKEN) {
+		struct ir_expression * divisor=expression->children[1];
+		if (divisor->token != INTEGER_TOKEN || divisor->literal.integer == 0 || divisor->literal.integer == -1) return 0;
+	}
+	for (i=0;i<expression->numberChildren;i++) {
+		if (!isHoistable(state, expression->children[i])) return 0;
+	}
+	return 1;
+}
+
+/**
+ * Gets the variable holding the value of some arithmetic computed before the loop, computing it there if it is not already.
+ * Returns -1 if there is no slot free to hold it
+ */
+static int getHoistedSlot(struct loop_state * state, struct ir_expression * expression) {
+	int i, slot;
+	for (i=0;i<state->numberHoisted;i++) {
+		if (isSameIRExpression(state->hoisted[i].value, expression)) return state->hoisted[i].slot;
+	}
+	slot=createTemporarySlot(state->program);
+	if (slot < 0) return -1;
+	struct ir_statement * store=createStoreStatement((unsigned short) slot, copyIRExpression(expression));
+	appendToPreheader(state, store);
+	state->hoisted=(struct hoisted_value*) realloc(state->hoisted, sizeof(struct hoisted_value) * (state->numberHoisted+1));
+	state->hoisted[state->numberHoisted].value=store->expressions[0];
+	state->hoisted[state->numberHoisted++].slot=(unsigned short) slot;
+	return slot;
+}
+
+/**
+ * Replaces integer multiplication of an induction variable by a constant with a variable holding the result, which is set
+ * before the loop and incremented straight after the induction variable
+ */
+static void reduceInductions(struct loop_state * state, struct ir_expression ** position, int isCondition) {
+	int i;
+	struct ir_expression * expression=*position;
+	if (!isCondition && expression->token == INT_MUL_TOKEN) {
+		struct ir_expression * variable=expression->children[0], * factor=expression->children[1];
+		if (variable->token == INTEGER_TOKEN) {
+			variable=expression->children[1];
+			factor=expression->children[0];
+		}
+		if (variable->token == LOAD_SLOT_TOKEN && factor->token == INTEGER_TOKEN && isInductionVariable(state, variable->slot)) {
+			int slot=getInductionSlot(state, variable->slot, factor->literal.integer);
+			if (slot >= 0) {
+				*position=createLoadExpression((unsigned short) slot);
+				freeIRExpression(expression);
+				return;
+			}
+		}
+	}
+	for (i=0;i<expression->numberChildren;i++) {
+		reduceInductions(state, &expression->children[i], expression->token == AND_TOKEN || expression->token == OR_TOKEN);
+	}
+}
+
+static int getInductionSlot(struct loop_state * state, unsigned short inductionSlot, int factor) {
+	int i, slot;
+	for (i=0;i<state->numberInductions;i++) {
+		if (state->inductions[i].inductionSlot == inductionSlot && state->inductions[i].factor == factor) return state->inductions[i].slot;
+	}
+	slot=createTemporarySlot(state->program);
+	if (slot < 0) return -1;
+	struct ir_expression * product=createIRExpression(INT_MUL_TOKEN, 2);
+	product->children[0]=createLoadExpression(inductionSlot);
+	product->children[1]=createIRExpression(INTEGER_TOKEN, 0);
+	product->children[1]->literal.integer=factor;
+	appendToPreheader(state, createStoreStatement((unsigned short) slot, product));
+
+	// Done unsigned so that overflow wraps as the multiplication would
+	struct ir_statement * increment=state->increments[getSlotIndex(state, inductionSlot)];
+	struct ir_statement * reduced=(struct ir_statement*) calloc(1, sizeof(struct ir_statement));
+	reduced->token=INC_SLOT_TOKEN;
+	reduced->slot=(unsigned short) slot;
+	reduced->code=increment->code;
+	reduced->integer=(int) ((unsigned int) increment->integer * (unsigned int) factor);
+	reduced->next=increment->next;
+	increment->next=reduced;
+
+	state->inductions=(struct induction_value*) realloc(state->inductions, sizeof(struct induction_value) * (state->numberInductions+1));
+	state->inductions[state->numberInductions].inductionSlot=inductionSlot;
+	state->inductions[state->numberInductions].factor=factor;
+	state->inductions[state->numberInductions++].slot=(unsigned short) slot;
+	return slot;
+}
+
+/**
+ * Appends a statement to the loop's preheader, a block run before the loop is entered. This is created the first time it is
+ * needed, placed before the header with every edge into the loop from outside it going there instead
+ */
+static void appendToPreheader(struct loop_state * state, struct ir_statement * statement) {
+	int i;
+	struct ir_block * header=state->loop->header, * block;
+	if (state->preheader == NULL) {
+		struct ir_block * preheader=(struct ir_block*) calloc(1, sizeof(struct ir_block));
+		preheader->location=state->numberBlocks;
+		preheader->fallthrough=header;
+		preheader->next=header;
+		if (state->function->blocks == header) {
+			state->function->blocks=preheader;
+		} else {
+			for (block=state->function->blocks;block->next != header;block=block->next);
+			block->next=preheader;
+		}
+		for (block=state->function->blocks;block != NULL;block=block->next) {
+			if (block == preheader || isBlockInLoop(state, block)) continue;
+			struct ir_statement * last=getLastStatement(block);
+			if (block->fallthrough == header) block->fallthrough=preheader;
+			for (i=0;last != NULL && i<last->numberTargets;i++) {
+				if (last->targets[i] == header) last->targets[i]=preheader;
+			}
+		}
+		state->preheader=preheader;
+	}
+	struct ir_statement * last=getLastStatement(state->preheader);
+	if (last == NULL) {
+		state->preheader->statements=statement;
+	} else {
+		last->next=statement;
+	}
+}
+
+/**
+ * Replaces small integer powers with multiplication and the division of a real by a power of two with multiplication by its
+ * reciprocal, which gives exactly the same result. A power of anything other than a variable is computed once into a slot
+ * which the multiplication then reads, this is done within the expression so the slot can be shared by them all
+ */
+static void reduceStrength(struct ir_program * program, struct ir_expression ** position, int isCondition, int * powerSlot) {
+	int i;
+	float reciprocal;
+	struct ir_expression * expression=*position;
+	for (i=0;i<expression->numberChildren;i++) {
+		reduceStrength(program, &expression->children[i], expression->token == AND_TOKEN || expression->token == OR_TOKEN, powerSlot);
+	}
+	if (expression->token == POW_TOKEN && expression->children[1]->token == INTEGER_TOKEN &&
+			expression->children[1]->literal.integer >= 2 && expression->children[1]->literal.integer <= MAX_REDUCED_POWER) {
+		struct ir_expression * base=expression->children[0];
+		int power=expression->children[1]->literal.integer;
+		if (base->token == LOAD_SLOT_TOKEN) {
+			*position=createPowerMultiplication(base, power);
+		} else {
+			if (isCondition) return;
+			if (*powerSlot < 0) *powerSlot=createTemporarySlot(program);
+			if (*powerSlot < 0) return;
+			struct ir_expression * load=createLoadExpression((unsigned short) *powerSlot);
+			*position=createIRExpression(STORE_SLOT_TOKEN, 2);
+			(*position)->slot=(unsigned short) *powerSlot;
+			(*position)->children[0]=base;
+			(*position)->children[1]=createPowerMultiplication(load, power);
+			freeIRExpression(load);
+			expression->children[0]=NULL;
+		}
+		freeIRExpression(expression);
+	} else if (getGenericOperator(expression->token) == DIV_TOKEN && getReciprocal(expression->children[1], &reciprocal)) {
+		expression->token=expression->token == DIV_TOKEN ? MUL_TOKEN : REAL_MUL_TOKEN;
+		expression->children[1]->literal.real=reciprocal;
+	}
+}
+
+/**
+ * Creates the multiplication of copies of a variable giving some power of it, in the same order as the interpreter does
+ */
+static struct ir_expression* createPowerMultiplication(struct ir_expression * variable, int power) {
+	int i;
+	struct ir_expression * result=copyIRExpression(variable);
+	for (i=1;i<power;i++) {
+		struct ir_expression * multiplication=createIRExpression(MUL_TOKEN, 2);
+		multiplication->children[0]=result;
+		multiplication->children[1]=copyIRExpression(variable);
+		result=multiplication;
+	}
+	return result;
+}
+
+/**
+ * If an expression is a real literal which is a power of two, whose reciprocal is also a normal real, then gets the reciprocal
+ */
+static int getReciprocal(struct ir_expression * expression, float * reciprocal) {
+	unsigned int bits;
+	if (expression->token != REAL_TOKEN) return 0;
+	memcpy(&bits, &expression->literal.real, sizeof(unsigned int));
+	unsigned int exponent=(bits >> 23) & 0xFF;
+	if ((bits & 0x7FFFFF) != 0 || exponent < 1 || exponent > 253) return 0;
+	*reciprocal=1.0f / expression->literal.real;
+	return 1;
+}
+
+/**
+ * Whether a statement tests its expression directly as a condition
+ */
+static int isConditionStatement(struct ir_statement * statement) {
+	return statement->token == IF_TOKEN || statement->token == IFELSE_TOKEN;
+}
+
+static struct ir_expression* createLoadExpression(unsigned short slot) {
+	struct ir_expression * load=createIRExpression(LOAD_SLOT_TOKEN, 0);
+	load->slot=slot;
+	return load;
+}
+
+static struct ir_statement* createStoreStatement(unsigned short slot, struct ir_expression * value) {
+	struct ir_statement * statement=(struct ir_statement*) calloc(1, sizeof(struct ir_statement));
+	statement->token=STORE_SLOT_TOKEN;
+	statement->slot=slot;
+	statement->numberExpressions=1;
+	statement->expressions=(struct ir_expression**) malloc(sizeof(struct ir_expression*));
+	statement->expressions[0]=value;
+	return statement;
+}
@@ -40,6 +40,9 @@
 #include "memorymanager.h"
 #include "byteassembler.h"
 #include "python_interoperability.h"
+#include "predecoder.h"
+#include "verifier.h"
+#include "optimiser.h"
 #include "misc.h"
 #ifndef HOST_STANDALONE
 #include "shared.h"
@@ -81,6 +84,7 @@ void loadByteCode(char*);
 static char* getIncludeFileWithPath(char*);
 static void runCodeOnHost(struct interpreterconfiguration*, struct shared_basic*);
 static void * runSpecificHostProcess(void*);
+static void appendSourceContents(char**, unsigned int*, unsigned int*, char*);
 static void appendIncludedSourceFileToStore(char*);
 static int hasSourceFileAlreadyBeenIncluded(char*);
 #ifndef HOST_STANDALONE
@@ -93,6 +97,7 @@ static void* runCodeOnEpiphany(void*);
 int main (int argc, char *argv[]) {
 	srand((unsigned) time(NULL) * getpid());
 	struct interpreterconfiguration* configuration=readConfiguration(argc, argv);
+	setPostfixExpressions(configuration->postfixExpressions);
 	if (configuration->filename != NULL) {
 		char * contents = getSourceFileContents(configuration->filename);
 		if (configuration->displayPPCode) printf("%s\n", contents);
@@ -103,10 +108,19 @@ int main (int argc, char *argv[]) {
 		if (configuration->displayPPCode) printf("%s\n", configuration->pipedInContents);
 		doParse(configuration->pipedInContents);
 	}
+	// Byte code loaded via -l was optimised when it was compiled
+	if (configuration->loadByteFilename == NULL) optimiseAssembledCode(configuration->optimisationLevel, configuration->postfixExpressions);
 	if (configuration->displayStats) displayParsedBasicInfo();
 	if (configuration->compiledByteFilename != NULL) {
 		writeOutByteCode(configuration->compiledByteFilename);
 	} else {
+		// The byte code is proved to be well formed before being run, as the device might be built to run it unchecked even if
+		// the host is not
+		verifyAssembledCode();
+#ifdef INTERPRETER_PREDECODE
+		// The interpreter runs the predecoded form, which is placed on the cores and used by the host processes
+		predecodeAssembledCode();
+#endif
 #ifndef HOST_STANDALONE
 		pthread_t epiphany_management_thread;
 		struct shared_basic * deviceState=loadCodeOntoEpiphany(configuration);
@@ -203,12 +217,15 @@ static void * runSpecificHostProcess(void * rawThreadContext) {
  * is reported along with program exit if the file cannot be read for whatever reason
  */
 static char * getSourceFileContents(char * filename) {
-	unsigned int contentsSize=TEXTUAL_BASIC_SIZE_STRIDE;
+	unsigned int contentsSize=TEXTUAL_BASIC_SIZE_STRIDE, contentsLength=0;
 	char * contents=(char*) malloc(contentsSize);
 	char buffer[1024];
 	FILE * sourceCode=fopen(filename, "r");
 	if (sourceCode != NULL) {
-		sprintf(contents, "<<<%s\n", filename);
+		contents[0]='\0';
+		appendSourceContents(&contents, &contentsLength, &contentsSize, "<<<");
+		appendSourceContents(&contents, &contentsLength, &contentsSize, filename);
+		appendSourceContents(&contents, &contentsLength, &contentsSize, "\n");
 		while (fgets(buffer, 1024, sourceCode) != NULL) {
 			if (strstr(buffer, "import") != NULL && buffer[0] != '#') {
 				char * importPoint=strstr(buffer, "import");
@@ -238,11 +255,8 @@ static char * getSourceFileContents(char * filename) {
 				if (!hasSourceFileAlreadyBeenIncluded(entirePathForFile)) {
                     appendIncludedSourceFileToStore(entirePathForFile);
                     char * importedContents=getSourceFileContents(entirePathForFile);
-                    if (strlen(importedContents)+strlen(contents)+1 >= contentsSize) {
-                        contentsSize=strlen(importedContents)+strlen(contents)+TEXTUAL_BASIC_SIZE_STRIDE;
-                        contents=realloc(contents, contentsSize);
-                    }
-                    sprintf(contents, "%s%s", contents, importedContents);
+                    appendSourceContents(&contents, &contentsLength, &contentsSize, importedContents);
+                    free(importedContents);
 				}
 				free(newFilename);
 				free(entirePathForFile);
@@ -250,25 +264,14 @@ static char * getSourceFileContents(char * filename) {
 				int i=0;
 				while(isspace(buffer[i]) && buffer[i] != '\0' && i < 1024) i++;
 				if (buffer[i] != '#') {
-					if (strlen(buffer)+strlen(contents)+1 >= contentsSize) {
-						contentsSize+=TEXTUAL_BASIC_SIZE_STRIDE;
-						contents=realloc(contents, contentsSize);
-					}
-					sprintf(contents, "%s%s", contents, buffer);
+					appendSourceContents(&contents, &contentsLength, &contentsSize, buffer);
 				} else {
 					// Empty line to preserve line numberings
-					if (strlen(buffer)+2 >= contentsSize) {
-						contentsSize+=TEXTUAL_BASIC_SIZE_STRIDE;
-						contents=realloc(contents, contentsSize);
-					}
-					sprintf(contents, "%s\n", contents);
+					appendSourceContents(&contents, &contentsLength, &contentsSize, "\n");
 				}
 			}
 		}
-		if (strlen(contents)+7 >=contentsSize) {
-			contents=realloc(contents, contentsSize+7);
-		}
-		sprintf(contents, "%s\n>>>\n", contents);
+		appendSourceContents(&contents, &contentsLength, &contentsSize, "\n>>>\n");
 		fclose(sourceCode);
 		return contents;
 	} else {
@@ -277,6 +280,20 @@ static char * getSourceFileContents(char * filename) {
 	}
 }
 
+/**
+ * Appends some text to the end of the source contents being read, whose size is doubled whenever it runs out so that reading
+ * the source takes time linear in its length
+ */
+static void appendSourceContents(char ** contents, unsigned int * contentsLength, unsigned int * contentsSize, char * text) {
+	unsigned int textLength=strlen(text);
+	if (*contentsLength+textLength+1 > *contentsSize) {
+		while (*contentsLength+textLength+1 > *contentsSize) *contentsSize*=2;
+		*contents=(char*) realloc(*contents, *contentsSize);
+	}
+	memcpy(&(*contents)[*contentsLength], text, textLength+1);
+	*contentsLength+=textLength;
+}
+
 static void appendIncludedSourceFileToStore(char * filename) {
     struct included_source_files * newNode=(struct included_source_files *) malloc(sizeof(struct included_source_files));
     newNode->fileName=(char*) malloc(strlen(filename) + 1);
@@ -37,31 +37,42 @@ struct functionListNode* functionListHead=NULL;
 
 struct function_call_tree_node mainCodeCallTree;
 
+// Open addressed hash table of the line and function definitions (the targets of gotos and function references), so that each
+// reference is resolved without searching every line definition of the program
+struct label_table {
+	unsigned int size;
+	struct lineDefinition ** entries;
+};
+
 static void determineUsedFunctions(void);
 static void processUsedFunction(struct functionDefinition*);
-static unsigned short findLocationOfLineNumber(struct lineDefinition*, int);
-static unsigned short findLocationOfFunctionName(struct lineDefinition*, char*, int, int);
+static void buildLabelTable(struct label_table*, struct lineDefinition*);
+static unsigned int findLabelEntry(struct label_table*, char, int, char*);
+static unsigned int getLabelHash(char, int, char*);
+static unsigned short findLocationOfLineNumber(struct label_table*, int);
+static unsigned short findLocationOfFunctionName(struct label_table*, char*, int, int);
 static struct functionDefinition* findFunctionDefinition(char*);
 
-int getNumberOfSymbolEntriesNotUsed(void) {
-    int ignoreSymbolEntries=0;
+int getNumberSymbolTableEntriesForFunctions(void) {
+    int symbolEntries=0;
     struct functionListNode * fnHead=functionListHead;
     while (fnHead != NULL) {
-        if (!fnHead->fn->called) ignoreSymbolEntries+=fnHead->fn->numberEntriesInSymbolTable;
+        if (fnHead->fn->called) symbolEntries+=fnHead->fn->numberEntriesInSymbolTable;
         fnHead=fnHead->next;
     }
-    return ignoreSymbolEntries;
+    return symbolEntries;
 }
 
 /**
- * Compiles the memory by going through and resolving relative links (i.e. gotos) and adds a stop at the end
+ * Compiles the memory by going through and resolving relative links (i.e. gotos), adds the program header at the start
+ * and a stop at the end
  */
 void compileMemory(struct memorycontainer* memory) {
 	int i;
 	determineUsedFunctions();
 	struct memorycontainer* stopStatement=appendStopStatement();
 	if (memory != NULL) {
-		struct memorycontainer* compiledMem=concatenateMemory(memory, stopStatement);
+		struct memorycontainer* compiledMem=concatenateMemory(createProgramHeader(), concatenateMemory(memory, stopStatement));
 		struct functionListNode * fnHead=functionListHead;
 		while (fnHead != NULL) {
 			if (fnHead->fn->called) compiledMem=concatenateMemory(compiledMem, fnHead->fn->contents);
@@ -73,17 +84,20 @@ void compileMemory(struct memorycontainer* memory) {
 			}
 			fnHead=fnHead->next;
 		}
+		struct label_table labels;
+		buildLabelTable(&labels, compiledMem->lineDefns);
 		struct lineDefinition * root=compiledMem->lineDefns, *r2;
 		while (root != NULL) {
 			if (root->type==1) {
-				unsigned short lineLocation=findLocationOfLineNumber(compiledMem->lineDefns, root->linenumber);
+				unsigned short lineLocation=findLocationOfLineNumber(&labels, root->linenumber);
 				memcpy(&compiledMem->data[root->currentpoint], &lineLocation, sizeof(unsigned short));
 			} else if (root->type==3 || root->type==4) {
-				unsigned short lineLocation=findLocationOfFunctionName(compiledMem->lineDefns, root->name, root->linenumber, root->type==4);
+				unsigned short lineLocation=findLocationOfFunctionName(&labels, root->name, root->linenumber, root->type==4);
 				memcpy(&compiledMem->data[root->currentpoint], &lineLocation, sizeof(unsigned short));
 			}
 			root=root->next;
 		}
+		free(labels.entries);
 		// Clear up the memory used for these line definition nodes
 		root=compiledMem->lineDefns;
 		while (root != NULL) {
@@ -93,7 +107,7 @@ void compileMemory(struct memorycontainer* memory) {
 		}
 		assembledMemory=compiledMem;
 	} else {
-		assembledMemory=stopStatement;
+		assembledMemory=concatenateMemory(createProgramHeader(), stopStatement);
 	}
 }
 
@@ -157,13 +171,56 @@ int getNumberSymbolTableEntriesForRecursion(void) {
 }
 
 /**
- * Given a line number will return the byte location of this in the memory
+ * Builds the table of line (type 0) and function (type 2) definitions, it is kept at most half full. Where a label is defined
+ * more than once the first definition in the list is found, as when searching the list
  */
-static unsigned short findLocationOfLineNumber(struct lineDefinition * root, int lineNumber) {
-	while (root != NULL) {
-		if (root->type==0 && root->linenumber == lineNumber) return (unsigned short) root->currentpoint;
-		root=root->next;
+static void buildLabelTable(struct label_table * table, struct lineDefinition * root) {
+	unsigned int numberLabels=0, entry;
+	struct lineDefinition * definition;
+	for (definition=root;definition != NULL;definition=definition->next) {
+		if (definition->type==0 || definition->type==2) numberLabels++;
+	}
+	table->size=16;
+	while (table->size < numberLabels*2) table->size*=2;
+	table->entries=(struct lineDefinition**) calloc(table->size, sizeof(struct lineDefinition*));
+	for (definition=root;definition != NULL;definition=definition->next) {
+		if (definition->type==0 || definition->type==2) {
+			entry=findLabelEntry(table, definition->type, definition->linenumber, definition->name);
+			if (table->entries[entry] == NULL) table->entries[entry]=definition;
+		}
+	}
+}
+
+/**
+ * Finds the entry of the table holding a label, or the empty entry where it would be held. Line definitions are keyed by their
+ * line number and function definitions by their name
+ */
+static unsigned int findLabelEntry(struct label_table * table, char type, int lineNumber, char * name) {
+	unsigned int entry=getLabelHash(type, lineNumber, name) & (table->size-1);
+	struct lineDefinition * definition;
+	while ((definition=table->entries[entry]) != NULL) {
+		if (definition->type == type) {
+			if (type==0 && definition->linenumber == lineNumber) return entry;
+			if (type==2 && strcmp(definition->name, name) == 0) return entry;
+		}
+		entry=(entry+1) & (table->size-1);
 	}
+	return entry;
+}
+
+static unsigned int getLabelHash(char type, int lineNumber, char * name) {
+	unsigned int hash=2166136261u;
+	if (type==0) return ((unsigned int) lineNumber) * 2654435761u;
+	while (*name != '\0') hash=(hash ^ (unsigned char) *name++) * 16777619u;
+	return hash;
+}
+
+/**
+ * Given a line number will return the byte location of this in the memory
+ */
+static unsigned short findLocationOfLineNumber(struct label_table * table, int lineNumber) {
+	struct lineDefinition * definition=table->entries[findLabelEntry(table, 0, lineNumber, NULL)];
+	if (definition != NULL) return (unsigned short) definition->currentpoint;
 	fprintf(stderr, "Can not find line %d in goto\n", lineNumber);
 	exit(0);
 }
@@ -171,11 +228,9 @@ static unsigned short findLocationOfLineNumber(struct lineDefinition * root, int
 /**
  * Finds the location of a function name and returns this or raises an error if the function is not found
  */
-static unsigned short findLocationOfFunctionName(struct lineDefinition * root, char * functionName, int line_num_for_error, int isvarorfn) {
-	while (root != NULL) {
-		if (root->type==2 && strcmp(root->name, functionName) == 0) return (unsigned short) root->currentpoint;
-		root=root->next;
-	}
+static unsigned short findLocationOfFunctionName(struct label_table * table, char * functionName, int line_num_for_error, int isvarorfn) {
+	struct lineDefinition * definition=table->entries[findLabelEntry(table, 2, 0, functionName)];
+	if (definition != NULL) return (unsigned short) definition->currentpoint;
 	if (isvarorfn) {
         fprintf(stderr, "Can not find variable or function '%s' in assignment at line number %d\n", functionName, line_num_for_error);
 	} else {
@@ -185,31 +240,34 @@ static unsigned short findLocationOfFunctionName(struct lineDefinition * root, c
 }
 
 /**
- * Concatenates two memory structures together and returns the result of this
+ * Concatenates two memory structures together and returns the result of this. The first is grown in place, with its capacity
+ * doubled whenever it runs out, so that building up code a statement at a time copies each statement a constant number of
+ * times rather than copying all of the code before it again
  */
 struct memorycontainer* concatenateMemory(struct memorycontainer* m1, struct memorycontainer* m2) {
 	if (m1 == NULL) return m2;
 	if (m2 == NULL) return m1;
-	struct memorycontainer* memoryContainer = (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
-	memoryContainer->length=m1->length + m2->length;
-	memoryContainer->data=malloc(memoryContainer->length);
-	memoryContainer->lineDefns=m1->lineDefns;
-	memcpy(memoryContainer->data, m1->data, m1->length);
-	memcpy(&memoryContainer->data[m1->length], m2->data, m2->length);
+	unsigned int startOfM2=m1->length;
+	if (m1->capacity < m1->length) m1->capacity=m1->length;
+	if (m1->length + m2->length > m1->capacity) {
+		if (m1->capacity == 0) m1->capacity=1;
+		while (m1->length + m2->length > m1->capacity) m1->capacity*=2;
+		m1->data=(char*) realloc(m1->data, m1->capacity);
+	}
+	memcpy(&m1->data[startOfM2], m2->data, m2->length);
+	m1->length+=m2->length;
 	struct lineDefinition * root=m2->lineDefns, *r2;
 	while (root != NULL) {
-		root->currentpoint+=m1->length;
+		root->currentpoint+=startOfM2;
 		r2=root->next;
-		root->next=memoryContainer->lineDefns;
-		memoryContainer->lineDefns=root;
+		root->next=m1->lineDefns;
+		m1->lineDefns=root;
 		root=r2;
 	}
-	// Free up the m1 and m2 memory
-	free(m1->data);
-	free(m1);
+	// Free up the m2 memory
 	free(m2->data);
 	free(m2);
-	return memoryContainer;
+	return m1;
 }
 
 /**
@@ -264,7 +322,7 @@ unsigned int getMemoryFilledSize() {
  * Sets the length of the assembled memory (when loading from bytecode file)
  */
 void setMemoryFilledSize(unsigned int size) {
-	if (assembledMemory == NULL) assembledMemory= (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	if (assembledMemory == NULL) assembledMemory= (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	assembledMemory->length=size;
 }
 
@@ -280,6 +338,7 @@ char * getAssembledCode() {
  * Sets the code in the assembled memory (when loading from bytecode file)
  */
 void setAssembledCode(char * a) {
-	if (assembledMemory == NULL) assembledMemory= (struct memorycontainer*) malloc(sizeof(struct memorycontainer));
+	if (assembledMemory == NULL) assembledMemory= (struct memorycontainer*) calloc(1, sizeof(struct memorycontainer));
 	assembledMemory->data=a;
+	assembledMemory->capacity=0;
 }
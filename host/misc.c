@@ -109,6 +109,12 @@ char* translateErrorCodeToMessage(unsigned char errorCode) {
     case ERR_NBSEND_NOT_SUPPORTED:
         errorMessage="Non-blocking sends between device and virtual cores on the host are not yet supported";
         break;
+    case ERR_CALL_STACK_DEPTH_EXCEEDED:
+        errorMessage="Maximum depth of function calls exceeded, is there unbounded recursion?";
+        break;
+    case ERR_STR_IN_ARRAY_NOT_SUPPORTED:
+        errorMessage="Strings can only be held in arrays where an address fits in an integer, which is not the case on this host";
+        break;
     }
     if (errorMessage != NULL) {
         char * msgToRet=(char*) malloc(strlen(errorMessage) + 1);
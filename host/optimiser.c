@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * The optimiser, which builds the assembled byte code into the IR, runs passes over this and then writes it back out. Each pass
+ * is independent and has the lowest optimisation level (set by -O0, -O1 or -O2) that it is run at, at -O0 the byte code is left
+ * exactly as the assembler emitted it
+ */
+
+#include <stdlib.h>
+#include "optimiser.h"
+#include "ir.h"
+#include "folding.h"
+#include "inlining.h"
+#include "typeinference.h"
+#include "loops.h"
+#include "subexpressions.h"
+#include "memorymanager.h"
+#include "byteassembler.h"
+#include "basictokens.h"
+
+// An optimisation pass and the lowest level that it runs at
+struct optimisation_pass {
+	char * name;
+	int level;
+	void (*run)(struct ir_program*);
+};
+
+static void threadJumps(struct ir_program*);
+static struct ir_block* getJumpDestination(struct ir_block*);
+static void removeLastStatement(struct ir_block*);
+static int isBlockAfter(struct ir_block*, struct ir_block*);
+
+static struct optimisation_pass passes[]={
+	{"inline-functions", 1, inlineFunctions},
+	{"fold-constants", 1, foldConstants},
+	{"propagate-constants", 1, propagateConstants},
+	{"infer-types", 1, inferTypes},
+	{"optimise-loops", 1, optimiseLoops},
+	{"eliminate-subexpressions", 1, eliminateCommonSubexpressions},
+	{"thread-jumps", 1, threadJumps}
+};
+
+/**
+ * Optimises the assembled byte code at some level, the postfix argument is whether arithmetic is to be written back out in
+ * postfix form
+ */
+void optimiseAssembledCode(int level, int postfixExpressions) {
+	unsigned int i, length;
+	if (level <= 0 || getMemoryFilledSize() == 0) return;
+	struct ir_program * program=buildProgramIR(getAssembledCode(), getMemoryFilledSize());
+	program->postfixExpressions=postfixExpressions;
+	unsigned short numberGlobals=program->numberGlobals;
+	for (i=0;i<sizeof(passes)/sizeof(struct optimisation_pass);i++) {
+		if (passes[i].level <= level) passes[i].run(program);
+	}
+	// Passes may hold values in extra global slots, which the symbol table must have room for
+	addGlobalSlots(program->numberGlobals-numberGlobals);
+	char * code=writeProgramIR(program, &length);
+	freeProgramIR(program);
+	free(getAssembledCode());
+	setAssembledCode(code);
+	setMemoryFilledSize(length);
+}
+
+/**
+ * Jump threading, a jump or fallthrough to a block which does nothing but goto elsewhere instead goes directly to where that leads.
+ * This is common as loops and if statements nest, where the end of each inner block goes to the end of the outer block. A goto
+ * ending a block becomes its fallthrough, so it is only written out if the block it leads to is not placed next
+ */
+static void threadJumps(struct ir_program * program) {
+	int i;
+	struct ir_function * function;
+	struct ir_block * block;
+	for (function=program->functions;function != NULL;function=function->next) {
+		for (block=function->blocks;block != NULL;block=block->next) {
+			struct ir_statement * last=getLastStatement(block);
+			if (last != NULL && last->token == GOTO_TOKEN) {
+				block->fallthrough=last->targets[0];
+				removeLastStatement(block);
+			}
+		}
+		for (block=function->blocks;block != NULL;block=block->next) {
+			struct ir_statement * last=getLastStatement(block);
+			if (last != NULL) {
+				for (i=0;i<last->numberTargets;i++) {
+					// A conditional or loop can only jump ahead, so is not threaded back to where it would need to go via a goto
+					struct ir_block * destination=getJumpDestination(last->targets[i]);
+					if (isBlockAfter(block, destination)) last->targets[i]=destination;
+				}
+			}
+			// Running on into the next block costs nothing, whereas going elsewhere costs a goto wherever it leads
+			if (block->fallthrough != NULL && block->fallthrough != block->next) block->fallthrough=getJumpDestination(block->fallthrough);
+		}
+	}
+}
+
+/**
+ * Follows a chain of empty blocks to where control ends up, stopping if the chain loops back on itself
+ */
+static struct ir_block* getJumpDestination(struct ir_block * block) {
+	struct ir_block * destination=block;
+	while (destination->statements == NULL && destination->fallthrough != NULL) {
+		destination=destination->fallthrough;
+		if (destination == block) return block;
+	}
+	return destination;
+}
+
+static void removeLastStatement(struct ir_block * block) {
+	struct ir_statement * last=getLastStatement(block), * statement;
+	if (block->statements == last) {
+		block->statements=NULL;
+	} else {
+		for (statement=block->statements;statement->next != last;statement=statement->next);
+		statement->next=NULL;
+	}
+	freeIRStatement(last);
+}
+
+/**
+ * Whether a block is laid out after another
+ */
+static int isBlockAfter(struct ir_block * block, struct ir_block * other) {
+	for (block=block->next;block != NULL;block=block->next) {
+		if (block == other) return 1;
+	}
+	return 0;
+}
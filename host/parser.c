@@ -1570,7 +1570,7 @@ yyreduce:
 
   case 14:
 #line 83 "epython.y" /* yacc.c:1646  */
-    { (yyval.data)=appendIfElseStatement((yyvsp[-3].data), (yyvsp[-1].data), (yyvsp[0].data)); }
+    { (yyval.data)=appendIfElifStatement((yyvsp[-3].data), (yyvsp[-1].data), (yyvsp[0].data)); }
 #line 1575 "parser.c" /* yacc.c:1646  */
     break;
 
@@ -1792,7 +1792,7 @@ yyreduce:
 
   case 51:
 #line 145 "epython.y" /* yacc.c:1646  */
-    { (yyval.data)=appendIfElseStatement((yyvsp[-3].data), (yyvsp[-1].data), (yyvsp[0].data)); }
+    { (yyval.data)=appendIfElifStatement((yyvsp[-3].data), (yyvsp[-1].data), (yyvsp[0].data)); }
 #line 1797 "parser.c" /* yacc.c:1646  */
     break;
 
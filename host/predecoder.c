@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Predecodes the compact byte code into the form that the interpreter runs when built with INTERPRETER_PREDECODE. The compact
+ * byte code is unaligned, so each operand must be copied out a byte at a time, and jumps are held as offsets which need adding
+ * each time they are taken. In the predecoded form every token and operand occupies an aligned word, absolute addresses are
+ * relocated and block lengths are replaced by the absolute location they lead to. The compact form is still what is stored and
+ * written to byte code files, this is done as the code is placed
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "predecoder.h"
+#include "memorymanager.h"
+#include "basictokens.h"
+
+// The kind of each unit (a token or operand) of the compact byte code, recorded against the location it starts at
+#define UNIT_BYTE 1
+#define UNIT_USHORT 2
+#define UNIT_WORD 3
+#define UNIT_STRING 4
+#define UNIT_ADDRESS 5
+#define UNIT_BLOCK_LENGTH 6
+#define UNIT_LOOP_BLOCK_LENGTH 7
+
+// Marks an entry on the work list as the start of a function, where the function's header precedes its statements
+#define FUNCTION_ENTRY_FLAG 0x80000000
+
+// A loop's block length also skips over the goto at the end of its block
+#define LOOP_GOTO_SIZE (sizeof(unsigned char)+sizeof(unsigned short))
+
+// The compact byte code being predecoded, the kinds of its units and the work list of statements still to be walked
+struct predecode_state {
+	char * code;
+	unsigned int length, workListSize;
+	unsigned char * unitKinds;
+	unsigned int * workList;
+};
+
+static void discoverStatements(struct predecode_state*, unsigned int);
+static unsigned int discoverStatement(struct predecode_state*, unsigned int, int*);
+static unsigned int discoverExpression(struct predecode_state*, unsigned int);
+static unsigned int discoverFunctionCall(struct predecode_state*, unsigned char, unsigned int);
+static unsigned int discoverNativeCall(struct predecode_state*, unsigned int);
+static unsigned int discoverArrayIndexes(struct predecode_state*, unsigned int);
+static unsigned int recordUnit(struct predecode_state*, unsigned int, unsigned char);
+static void addToWorkList(struct predecode_state*, unsigned int);
+static unsigned int getPredecodedUnitSize(struct predecode_state*, unsigned int);
+static void emitUnit(struct predecode_state*, unsigned int*, char*, unsigned int);
+static unsigned int getPredecodedLocation(struct predecode_state*, unsigned int*, unsigned int);
+static unsigned short getCompactUShort(struct predecode_state*, unsigned int);
+static int isBinaryOperatorToken(unsigned char);
+static int isArithmeticToken(unsigned char);
+
+/**
+ * Predecodes the assembled code, replacing it. The units of the code are found by following its control flow from the main
+ * code and into each function called, so any code which can never be reached (such as padding) is dropped. Each unit is then
+ * given its location in the predecoded code and written there
+ */
+void predecodeAssembledCode(void) {
+	struct predecode_state state;
+	state.code=getAssembledCode();
+	state.length=getMemoryFilledSize();
+	state.unitKinds=(unsigned char*) calloc(state.length, sizeof(unsigned char));
+	// Each unit adds at most one entry, so the work list can not exceed the length of the code
+	state.workList=(unsigned int*) malloc(sizeof(unsigned int) * (state.length+1));
+	state.workListSize=0;
+
+	// The program header, which is the number of global slots, is followed by the main code
+	addToWorkList(&state, recordUnit(&state, 0, UNIT_USHORT));
+	while (state.workListSize > 0) discoverStatements(&state, state.workList[--state.workListSize]);
+
+	unsigned int i, predecodedLength=0;
+	unsigned int * locations=(unsigned int*) malloc(sizeof(unsigned int) * (state.length+1));
+	for (i=0;i<state.length;i++) {
+		locations[i]=predecodedLength;
+		predecodedLength+=getPredecodedUnitSize(&state, i);
+	}
+	locations[state.length]=predecodedLength;
+
+	char * predecoded=(char*) calloc(predecodedLength, sizeof(char));
+	for (i=0;i<state.length;i++) {
+		if (state.unitKinds[i]) emitUnit(&state, locations, predecoded, i);
+	}
+	free(locations);
+	free(state.workList);
+	free(state.unitKinds);
+	free(state.code);
+	setAssembledCode(predecoded);
+	setMemoryFilledSize(predecodedLength);
+}
+
+/**
+ * Walks a run of statements from an entry on the work list until control can not fall through to the next statement, or
+ * the next statement has already been walked
+ */
+static void discoverStatements(struct predecode_state * state, unsigned int entry) {
+	unsigned int point=entry & ~FUNCTION_ENTRY_FLAG;
+	if (point >= state->length || state->unitKinds[point]) return;
+	if (entry & FUNCTION_ENTRY_FLAG) {
+		// The function header is the size of its frame, then the number of arguments and the slot of each
+		point=recordUnit(state, point, UNIT_USHORT);
+		unsigned short i, numberArgs=getCompactUShort(state, point);
+		point=recordUnit(state, point, UNIT_USHORT);
+		for (i=0;i<numberArgs;i++) point=recordUnit(state, point, UNIT_USHORT);
+	}
+	int fallsThrough=1;
+	while (fallsThrough && point < state->length && !state->unitKinds[point]) {
+		point=discoverStatement(state, point, &fallsThrough);
+	}
+}
+
+/**
+ * Walks a single statement, adding any location it may jump to onto the work list, and returns the location after it
+ */
+static unsigned int discoverStatement(struct predecode_state * state, unsigned int point, int * fallsThrough) {
+	unsigned char token=(unsigned char) state->code[point];
+	point=recordUnit(state, point, UNIT_BYTE);
+	switch (token) {
+	case STORE_SLOT_TOKEN:
+	case LETNOALIAS_TOKEN:
+		point=recordUnit(state, point, UNIT_USHORT);
+		return discoverExpression(state, point);
+	case OP_ASSIGN_TOKEN:
+		point=recordUnit(state, point, UNIT_USHORT);
+		point=recordUnit(state, point, UNIT_BYTE);
+		return discoverExpression(state, point);
+	case INC_SLOT_TOKEN:
+		point=recordUnit(state, point, UNIT_USHORT);
+		point=recordUnit(state, point, UNIT_BYTE);
+		return recordUnit(state, point, UNIT_WORD);
+	case ARRAYSET_TOKEN:
+	case ARRAYSET_1D_TOKEN:
+		point=recordUnit(state, point, UNIT_USHORT);
+		point=discoverArrayIndexes(state, point);
+		return discoverExpression(state, point);
+	case IF_TOKEN:
+	case IFELSE_TOKEN:
+	case CMP_JUMP_TOKEN:
+		point=discoverExpression(state, point);
+		addToWorkList(state, point+sizeof(unsigned short)+getCompactUShort(state, point));
+		return recordUnit(state, point, UNIT_BLOCK_LENGTH);
+	case FOR_TOKEN:
+		point=recordUnit(state, point, UNIT_USHORT);
+		point=recordUnit(state, point, UNIT_USHORT);
+		point=discoverExpression(state, point);
+		addToWorkList(state, point+sizeof(unsigned short)+getCompactUShort(state, point)+LOOP_GOTO_SIZE);
+		return recordUnit(state, point, UNIT_LOOP_BLOCK_LENGTH);
+	case FOR_RANGE_TOKEN: {
+		// The loop variable, counter, stop and step
+		int i;
+		for (i=0;i<4;i++) point=recordUnit(state, point, UNIT_USHORT);
+		addToWorkList(state, point+sizeof(unsigned short)+getCompactUShort(state, point)+LOOP_GOTO_SIZE);
+		return recordUnit(state, point, UNIT_LOOP_BLOCK_LENGTH);
+	}
+	case SWITCH_TOKEN: {
+		// The variable, number of arms and their constants, then the block length leading to each arm and to the else arm
+		unsigned short i, numberArms;
+		point=recordUnit(state, point, UNIT_USHORT);
+		numberArms=getCompactUShort(state, point);
+		point=recordUnit(state, point, UNIT_USHORT);
+		for (i=0;i<numberArms;i++) point=recordUnit(state, point, UNIT_WORD);
+		for (i=0;i<=numberArms;i++) {
+			addToWorkList(state, point+sizeof(unsigned short)+getCompactUShort(state, point));
+			point=recordUnit(state, point, UNIT_BLOCK_LENGTH);
+		}
+		*fallsThrough=0;
+		return point;
+	}
+	case GOTO_TOKEN:
+		*fallsThrough=0;
+		addToWorkList(state, getCompactUShort(state, point));
+		return recordUnit(state, point, UNIT_ADDRESS);
+	case FNCALL_TOKEN:
+	case FNCALL_BY_VAR_TOKEN:
+		return discoverFunctionCall(state, token, point);
+	case NATIVE_TOKEN:
+		return discoverNativeCall(state, point);
+	case RETURN_EXP_TOKEN:
+		*fallsThrough=0;
+		return discoverExpression(state, point);
+	case RETURN_TOKEN:
+	case STOP_TOKEN:
+		*fallsThrough=0;
+		return point;
+	}
+	// As in the interpreter, any other token is a statement which does nothing
+	return point;
+}
+
+/**
+ * Walks an expression and returns the location after it, conditions have the same layout as expressions
+ */
+static unsigned int discoverExpression(struct predecode_state * state, unsigned int point) {
+	unsigned char token=(unsigned char) state->code[point];
+	point=recordUnit(state, point, UNIT_BYTE);
+	switch (token) {
+	case INTEGER_TOKEN:
+	case REAL_TOKEN:
+	case BOOLEAN_TOKEN:
+		return recordUnit(state, point, UNIT_WORD);
+	case STRING_TOKEN:
+		return recordUnit(state, point, UNIT_STRING);
+	case NONE_TOKEN:
+		return point;
+	case FN_ADDR_TOKEN:
+		addToWorkList(state, getCompactUShort(state, point) | FUNCTION_ENTRY_FLAG);
+		return recordUnit(state, point, UNIT_ADDRESS);
+	case LOAD_SLOT_TOKEN:
+		return recordUnit(state, point, UNIT_USHORT);
+	case STORE_SLOT_TOKEN:
+		// An assignment followed by the expression whose value is returned
+		point=recordUnit(state, point, UNIT_USHORT);
+		point=discoverExpression(state, point);
+		return discoverExpression(state, point);
+	case ARRAY_TOKEN: {
+		int i, numberItems;
+		memcpy(&numberItems, &state->code[point], sizeof(int));
+		point=recordUnit(state, point, UNIT_WORD);
+		unsigned char hasRepetition=(unsigned char) state->code[point];
+		point=recordUnit(state, point, UNIT_BYTE);
+		if (hasRepetition) point=discoverExpression(state, point);
+		for (i=0;i<numberItems;i++) point=discoverExpression(state, point);
+		return point;
+	}
+	case FNCALL_TOKEN:
+	case FNCALL_BY_VAR_TOKEN:
+		return discoverFunctionCall(state, token, point);
+	case NATIVE_TOKEN:
+		return discoverNativeCall(state, point);
+	case ARRAYACCESS_TOKEN:
+	case ARRAYACCESS_1D_TOKEN:
+		point=recordUnit(state, point, UNIT_USHORT);
+		return discoverArrayIndexes(state, point);
+	case ARRAYACCESS_OFFSET_TOKEN:
+		point=recordUnit(state, point, UNIT_USHORT);
+		point=recordUnit(state, point, UNIT_USHORT);
+		return recordUnit(state, point, UNIT_WORD);
+	case NOT_TOKEN:
+		return discoverExpression(state, point);
+	case AND_TOKEN:
+	case OR_TOKEN:
+		// The first operand, then the length of the second which is branched over if the first decides the result
+		point=discoverExpression(state, point);
+		point=recordUnit(state, point, UNIT_BLOCK_LENGTH);
+		return discoverExpression(state, point);
+	case POSTFIX_TOKEN: {
+		// The depth of the operand stack and length of the body, then operands and arithmetic operators until its end
+		point=recordUnit(state, point, UNIT_BYTE);
+		unsigned int end=point+sizeof(unsigned short)+getCompactUShort(state, point);
+		point=recordUnit(state, point, UNIT_BLOCK_LENGTH);
+		while (point < end) {
+			if (isArithmeticToken((unsigned char) state->code[point])) {
+				point=recordUnit(state, point, UNIT_BYTE);
+			} else {
+				point=discoverExpression(state, point);
+			}
+		}
+		return point;
+	}
+	}
+	if (isBinaryOperatorToken(token)) {
+		point=discoverExpression(state, point);
+		return discoverExpression(state, point);
+	}
+	return point;
+}
+
+/**
+ * Walks a function call, directly to a function (which is added to the work list) or via a variable, and its argument slots
+ */
+static unsigned int discoverFunctionCall(struct predecode_state * state, unsigned char token, unsigned int point) {
+	if (token == FNCALL_TOKEN) {
+		addToWorkList(state, getCompactUShort(state, point) | FUNCTION_ENTRY_FLAG);
+		point=recordUnit(state, point, UNIT_ADDRESS);
+	} else {
+		point=recordUnit(state, point, UNIT_USHORT);
+	}
+	unsigned short i, numberArgs=getCompactUShort(state, point), numberValues=0;
+	point=recordUnit(state, point, UNIT_USHORT);
+	for (i=0;i<numberArgs;i++) {
+		if (getCompactUShort(state, point) == VALUE_ARGUMENT_SLOT) numberValues++;
+		point=recordUnit(state, point, UNIT_USHORT);
+	}
+	// The expressions of the arguments passed by value follow the slots
+	for (i=0;i<numberValues;i++) point=discoverExpression(state, point);
+	return point;
+}
+
+static unsigned int discoverNativeCall(struct predecode_state * state, unsigned int point) {
+	point=recordUnit(state, point, UNIT_BYTE);
+	unsigned short i, numberArgs=getCompactUShort(state, point);
+	point=recordUnit(state, point, UNIT_USHORT);
+	for (i=0;i<numberArgs;i++) point=discoverExpression(state, point);
+	return point;
+}
+
+static unsigned int discoverArrayIndexes(struct predecode_state * state, unsigned int point) {
+	unsigned char i, numberIndexes=(unsigned char) state->code[point];
+	point=recordUnit(state, point, UNIT_BYTE);
+	for (i=0;i<numberIndexes;i++) point=discoverExpression(state, point);
+	return point;
+}
+
+/**
+ * Records the kind of the unit at some location and returns the location after it in the compact code
+ */
+static unsigned int recordUnit(struct predecode_state * state, unsigned int point, unsigned char kind) {
+	if (point >= state->length) {
+		fprintf(stderr, "Byte code is malformed, a unit at %d is beyond the end of the code\n", point);
+		exit(EXIT_FAILURE);
+	}
+	state->unitKinds[point]=kind;
+	if (kind == UNIT_BYTE) return point+sizeof(unsigned char);
+	if (kind == UNIT_WORD) return point+sizeof(int);
+	if (kind == UNIT_STRING) return point+strlen(&state->code[point])+1;
+	return point+sizeof(unsigned short);
+}
+
+static void addToWorkList(struct predecode_state * state, unsigned int entry) {
+	if ((entry & ~FUNCTION_ENTRY_FLAG) < state->length) state->workList[state->workListSize++]=entry;
+}
+
+/**
+ * The size of a unit in the predecoded code, each is a word apart from strings which are padded to a whole number of words
+ */
+static unsigned int getPredecodedUnitSize(struct predecode_state * state, unsigned int point) {
+	if (state->unitKinds[point] == 0) return 0;
+	if (state->unitKinds[point] == UNIT_STRING) {
+		return ((strlen(&state->code[point])+PREDECODED_WORD_SIZE)/PREDECODED_WORD_SIZE)*PREDECODED_WORD_SIZE;
+	}
+	return PREDECODED_WORD_SIZE;
+}
+
+/**
+ * Writes a unit into the predecoded code, single byte units are in the first byte of their word. Addresses and the locations that
+ * block lengths lead to are translated into their locations in the predecoded code
+ */
+static void emitUnit(struct predecode_state * state, unsigned int * locations, char * predecoded, unsigned int point) {
+	char * target=&predecoded[locations[point]];
+	unsigned int word;
+	switch (state->unitKinds[point]) {
+	case UNIT_BYTE:
+		*target=state->code[point];
+		return;
+	case UNIT_WORD:
+		memcpy(target, &state->code[point], sizeof(int));
+		return;
+	case UNIT_STRING:
+		strcpy(target, &state->code[point]);
+		return;
+	case UNIT_USHORT:
+		word=getCompactUShort(state, point);
+		break;
+	case UNIT_ADDRESS:
+		word=getPredecodedLocation(state, locations, getCompactUShort(state, point));
+		break;
+	case UNIT_BLOCK_LENGTH:
+		word=getPredecodedLocation(state, locations, point+sizeof(unsigned short)+getCompactUShort(state, point));
+		break;
+	default:
+		word=getPredecodedLocation(state, locations, point+sizeof(unsigned short)+getCompactUShort(state, point)+LOOP_GOTO_SIZE);
+		break;
+	}
+	memcpy(target, &word, sizeof(unsigned int));
+}
+
+static unsigned int getPredecodedLocation(struct predecode_state * state, unsigned int * locations, unsigned int point) {
+	if (point > state->length) {
+		fprintf(stderr, "Byte code is malformed, the location %d is beyond the end of the code\n", point);
+		exit(EXIT_FAILURE);
+	}
+	return locations[point];
+}
+
+static unsigned short getCompactUShort(struct predecode_state * state, unsigned int point) {
+	unsigned short v;
+	memcpy(&v, &state->code[point], sizeof(unsigned short));
+	return v;
+}
+
+/**
+ * Whether a token is an operator with two operands which directly follow it, comparisons as well as arithmetic
+ */
+static int isBinaryOperatorToken(unsigned char token) {
+	return (token >= EQ_TOKEN && token <= GEQ_TOKEN) || token == IS_TOKEN || isArithmeticToken(token) ||
+			(token >= INT_EQ_TOKEN && token <= REAL_GEQ_TOKEN);
+}
+
+static int isArithmeticToken(unsigned char token) {
+	return (token >= ADD_TOKEN && token <= MOD_TOKEN) || token == POW_TOKEN || (token >= INT_ADD_TOKEN && token <= REAL_DIV_TOKEN);
+}
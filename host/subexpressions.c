@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Common subexpression elimination pass. Within each basic block an array element read or arithmetic which is computed again,
+ * with none of the variables or array elements it reads having been written in between, is computed once. The first
+ * computation stores the value into a new global slot as it is evaluated and later ones read that slot instead. This is aimed
+ * at stencil codes, where the same elements and index expressions appear in several statements of a loop body, and a reused
+ * index being a variable also means the access is written as a single index superinstruction.
+ *
+ * A call might run this same block again (overwriting the slots), so any call or native function forgets everything known.
+ * As arguments are passed by reference a write to a global or argument forgets all values read from globals or arguments
+ */
+
+#include <stdlib.h>
+#include "subexpressions.h"
+#include "basictokens.h"
+
+// Least cost, in expression nodes, of a value for it to be worth holding in a slot. An array access counts as two nodes and
+// one whose index a superinstruction reads directly as only those two, as the store and load of the slot cost more than it
+#define MIN_REUSED_COST 4
+
+// A value computed earlier in the block, the node where it is computed and the slot it is held in (-1 until it is reused)
+struct available_value {
+	struct ir_expression * value, * definition;
+	int slot;
+};
+
+struct subexpression_state {
+	struct ir_program * program;
+	struct ir_function * function;
+	int numberAvailable, availableCapacity, numberTemporaries, usedTemporaries;
+	struct available_value * available;
+	int * temporarySlots; // Slots created by this pass, each block uses them afresh
+};
+
+static void eliminateInBlock(struct subexpression_state*, struct ir_block*);
+static void eliminateInExpression(struct subexpression_state*, struct ir_expression**, int, int);
+static int getReuseCost(struct ir_expression*);
+static int findAvailableValue(struct subexpression_state*, struct ir_expression*);
+static void addAvailableValue(struct subexpression_state*, struct ir_expression*);
+static int holdAvailableValue(struct subexpression_state*, struct available_value*);
+static int getTemporarySlot(struct subexpression_state*);
+static void forgetStatementWrites(struct subexpression_state*, struct ir_statement*);
+static void forgetSlot(struct subexpression_state*, unsigned short);
+static void forgetArrayReads(struct subexpression_state*);
+static void forgetAvailableValue(struct subexpression_state*, int);
+static void forgetAll(struct subexpression_state*);
+static int isSlotAliased(struct subexpression_state*, unsigned short);
+static int readsSlot(struct subexpression_state*, struct ir_expression*, unsigned short, int);
+static int readsArray(struct ir_expression*);
+
+/**
+ * Eliminates common subexpressions within every block of the program
+ */
+void eliminateCommonSubexpressions(struct ir_program * program) {
+	struct subexpression_state state;
+	struct ir_function * function;
+	struct ir_block * block;
+	state.program=program;
+	state.numberAvailable=0;
+	state.availableCapacity=0;
+	state.available=NULL;
+	state.numberTemporaries=0;
+	state.temporarySlots=NULL;
+	for (function=program->functions;function != NULL;function=function->next) {
+		state.function=function;
+		for (block=function->blocks;block != NULL;block=block->next) eliminateInBlock(&state, block);
+	}
+	free(state.available);
+	free(state.temporarySlots);
+}
+
+/**
+ * Works through the statements of a block in the order they run, each expression in the order it is evaluated. A condition
+ * is tested directly by the interpreter rather than evaluated as a value, so is left as it is (its operands are not.) The range
+ * of a loop is read again on each iteration, after its body has run, so is left alone
+ */
+static void eliminateInBlock(struct subexpression_state * state, struct ir_block * block) {
+	int i;
+	struct ir_statement * statement;
+	state->usedTemporaries=0;
+	for (statement=block->statements;statement != NULL;statement=statement->next) {
+		if (statement->token == FOR_TOKEN || statement->token == FOR_RANGE_TOKEN) {
+			forgetAll(state);
+			continue;
+		}
+		int hasCondition=statement->token == IF_TOKEN || statement->token == IFELSE_TOKEN || statement->token == CMP_JUMP_TOKEN;
+		for (i=0;i<statement->numberExpressions;i++) {
+			eliminateInExpression(state, &statement->expressions[i], hasCondition && i == 0, 1);
+		}
+		forgetStatementWrites(state, statement);
+	}
+	forgetAll(state);
+}
+
+/**
+ * Replaces an expression by the slot holding its value if it has already been computed, otherwise works through its operands
+ * and then makes it available. Where an operand might not be evaluated (the second of an and or or) it is not made available
+ */
+static void eliminateInExpression(struct subexpression_state * state, struct ir_expression ** location, int isCondition,
+		int isEvaluated) {
+	int i;
+	struct ir_expression * expression=*location;
+	if (!isCondition && getReuseCost(expression) >= MIN_REUSED_COST) {
+		int index=findAvailableValue(state, expression);
+		if (index >= 0 && holdAvailableValue(state, &state->available[index])) {
+			*location=createIRExpression(LOAD_SLOT_TOKEN, 0);
+			(*location)->slot=(unsigned short) state->available[index].slot;
+			freeIRExpression(expression);
+			return;
+		}
+	}
+	if (expression->token == AND_TOKEN || expression->token == OR_TOKEN) {
+		eliminateInExpression(state, &expression->children[0], 1, isEvaluated);
+		eliminateInExpression(state, &expression->children[1], 1, 0);
+	} else {
+		for (i=0;i<expression->numberChildren;i++) {
+			eliminateInExpression(state, &expression->children[i], expression->token == NOT_TOKEN, isEvaluated);
+		}
+	}
+	if (expression->token == STORE_SLOT_TOKEN) {
+		forgetSlot(state, expression->slot);
+	} else if (expression->token == FNCALL_TOKEN || expression->token == FNCALL_BY_VAR_TOKEN || expression->token == NATIVE_TOKEN) {
+		forgetAll(state);
+	} else if (!isCondition && isEvaluated && getReuseCost(expression) >= MIN_REUSED_COST) {
+		addAvailableValue(state, expression);
+	}
+}
+
+/**
+ * The cost of computing an expression which may be reused, or -1 if it may not. This is arithmetic and array element reads
+ * on variables and literals, apart from generic addition as that might concatenate strings and so give a new one each time
+ */
+static int getReuseCost(struct ir_expression * expression) {
+	int i, cost, childCost;
+	unsigned char token=expression->token;
+	if (token == LOAD_SLOT_TOKEN || token == INTEGER_TOKEN || token == REAL_TOKEN || token == BOOLEAN_TOKEN) return 1;
+	if (token == ARRAYACCESS_TOKEN || token == ARRAYACCESS_1D_TOKEN) {
+		if (expression->numberChildren == 1 && isDirectIndexExpression(expression->children[0])) return 2;
+		cost=2;
+	} else if (isArithmeticExpression(expression) && token != ADD_TOKEN) {
+		cost=1;
+	} else {
+		return -1;
+	}
+	for (i=0;i<expression->numberChildren;i++) {
+		childCost=getReuseCost(expression->children[i]);
+		if (childCost < 0) return -1;
+		cost+=childCost;
+	}
+	return cost;
+}
+
+static int findAvailableValue(struct subexpression_state * state, struct ir_expression * expression) {
+	int i;
+	for (i=0;i<state->numberAvailable;i++) {
+		if (isSameIRExpression(state->available[i].value, expression)) return i;
+	}
+	return -1;
+}
+
+/**
+ * Makes a value which has just been computed available, a copy is kept as the expression itself may be changed if one of its
+ * operands is reused later on
+ */
+static void addAvailableValue(struct subexpression_state * state, struct ir_expression * expression) {
+	if (findAvailableValue(state, expression) >= 0) return;
+	if (state->numberAvailable == state->availableCapacity) {
+		state->availableCapacity=state->availableCapacity == 0 ? 16 : state->availableCapacity*2;
+		state->available=(struct available_value*) realloc(state->available, sizeof(struct available_value) * state->availableCapacity);
+	}
+	state->available[state->numberAvailable].value=copyIRExpression(expression);
+	state->available[state->numberAvailable].definition=expression;
+	state->available[state->numberAvailable].slot=-1;
+	state->numberAvailable++;
+}
+
+/**
+ * Holds an available value in a slot, if it is not already, by turning the node where it is computed into a store of it which
+ * also gives the value. Returns whether the value is held, which it can not be if there are no more slots
+ */
+static int holdAvailableValue(struct subexpression_state * state, struct available_value * available) {
+	if (available->slot >= 0) return 1;
+	int slot=getTemporarySlot(state);
+	if (slot < 0) return 0;
+	struct ir_expression * definition=available->definition, * computed=createIRExpression(0, 0);
+	*computed=*definition;
+	definition->token=STORE_SLOT_TOKEN;
+	definition->code=0;
+	definition->slot=(unsigned short) slot;
+	definition->literal.integer=0;
+	definition->string=NULL;
+	definition->function=NULL;
+	definition->numberArguments=0;
+	definition->argumentSlots=NULL;
+	definition->numberChildren=2;
+	definition->children=(struct ir_expression**) malloc(sizeof(struct ir_expression*) * 2);
+	definition->children[0]=computed;
+	definition->children[1]=createIRExpression(LOAD_SLOT_TOKEN, 0);
+	definition->children[1]->slot=(unsigned short) slot;
+	available->slot=slot;
+	return 1;
+}
+
+static int getTemporarySlot(struct subexpression_state * state) {
+	if (state->usedTemporaries == state->numberTemporaries) {
+		int slot=createTemporarySlot(state->program);
+		if (slot < 0) return -1;
+		state->temporarySlots=(int*) realloc(state->temporarySlots, sizeof(int) * (state->numberTemporaries+1));
+		state->temporarySlots[state->numberTemporaries++]=slot;
+	}
+	return state->temporarySlots[state->usedTemporaries++];
+}
+
+/**
+ * Forgets the values which a statement may change once it has run, calls forget everything
+ */
+static void forgetStatementWrites(struct subexpression_state * state, struct ir_statement * statement) {
+	switch (statement->token) {
+	case STORE_SLOT_TOKEN:
+	case LETNOALIAS_TOKEN:
+	case OP_ASSIGN_TOKEN:
+	case INC_SLOT_TOKEN:
+		forgetSlot(state, statement->slot);
+		break;
+	case ARRAYSET_TOKEN:
+	case ARRAYSET_1D_TOKEN:
+		forgetArrayReads(state);
+		break;
+	case FNCALL_TOKEN:
+	case FNCALL_BY_VAR_TOKEN:
+	case NATIVE_TOKEN:
+		forgetAll(state);
+		break;
+	}
+}
+
+/**
+ * Forgets the values reading a slot which has been written, which if the slot might be aliased (it is a global or an argument)
+ * is all those reading a global or an argument
+ */
+static void forgetSlot(struct subexpression_state * state, unsigned short slot) {
+	int i, aliased=isSlotAliased(state, slot);
+	for (i=state->numberAvailable-1;i>=0;i--) {
+		if (readsSlot(state, state->available[i].value, slot, aliased)) forgetAvailableValue(state, i);
+	}
+}
+
+/**
+ * Forgets the values reading any array element, as arrays may be shared between variables an element written via one is
+ * not necessarily read via the same variable
+ */
+static void forgetArrayReads(struct subexpression_state * state) {
+	int i;
+	for (i=state->numberAvailable-1;i>=0;i--) {
+		if (readsArray(state->available[i].value)) forgetAvailableValue(state, i);
+	}
+}
+
+static void forgetAvailableValue(struct subexpression_state * state, int index) {
+	freeIRExpression(state->available[index].value);
+	state->available[index]=state->available[--state->numberAvailable];
+}
+
+static void forgetAll(struct subexpression_state * state) {
+	while (state->numberAvailable > 0) forgetAvailableValue(state, state->numberAvailable-1);
+}
+
+static int isSlotAliased(struct subexpression_state * state, unsigned short slot) {
+	int i;
+	if (!(slot & LOCAL_SLOT_FLAG)) return 1;
+	for (i=0;i<state->function->numberArguments;i++) {
+		if (state->function->argumentSlots[i] == slot) return 1;
+	}
+	return 0;
+}
+
+/**
+ * Whether an expression reads a slot, or any slot which might be aliased if that is set
+ */
+static int readsSlot(struct subexpression_state * state, struct ir_expression * expression, unsigned short slot, int aliased) {
+	int i;
+	if (expression->token == LOAD_SLOT_TOKEN || expression->token == ARRAYACCESS_TOKEN || expression->token == ARRAYACCESS_1D_TOKEN) {
+		if (expression->slot == slot || (aliased && isSlotAliased(state, expression->slot))) return 1;
+	}
+	for (i=0;i<expression->numberChildren;i++) {
+		if (readsSlot(state, expression->children[i], slot, aliased)) return 1;
+	}
+	return 0;
+}
+
+static int readsArray(struct ir_expression * expression) {
+	int i;
+	if (expression->token == ARRAYACCESS_TOKEN || expression->token == ARRAYACCESS_1D_TOKEN) return 1;
+	for (i=0;i<expression->numberChildren;i++) {
+		if (readsArray(expression->children[i])) return 1;
+	}
+	return 0;
+}
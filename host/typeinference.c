@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Type inference pass of the optimiser. For each function this works out, at every point, which variables are known to hold
+ * an integer or a real by following the assignments made along every path of the control flow (a variable is only known where
+ * all paths leading there agree on its type.) Arithmetic and comparisons whose operands are then known to be both integers or
+ * both reals are written out as the quickened operators, so the interpreter runs them directly from the start rather than first
+ * dispatching on the types, and an integer literal against a real is written as a real so that it needs no promotion. The
+ * interpreter still checks the types of a quickened operator, so anything not proven is just left generic. As a quickened
+ * operator is only written where its types have been proven, if this pass is run again it also takes these as known
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "typeinference.h"
+#include "basictokens.h"
+
+// What is known about the type of a variable
+#define TYPE_UNKNOWN 0
+#define TYPE_INT 1
+#define TYPE_REAL 2
+
+// The types of the variables of a function (globals followed by locals) at some point
+struct type_state {
+	unsigned char * types;
+	int numberGlobals, numberSlots;
+	unsigned char * isArgument;
+};
+
+static void inferFunctionTypes(struct ir_function*, unsigned short);
+static int mergeTypes(unsigned char*, unsigned char*, int, int);
+static void transferBlock(struct ir_block*, struct type_state*, int);
+static void transferStatement(struct ir_statement*, struct type_state*, int);
+static void applyExpressionEffects(struct ir_expression*, struct type_state*);
+static void forgetCallTypes(struct type_state*, unsigned short, unsigned short*);
+static void setSlotType(struct type_state*, unsigned short, unsigned char);
+static unsigned char getSlotType(struct type_state*, unsigned short);
+static int getSlotIndex(struct type_state*, unsigned short);
+static unsigned char getExpressionType(struct ir_expression*, struct type_state*);
+static unsigned char getStoreExpressionType(struct ir_expression*, struct type_state*, int);
+static unsigned char getArithmeticType(unsigned char, unsigned char);
+static unsigned char specialiseExpression(struct ir_expression*, struct type_state*);
+static unsigned char getSpecialisedOperator(unsigned char, struct ir_expression*, unsigned char, struct ir_expression*, unsigned char);
+static void specialiseIncrement(struct ir_statement*, struct type_state*);
+static void promoteLiteral(struct ir_expression*);
+
+/**
+ * Infers the types of variables throughout each function and specialises the operators which this proves the types of
+ */
+void inferTypes(struct ir_program * program) {
+	struct ir_function * function;
+	for (function=program->functions;function != NULL;function=function->next) inferFunctionTypes(function, program->numberGlobals);
+}
+
+/**
+ * Works out the types of the variables on entry to each block of a function, iterating over the blocks until nothing changes,
+ * and then specialises each block's statements given these. On entry to the function nothing is known
+ */
+static void inferFunctionTypes(struct ir_function * function, unsigned short numberGlobals) {
+	int i, numberBlocks=0, changed=1;
+	struct ir_block * block;
+	struct type_state state;
+	for (block=function->blocks;block != NULL;block=block->next) block->location=numberBlocks++;
+	state.numberGlobals=numberGlobals;
+	state.numberSlots=numberGlobals+function->numberLocals;
+	if (state.numberSlots == 0) return;
+	state.types=(unsigned char*) malloc(state.numberSlots);
+	state.isArgument=(unsigned char*) calloc(state.numberSlots, sizeof(unsigned char));
+	for (i=0;i<function->numberArguments;i++) {
+		int index=getSlotIndex(&state, function->argumentSlots[i]);
+		if (index >= 0) state.isArgument[index]=1;
+	}
+	unsigned char * entryTypes=(unsigned char*) calloc(numberBlocks * state.numberSlots, sizeof(unsigned char));
+	unsigned char * reached=(unsigned char*) calloc(numberBlocks, sizeof(unsigned char));
+	reached[0]=1;
+	while (changed) {
+		changed=0;
+		for (block=function->blocks;block != NULL;block=block->next) {
+			if (!reached[block->location]) continue;
+			memcpy(state.types, &entryTypes[block->location * state.numberSlots], state.numberSlots);
+			transferBlock(block, &state, 0);
+			struct ir_statement * last=getLastStatement(block);
+			int numberSuccessors=last != NULL ? last->numberTargets : 0;
+			for (i=-1;i<numberSuccessors;i++) {
+				struct ir_block * successor=i < 0 ? block->fallthrough : last->targets[i];
+				if (successor == NULL) continue;
+				changed|=mergeTypes(&entryTypes[successor->location * state.numberSlots], state.types, state.numberSlots,
+						!reached[successor->location]);
+				reached[successor->location]=1;
+			}
+		}
+	}
+	for (block=function->blocks;block != NULL;block=block->next) {
+		if (!reached[block->location]) continue;
+		memcpy(state.types, &entryTypes[block->location * state.numberSlots], state.numberSlots);
+		transferBlock(block, &state, 1);
+	}
+	free(entryTypes);
+	free(reached);
+	free(state.types);
+	free(state.isArgument);
+}
+
+/**
+ * Merges the types at the end of a block into those on entry to one it leads to, where these disagree nothing is known. Returns
+ * whether the entry types have changed
+ */
+static int mergeTypes(unsigned char * entryTypes, unsigned char * types, int numberSlots, int isFirst) {
+	int i, changed=0;
+	if (isFirst) {
+		memcpy(entryTypes, types, numberSlots);
+		return 1;
+	}
+	for (i=0;i<numberSlots;i++) {
+		if (entryTypes[i] != TYPE_UNKNOWN && entryTypes[i] != types[i]) {
+			entryTypes[i]=TYPE_UNKNOWN;
+			changed=1;
+		}
+	}
+	return changed;
+}
+
+static void transferBlock(struct ir_block * block, struct type_state * state, int specialise) {
+	struct ir_statement * statement;
+	for (statement=block->statements;statement != NULL;statement=statement->next) transferStatement(statement, state, specialise);
+}
+
+/**
+ * Updates the types given the effect of a statement, first specialising it if required. The assignments and calls within its
+ * expressions are applied before anything that they read is typed, which can only lose what is known so is always safe
+ */
+static void transferStatement(struct ir_statement * statement, struct type_state * state, int specialise) {
+	int i;
+	unsigned char token=statement->token, type=TYPE_UNKNOWN;
+	for (i=0;i<statement->numberExpressions;i++) applyExpressionEffects(statement->expressions[i], state);
+	if (specialise) {
+		for (i=0;i<statement->numberExpressions;i++) specialiseExpression(statement->expressions[i], state);
+		if (token == OP_ASSIGN_TOKEN) {
+			statement->code=getSpecialisedOperator(statement->code, NULL, getSlotType(state, statement->slot),
+					statement->expressions[0], getExpressionType(statement->expressions[0], state));
+		} else if (token == INC_SLOT_TOKEN) {
+			specialiseIncrement(statement, state);
+			token=statement->token;
+		}
+	}
+	if (token == STORE_SLOT_TOKEN) {
+		type=getExpressionType(statement->expressions[0], state);
+	} else if (token == OP_ASSIGN_TOKEN) {
+		type=getArithmeticType(getSlotType(state, statement->slot), getExpressionType(statement->expressions[0], state));
+	} else if (token == INC_SLOT_TOKEN) {
+		type=getArithmeticType(getSlotType(state, statement->slot), TYPE_INT);
+	} else if (token == FNCALL_TOKEN || token == FNCALL_BY_VAR_TOKEN) {
+		forgetCallTypes(state, statement->numberArguments, statement->argumentSlots);
+	} else if (token == FOR_RANGE_TOKEN) {
+		// The loop variable is set to the counter, which then moves on by the step, only if the body is entered so each keeps
+		// its type on leaving the loop only if this is the same as it is given on entering the body
+		unsigned char counterType=getSlotType(state, statement->secondSlot);
+		unsigned char steppedType=getArithmeticType(counterType, getSlotType(state, statement->stepSlot));
+		setSlotType(state, statement->slot, getSlotType(state, statement->slot) == counterType ? counterType : TYPE_UNKNOWN);
+		setSlotType(state, statement->secondSlot, steppedType == counterType ? counterType : TYPE_UNKNOWN);
+	}
+	// A default argument's assignment only happens if the argument was not passed, so its type is not known afterwards
+	if (token == STORE_SLOT_TOKEN || token == LETNOALIAS_TOKEN || token == OP_ASSIGN_TOKEN || token == INC_SLOT_TOKEN ||
+			token == ARRAYSET_TOKEN || token == ARRAYSET_1D_TOKEN || token == FOR_TOKEN) {
+		setSlotType(state, statement->slot, type);
+		if (token == FOR_TOKEN) setSlotType(state, statement->secondSlot, TYPE_UNKNOWN);
+	}
+}
+
+/**
+ * Forgets the types of variables assigned within an expression and those which any function it calls might assign
+ */
+static void applyExpressionEffects(struct ir_expression * expression, struct type_state * state) {
+	int i;
+	if (expression->token == STORE_SLOT_TOKEN) setSlotType(state, expression->slot, TYPE_UNKNOWN);
+	if (expression->token == FNCALL_TOKEN || expression->token == FNCALL_BY_VAR_TOKEN) {
+		forgetCallTypes(state, expression->numberArguments, expression->argumentSlots);
+	}
+	for (i=0;i<expression->numberChildren;i++) applyExpressionEffects(expression->children[i], state);
+}
+
+/**
+ * A function call might assign any global and, as arguments are passed by reference, any variable passed to it
+ */
+static void forgetCallTypes(struct type_state * state, unsigned short numberArguments, unsigned short * argumentSlots) {
+	int i;
+	memset(state->types, TYPE_UNKNOWN, state->numberGlobals);
+	for (i=0;i<numberArguments;i++) setSlotType(state, argumentSlots[i], TYPE_UNKNOWN);
+}
+
+/**
+ * Sets the type of a variable. The function's own arguments are never known, as they refer to the caller's variables which may
+ * be assigned under another name, and for the same reason assigning one of them forgets the type of every global
+ */
+static void setSlotType(struct type_state * state, unsigned short slot, unsigned char type) {
+	int index=getSlotIndex(state, slot);
+	if (index < 0) return;
+	if (state->isArgument[index]) {
+		memset(state->types, TYPE_UNKNOWN, state->numberGlobals);
+		type=TYPE_UNKNOWN;
+	}
+	state->types[index]=type;
+}
+
+static unsigned char getSlotType(struct type_state * state, unsigned short slot) {
+	int index=getSlotIndex(state, slot);
+	return index < 0 ? TYPE_UNKNOWN : state->types[index];
+}
+
+/**
+ * Gets where a variable is held in the state, globals are first followed by the function's locals. -1 if it is neither
+ */
+static int getSlotIndex(struct type_state * state, unsigned short slot) {
+	int index=slot & LOCAL_SLOT_FLAG ? state->numberGlobals + (slot & ~LOCAL_SLOT_FLAG) : slot;
+	if (!(slot & LOCAL_SLOT_FLAG) && slot >= state->numberGlobals) return -1;
+	return index < state->numberSlots ? index : -1;
+}
+
+/**
+ * Gets the type of the value of an expression, or unknown if it is anything other than an integer or real that is certain
+ */
+static unsigned char getExpressionType(struct ir_expression * expression, struct type_state * state) {
+	if (expression->token == INTEGER_TOKEN) return TYPE_INT;
+	if (expression->token == REAL_TOKEN) return TYPE_REAL;
+	if (expression->token == LOAD_SLOT_TOKEN) return getSlotType(state, expression->slot);
+	if (expression->token == STORE_SLOT_TOKEN) return getStoreExpressionType(expression, state, 0);
+	if (expression->token >= INT_ADD_TOKEN && expression->token <= INT_DIV_TOKEN) return TYPE_INT;
+	if (expression->token >= REAL_ADD_TOKEN && expression->token <= REAL_DIV_TOKEN) return TYPE_REAL;
+	if (expression->token == NATIVE_TOKEN && (expression->code == NATIVE_FN_RTL_NUMCORES || expression->code == NATIVE_FN_RTL_COREID)) {
+		return TYPE_INT;
+	}
+	if (isArithmeticExpression(expression)) {
+		return getArithmeticType(getExpressionType(expression->children[0], state), getExpressionType(expression->children[1], state));
+	}
+	return TYPE_UNKNOWN;
+}
+
+/**
+ * Gets the type of an assignment within an expression, which is that of the expression following it, specialising both if
+ * required. If the following expression neither calls nor assigns anything then the variable assigned is known to hold the
+ * value assigned throughout it
+ */
+static unsigned char getStoreExpressionType(struct ir_expression * expression, struct type_state * state, int specialise) {
+	int index=getSlotIndex(state, expression->slot);
+	unsigned char type;
+	if (specialise) specialiseExpression(expression->children[0], state);
+	if (index < 0 || state->isArgument[index] || !isExpressionPure(expression->children[1])) {
+		if (specialise) specialiseExpression(expression->children[1], state);
+		return getExpressionType(expression->children[1], state);
+	}
+	unsigned char previousType=state->types[index];
+	state->types[index]=getExpressionType(expression->children[0], state);
+	if (specialise) specialiseExpression(expression->children[1], state);
+	type=getExpressionType(expression->children[1], state);
+	state->types[index]=previousType;
+	return type;
+}
+
+/**
+ * The type of the result of arithmetic, as in the interpreter two integers give an integer and otherwise a real is raised to
+ */
+static unsigned char getArithmeticType(unsigned char type1, unsigned char type2) {
+	if (type1 == TYPE_UNKNOWN || type2 == TYPE_UNKNOWN) return TYPE_UNKNOWN;
+	return type1 == TYPE_INT && type2 == TYPE_INT ? TYPE_INT : TYPE_REAL;
+}
+
+/**
+ * Specialises the operators throughout an expression given the types of its operands, returning its type
+ */
+static unsigned char specialiseExpression(struct ir_expression * expression, struct type_state * state) {
+	int i;
+	unsigned char operator=getGenericOperator(expression->token);
+	if (expression->token == STORE_SLOT_TOKEN) return getStoreExpressionType(expression, state, 1);
+	for (i=0;i<expression->numberChildren;i++) specialiseExpression(expression->children[i], state);
+	if ((operator >= ADD_TOKEN && operator <= DIV_TOKEN) || (operator >= EQ_TOKEN && operator <= GEQ_TOKEN)) {
+		struct ir_expression * first=expression->children[0], * second=expression->children[1];
+		expression->token=getSpecialisedOperator(expression->token, first, getExpressionType(first, state), second,
+				getExpressionType(second, state));
+	}
+	return getExpressionType(expression, state);
+}
+
+/**
+ * Gets the quickened variant of an arithmetic or comparison operator whose operands are both integers or both reals, otherwise
+ * the operator is left as it is. An integer literal operand against a real is made a real literal, as the interpreter would
+ * raise it to be anyway. A NULL operand is a variable which can not be changed
+ */
+static unsigned char getSpecialisedOperator(unsigned char token, struct ir_expression * first, unsigned char type1,
+		struct ir_expression * second, unsigned char type2) {
+	unsigned char operator=getGenericOperator(token);
+	if (!((operator >= ADD_TOKEN && operator <= DIV_TOKEN) || (operator >= EQ_TOKEN && operator <= GEQ_TOKEN))) return token;
+	if (type1 == TYPE_REAL && second != NULL && second->token == INTEGER_TOKEN) {
+		promoteLiteral(second);
+		type2=TYPE_REAL;
+	}
+	if (type2 == TYPE_REAL && first != NULL && first->token == INTEGER_TOKEN) {
+		promoteLiteral(first);
+		type1=TYPE_REAL;
+	}
+	if (type1 != type2 || type1 == TYPE_UNKNOWN) return token;
+	if (operator >= EQ_TOKEN && operator <= GEQ_TOKEN) {
+		return (type1 == TYPE_INT ? INT_EQ_TOKEN : REAL_EQ_TOKEN) + (operator-EQ_TOKEN);
+	}
+	return (type1 == TYPE_INT ? INT_ADD_TOKEN : REAL_ADD_TOKEN) + (operator-ADD_TOKEN);
+}
+
+/**
+ * Incrementing a variable known to be a real is done as a quickened assignment of a real literal, rather than the increment
+ * falling back to generic arithmetic every time it runs
+ */
+static void specialiseIncrement(struct ir_statement * statement, struct type_state * state) {
+	if (getSlotType(state, statement->slot) != TYPE_REAL) return;
+	struct ir_expression * delta=createIRExpression(REAL_TOKEN, 0);
+	delta->literal.real=(float) statement->integer;
+	statement->token=OP_ASSIGN_TOKEN;
+	statement->code=statement->code == ADD_TOKEN ? REAL_ADD_TOKEN : REAL_SUB_TOKEN;
+	statement->numberExpressions=1;
+	statement->expressions=(struct ir_expression**) malloc(sizeof(struct ir_expression*));
+	statement->expressions[0]=delta;
+}
+
+static void promoteLiteral(struct ir_expression * expression) {
+	expression->token=REAL_TOKEN;
+	expression->literal.real=(float) expression->literal.integer;
+}
@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Verifies the assembled byte code before it is run, whatever the interpreter was built with, so that one built with
+ * INTERPRETER_UNCHECKED can leave out the checks that each instruction makes sense as it runs. Every statement which can be reached is walked, from the main code and
+ * into each function which may be called, proving that tokens are known, units lie within the code and never overlap, jumps
+ * land on a statement of the same function and calls on a function header, variable slots lie within the globals or the frame
+ * of the function, native functions are passed as many arguments as they take, arrays are accessed with a number of indexes
+ * that the interpreter can hold and the operand stack of every postfix expression balances within its depth. What depends on
+ * the values at runtime, such as array bounds, can not be proved here and so is left to the program
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "verifier.h"
+#include "memorymanager.h"
+#include "basictokens.h"
+
+// The kind of each byte of the code, the first byte of a statement or of a function header and any other byte of a unit
+#define UNIT_STATEMENT 1
+#define UNIT_FUNCTION 2
+#define UNIT_OPERAND 3
+
+// The owner of the statements of the main code, no function header can be at the start of the code as the program header is
+#define MAIN_CODE_OWNER 0
+
+// A loop's block length also skips over the goto at the end of its block
+#define LOOP_GOTO_SIZE (sizeof(unsigned char)+sizeof(unsigned short))
+
+// The interpreter holds the indexes of an array access in a fixed array of this size, as arrays have at most this many dimensions
+#define MAX_ARRAY_INDEXES 0xF
+
+// The code being verified, the kind of each byte and the function (by the location of its header) that each statement belongs
+// to. The work list holds the statements of the current function still to be walked and functions those still to be verified
+struct verify_state {
+	char * code;
+	unsigned int length, workListSize, numberFunctions, function;
+	unsigned short numberGlobals, numberLocals;
+	unsigned char * unitKinds;
+	unsigned int * owners, * workList, * functions;
+};
+
+static void verifyFunction(struct verify_state*, unsigned int, int);
+static void verifyStatements(struct verify_state*, unsigned int);
+static unsigned int verifyStatement(struct verify_state*, unsigned int, int*);
+static unsigned int verifyExpression(struct verify_state*, unsigned int);
+static unsigned int verifyPostfixExpression(struct verify_state*, unsigned int, unsigned int);
+static unsigned int verifyFunctionCall(struct verify_state*, unsigned char, unsigned int);
+static unsigned short verifyFunctionAddress(struct verify_state*, unsigned int*);
+static unsigned int verifyNativeCall(struct verify_state*, unsigned int);
+static int getNativeFunctionArguments(unsigned char, unsigned short*, unsigned short*);
+static unsigned int verifyArrayIndexes(struct verify_state*, unsigned int, int);
+static unsigned int verifyBlockLength(struct verify_state*, unsigned int, unsigned int);
+static void verifySlot(struct verify_state*, unsigned int*);
+static void checkSlot(struct verify_state*, unsigned short, unsigned int);
+static unsigned char verifyUChar(struct verify_state*, unsigned int*);
+static unsigned short verifyUShort(struct verify_state*, unsigned int*);
+static unsigned int recordUnit(struct verify_state*, unsigned int, unsigned int, unsigned char);
+static void addJump(struct verify_state*, unsigned int, unsigned int);
+static unsigned short getCompactUShort(struct verify_state*, unsigned int);
+static int isBinaryOperatorToken(unsigned char);
+static int isArithmeticToken(unsigned char);
+static int isComparisonToken(unsigned char);
+static void malformedByteCode(char*, unsigned int);
+
+/**
+ * Verifies the assembled code, exiting with an error if anything is found that the interpreter can not safely run
+ */
+void verifyAssembledCode(void) {
+	struct verify_state state;
+	state.code=getAssembledCode();
+	state.length=getMemoryFilledSize();
+	state.unitKinds=(unsigned char*) calloc(state.length+1, sizeof(unsigned char));
+	state.owners=(unsigned int*) malloc(sizeof(unsigned int) * (state.length+1));
+	// Each unit adds at most one entry, so neither list can exceed the length of the code
+	state.workList=(unsigned int*) malloc(sizeof(unsigned int) * (state.length+1));
+	state.functions=(unsigned int*) malloc(sizeof(unsigned int) * (state.length+1));
+	state.workListSize=state.numberFunctions=0;
+
+	// The program header, which is the number of global slots, is followed by the main code which has no frame of its own
+	unsigned int i, point=0;
+	state.numberGlobals=verifyUShort(&state, &point);
+	verifyFunction(&state, point, 0);
+	for (i=0;i<state.numberFunctions;i++) verifyFunction(&state, state.functions[i], 1);
+
+	free(state.functions);
+	free(state.workList);
+	free(state.owners);
+	free(state.unitKinds);
+}
+
+/**
+ * Verifies a function (or the main code) by walking every statement reachable from its entry. The function header is the size
+ * of its frame, then the number of arguments and the slot of each
+ */
+static void verifyFunction(struct verify_state * state, unsigned int entry, int hasHeader) {
+	unsigned int point=entry;
+	state->function=hasHeader ? entry : MAIN_CODE_OWNER;
+	state->numberLocals=0;
+	if (hasHeader) {
+		if (state->unitKinds[entry] == UNIT_FUNCTION) return;
+		point=recordUnit(state, point, sizeof(unsigned short), UNIT_FUNCTION);
+		state->numberLocals=getCompactUShort(state, entry);
+		unsigned short i, numberArgs=verifyUShort(state, &point);
+		for (i=0;i<numberArgs;i++) {
+			// Parameters are always local, the flag marks those which the function assigns to
+			checkSlot(state, verifyUShort(state, &point) | LOCAL_SLOT_FLAG, point-sizeof(unsigned short));
+		}
+	}
+	state->workListSize=0;
+	addJump(state, point, entry);
+	while (state->workListSize > 0) verifyStatements(state, state->workList[--state->workListSize]);
+}
+
+/**
+ * Walks a run of statements until control can not fall through to the next statement, or the next statement has already been
+ * walked in which case it must belong to the same function
+ */
+static void verifyStatements(struct verify_state * state, unsigned int point) {
+	int fallsThrough=1;
+	while (fallsThrough && point < state->length) {
+		if (state->unitKinds[point] == UNIT_STATEMENT) {
+			if (state->owners[point] != state->function) malformedByteCode("control passes into another function", point);
+			return;
+		}
+		point=verifyStatement(state, point, &fallsThrough);
+	}
+}
+
+/**
+ * Verifies a single statement, adding any location it may jump to onto the work list, and returns the location after it
+ */
+static unsigned int verifyStatement(struct verify_state * state, unsigned int point, int * fallsThrough) {
+	unsigned int start=point;
+	unsigned char token=(unsigned char) state->code[point];
+	point=recordUnit(state, point, sizeof(unsigned char), UNIT_STATEMENT);
+	state->owners[start]=state->function;
+	switch (token) {
+	case STORE_SLOT_TOKEN:
+	case LETNOALIAS_TOKEN:
+		verifySlot(state, &point);
+		return verifyExpression(state, point);
+	case OP_ASSIGN_TOKEN:
+		verifySlot(state, &point);
+		if (!isArithmeticToken(verifyUChar(state, &point))) malformedByteCode("an assignment has an unknown operator", start);
+		return verifyExpression(state, point);
+	case INC_SLOT_TOKEN: {
+		verifySlot(state, &point);
+		unsigned char operator=verifyUChar(state, &point);
+		if (operator != ADD_TOKEN && operator != SUB_TOKEN) malformedByteCode("an increment has an unknown operator", start);
+		return recordUnit(state, point, sizeof(int), UNIT_OPERAND);
+	}
+	case ARRAYSET_TOKEN:
+	case ARRAYSET_1D_TOKEN:
+		verifySlot(state, &point);
+		point=verifyArrayIndexes(state, point, token == ARRAYSET_1D_TOKEN);
+		return verifyExpression(state, point);
+	case CMP_JUMP_TOKEN:
+		// The comparison and variable it starts with are read directly, the rest of the condition is as any other
+		if (point+sizeof(unsigned char) >= state->length || !isComparisonToken((unsigned char) state->code[point]) ||
+				state->code[point+sizeof(unsigned char)] != LOAD_SLOT_TOKEN) {
+			malformedByteCode("a fused comparison is not of a variable", start);
+		}
+		point=verifyExpression(state, point);
+		return verifyBlockLength(state, point, 0);
+	case IF_TOKEN:
+	case IFELSE_TOKEN:
+		point=verifyExpression(state, point);
+		return verifyBlockLength(state, point, 0);
+	case FOR_TOKEN:
+		verifySlot(state, &point);
+		verifySlot(state, &point);
+		point=verifyExpression(state, point);
+		return verifyBlockLength(state, point, LOOP_GOTO_SIZE);
+	case FOR_RANGE_TOKEN: {
+		// The loop variable, counter, stop and step
+		int i;
+		for (i=0;i<4;i++) verifySlot(state, &point);
+		return verifyBlockLength(state, point, LOOP_GOTO_SIZE);
+	}
+	case SWITCH_TOKEN: {
+		// The variable, number of arms and their constants, then the block length leading to each arm and to the else arm
+		unsigned short i, numberArms;
+		verifySlot(state, &point);
+		numberArms=verifyUShort(state, &point);
+		for (i=0;i<numberArms;i++) point=recordUnit(state, point, sizeof(int), UNIT_OPERAND);
+		for (i=0;i<=numberArms;i++) point=verifyBlockLength(state, point, 0);
+		*fallsThrough=0;
+		return point;
+	}
+	case GOTO_TOKEN: {
+		unsigned short target=verifyUShort(state, &point);
+		addJump(state, target, start);
+		*fallsThrough=0;
+		return point;
+	}
+	case FNCALL_TOKEN:
+	case FNCALL_BY_VAR_TOKEN:
+		return verifyFunctionCall(state, token, point);
+	case NATIVE_TOKEN:
+		return verifyNativeCall(state, point);
+	case RETURN_EXP_TOKEN:
+		*fallsThrough=0;
+		return verifyExpression(state, point);
+	case RETURN_TOKEN:
+	case STOP_TOKEN:
+		*fallsThrough=0;
+		return point;
+	}
+	malformedByteCode("a statement is unknown", start);
+	return point;
+}
+
+/**
+ * Verifies an expression and returns the location after it, conditions have the same layout as expressions
+ */
+static unsigned int verifyExpression(struct verify_state * state, unsigned int point) {
+	unsigned int start=point;
+	unsigned char token=verifyUChar(state, &point);
+	switch (token) {
+	case INTEGER_TOKEN:
+	case REAL_TOKEN:
+	case BOOLEAN_TOKEN:
+		return recordUnit(state, point, sizeof(int), UNIT_OPERAND);
+	case STRING_TOKEN: {
+		// The string is null terminated, which must be within the code
+		char * terminator=(char*) memchr(&state->code[point], '\0', point < state->length ? state->length-point : 0);
+		if (terminator == NULL) malformedByteCode("a string is not terminated", start);
+		return recordUnit(state, point, (terminator-&state->code[point])+1, UNIT_OPERAND);
+	}
+	case NONE_TOKEN:
+		return point;
+	case FN_ADDR_TOKEN:
+		verifyFunctionAddress(state, &point);
+		return point;
+	case LOAD_SLOT_TOKEN:
+		verifySlot(state, &point);
+		return point;
+	case STORE_SLOT_TOKEN:
+		// An assignment followed by the expression whose value is returned
+		verifySlot(state, &point);
+		point=verifyExpression(state, point);
+		return verifyExpression(state, point);
+	case ARRAY_TOKEN: {
+		int i, numberItems;
+		unsigned int itemsPoint=point;
+		point=recordUnit(state, point, sizeof(int), UNIT_OPERAND);
+		memcpy(&numberItems, &state->code[itemsPoint], sizeof(int));
+		if (numberItems < 0) malformedByteCode("an array literal has a negative number of items", start);
+		if (verifyUChar(state, &point)) point=verifyExpression(state, point);
+		for (i=0;i<numberItems;i++) point=verifyExpression(state, point);
+		return point;
+	}
+	case FNCALL_TOKEN:
+	case FNCALL_BY_VAR_TOKEN:
+		return verifyFunctionCall(state, token, point);
+	case NATIVE_TOKEN:
+		return verifyNativeCall(state, point);
+	case ARRAYACCESS_TOKEN:
+	case ARRAYACCESS_1D_TOKEN:
+		verifySlot(state, &point);
+		return verifyArrayIndexes(state, point, token == ARRAYACCESS_1D_TOKEN);
+	case ARRAYACCESS_OFFSET_TOKEN:
+		// The array, the integer variable and the constant added to it
+		verifySlot(state, &point);
+		verifySlot(state, &point);
+		return recordUnit(state, point, sizeof(int), UNIT_OPERAND);
+	case NOT_TOKEN:
+		return verifyExpression(state, point);
+	case AND_TOKEN:
+	case OR_TOKEN: {
+		// The first operand, then the length of the second which is branched over if the first decides the result
+		point=verifyExpression(state, point);
+		unsigned short secondLength=verifyUShort(state, &point);
+		unsigned int end=verifyExpression(state, point);
+		if (end != point+secondLength) malformedByteCode("the length of a logical operand is wrong", start);
+		return end;
+	}
+	case POSTFIX_TOKEN:
+		return verifyPostfixExpression(state, point, start);
+	}
+	if (isBinaryOperatorToken(token)) {
+		point=verifyExpression(state, point);
+		return verifyExpression(state, point);
+	}
+	malformedByteCode("an expression is unknown", start);
+	return point;
+}
+
+/**
+ * Verifies the body of a postfix expression, each operand pushes onto the operand stack and each operator replaces the top two
+ * entries with its result. The body must leave exactly one value and never need more of the stack than the depth in its header,
+ * which itself must fit within the interpreter's operand stack
+ */
+static unsigned int verifyPostfixExpression(struct verify_state * state, unsigned int point, unsigned int start) {
+	unsigned char depth=verifyUChar(state, &point);
+	unsigned short bodyLength=verifyUShort(state, &point);
+	unsigned int end=point+bodyLength;
+	int stackDepth=0, maximumDepth=0;
+	while (point < end) {
+		if (point >= state->length) malformedByteCode("a postfix expression is beyond the end of the code", start);
+		if (isArithmeticToken((unsigned char) state->code[point])) {
+			if (stackDepth < 2) malformedByteCode("a postfix operator has fewer than two operands", point);
+			point=recordUnit(state, point, sizeof(unsigned char), UNIT_OPERAND);
+			stackDepth--;
+		} else {
+			point=verifyExpression(state, point);
+			if (++stackDepth > maximumDepth) maximumDepth=stackDepth;
+		}
+	}
+	if (point != end || stackDepth != 1) malformedByteCode("a postfix expression does not leave a single value", start);
+	if (maximumDepth > depth || depth > POSTFIX_STACK_DEPTH) malformedByteCode("a postfix expression exceeds its operand stack", start);
+	return point;
+}
+
+/**
+ * Verifies a function call, directly to a function or via a variable, and its arguments. A direct call can not pass more
+ * arguments than the function takes, the expressions of those passed by value follow the argument slots
+ */
+static unsigned int verifyFunctionCall(struct verify_state * state, unsigned char token, unsigned int point) {
+	unsigned int start=point-sizeof(unsigned char);
+	unsigned short numberParameters=0;
+	if (token == FNCALL_TOKEN) {
+		numberParameters=verifyFunctionAddress(state, &point);
+	} else {
+		verifySlot(state, &point);
+	}
+	unsigned short i, slot, numberArgs=verifyUShort(state, &point), numberValues=0;
+	if (token == FNCALL_TOKEN && numberArgs > numberParameters) {
+		malformedByteCode("a function is passed more arguments than it takes", start);
+	}
+	for (i=0;i<numberArgs;i++) {
+		slot=verifyUShort(state, &point);
+		if (slot == VALUE_ARGUMENT_SLOT) {
+			numberValues++;
+		} else {
+			checkSlot(state, slot, point-sizeof(unsigned short));
+		}
+	}
+	for (i=0;i<numberValues;i++) point=verifyExpression(state, point);
+	return point;
+}
+
+/**
+ * Verifies the address of a function, which must be a function header (this is added to the functions to verify if it has not
+ * been already) and returns the number of arguments that the function takes
+ */
+static unsigned short verifyFunctionAddress(struct verify_state * state, unsigned int * point) {
+	unsigned int addressPoint=*point;
+	unsigned short target=verifyUShort(state, point);
+	if (target+sizeof(unsigned short)*2 > state->length || (state->unitKinds[target] && state->unitKinds[target] != UNIT_FUNCTION)) {
+		malformedByteCode("an address is not of a function", addressPoint);
+	}
+	if (!state->unitKinds[target]) state->functions[state->numberFunctions++]=target;
+	return getCompactUShort(state, target+sizeof(unsigned short));
+}
+
+static unsigned int verifyNativeCall(struct verify_state * state, unsigned int point) {
+	unsigned int start=point-sizeof(unsigned char);
+	unsigned char nativeFunction=verifyUChar(state, &point);
+	unsigned short i, numberArgs=verifyUShort(state, &point), minimumArgs, maximumArgs;
+	if (!getNativeFunctionArguments(nativeFunction, &minimumArgs, &maximumArgs)) {
+		malformedByteCode("a native function is unknown", start);
+	}
+	if (numberArgs < minimumArgs || numberArgs > maximumArgs) {
+		malformedByteCode("a native function is passed the wrong number of arguments", start);
+	}
+	for (i=0;i<numberArgs;i++) point=verifyExpression(state, point);
+	return point;
+}
+
+/**
+ * The range of the number of arguments that each native function takes, as checked by the host and device when not
+ * unchecked. Returns zero if the native function is unknown
+ */
+static int getNativeFunctionArguments(unsigned char nativeFunction, unsigned short * minimumArgs, unsigned short * maximumArgs) {
+	switch (nativeFunction) {
+	case NATIVE_FN_RTL_ISHOST:
+	case NATIVE_FN_RTL_ISDEVICE:
+	case NATIVE_FN_RTL_INPUT:
+	case NATIVE_FN_RTL_SYNC:
+	case NATIVE_FN_RTL_GC:
+	case NATIVE_FN_RTL_NUMCORES:
+	case NATIVE_FN_RTL_COREID:
+		*minimumArgs=*maximumArgs=0;
+		return 1;
+	case NATIVE_FN_RTL_PRINT:
+	case NATIVE_FN_RTL_NUMDIMS:
+	case NATIVE_FN_RTL_INPUTPRINT:
+	case NATIVE_FN_RTL_FREE:
+	case NATIVE_FN_RTL_RECV:
+	case NATIVE_FN_RTL_PROBE_FOR_MESSAGE:
+	case NATIVE_FN_RTL_TEST_FOR_SEND:
+	case NATIVE_FN_RTL_WAIT_FOR_SEND:
+		*minimumArgs=*maximumArgs=1;
+		return 1;
+	case NATIVE_FN_RTL_DSIZE:
+	case NATIVE_FN_RTL_SEND:
+	case NATIVE_FN_RTL_SEND_NB:
+	case NATIVE_FN_RTL_SENDRECV:
+	case NATIVE_FN_RTL_BCAST:
+	case NATIVE_FN_RTL_REDUCE:
+		*minimumArgs=*maximumArgs=2;
+		return 1;
+	case NATIVE_FN_RTL_ALLOCARRAY:
+	case NATIVE_FN_RTL_ALLOCSHAREDARRAY:
+		// The size of each dimension
+		*minimumArgs=1;
+		*maximumArgs=MAX_ARRAY_INDEXES;
+		return 1;
+	case NATIVE_FN_RTL_MATH:
+		// The operation and, for all but random, its operand
+		*minimumArgs=1;
+		*maximumArgs=2;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Verifies the indexes of an array access, the one dimensional superinstructions have a single index which the interpreter
+ * reads directly if it is a variable or integer literal, so it must be one of these
+ */
+static unsigned int verifyArrayIndexes(struct verify_state * state, unsigned int point, int isOneDimensional) {
+	unsigned int start=point;
+	unsigned char i, numberIndexes=verifyUChar(state, &point);
+	if (numberIndexes == 0 || numberIndexes > MAX_ARRAY_INDEXES) malformedByteCode("an array is accessed with too many indexes", start);
+	if (isOneDimensional && (numberIndexes != 1 || point >= state->length ||
+			(state->code[point] != LOAD_SLOT_TOKEN && state->code[point] != INTEGER_TOKEN))) {
+		malformedByteCode("a one dimensional array access is not by a variable or integer", start);
+	}
+	for (i=0;i<numberIndexes;i++) point=verifyExpression(state, point);
+	return point;
+}
+
+/**
+ * Verifies a block length, which leads to the location this many bytes after it (and any bytes after the block)
+ */
+static unsigned int verifyBlockLength(struct verify_state * state, unsigned int point, unsigned int bytesAfterBlock) {
+	unsigned int lengthPoint=point;
+	unsigned short blockLength=verifyUShort(state, &point);
+	addJump(state, point+blockLength+bytesAfterBlock, lengthPoint);
+	return point;
+}
+
+static void verifySlot(struct verify_state * state, unsigned int * point) {
+	unsigned int slotPoint=*point;
+	checkSlot(state, verifyUShort(state, point), slotPoint);
+}
+
+/**
+ * Checks that a slot is either a global or a local within the frame of the current function, the main code has no frame
+ */
+static void checkSlot(struct verify_state * state, unsigned short slot, unsigned int point) {
+	if (slot & LOCAL_SLOT_FLAG) {
+		if ((slot & ~LOCAL_SLOT_FLAG) >= state->numberLocals) malformedByteCode("a local variable is outside the frame", point);
+	} else if (slot >= state->numberGlobals) {
+		malformedByteCode("a global variable is outside the globals", point);
+	}
+}
+
+static unsigned char verifyUChar(struct verify_state * state, unsigned int * point) {
+	unsigned int start=*point;
+	*point=recordUnit(state, *point, sizeof(unsigned char), UNIT_OPERAND);
+	return (unsigned char) state->code[start];
+}
+
+static unsigned short verifyUShort(struct verify_state * state, unsigned int * point) {
+	unsigned int start=*point;
+	*point=recordUnit(state, *point, sizeof(unsigned short), UNIT_OPERAND);
+	return getCompactUShort(state, start);
+}
+
+/**
+ * Records the bytes of a unit, the first of which is of some kind, and returns the location after it. A unit must be entirely
+ * within the code and may not overlap any other
+ */
+static unsigned int recordUnit(struct verify_state * state, unsigned int point, unsigned int size, unsigned char kind) {
+	unsigned int i;
+	if (point+size > state->length) malformedByteCode("a unit is beyond the end of the code", point);
+	for (i=0;i<size;i++) {
+		if (state->unitKinds[point+i]) malformedByteCode("units overlap", point+i);
+		state->unitKinds[point+i]=i == 0 ? kind : UNIT_OPERAND;
+	}
+	return point+size;
+}
+
+/**
+ * Adds a location that control may pass to onto the work list, leading to the very end of the code finishes the program
+ */
+static void addJump(struct verify_state * state, unsigned int target, unsigned int point) {
+	if (target > state->length) malformedByteCode("a jump is beyond the end of the code", point);
+	if (target < state->length) state->workList[state->workListSize++]=target;
+}
+
+static unsigned short getCompactUShort(struct verify_state * state, unsigned int point) {
+	unsigned short v;
+	memcpy(&v, &state->code[point], sizeof(unsigned short));
+	return v;
+}
+
+/**
+ * Whether a token is an operator with two operands which directly follow it, comparisons as well as arithmetic
+ */
+static int isBinaryOperatorToken(unsigned char token) {
+	return isComparisonToken(token) || token == IS_TOKEN || isArithmeticToken(token);
+}
+
+static int isArithmeticToken(unsigned char token) {
+	return (token >= ADD_TOKEN && token <= MOD_TOKEN) || token == POW_TOKEN || (token >= INT_ADD_TOKEN && token <= REAL_DIV_TOKEN);
+}
+
+static int isComparisonToken(unsigned char token) {
+	return (token >= EQ_TOKEN && token <= GEQ_TOKEN) || (token >= INT_EQ_TOKEN && token <= REAL_GEQ_TOKEN);
+}
+
+static void malformedByteCode(char * where, unsigned int location) {
+	fprintf(stderr, "Malformed byte code where %s at location %d, can not run it\n", where, location);
+	exit(EXIT_FAILURE);
+}
@@ -27,7 +27,7 @@
 #ifndef BASICTOKENS_H_
 #define BASICTOKENS_H_
 
-#define LET_TOKEN 0x00
+#define STORE_SLOT_TOKEN 0x00
 #define STOP_TOKEN 0x01
 #define OR_TOKEN 0x02
 #define AND_TOKEN 0x03
@@ -42,7 +42,7 @@
 #define MUL_TOKEN 0x0C
 #define DIV_TOKEN 0x0D
 #define MOD_TOKEN 0x0E
-#define IDENTIFIER_TOKEN 0x0F
+#define LOAD_SLOT_TOKEN 0x0F
 #define REAL_TOKEN 0x10
 #define STRING_TOKEN 0x11
 #define INTEGER_TOKEN 0x12
@@ -65,6 +65,62 @@
 #define NATIVE_TOKEN 0x23
 #define FN_ADDR_TOKEN 0x24
 #define FNCALL_BY_VAR_TOKEN 0x25
+#define POSTFIX_TOKEN 0x26
+// Superinstructions, fused forms of the most common statement and expression shapes which are emitted by the assembler
+#define INC_SLOT_TOKEN 0x27
+#define OP_ASSIGN_TOKEN 0x28
+#define CMP_JUMP_TOKEN 0x29
+#define ARRAYACCESS_1D_TOKEN 0x2A
+#define ARRAYSET_1D_TOKEN 0x2B
+// Quickened arithmetic and comparisons, the interpreter rewrites generic operators to these once it has seen their operand types.
+// Each group is in the same order as the generic ADD to DIV and EQ to GEQ tokens
+#define INT_ADD_TOKEN 0x2C
+#define INT_SUB_TOKEN 0x2D
+#define INT_MUL_TOKEN 0x2E
+#define INT_DIV_TOKEN 0x2F
+#define REAL_ADD_TOKEN 0x30
+#define REAL_SUB_TOKEN 0x31
+#define REAL_MUL_TOKEN 0x32
+#define REAL_DIV_TOKEN 0x33
+#define INT_EQ_TOKEN 0x34
+#define INT_NEQ_TOKEN 0x35
+#define INT_LT_TOKEN 0x36
+#define INT_GT_TOKEN 0x37
+#define INT_LEQ_TOKEN 0x38
+#define INT_GEQ_TOKEN 0x39
+#define REAL_EQ_TOKEN 0x3A
+#define REAL_NEQ_TOKEN 0x3B
+#define REAL_LT_TOKEN 0x3C
+#define REAL_GT_TOKEN 0x3D
+#define REAL_LEQ_TOKEN 0x3E
+#define REAL_GEQ_TOKEN 0x3F
+// Selects between the arms of an if/elif chain comparing a variable against integer constants via a sorted table of the constants
+#define SWITCH_TOKEN 0x40
+// Element of a one dimensional array at an integer variable plus a constant, the neighbours read by stencil codes
+#define ARRAYACCESS_OFFSET_TOKEN 0x41
+// Counted loop over a range whose start, stop and step are evaluated once into hidden variables, so no array is allocated
+#define FOR_RANGE_TOKEN 0x42
+
+// One more than the largest token, used to size the interpreter dispatch tables
+#define NUMBER_TOKENS 0x43
+
+// Variables are referenced by slot, either a global (absolute) slot or, if this flag is set, a slot relative to the current frame
+#define LOCAL_SLOT_FLAG 0x8000
+// A call argument of this slot is passed by value, its expression follows the argument slots of the call in order
+#define VALUE_ARGUMENT_SLOT 0xFFFF
+// Parameters are all local so in a function header this flag marks those the function assigns to, which alias the variable passed
+// whereas values are copied into the others
+#define REFERENCE_PARAMETER_FLAG LOCAL_SLOT_FLAG
+
+// Depth of the operand stack used to evaluate postfix expressions, the assembler never emits one needing more than this
+#define POSTFIX_STACK_DEPTH 8
+
+// Maximum depth of nested function calls, each call takes one record on the interpreter's call stack and the assembler sizes
+// the recursion area of the symbol table to hold this many frames of every recursive function
+#define MAX_CALL_STACK_DEPTH 64
+
+// In predecoded byte code every token and operand occupies a word of this size, with strings padded to a multiple of it
+#define PREDECODED_WORD_SIZE 4
 
 #define ERR_STR_ONLYTEST_EQ 0x00
 #define ERR_NONE_ONLYTEST_EQ 0x01
@@ -89,6 +145,8 @@
 #define ERR_FNCALL_VAR_NOT_CONTAINING_FN_PTR 0x14
 #define ERR_PROBE_NOT_SUPPORTED 0x15
 #define ERR_NBSEND_NOT_SUPPORTED 0x16
+#define ERR_CALL_STACK_DEPTH_EXCEEDED 0x17
+#define ERR_STR_IN_ARRAY_NOT_SUPPORTED 0x18
 
 #define NATIVE_FN_RTL_ISHOST 0x00
 #define NATIVE_FN_RTL_ISDEVICE 0x01
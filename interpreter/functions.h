@@ -29,6 +29,14 @@
 
 #include "interpreter.h"
 
+// The number of arguments passed to a native function, when built with INTERPRETER_UNCHECKED the byte code has already been
+// verified to pass each native function the number it takes, so this is not checked again as the code runs
+#ifdef INTERPRETER_UNCHECKED
+#define CHECK_NATIVE_ARGUMENTS(numberArgs, expected)
+#else
+#define CHECK_NATIVE_ARGUMENTS(numberArgs, expected) if (numberArgs != expected) raiseError(ERR_INCORRECT_NUM_NATIVE_PARAMS)
+#endif
+
 /*
  * These functions are implemented by the device and host to support running in normal parallel core
  * Epiphany mode, and also standalone host mode only which is useful for interpreter development/testing
@@ -36,16 +44,31 @@
 
 #ifdef HOST_INTERPRETER
 void callNativeFunction(struct value_defn*, unsigned char, int, struct value_defn*,int,int,int,struct symbol_node*,int);
-char* getHeapMemory(int,char,int);
+char* getHeapMemory(int,char,int,struct symbol_node*,int);
 void freeMemoryInHeap(void*,int);
+void holdTemporary(char*,int);
+void releaseTemporaries(int,int);
+void retainHeapMemory(char*,char,int);
+void releaseHeapMemory(char*,char,int);
+char* getScratchMemory(int,int);
+char* getScratchMark(int);
+void resetScratchMemory(char*,int);
 void syncCores(int, int);
-struct value_defn performStringConcatenation(struct value_defn, struct value_defn, int);
+struct value_defn performStringConcatenation(struct value_defn, struct value_defn, char, int, struct symbol_node*, int);
 #else
 void callNativeFunction(struct value_defn*, unsigned char, int, struct value_defn*, int, int, int, struct symbol_node*);
 char* getHeapMemory(int,char,int,struct symbol_node*);
 void freeMemoryInHeap(void*);
+void holdTemporary(char*);
+void releaseTemporaries(int);
+void retainHeapMemory(char*,char);
+void releaseHeapMemory(char*,char);
+char* getScratchMemory(int);
+char* getScratchMark(void);
+void resetScratchMemory(char*);
 void syncCores(int);
-struct value_defn performStringConcatenation(struct value_defn, struct value_defn, int, struct symbol_node*);
+int hasCStackSpace(int);
+struct value_defn performStringConcatenation(struct value_defn, struct value_defn, char, int, struct symbol_node*);
 #endif
 int checkStringEquality(struct value_defn, struct value_defn);
 struct symbol_node* initialiseSymbolTable(int);
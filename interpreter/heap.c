@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Segregated fit allocator of the heaps; the core and shared heaps on the device and the heap of each process on the host. Free
+ * chunks are held on a list per size class, so allocating a chunk takes it from the first list which must hold one big enough
+ * and freeing a chunk places it at the head of its list, neither of which walks the heap. Adjacent free chunks are coalesced
+ * in a single pass over the heap, but this is deferred until an allocation can not otherwise be met or garbage has been
+ * collected. The device heaps differ only in the size of the length in their chunk headers, two bytes for the core heap and
+ * four for the far larger shared heap, and as chunks are not aligned their headers and links are accessed via cpy
+ */
+
+#include "heap.h"
+#include "functions.h"
+#include <stddef.h>
+
+// A free chunk holds the link to the next free chunk of its class in its data, so no chunk may be smaller than this
+#define MIN_CHUNK_DATA sizeof(char*)
+// The heap is not coalesced by an allocation until at least this fraction of it has been freed since it last was
+#define HEAP_COALESCE_FRACTION 16
+// Roots are gathered and looked up in batches of at most this many, which bounds the memory that collecting garbage needs
+#define HEAP_ROOT_BATCH 16
+// The number of chunks of each heap examined by a step of incremental garbage collection
+#define HEAP_COLLECTION_STEP 32
+// The in use byte of a chunk, which whilst collecting garbage also marks the chunks found to be live
+#define HEAP_CHUNK_IN_USE 0x1
+#define HEAP_CHUNK_MARKED 0x2
+// When reference counting the rest of the in use byte counts the variables referencing the chunk, once at its most the count
+// sticks there and the chunk is left for collecting garbage to free
+#define HEAP_REFERENCE_UNIT 0x4
+#define HEAP_REFERENCE_MAX 0xFC
+// Chunks of size class zero are smaller than double this, and each following class is double the size of the one before
+#define SMALLEST_SIZE_CLASS 8
+
+// A batch of roots, sorted by address, along with those which are arrays of strings. Whether every chunk must be kept, as
+// there are more roots than can be held, is also tracked
+struct heap_root_batch {
+	char * addresses[HEAP_ROOT_BATCH], * stringArrayAddresses[HEAP_ROOT_BATCH];
+	int number, stringArrays;
+	char conservative;
+};
+
+// A variable holding the address of some heap memory, which compacting the heap patches if the memory is moved
+struct heap_reference {
+	char * address;
+	struct symbol_node * symbol;
+};
+
+static int gatherRoots(struct heap_root_batch*, struct heap_temporaries*, int, struct symbol_node*, int*);
+static void markHeap(struct heap_definition*, struct heap_root_batch*, struct heap_root_batch*);
+static void markChunks(struct heap_definition*, char*, char*, struct heap_root_batch*, struct heap_root_batch*);
+static void addStringArrayElements(char*, unsigned int, struct heap_root_batch*);
+static char sweepHeap(struct heap_definition*, char);
+static void sortRoots(char**, int);
+static char findRoot(char**, int, char*);
+static char isSymbolRoot(struct symbol_node*);
+static int gatherReferences(struct heap_reference*, int, struct symbol_node*, int*);
+static void fillCompactedGap(struct heap_definition*, char*, char*, char*);
+static void moveChunk(char*, char*, unsigned int);
+static char * takeFreeChunk(struct heap_definition*, unsigned int);
+static void addFreeChunk(struct heap_definition*, char*);
+static unsigned int getSizeClass(unsigned int);
+static unsigned int getChunkLength(struct heap_definition*, char*);
+static void setChunkLength(struct heap_definition*, char*, unsigned int);
+static char isChunkInUse(struct heap_definition*, char*);
+static unsigned char * getChunkInUseByte(struct heap_definition*, char*);
+static void setChunkInUse(struct heap_definition*, char*, char);
+static char * getNextFreeChunk(struct heap_definition*, char*);
+static void setNextFreeChunk(struct heap_definition*, char*, char*);
+
+/**
+ * Initialises a heap of some size to be a single free chunk, a heap too small to hold any chunk is left empty
+ */
+void initialiseHeap(struct heap_definition * heap, char * start, unsigned int size, unsigned char lengthSize) {
+	int i;
+	heap->start=start;
+	heap->lengthSize=lengthSize;
+	heap->freedSinceCoalesce=0;
+	heap->collectionPoint=start;
+	for (i=0;i<HEAP_SIZE_CLASSES;i++) heap->freeLists[i]=NULL;
+	if (size < lengthSize+sizeof(unsigned char)+MIN_CHUNK_DATA) {
+		heap->end=start;
+		return;
+	}
+	heap->end=start+size;
+	setChunkLength(heap, start, size-(lengthSize+sizeof(unsigned char)));
+	setChunkInUse(heap, start, 0);
+	addFreeChunk(heap, start);
+}
+
+/**
+ * Allocates some memory in the heap, returning NULL if there is no free chunk big enough. The heap is only coalesced to find one
+ * if at least this much memory, and a fraction of the heap, has been freed since it last was. Otherwise a heap which is almost
+ * full would be walked by every allocation, whereas this way the cost of coalescing is spread over the memory freed, and
+ * collecting garbage will coalesce it regardless. Any of the chunk not needed is split off the start of it and remains free
+ */
+char* allocateInHeap(struct heap_definition * heap, unsigned int size) {
+	unsigned int length, headerSize=heap->lengthSize+sizeof(unsigned char);
+	char * chunk;
+	if (size < MIN_CHUNK_DATA) size=MIN_CHUNK_DATA;
+	chunk=takeFreeChunk(heap, size);
+	if (chunk == NULL) {
+		if (heap->freedSinceCoalesce < size || heap->freedSinceCoalesce < (heap->end-heap->start) / HEAP_COALESCE_FRACTION) return NULL;
+		coalesceHeap(heap);
+		chunk=takeFreeChunk(heap, size);
+		if (chunk == NULL) return NULL;
+	}
+	length=getChunkLength(heap, chunk);
+	if (length >= size+headerSize+MIN_CHUNK_DATA) {
+		setChunkLength(heap, chunk, length-size-headerSize);
+		addFreeChunk(heap, chunk);
+		chunk+=length-size;
+		setChunkLength(heap, chunk, size);
+	}
+	setChunkInUse(heap, chunk, HEAP_CHUNK_IN_USE);
+	return chunk+headerSize;
+}
+
+/**
+ * Frees some memory in the heap, it is coalesced with any free neighbours later. Freeing memory which is already free is ignored
+ * as otherwise the chunk would be on its free list twice
+ */
+void freeInHeap(struct heap_definition * heap, char * address) {
+	char * chunk=address-(heap->lengthSize+sizeof(unsigned char));
+	if (!isChunkInUse(heap, chunk)) return;
+	setChunkInUse(heap, chunk, 0);
+	addFreeChunk(heap, chunk);
+	heap->freedSinceCoalesce+=getChunkLength(heap, chunk);
+}
+
+/**
+ * Shrinks some allocated memory to a smaller size, freeing the rest of its chunk if this is big enough to be a chunk itself
+ */
+void shrinkInHeap(struct heap_definition * heap, char * address, unsigned int size) {
+	unsigned int length, headerSize=heap->lengthSize+sizeof(unsigned char);
+	char * chunk=address-headerSize, * remainder;
+	if (size < MIN_CHUNK_DATA) size=MIN_CHUNK_DATA;
+	length=getChunkLength(heap, chunk);
+	if (length >= size+headerSize+MIN_CHUNK_DATA) {
+		setChunkLength(heap, chunk, size);
+		remainder=address+size;
+		setChunkLength(heap, remainder, length-size-headerSize);
+		setChunkInUse(heap, remainder, 0);
+		addFreeChunk(heap, remainder);
+		heap->freedSinceCoalesce+=length-size-headerSize;
+	}
+}
+
+char isAddressInHeap(struct heap_definition * heap, char * address) {
+	return address >= heap->start && address < heap->end;
+}
+
+/**
+ * Collects the garbage in some heaps, freeing every chunk in use which is not reachable from the symbol table or temporaries
+ * and coalescing the heaps as they are swept, returns whether any memory was freed. Roots are gathered in batches, each is
+ * sorted and the heaps walked once marking the chunks it holds, which are looked up by binary search, before the heaps are
+ * swept in a single pass. The elements of arrays of strings are only read once their array has been found to be a live chunk,
+ * and if there are more of these than can be held then every chunk is kept
+ */
+char collectGarbage(struct heap_definition ** heaps, int numberHeaps, struct heap_temporaries * temporaries,
+		int currentSymbolEntries, struct symbol_node * symbolTable) {
+	struct heap_root_batch roots, elements;
+	int i, position=0;
+	char freedMem=0;
+	elements.number=0;
+	elements.stringArrays=0;
+	roots.conservative=temporaries->number > HEAP_TEMPORARY_ROOTS;
+	elements.conservative=0;
+	while (!roots.conservative && gatherRoots(&roots, temporaries, currentSymbolEntries, symbolTable, &position)) {
+		for (i=0;i<numberHeaps;i++) markHeap(heaps[i], &roots, &elements);
+	}
+	if (elements.number > 0) {
+		sortRoots(elements.addresses, elements.number);
+		for (i=0;i<numberHeaps;i++) markHeap(heaps[i], &elements, NULL);
+	}
+	for (i=0;i<numberHeaps;i++) {
+		freedMem|=sweepHeap(heaps[i], roots.conservative || elements.conservative);
+	}
+	return freedMem;
+}
+
+/**
+ * Takes a step of collecting the garbage in some heaps, this only examines a bounded number of chunks in each heap from where
+ * the last step finished (starting again once a heap's end is reached) so each step takes a bounded time whatever the size of
+ * the heap. Chunks are freed but left for the heap to coalesce later, and as the arrays holding strings might lie outside the
+ * chunks examined the step frees nothing whilst there are any of these. Returns whether any memory was freed
+ */
+char collectGarbageIncrementally(struct heap_definition ** heaps, int numberHeaps, struct heap_temporaries * temporaries,
+		int currentSymbolEntries, struct symbol_node * symbolTable) {
+	struct heap_root_batch roots;
+	unsigned int headerSize;
+	int i, j, position=0;
+	char * chunk, * stepEnd[numberHeaps], freedMem=0;
+	for (i=0;i<numberHeaps;i++) {
+		headerSize=heaps[i]->lengthSize+sizeof(unsigned char);
+		if (heaps[i]->collectionPoint >= heaps[i]->end) heaps[i]->collectionPoint=heaps[i]->start;
+		chunk=heaps[i]->collectionPoint;
+		for (j=0;j<HEAP_COLLECTION_STEP && chunk < heaps[i]->end;j++) chunk+=headerSize+getChunkLength(heaps[i], chunk);
+		stepEnd[i]=chunk;
+	}
+	roots.conservative=temporaries->number > HEAP_TEMPORARY_ROOTS;
+	while (!roots.conservative && gatherRoots(&roots, temporaries, currentSymbolEntries, symbolTable, &position)) {
+		if (roots.stringArrays) roots.conservative=1;
+		for (i=0;i<numberHeaps;i++) markChunks(heaps[i], heaps[i]->collectionPoint, stepEnd[i], &roots, NULL);
+	}
+	for (i=0;i<numberHeaps;i++) {
+		headerSize=heaps[i]->lengthSize+sizeof(unsigned char);
+		for (chunk=heaps[i]->collectionPoint;chunk < stepEnd[i];chunk+=headerSize+getChunkLength(heaps[i], chunk)) {
+			if ((chunk[heaps[i]->lengthSize] & HEAP_CHUNK_MARKED) || roots.conservative) {
+				chunk[heaps[i]->lengthSize]&=~HEAP_CHUNK_MARKED;
+			} else if (isChunkInUse(heaps[i], chunk)) {
+				freeInHeap(heaps[i], chunk+headerSize);
+				freedMem=1;
+			}
+		}
+		heaps[i]->collectionPoint=stepEnd[i];
+	}
+	return freedMem;
+}
+
+/**
+ * Gathers the next batch of roots, which are the temporaries followed by the arrays and strings held by the symbol table. The
+ * position is how far through these the gathering has got, and the number of roots in the batch is returned (zero once all have
+ * been gathered.) Arrays of strings are also noted separately, so that their elements can be marked once they are found to be live
+ */
+static int gatherRoots(struct heap_root_batch * roots, struct heap_temporaries * temporaries, int currentSymbolEntries,
+		struct symbol_node * symbolTable, int * position) {
+	struct symbol_node * symbol;
+	char * address;
+	roots->number=0;
+	roots->stringArrays=0;
+	while (roots->number < HEAP_ROOT_BATCH && *position < temporaries->number) {
+		roots->addresses[roots->number++]=temporaries->addresses[(*position)++];
+	}
+	while (roots->number < HEAP_ROOT_BATCH && *position-temporaries->number <= currentSymbolEntries) {
+		symbol=&symbolTable[*position-temporaries->number];
+		(*position)++;
+		if (isSymbolRoot(symbol)) {
+			cpy(&address, symbol->value.data, sizeof(char*));
+			roots->addresses[roots->number++]=address;
+			// Elements are held in an int, so can only hold the address of a string if this fits in one
+			if (symbol->value.dtype==ARRAY && symbol->value.type==STRING_TYPE && sizeof(char*) <= sizeof(int)) {
+				roots->stringArrayAddresses[roots->stringArrays++]=address;
+			}
+		}
+	}
+	sortRoots(roots->addresses, roots->number);
+	sortRoots(roots->stringArrayAddresses, roots->stringArrays);
+	return roots->number;
+}
+
+/**
+ * Marks every chunk in use in a heap which a batch of roots holds
+ */
+static void markHeap(struct heap_definition * heap, struct heap_root_batch * roots, struct heap_root_batch * elements) {
+	markChunks(heap, heap->start, heap->end, roots, elements);
+}
+
+/**
+ * Marks every chunk in use between two points of a heap which a batch of roots holds. If the chunk is an array of strings then
+ * the addresses of its strings are added to the batch of elements, which if full means every chunk must be kept
+ */
+static void markChunks(struct heap_definition * heap, char * from, char * to, struct heap_root_batch * roots,
+		struct heap_root_batch * elements) {
+	unsigned int headerSize=heap->lengthSize+sizeof(unsigned char), length;
+	char * chunk;
+	for (chunk=from;chunk < to;chunk+=headerSize+length) {
+		length=getChunkLength(heap, chunk);
+		if (isChunkInUse(heap, chunk) && findRoot(roots->addresses, roots->number, chunk+headerSize)) {
+			chunk[heap->lengthSize]|=HEAP_CHUNK_MARKED;
+			if (elements != NULL && findRoot(roots->stringArrayAddresses, roots->stringArrays, chunk+headerSize)) {
+				addStringArrayElements(chunk+headerSize, length, elements);
+			}
+		}
+	}
+}
+
+/**
+ * Adds the addresses of the strings held by an array, which is a live chunk of some length, to a batch of roots
+ */
+static void addStringArrayElements(char * array, unsigned int length, struct heap_root_batch * elements) {
+	unsigned char numberDims;
+	int i, dimSize, numberElements=1, headerSize;
+	char * address=NULL;
+	cpy(&numberDims, array, sizeof(unsigned char));
+	numberDims=numberDims & 0xF;
+	for (i=0;i<numberDims;i++) {
+		cpy(&dimSize, &array[sizeof(unsigned char)+(i*sizeof(int))], sizeof(int));
+		numberElements*=dimSize;
+	}
+	headerSize=sizeof(unsigned char)+(sizeof(int)*numberDims);
+	// The array is live but its dimensions are checked against the chunk nevertheless
+	if (numberElements < 0 || headerSize+(numberElements*sizeof(int)) > length) numberElements=(length-headerSize)/sizeof(int);
+	for (i=0;i<numberElements;i++) {
+		if (elements->number == HEAP_ROOT_BATCH) {
+			elements->conservative=1;
+			return;
+		}
+		cpy(&address, &array[headerSize+(i*sizeof(int))], sizeof(int));
+		elements->addresses[elements->number++]=address;
+	}
+}
+
+/**
+ * Sweeps a heap, freeing every chunk in use which has not been marked (unless every chunk is to be kept) and clearing the marks
+ * of the others. Runs of adjacent free chunks are merged as the heap is swept and the free lists rebuilt from these
+ */
+static char sweepHeap(struct heap_definition * heap, char keepAll) {
+	unsigned int i, length, headerSize=heap->lengthSize+sizeof(unsigned char);
+	char * chunk, * freeChunk=NULL, freedMem=0;
+	for (i=0;i<HEAP_SIZE_CLASSES;i++) heap->freeLists[i]=NULL;
+	heap->freedSinceCoalesce=0;
+	heap->collectionPoint=heap->start;
+	for (chunk=heap->start;chunk < heap->end;chunk+=headerSize+length) {
+		length=getChunkLength(heap, chunk);
+		if ((chunk[heap->lengthSize] & HEAP_CHUNK_MARKED) || (keepAll && isChunkInUse(heap, chunk))) {
+			chunk[heap->lengthSize]&=~HEAP_CHUNK_MARKED;
+			if (freeChunk != NULL) addFreeChunk(heap, freeChunk);
+			freeChunk=NULL;
+		} else {
+			if (isChunkInUse(heap, chunk)) {
+				setChunkInUse(heap, chunk, 0);
+				freedMem=1;
+			}
+			if (freeChunk == NULL) {
+				freeChunk=chunk;
+			} else {
+				setChunkLength(heap, freeChunk, getChunkLength(heap, freeChunk)+headerSize+length);
+			}
+		}
+	}
+	if (freeChunk != NULL) addFreeChunk(heap, freeChunk);
+	return freedMem;
+}
+
+/**
+ * Sorts a batch of roots into ascending order of address, batches are small so this is an insertion sort
+ */
+static void sortRoots(char ** addresses, int number) {
+	int i, j;
+	char * address;
+	for (i=1;i<number;i++) {
+		address=addresses[i];
+		for (j=i;j>0 && addresses[j-1] > address;j--) addresses[j]=addresses[j-1];
+		addresses[j]=address;
+	}
+}
+
+/**
+ * Binary searches a sorted batch of roots for an address
+ */
+static char findRoot(char ** addresses, int number, char * address) {
+	int low=0, high=number-1, middle;
+	while (low <= high) {
+		middle=(low+high)/2;
+		if (addresses[middle] == address) return 1;
+		if (addresses[middle] < address) {
+			low=middle+1;
+		} else {
+			high=middle-1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Determines whether a symbol holds the address of some heap memory, which is where it holds an array or string
+ */
+static char isSymbolRoot(struct symbol_node * symbol) {
+	return (symbol->state==ALLOCATED || symbol->state==ARGUMENT) && (symbol->value.dtype==ARRAY || symbol->value.type==STRING_TYPE);
+}
+
+/**
+ * Holds the address of some heap memory as a temporary, so that collecting garbage does not free it. If there are more
+ * temporaries than can be held then these are still counted, and collecting garbage frees nothing until they have been released
+ */
+void holdHeapTemporary(struct heap_temporaries * temporaries, char * address) {
+	if (temporaries->number < HEAP_TEMPORARY_ROOTS) temporaries->addresses[temporaries->number]=address;
+	temporaries->number++;
+}
+
+void releaseHeapTemporaries(struct heap_temporaries * temporaries, int number) {
+	temporaries->number-=number;
+}
+
+/**
+ * Counts a further variable referencing some heap memory, or if permanently then this is held somewhere that is not counted (such
+ * as an element of an array) and it is only freed by collecting garbage
+ */
+void retainInHeap(struct heap_definition * heap, char * address, char permanently) {
+	unsigned char * inUse=getChunkInUseByte(heap, address);
+	if (!(*inUse & HEAP_CHUNK_IN_USE) || (*inUse & HEAP_REFERENCE_MAX) == HEAP_REFERENCE_MAX) return;
+	*inUse=permanently ? *inUse | HEAP_REFERENCE_MAX : *inUse+HEAP_REFERENCE_UNIT;
+}
+
+/**
+ * Counts a variable no longer referencing some heap memory. If reclaim is set and no variable now references the memory it is
+ * freed straight away, unless it is held as a temporary (such as an operand of the expression being evaluated)
+ */
+void releaseInHeap(struct heap_definition * heap, char * address, struct heap_temporaries * temporaries, char reclaim) {
+	unsigned char * inUse=getChunkInUseByte(heap, address);
+	int i;
+	if (!(*inUse & HEAP_CHUNK_IN_USE) || (*inUse & HEAP_REFERENCE_MAX) == HEAP_REFERENCE_MAX || !(*inUse & HEAP_REFERENCE_MAX)) return;
+	*inUse-=HEAP_REFERENCE_UNIT;
+	if (!reclaim || (*inUse & HEAP_REFERENCE_MAX) || temporaries->number > HEAP_TEMPORARY_ROOTS) return;
+	for (i=0;i<temporaries->number;i++) {
+		if (temporaries->addresses[i] == address) return;
+	}
+	freeInHeap(heap, address);
+}
+
+/**
+ * Determines whether any variable references some heap memory
+ */
+char isReferencedInHeap(struct heap_definition * heap, char * address) {
+	return (*getChunkInUseByte(heap, address) & HEAP_REFERENCE_MAX) != 0;
+}
+
+/**
+ * Initialises a scratch arena over some memory, which is empty to begin with
+ */
+void initialiseScratchArena(struct scratch_arena * arena, char * start, unsigned int size) {
+	arena->start=start;
+	arena->end=start+size;
+	arena->top=start;
+}
+
+/**
+ * Allocates some memory at the top of a scratch arena, word aligned, returning NULL if the arena does not have enough left
+ */
+char* allocateInScratchArena(struct scratch_arena * arena, unsigned int size) {
+	char * allocated=arena->start+((((arena->top-arena->start)+sizeof(int)-1)/sizeof(int))*sizeof(int));
+	if (allocated > arena->end || (unsigned int) (arena->end-allocated) < size) return NULL;
+	arena->top=allocated+size;
+	return allocated;
+}
+
+/**
+ * Merges each run of adjacent free chunks into one and rebuilds the free lists from these
+ */
+void coalesceHeap(struct heap_definition * heap) {
+	unsigned int i, length, headerSize=heap->lengthSize+sizeof(unsigned char);
+	char * chunk, * next;
+	for (i=0;i<HEAP_SIZE_CLASSES;i++) heap->freeLists[i]=NULL;
+	heap->freedSinceCoalesce=0;
+	// Chunks are merged so the point an incremental collection had got to might no longer start one
+	heap->collectionPoint=heap->start;
+	for (chunk=heap->start;chunk < heap->end;chunk=next) {
+		length=getChunkLength(heap, chunk);
+		next=chunk+headerSize+length;
+		if (!isChunkInUse(heap, chunk)) {
+			while (next < heap->end && !isChunkInUse(heap, next)) {
+				length+=headerSize+getChunkLength(heap, next);
+				next=chunk+headerSize+length;
+			}
+			setChunkLength(heap, chunk, length);
+			addFreeChunk(heap, chunk);
+		}
+	}
+}
+
+/**
+ * Compacts a heap, sliding the chunks in use down over the free memory between them so that this is gathered into one free
+ * chunk at the end and patching the variables which hold the chunks moved. Temporaries are held in C variables that can not be
+ * patched, so the chunks they hold are left in place and the free memory before each of these gathered in front of it. This is
+ * only done if the heap holds enough free memory in total for an allocation of some size, there are no more temporaries than can
+ * be held and there are no arrays of strings (whose elements would also need patching.) Every chunk in use is kept so garbage
+ * should be collected first, returns whether the heap was compacted
+ */
+char compactHeap(struct heap_definition * heap, unsigned int size, struct heap_temporaries * temporaries, int currentSymbolEntries,
+		struct symbol_node * symbolTable) {
+	struct heap_reference references[HEAP_ROOT_BATCH];
+	char * pinned[HEAP_TEMPORARY_ROOTS], * chunk, * next, * target, * moved, * lastPlaced=NULL;
+	unsigned int length, freeMemory=0, headerSize=heap->lengthSize+sizeof(unsigned char);
+	int i, numberReferences, position=0;
+	if (temporaries->number > HEAP_TEMPORARY_ROOTS) return 0;
+	for (i=0;i<=currentSymbolEntries;i++) {
+		if (isSymbolRoot(&symbolTable[i]) && symbolTable[i].value.dtype==ARRAY && symbolTable[i].value.type==STRING_TYPE) return 0;
+	}
+	for (chunk=heap->start;chunk < heap->end;chunk+=headerSize+getChunkLength(heap, chunk)) {
+		if (!isChunkInUse(heap, chunk)) freeMemory+=headerSize+getChunkLength(heap, chunk);
+	}
+	if (freeMemory < headerSize+size) return 0;
+	for (i=0;i<temporaries->number;i++) pinned[i]=temporaries->addresses[i];
+	sortRoots(pinned, temporaries->number);
+	// The variables are patched a batch at a time, each sorted by address so it is matched against the chunks in one walk that
+	// works out where each chunk will be moved to
+	while ((numberReferences=gatherReferences(references, currentSymbolEntries, symbolTable, &position)) > 0) {
+		i=0;
+		target=heap->start;
+		for (chunk=heap->start;chunk < heap->end && i < numberReferences;chunk+=headerSize+length) {
+			length=getChunkLength(heap, chunk);
+			if (!isChunkInUse(heap, chunk)) continue;
+			if (findRoot(pinned, temporaries->number, chunk+headerSize)) target=chunk;
+			while (i < numberReferences && references[i].address < chunk+headerSize) i++;
+			moved=target+headerSize;
+			while (i < numberReferences && references[i].address == chunk+headerSize) {
+				cpy(references[i++].symbol->value.data, &moved, sizeof(char*));
+			}
+			target+=headerSize+length;
+		}
+	}
+	target=heap->start;
+	for (chunk=heap->start;chunk < heap->end;chunk=next) {
+		length=getChunkLength(heap, chunk);
+		next=chunk+headerSize+length;
+		if (!isChunkInUse(heap, chunk)) continue;
+		if (findRoot(pinned, temporaries->number, chunk+headerSize)) {
+			fillCompactedGap(heap, target, chunk, lastPlaced);
+		} else if (target != chunk) {
+			moveChunk(target, chunk, headerSize+length);
+			chunk=target;
+		}
+		lastPlaced=chunk;
+		target=chunk+headerSize+length;
+	}
+	fillCompactedGap(heap, target, heap->end, lastPlaced);
+	coalesceHeap(heap);
+	return 1;
+}
+
+/**
+ * Gathers the next batch of variables holding the addresses of heap memory, sorted by the address held. The position is how far
+ * through the symbol table the gathering has got and the number in the batch is returned, zero once all have been gathered
+ */
+static int gatherReferences(struct heap_reference * references, int currentSymbolEntries, struct symbol_node * symbolTable,
+		int * position) {
+	struct heap_reference reference;
+	int i, number=0;
+	while (number < HEAP_ROOT_BATCH && *position <= currentSymbolEntries) {
+		reference.symbol=&symbolTable[(*position)++];
+		if (isSymbolRoot(reference.symbol)) {
+			cpy(&reference.address, reference.symbol->value.data, sizeof(char*));
+			for (i=number;i>0 && references[i-1].address > reference.address;i--) references[i]=references[i-1];
+			references[i]=reference;
+			number++;
+		}
+	}
+	return number;
+}
+
+/**
+ * Fills the gap left between two points by compacting a heap, with a free chunk or if the gap is too small to hold one then by
+ * extending the chunk placed immediately before it
+ */
+static void fillCompactedGap(struct heap_definition * heap, char * from, char * to, char * lastPlaced) {
+	unsigned int gap=to-from, headerSize=heap->lengthSize+sizeof(unsigned char);
+	if (gap == 0) return;
+	if (gap >= headerSize+MIN_CHUNK_DATA || lastPlaced == NULL) {
+		setChunkLength(heap, from, gap-headerSize);
+		setChunkInUse(heap, from, 0);
+	} else {
+		setChunkLength(heap, lastPlaced, getChunkLength(heap, lastPlaced)+gap);
+	}
+}
+
+/**
+ * Moves a chunk down to a lower address, the two might overlap so this copies from the start
+ */
+static void moveChunk(char * to, char * from, unsigned int size) {
+	unsigned int i;
+	for (i=0;i<size;i++) to[i]=from[i];
+}
+
+/**
+ * Takes a free chunk of at least some size off its free list. The first chunk of the size's own class is taken if it is big
+ * enough, otherwise every chunk of a larger class is, so the first chunk of the smallest of these is taken. Failing that the
+ * rest of the size's own class is searched
+ */
+static char * takeFreeChunk(struct heap_definition * heap, unsigned int size) {
+	unsigned int i, sizeClass=getSizeClass(size);
+	char * chunk=heap->freeLists[sizeClass], * previous=NULL;
+	if (chunk != NULL && getChunkLength(heap, chunk) >= size) {
+		heap->freeLists[sizeClass]=getNextFreeChunk(heap, chunk);
+		return chunk;
+	}
+	for (i=sizeClass+1;i<HEAP_SIZE_CLASSES;i++) {
+		chunk=heap->freeLists[i];
+		if (chunk != NULL) {
+			heap->freeLists[i]=getNextFreeChunk(heap, chunk);
+			return chunk;
+		}
+	}
+	for (chunk=heap->freeLists[sizeClass];chunk != NULL;chunk=getNextFreeChunk(heap, chunk)) {
+		if (getChunkLength(heap, chunk) >= size) {
+			if (previous == NULL) {
+				heap->freeLists[sizeClass]=getNextFreeChunk(heap, chunk);
+			} else {
+				setNextFreeChunk(heap, previous, getNextFreeChunk(heap, chunk));
+			}
+			return chunk;
+		}
+		previous=chunk;
+	}
+	return NULL;
+}
+
+static void addFreeChunk(struct heap_definition * heap, char * chunk) {
+	unsigned int sizeClass=getSizeClass(getChunkLength(heap, chunk));
+	setNextFreeChunk(heap, chunk, heap->freeLists[sizeClass]);
+	heap->freeLists[sizeClass]=chunk;
+}
+
+/**
+ * The size class of a chunk's data, the last class holds every chunk too large for the classes before it
+ */
+static unsigned int getSizeClass(unsigned int size) {
+	unsigned int sizeClass=0;
+	while (size >= SMALLEST_SIZE_CLASS*2 && sizeClass < HEAP_SIZE_CLASSES-1) {
+		size>>=1;
+		sizeClass++;
+	}
+	return sizeClass;
+}
+
+static unsigned int getChunkLength(struct heap_definition * heap, char * chunk) {
+	unsigned short coreChunkLength;
+	unsigned int chunkLength;
+	if (heap->lengthSize == sizeof(unsigned short)) {
+		cpy(&coreChunkLength, chunk, sizeof(unsigned short));
+		return coreChunkLength;
+	}
+	cpy(&chunkLength, chunk, sizeof(unsigned int));
+	return chunkLength;
+}
+
+static void setChunkLength(struct heap_definition * heap, char * chunk, unsigned int chunkLength) {
+	unsigned short coreChunkLength=(unsigned short) chunkLength;
+	if (heap->lengthSize == sizeof(unsigned short)) {
+		cpy(chunk, &coreChunkLength, sizeof(unsigned short));
+	} else {
+		cpy(chunk, &chunkLength, sizeof(unsigned int));
+	}
+}
+
+static char isChunkInUse(struct heap_definition * heap, char * chunk) {
+	return chunk[heap->lengthSize] & HEAP_CHUNK_IN_USE;
+}
+
+/**
+ * Gets the in use byte of the chunk holding some heap memory, which also holds its mark and reference count
+ */
+static unsigned char * getChunkInUseByte(struct heap_definition * heap, char * address) {
+	char * chunk=address-(heap->lengthSize+sizeof(unsigned char));
+	return (unsigned char*) &chunk[heap->lengthSize];
+}
+
+static void setChunkInUse(struct heap_definition * heap, char * chunk, char inUse) {
+	chunk[heap->lengthSize]=inUse;
+}
+
+static char * getNextFreeChunk(struct heap_definition * heap, char * chunk) {
+	char * next;
+	cpy(&next, &chunk[heap->lengthSize+sizeof(unsigned char)], sizeof(char*));
+	return next;
+}
+
+static void setNextFreeChunk(struct heap_definition * heap, char * chunk, char * next) {
+	cpy(&chunk[heap->lengthSize+sizeof(unsigned char)], &next, sizeof(char*));
+}
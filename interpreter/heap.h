@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2016, Nick Brown
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HEAP_H_
+#define HEAP_H_
+
+#include "interpreter.h"
+
+// The number of size classes of free chunks, each class holds chunks up to double the size of the class before it
+#define HEAP_SIZE_CLASSES 12
+
+// Most temporaries, values not yet held by a variable such as the operands of a string concatenation, that can be held as roots
+#define HEAP_TEMPORARY_ROOTS 8
+
+// A heap of chunks, each is a header of its length (held in lengthSize bytes) and whether it is in use, followed by its data.
+// The free chunks of each size class are linked through their data from the head held here, along with the amount of memory freed
+// since the heap was last coalesced and the point an incremental garbage collection has got to
+struct heap_definition {
+	char * start, * end, * collectionPoint;
+	unsigned char lengthSize;
+	unsigned int freedSinceCoalesce;
+	char * freeLists[HEAP_SIZE_CLASSES];
+};
+
+// Addresses of heap memory held by temporaries rather than variables, which collecting garbage must not free. The number can
+// exceed the addresses held, in which case collecting garbage frees nothing
+struct heap_temporaries {
+	char * addresses[HEAP_TEMPORARY_ROOTS];
+	int number;
+};
+
+// A bump allocated arena for values which do not outlive the statement creating them (such as the intermediate strings of a
+// concatenation), these are freed all at once by resetting the top back to a mark taken before they were allocated
+struct scratch_arena {
+	char * start, * end, * top;
+};
+
+void initialiseHeap(struct heap_definition*, char*, unsigned int, unsigned char);
+char* allocateInHeap(struct heap_definition*, unsigned int);
+void freeInHeap(struct heap_definition*, char*);
+void shrinkInHeap(struct heap_definition*, char*, unsigned int);
+char isAddressInHeap(struct heap_definition*, char*);
+void coalesceHeap(struct heap_definition*);
+char collectGarbage(struct heap_definition**, int, struct heap_temporaries*, int, struct symbol_node*);
+char collectGarbageIncrementally(struct heap_definition**, int, struct heap_temporaries*, int, struct symbol_node*);
+char compactHeap(struct heap_definition*, unsigned int, struct heap_temporaries*, int, struct symbol_node*);
+void holdHeapTemporary(struct heap_temporaries*, char*);
+void releaseHeapTemporaries(struct heap_temporaries*, int);
+void retainInHeap(struct heap_definition*, char*, char);
+void releaseInHeap(struct heap_definition*, char*, struct heap_temporaries*, char);
+char isReferencedInHeap(struct heap_definition*, char*);
+void initialiseScratchArena(struct scratch_arena*, char*, unsigned int);
+char* allocateInScratchArena(struct scratch_arena*, unsigned int);
+
+#endif /* HEAP_H_ */
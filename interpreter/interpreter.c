@@ -32,7 +32,16 @@
 #include "../host/host-functions.h"
 #endif
 
-#define MAX_CALL_STACK_DEPTH 10
+// C stack needed to run a call within an expression, which nests the interpreter loop. Each level takes around 800 bytes
+// (getExpressionValue twice, processAssembledCode and handleFnCall, measured with -fstack-usage) along with room for the
+// statements and native functions then run
+#define EXPRESSION_CALL_C_STACK 1536
+
+// A record on the call stack, where to resume in the caller and the start of the caller's frame in the symbol table
+struct call_frame {
+	unsigned int returnPoint;
+	int previousFrameBase;
+};
 
 #ifdef HOST_INTERPRETER
 // Whether we should stop the interpreter or not (due to error raised)
@@ -45,8 +54,16 @@ static volatile int * currentSymbolEntries;
 static volatile int * localCoreId;
 // Number of active cores
 static volatile int * numActiveCores;
-// Function call level
-unsigned volatile char * fnLevel;
+// Start of the current function's frame in the symbol table
+static volatile int * frameBase;
+// Number of entries allocated for the symbol table
+static volatile int * symbolTableSize;
+// The interpreter's call stack and number of records currently on it
+static struct call_frame ** callStack;
+static volatile int * callStackDepth;
+// Whether the values being evaluated are consumed by the current statement, in which case strings and arrays created for them
+// are placed in the scratch arena
+static char * scratchValues;
 #else
 #define NULL ((void *)0)
 // Whether we should stop the interpreter or not (due to error raised)
@@ -59,52 +76,221 @@ static int currentSymbolEntries;
 static int localCoreId;
 // Number of active cores
 static int numActiveCores;
-// Function call level
-unsigned char fnLevel;
+// Start of the current function's frame in the symbol table
+static int frameBase;
+// Number of entries allocated for the symbol table
+static int symbolTableSize;
+// The interpreter's call stack and number of records currently on it
+static struct call_frame * callStack;
+static int callStackDepth;
+// Whether the values being evaluated are consumed by the current statement, in which case strings and arrays created for them
+// are placed in the scratch arena
+static char scratchValues;
 #endif
 
 static int hostCoresBasePid;
 
+/*
+ * Dispatch of statements and expressions is driven by the token of each node. By default on GCC we use computed goto
+ * (threaded dispatch, each handler jumping straight to the next one) and otherwise, or if INTERPRETER_TABLE_DISPATCH is
+ * defined (make DISPATCH=table), a dense table of handler functions indexed by token. Both call the same handlers.
+ */
+#if defined(__GNUC__) && !defined(INTERPRETER_TABLE_DISPATCH)
+#define INTERPRETER_COMPUTED_GOTO
+#endif
+
+/*
+ * Quickening, once a generic arithmetic or comparison operator has executed its token in the byte code is rewritten to the variant
+ * specialised for the types of its operands (i.e. ADD to INT_ADD) which skips the type dispatch. Each variant checks its operand
+ * types and if these differ does the operation generically and reverts to the generic token. This is disabled by defining
+ * INTERPRETER_NO_QUICKENING (make QUICKEN=0) which leaves the byte code unmodified
+ */
+
+/*
+ * With INTERPRETER_PREDECODE (make PREDECODE=1) the interpreter runs byte code which the host has predecoded as it placed it. Every
+ * token and operand is an aligned word and so read directly, rather than copied byte by byte from the unaligned compact form, and
+ * addresses and block lengths have been resolved to absolute locations in the predecoded code
+ */
+#ifdef INTERPRETER_PREDECODE
+#define CODE_UCHAR_SIZE PREDECODED_WORD_SIZE
+#define CODE_USHORT_SIZE PREDECODED_WORD_SIZE
+#define CODE_STRING_SIZE(length) ((((length)+PREDECODED_WORD_SIZE)/PREDECODED_WORD_SIZE)*PREDECODED_WORD_SIZE)
+#else
+#define CODE_UCHAR_SIZE sizeof(unsigned char)
+#define CODE_USHORT_SIZE sizeof(unsigned short)
+#define CODE_STRING_SIZE(length) ((length)+1)
+#endif
+
+/*
+ * With INTERPRETER_REFERENCE_COUNTING (make REFCOUNT=1) the variables referencing each array and string are counted, so that
+ * memory is freed as soon as the last variable referencing it is set to something else or its function returns. Values that are
+ * never held by a variable, and strings held by an array, are not counted and are left for collecting garbage to free
+ */
+
 #ifdef HOST_INTERPRETER
 struct value_defn processAssembledCode(char*, unsigned int, unsigned int, int);
 static unsigned int handleGoto(char*, unsigned int, unsigned int, int);
-static unsigned int handleFnCall(char*, unsigned int, unsigned int*, unsigned int, char, int);
+static unsigned int handleFnCall(char*, unsigned int, unsigned int, char, int);
 static unsigned int handleLet(char*, unsigned int, unsigned int, char, int);
 static unsigned int handleArraySet(char*, unsigned int, unsigned int, int);
 static unsigned int handleIf(char*, unsigned int, unsigned int, int);
 static unsigned int handleFor(char*, unsigned int, unsigned int, int);
+static unsigned int handleForRange(char*, unsigned int, unsigned int, int);
+static unsigned int handleIncSlot(char*, unsigned int, unsigned int, int);
+static unsigned int handleOpAssign(char*, unsigned int, unsigned int, int);
+static unsigned int handleCmpJump(char*, unsigned int, unsigned int, int);
+static unsigned int handleSwitch(char*, unsigned int, unsigned int, int);
+static unsigned int handleArraySet1D(char*, unsigned int, unsigned int, int);
 static unsigned int handleNative(char *, unsigned int, unsigned int, struct value_defn*, int);
 static int getArrayAccessorIndex(struct symbol_node*, char*, unsigned int*, unsigned int, int);
-static struct symbol_node* getVariableSymbol(unsigned short, unsigned char, int, int);
-static int getSymbolTableEntryId(int);
-static void clearVariablesToLevel(unsigned char, int);
+static int getArray1DAccessorIndex(struct symbol_node*, char*, unsigned int*, unsigned int, int);
+static int getArrayOffsetAccessorIndex(struct symbol_node*, char*, unsigned int*, int);
+static int getArrayElementIndex(struct symbol_node*, unsigned char, int*, int);
+static struct symbol_node* getVariableSymbol(unsigned short, int, int);
+static void initialiseSymbolEntries(int, int, int);
+static unsigned int popFrame(int);
+static char* beginScratchValues(int);
+static void endScratchValues(char*, int);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+static void retainValue(struct value_defn*, char, int);
+static void releaseValue(struct value_defn*, char, int);
+#endif
 static struct value_defn getExpressionValue(char*, unsigned int*, unsigned int, int);
+static struct value_defn getIntegerValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getRealValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getBooleanValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getStringValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getNoneValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getFnAddrValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getLetValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getArrayLiteralValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getFnCallValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getNativeValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getIdentifierValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getArrayAccessValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getArrayAccess1DValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getArrayAccessOffsetValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getLogicalValue(unsigned char, char*, unsigned int*, unsigned int, int);
 static int determine_logical_expression(char*, unsigned int*,  unsigned int, int);
 static struct value_defn computeExpressionResult(unsigned char, char*, unsigned int*, unsigned int, int);
+static struct value_defn getPostfixValue(unsigned char, char*, unsigned int*, unsigned int, int);
+static void performArithmetic(unsigned char, struct value_defn*, struct value_defn*, struct value_defn*, int);
+static unsigned char performQuickenedArithmetic(unsigned char, struct value_defn*, struct value_defn*, struct value_defn*, int);
 #else
 struct value_defn processAssembledCode(char*, unsigned int, unsigned int);
 static unsigned int handleGoto(char*, unsigned int, unsigned int);
-static unsigned int handleFnCall(char*, unsigned int, unsigned int*, unsigned int, char);
+static unsigned int handleFnCall(char*, unsigned int, unsigned int, char);
 static unsigned int handleLet(char*, unsigned int, unsigned int, char);
 static unsigned int handleArraySet(char*, unsigned int, unsigned int);
 static unsigned int handleIf(char*, unsigned int, unsigned int);
 static unsigned int handleFor(char*, unsigned int, unsigned int);
+static unsigned int handleForRange(char*, unsigned int, unsigned int);
+static unsigned int handleIncSlot(char*, unsigned int, unsigned int);
+static unsigned int handleOpAssign(char*, unsigned int, unsigned int);
+static unsigned int handleCmpJump(char*, unsigned int, unsigned int);
+static unsigned int handleSwitch(char*, unsigned int, unsigned int);
+static unsigned int handleArraySet1D(char*, unsigned int, unsigned int);
 static unsigned int handleNative(char *, unsigned int, unsigned int, struct value_defn*);
 static int getArrayAccessorIndex(struct symbol_node*, char*, unsigned int*, unsigned int);
-static struct symbol_node* getVariableSymbol(unsigned short, unsigned char, int);
-static int getSymbolTableEntryId(void);
-static void clearVariablesToLevel(unsigned char);
+static int getArray1DAccessorIndex(struct symbol_node*, char*, unsigned int*, unsigned int);
+static int getArrayOffsetAccessorIndex(struct symbol_node*, char*, unsigned int*);
+static int getArrayElementIndex(struct symbol_node*, unsigned char, int*);
+static struct symbol_node* getVariableSymbol(unsigned short, int);
+static void initialiseSymbolEntries(int, int);
+static unsigned int popFrame(void);
+static char* beginScratchValues(void);
+static void endScratchValues(char*);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+static void retainValue(struct value_defn*, char);
+static void releaseValue(struct value_defn*, char);
+#endif
 static struct value_defn getExpressionValue(char*, unsigned int*, unsigned int);
+static struct value_defn getIntegerValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getRealValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getBooleanValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getStringValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getNoneValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getFnAddrValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getLetValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getArrayLiteralValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getFnCallValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getNativeValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getIdentifierValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getArrayAccessValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getArrayAccess1DValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getArrayAccessOffsetValue(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getLogicalValue(unsigned char, char*, unsigned int*, unsigned int);
 static int determine_logical_expression(char*, unsigned int*, unsigned int);
 static struct value_defn computeExpressionResult(unsigned char, char*, unsigned int*, unsigned int);
+static struct value_defn getPostfixValue(unsigned char, char*, unsigned int*, unsigned int);
+static void performArithmetic(unsigned char, struct value_defn*, struct value_defn*, struct value_defn*);
+static unsigned char performQuickenedArithmetic(unsigned char, struct value_defn*, struct value_defn*, struct value_defn*);
 #endif
+static int compareValues(unsigned char, struct value_defn*, struct value_defn*);
+static unsigned char performQuickenedComparison(unsigned char, struct value_defn*, struct value_defn*, int*);
+static int compareIntegers(unsigned char, int, int);
+static int compareReals(unsigned char, float, float);
+#ifdef HOST_INTERPRETER
+void setVariableValue(struct symbol_node*, struct value_defn, int, int);
+#else
 void setVariableValue(struct symbol_node*, struct value_defn, int);
+#endif
 struct value_defn getVariableValue(struct symbol_node*, int);
 static unsigned short getUShort(void*);
 static unsigned char getUChar(void*);
+static unsigned int getCodeAddress(void*);
+static int getCodeInt(void*);
+static char* getValuePointer(struct value_defn*);
+static unsigned int getBlockEnd(char*, unsigned int, unsigned int);
 int getInt(void*);
 float getFloat(void*);
 
+#ifndef INTERPRETER_COMPUTED_GOTO
+#ifdef HOST_INTERPRETER
+static unsigned int handleLetStatement(char*, unsigned int, unsigned int, int);
+static unsigned int handleLetNoAliasStatement(char*, unsigned int, unsigned int, int);
+static unsigned int handleNativeStatement(char *, unsigned int, unsigned int, int);
+#else
+static unsigned int handleLetStatement(char*, unsigned int, unsigned int);
+static unsigned int handleLetNoAliasStatement(char*, unsigned int, unsigned int);
+static unsigned int handleNativeStatement(char *, unsigned int, unsigned int);
+#endif
+
+#ifdef HOST_INTERPRETER
+typedef unsigned int (*statement_handler)(char*, unsigned int, unsigned int, int);
+typedef struct value_defn (*expression_handler)(unsigned char, char*, unsigned int*, unsigned int, int);
+#else
+typedef unsigned int (*statement_handler)(char*, unsigned int, unsigned int);
+typedef struct value_defn (*expression_handler)(unsigned char, char*, unsigned int*, unsigned int);
+#endif
+
+// Handlers for simple statements, function calls and returns (which affect control flow) are NULL here and done in the loop
+static const statement_handler statementHandlers[NUMBER_TOKENS]={
+	[STORE_SLOT_TOKEN]=handleLetStatement, [LETNOALIAS_TOKEN]=handleLetNoAliasStatement, [ARRAYSET_TOKEN]=handleArraySet,
+	[IF_TOKEN]=handleIf, [IFELSE_TOKEN]=handleIf, [FOR_TOKEN]=handleFor, [GOTO_TOKEN]=handleGoto,
+	[NATIVE_TOKEN]=handleNativeStatement, [INC_SLOT_TOKEN]=handleIncSlot, [OP_ASSIGN_TOKEN]=handleOpAssign,
+	[CMP_JUMP_TOKEN]=handleCmpJump, [ARRAYSET_1D_TOKEN]=handleArraySet1D, [SWITCH_TOKEN]=handleSwitch,
+	[FOR_RANGE_TOKEN]=handleForRange };
+
+static const expression_handler expressionHandlers[NUMBER_TOKENS]={
+	[INTEGER_TOKEN]=getIntegerValue, [REAL_TOKEN]=getRealValue, [BOOLEAN_TOKEN]=getBooleanValue, [STRING_TOKEN]=getStringValue,
+	[NONE_TOKEN]=getNoneValue, [FN_ADDR_TOKEN]=getFnAddrValue, [STORE_SLOT_TOKEN]=getLetValue, [ARRAY_TOKEN]=getArrayLiteralValue,
+	[FNCALL_TOKEN]=getFnCallValue, [FNCALL_BY_VAR_TOKEN]=getFnCallValue, [NATIVE_TOKEN]=getNativeValue,
+	[LOAD_SLOT_TOKEN]=getIdentifierValue, [ARRAYACCESS_TOKEN]=getArrayAccessValue,
+	[ADD_TOKEN]=computeExpressionResult, [SUB_TOKEN]=computeExpressionResult, [MUL_TOKEN]=computeExpressionResult,
+	[DIV_TOKEN]=computeExpressionResult, [MOD_TOKEN]=computeExpressionResult, [POW_TOKEN]=computeExpressionResult,
+	[EQ_TOKEN]=getLogicalValue, [NEQ_TOKEN]=getLogicalValue, [GT_TOKEN]=getLogicalValue, [GEQ_TOKEN]=getLogicalValue,
+	[LT_TOKEN]=getLogicalValue, [LEQ_TOKEN]=getLogicalValue, [IS_TOKEN]=getLogicalValue, [AND_TOKEN]=getLogicalValue,
+	[OR_TOKEN]=getLogicalValue, [NOT_TOKEN]=getLogicalValue, [POSTFIX_TOKEN]=getPostfixValue,
+	[ARRAYACCESS_1D_TOKEN]=getArrayAccess1DValue, [INT_ADD_TOKEN]=computeExpressionResult, [INT_SUB_TOKEN]=computeExpressionResult,
+	[INT_MUL_TOKEN]=computeExpressionResult, [INT_DIV_TOKEN]=computeExpressionResult, [REAL_ADD_TOKEN]=computeExpressionResult,
+	[REAL_SUB_TOKEN]=computeExpressionResult, [REAL_MUL_TOKEN]=computeExpressionResult, [REAL_DIV_TOKEN]=computeExpressionResult,
+	[INT_EQ_TOKEN]=getLogicalValue, [INT_NEQ_TOKEN]=getLogicalValue, [INT_LT_TOKEN]=getLogicalValue, [INT_GT_TOKEN]=getLogicalValue,
+	[INT_LEQ_TOKEN]=getLogicalValue, [INT_GEQ_TOKEN]=getLogicalValue, [REAL_EQ_TOKEN]=getLogicalValue, [REAL_NEQ_TOKEN]=getLogicalValue,
+	[REAL_LT_TOKEN]=getLogicalValue, [REAL_GT_TOKEN]=getLogicalValue, [REAL_LEQ_TOKEN]=getLogicalValue, [REAL_GEQ_TOKEN]=getLogicalValue,
+	[ARRAYACCESS_OFFSET_TOKEN]=getArrayAccessOffsetValue };
+#endif
+
 #ifdef HOST_INTERPRETER
 void initThreadedAspectsForInterpreter(int total_number_threads, int baseHostPid, struct shared_basic * basicState) {
 	stopInterpreter=(char*) malloc(total_number_threads);
@@ -112,7 +298,11 @@ void initThreadedAspectsForInterpreter(int total_number_threads, int baseHostPid
 	currentSymbolEntries=(int*) malloc(sizeof(int) * total_number_threads);
 	localCoreId=(int*) malloc(sizeof(int) * total_number_threads);
 	numActiveCores=(int*) malloc(sizeof(int) * total_number_threads);
-	fnLevel=(unsigned char*) malloc(sizeof(unsigned char) * total_number_threads);
+	frameBase=(int*) malloc(sizeof(int) * total_number_threads);
+	symbolTableSize=(int*) malloc(sizeof(int) * total_number_threads);
+	callStack=(struct call_frame**) malloc(sizeof(struct call_frame*) * total_number_threads);
+	callStackDepth=(int*) malloc(sizeof(int) * total_number_threads);
+	scratchValues=(char*) malloc(total_number_threads);
 	initHostCommunicationData(total_number_threads, basicState, baseHostPid);
 	hostCoresBasePid=baseHostPid;
 }
@@ -121,102 +311,307 @@ void initThreadedAspectsForInterpreter(int total_number_threads, int baseHostPid
 #ifdef HOST_INTERPRETER
 void runIntepreter(char * assembled, unsigned int length, unsigned short numberSymbols,
 		int coreId, int numberActiveCores, int threadId) {
+	unsigned short numberGlobals=getUShort(assembled);
 	stopInterpreter[threadId]=0;
-	currentSymbolEntries[threadId]=-1;
-	fnLevel[threadId]=0;
+	frameBase[threadId]=0;
+	currentSymbolEntries[threadId]=numberGlobals-1;
 	localCoreId[threadId]=coreId;
 	numActiveCores[threadId]=numberActiveCores;
 	symbolTable[threadId]=initialiseSymbolTable(numberSymbols);
-	processAssembledCode(assembled, 0, length, threadId);
+	symbolTableSize[threadId]=numberSymbols;
+	callStack[threadId]=(struct call_frame*) getStackMemory(sizeof(struct call_frame) * MAX_CALL_STACK_DEPTH, 0);
+	callStackDepth[threadId]=0;
+	scratchValues[threadId]=0;
+	initialiseSymbolEntries(0, numberGlobals, threadId);
+	processAssembledCode(assembled, CODE_USHORT_SIZE, length, threadId);
 }
 
 #else
 void runIntepreter(char * assembled, unsigned int length, unsigned short numberSymbols,
 		int coreId, int numberActiveCores, int baseHostPid) {
+	unsigned short numberGlobals=getUShort(assembled);
 	stopInterpreter=0;
-	currentSymbolEntries=-1;
-	fnLevel=0;
+	frameBase=0;
+	currentSymbolEntries=numberGlobals-1;
 	localCoreId=coreId;
 	numActiveCores=numberActiveCores;
 	symbolTable=initialiseSymbolTable(numberSymbols);
+	symbolTableSize=numberSymbols;
+	callStack=(struct call_frame*) getStackMemory(sizeof(struct call_frame) * MAX_CALL_STACK_DEPTH, 0);
+	callStackDepth=0;
+	scratchValues=0;
+	initialiseSymbolEntries(0, numberGlobals);
 	hostCoresBasePid=baseHostPid;
-	processAssembledCode(assembled, 0, length);
+	processAssembledCode(assembled, CODE_USHORT_SIZE, length);
 }
 #endif
 
 #ifdef HOST_INTERPRETER
 /**
- * Entry function which will process the assembled code and perform the required actions
+ * Entry function which will process the assembled code and perform the required actions. Call statements and returns are
+ * handled within this loop via the call stack, only a call within an expression enters a nested loop (see getFnCallValue),
+ * which returns once a return is made at the call depth it was entered at
  */
 struct value_defn processAssembledCode(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
 	struct value_defn empty;
 	empty.type=NONE_TYPE;
 	empty.dtype=SCALAR;
-	unsigned int i, fnAddr;
-	for (i=currentPoint;i<length;) {
-		unsigned char command=getUChar(&assembled[i]);
-		i+=sizeof(unsigned char);
-		if (command == LET_TOKEN) i=handleLet(assembled, i, length, 0, threadId);
-		if (command == LETNOALIAS_TOKEN) i=handleLet(assembled, i, length, 1, threadId);
-		if (command == ARRAYSET_TOKEN) i=handleArraySet(assembled, i, length, threadId);
-		if (command == STOP_TOKEN) return empty;
-		if (command == IF_TOKEN) i=handleIf(assembled, i, length, threadId);
-		if (command == IFELSE_TOKEN) i=handleIf(assembled, i, length, threadId);
-		if (command == FOR_TOKEN) i=handleFor(assembled, i, length, threadId);
-		if (command == GOTO_TOKEN) i=handleGoto(assembled, i, length, threadId);
-		if (command == FNCALL_TOKEN || command == FNCALL_BY_VAR_TOKEN) {
-			i=handleFnCall(assembled, i, &fnAddr, length, command == FNCALL_BY_VAR_TOKEN ? 1:0, threadId);
-			fnLevel[threadId]++;
-			processAssembledCode(assembled, fnAddr, length, threadId);
-			clearVariablesToLevel(fnLevel[threadId], threadId);
-			fnLevel[threadId]--;
-		}
-		if (command == NATIVE_TOKEN) i=handleNative(assembled, i, length, NULL, threadId);
-		if (command == RETURN_TOKEN) return empty;
-		if (command == RETURN_EXP_TOKEN) {
-			return getExpressionValue(assembled, &i, length, threadId);
+	unsigned int i=currentPoint;
+	int entryCallDepth=callStackDepth[threadId];
+	unsigned char command;
+#ifdef INTERPRETER_COMPUTED_GOTO
+	static void * statementLabels[NUMBER_TOKENS]={
+		[STORE_SLOT_TOKEN]=&&let, [STOP_TOKEN]=&&stop, [OR_TOKEN]=&&noop, [AND_TOKEN]=&&noop, [EQ_TOKEN]=&&noop,
+		[NEQ_TOKEN]=&&noop, [LT_TOKEN]=&&noop, [GT_TOKEN]=&&noop, [LEQ_TOKEN]=&&noop, [GEQ_TOKEN]=&&noop,
+		[ADD_TOKEN]=&&noop, [SUB_TOKEN]=&&noop, [MUL_TOKEN]=&&noop, [DIV_TOKEN]=&&noop, [MOD_TOKEN]=&&noop,
+		[LOAD_SLOT_TOKEN]=&&noop, [REAL_TOKEN]=&&noop, [STRING_TOKEN]=&&noop, [INTEGER_TOKEN]=&&noop, [IF_TOKEN]=&&ifstmt,
+		[FOR_TOKEN]=&&forstmt, [GOTO_TOKEN]=&&gotostmt, [ARRAYACCESS_TOKEN]=&&noop, [ARRAYSET_TOKEN]=&&arrayset,
+		[IFELSE_TOKEN]=&&ifstmt, [POW_TOKEN]=&&noop, [RETURN_TOKEN]=&&returnstmt, [FNCALL_TOKEN]=&&fncall,
+		[RETURN_EXP_TOKEN]=&&returnexp, [BOOLEAN_TOKEN]=&&noop, [LETNOALIAS_TOKEN]=&&letnoalias, [NONE_TOKEN]=&&noop,
+		[IS_TOKEN]=&&noop, [ARRAY_TOKEN]=&&noop, [NOT_TOKEN]=&&noop, [NATIVE_TOKEN]=&&native, [FN_ADDR_TOKEN]=&&noop,
+		[FNCALL_BY_VAR_TOKEN]=&&fncall, [POSTFIX_TOKEN]=&&noop, [INC_SLOT_TOKEN]=&&incslot, [OP_ASSIGN_TOKEN]=&&opassign,
+		[CMP_JUMP_TOKEN]=&&cmpjump, [ARRAYACCESS_1D_TOKEN]=&&noop, [ARRAYSET_1D_TOKEN]=&&arrayset1d,
+		[INT_ADD_TOKEN ... REAL_GEQ_TOKEN]=&&noop, [SWITCH_TOKEN]=&&switchstmt, [ARRAYACCESS_OFFSET_TOKEN]=&&noop,
+		[FOR_RANGE_TOKEN]=&&forrangestmt };
+#define DISPATCH_NEXT_STATEMENT() if (i >= length) return empty; \
+	command=getUChar(&assembled[i]); \
+	i+=CODE_UCHAR_SIZE; \
+	goto *statementLabels[command]
+#define END_STATEMENT() if (stopInterpreter[threadId]) return empty; \
+	DISPATCH_NEXT_STATEMENT()
+
+	DISPATCH_NEXT_STATEMENT();
+let:
+	i=handleLet(assembled, i, length, 0, threadId);
+	END_STATEMENT();
+letnoalias:
+	i=handleLet(assembled, i, length, 1, threadId);
+	END_STATEMENT();
+arrayset:
+	i=handleArraySet(assembled, i, length, threadId);
+	END_STATEMENT();
+arrayset1d:
+	i=handleArraySet1D(assembled, i, length, threadId);
+	END_STATEMENT();
+incslot:
+	i=handleIncSlot(assembled, i, length, threadId);
+	END_STATEMENT();
+opassign:
+	i=handleOpAssign(assembled, i, length, threadId);
+	END_STATEMENT();
+cmpjump:
+	i=handleCmpJump(assembled, i, length, threadId);
+	END_STATEMENT();
+switchstmt:
+	i=handleSwitch(assembled, i, length, threadId);
+	END_STATEMENT();
+ifstmt:
+	i=handleIf(assembled, i, length, threadId);
+	END_STATEMENT();
+forstmt:
+	i=handleFor(assembled, i, length, threadId);
+	END_STATEMENT();
+forrangestmt:
+	i=handleForRange(assembled, i, length, threadId);
+	END_STATEMENT();
+gotostmt:
+	i=handleGoto(assembled, i, length, threadId);
+	END_STATEMENT();
+fncall:
+	i=handleFnCall(assembled, i, length, command == FNCALL_BY_VAR_TOKEN ? 1:0, threadId);
+	END_STATEMENT();
+native:
+	i=handleNative(assembled, i, length, NULL, threadId);
+	END_STATEMENT();
+noop:
+	END_STATEMENT();
+returnstmt:
+	if (callStackDepth[threadId] == entryCallDepth) return empty;
+	i=popFrame(threadId);
+	END_STATEMENT();
+returnexp:
+	if (callStackDepth[threadId] == entryCallDepth) return getExpressionValue(assembled, &i, length, threadId);
+	getExpressionValue(assembled, &i, length, threadId);
+	i=popFrame(threadId);
+	END_STATEMENT();
+stop:
+	return empty;
+#undef DISPATCH_NEXT_STATEMENT
+#undef END_STATEMENT
+#else
+	statement_handler handler;
+	while (i<length) {
+		command=getUChar(&assembled[i]);
+		i+=CODE_UCHAR_SIZE;
+		handler=statementHandlers[command];
+		if (handler != NULL) {
+			i=handler(assembled, i, length, threadId);
+		} else if (command == FNCALL_TOKEN || command == FNCALL_BY_VAR_TOKEN) {
+			i=handleFnCall(assembled, i, length, command == FNCALL_BY_VAR_TOKEN ? 1:0, threadId);
+		} else if (command == STOP_TOKEN) {
+			return empty;
+		} else if (command == RETURN_TOKEN) {
+			if (callStackDepth[threadId] == entryCallDepth) return empty;
+			i=popFrame(threadId);
+		} else if (command == RETURN_EXP_TOKEN) {
+			if (callStackDepth[threadId] == entryCallDepth) return getExpressionValue(assembled, &i, length, threadId);
+			getExpressionValue(assembled, &i, length, threadId);
+			i=popFrame(threadId);
 		}
 		if (stopInterpreter[threadId]) return empty;
 	}
 	return empty;
+#endif
 }
 #else
 /**
- * Entry function which will process the assembled code and perform the required actions
+ * Entry function which will process the assembled code and perform the required actions. Call statements and returns are
+ * handled within this loop via the call stack, only a call within an expression enters a nested loop (see getFnCallValue),
+ * which returns once a return is made at the call depth it was entered at
  */
 struct value_defn processAssembledCode(char * assembled, unsigned int currentPoint, unsigned int length) {
 	struct value_defn empty;
 	empty.type=NONE_TYPE;
 	empty.dtype=SCALAR;
-	unsigned int i, fnAddr;
-	for (i=currentPoint;i<length;) {
-		unsigned char command=getUChar(&assembled[i]);
-		i+=sizeof(unsigned char);
-		if (command == LET_TOKEN) i=handleLet(assembled, i, length, 0);
-		if (command == LETNOALIAS_TOKEN) i=handleLet(assembled, i, length, 1);
-		if (command == ARRAYSET_TOKEN) i=handleArraySet(assembled, i, length);
-		if (command == STOP_TOKEN) return empty;
-		if (command == IF_TOKEN) i=handleIf(assembled, i, length);
-		if (command == IFELSE_TOKEN) i=handleIf(assembled, i, length);
-		if (command == FOR_TOKEN) i=handleFor(assembled, i, length);
-		if (command == GOTO_TOKEN) i=handleGoto(assembled, i, length);
-		if (command == FNCALL_TOKEN || command == FNCALL_BY_VAR_TOKEN) {
-			i=handleFnCall(assembled, i, &fnAddr, length, command == FNCALL_BY_VAR_TOKEN ? 1:0);
-			fnLevel++;
-			processAssembledCode(assembled, fnAddr, length);
-			clearVariablesToLevel(fnLevel);
-			fnLevel--;
-		}
-		if (command == NATIVE_TOKEN) i=handleNative(assembled, i, length, NULL);
-		if (command == RETURN_TOKEN) return empty;
-		if (command == RETURN_EXP_TOKEN) {
-			return getExpressionValue(assembled, &i, length);
+	unsigned int i=currentPoint;
+	int entryCallDepth=callStackDepth;
+	unsigned char command;
+#ifdef INTERPRETER_COMPUTED_GOTO
+	static void * statementLabels[NUMBER_TOKENS]={
+		[STORE_SLOT_TOKEN]=&&let, [STOP_TOKEN]=&&stop, [OR_TOKEN]=&&noop, [AND_TOKEN]=&&noop, [EQ_TOKEN]=&&noop,
+		[NEQ_TOKEN]=&&noop, [LT_TOKEN]=&&noop, [GT_TOKEN]=&&noop, [LEQ_TOKEN]=&&noop, [GEQ_TOKEN]=&&noop,
+		[ADD_TOKEN]=&&noop, [SUB_TOKEN]=&&noop, [MUL_TOKEN]=&&noop, [DIV_TOKEN]=&&noop, [MOD_TOKEN]=&&noop,
+		[LOAD_SLOT_TOKEN]=&&noop, [REAL_TOKEN]=&&noop, [STRING_TOKEN]=&&noop, [INTEGER_TOKEN]=&&noop, [IF_TOKEN]=&&ifstmt,
+		[FOR_TOKEN]=&&forstmt, [GOTO_TOKEN]=&&gotostmt, [ARRAYACCESS_TOKEN]=&&noop, [ARRAYSET_TOKEN]=&&arrayset,
+		[IFELSE_TOKEN]=&&ifstmt, [POW_TOKEN]=&&noop, [RETURN_TOKEN]=&&returnstmt, [FNCALL_TOKEN]=&&fncall,
+		[RETURN_EXP_TOKEN]=&&returnexp, [BOOLEAN_TOKEN]=&&noop, [LETNOALIAS_TOKEN]=&&letnoalias, [NONE_TOKEN]=&&noop,
+		[IS_TOKEN]=&&noop, [ARRAY_TOKEN]=&&noop, [NOT_TOKEN]=&&noop, [NATIVE_TOKEN]=&&native, [FN_ADDR_TOKEN]=&&noop,
+		[FNCALL_BY_VAR_TOKEN]=&&fncall, [POSTFIX_TOKEN]=&&noop, [INC_SLOT_TOKEN]=&&incslot, [OP_ASSIGN_TOKEN]=&&opassign,
+		[CMP_JUMP_TOKEN]=&&cmpjump, [ARRAYACCESS_1D_TOKEN]=&&noop, [ARRAYSET_1D_TOKEN]=&&arrayset1d,
+		[INT_ADD_TOKEN ... REAL_GEQ_TOKEN]=&&noop, [SWITCH_TOKEN]=&&switchstmt, [ARRAYACCESS_OFFSET_TOKEN]=&&noop,
+		[FOR_RANGE_TOKEN]=&&forrangestmt };
+#define DISPATCH_NEXT_STATEMENT() if (i >= length) return empty; \
+	command=getUChar(&assembled[i]); \
+	i+=CODE_UCHAR_SIZE; \
+	goto *statementLabels[command]
+#define END_STATEMENT() if (stopInterpreter) return empty; \
+	DISPATCH_NEXT_STATEMENT()
+
+	DISPATCH_NEXT_STATEMENT();
+let:
+	i=handleLet(assembled, i, length, 0);
+	END_STATEMENT();
+letnoalias:
+	i=handleLet(assembled, i, length, 1);
+	END_STATEMENT();
+arrayset:
+	i=handleArraySet(assembled, i, length);
+	END_STATEMENT();
+arrayset1d:
+	i=handleArraySet1D(assembled, i, length);
+	END_STATEMENT();
+incslot:
+	i=handleIncSlot(assembled, i, length);
+	END_STATEMENT();
+opassign:
+	i=handleOpAssign(assembled, i, length);
+	END_STATEMENT();
+cmpjump:
+	i=handleCmpJump(assembled, i, length);
+	END_STATEMENT();
+switchstmt:
+	i=handleSwitch(assembled, i, length);
+	END_STATEMENT();
+ifstmt:
+	i=handleIf(assembled, i, length);
+	END_STATEMENT();
+forstmt:
+	i=handleFor(assembled, i, length);
+	END_STATEMENT();
+forrangestmt:
+	i=handleForRange(assembled, i, length);
+	END_STATEMENT();
+gotostmt:
+	i=handleGoto(assembled, i, length);
+	END_STATEMENT();
+fncall:
+	i=handleFnCall(assembled, i, length, command == FNCALL_BY_VAR_TOKEN ? 1:0);
+	END_STATEMENT();
+native:
+	i=handleNative(assembled, i, length, NULL);
+	END_STATEMENT();
+noop:
+	END_STATEMENT();
+returnstmt:
+	if (callStackDepth == entryCallDepth) return empty;
+	i=popFrame();
+	END_STATEMENT();
+returnexp:
+	if (callStackDepth == entryCallDepth) return getExpressionValue(assembled, &i, length);
+	getExpressionValue(assembled, &i, length);
+	i=popFrame();
+	END_STATEMENT();
+stop:
+	return empty;
+#undef DISPATCH_NEXT_STATEMENT
+#undef END_STATEMENT
+#else
+	statement_handler handler;
+	while (i<length) {
+		command=getUChar(&assembled[i]);
+		i+=CODE_UCHAR_SIZE;
+		handler=statementHandlers[command];
+		if (handler != NULL) {
+			i=handler(assembled, i, length);
+		} else if (command == FNCALL_TOKEN || command == FNCALL_BY_VAR_TOKEN) {
+			i=handleFnCall(assembled, i, length, command == FNCALL_BY_VAR_TOKEN ? 1:0);
+		} else if (command == STOP_TOKEN) {
+			return empty;
+		} else if (command == RETURN_TOKEN) {
+			if (callStackDepth == entryCallDepth) return empty;
+			i=popFrame();
+		} else if (command == RETURN_EXP_TOKEN) {
+			if (callStackDepth == entryCallDepth) return getExpressionValue(assembled, &i, length);
+			getExpressionValue(assembled, &i, length);
+			i=popFrame();
 		}
 		if (stopInterpreter) return empty;
 	}
 	return empty;
+#endif
+}
+#endif
+
+#ifndef INTERPRETER_COMPUTED_GOTO
+/**
+ * Statement forms of LET, LETNOALIAS and NATIVE, which have a common signature for the dispatch table
+ */
+#ifdef HOST_INTERPRETER
+static unsigned int handleLetStatement(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+	return handleLet(assembled, currentPoint, length, 0, threadId);
+}
+
+static unsigned int handleLetNoAliasStatement(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+	return handleLet(assembled, currentPoint, length, 1, threadId);
+}
+
+static unsigned int handleNativeStatement(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+	return handleNative(assembled, currentPoint, length, NULL, threadId);
+}
+#else
+static unsigned int handleLetStatement(char * assembled, unsigned int currentPoint, unsigned int length) {
+	return handleLet(assembled, currentPoint, length, 0);
+}
+
+static unsigned int handleLetNoAliasStatement(char * assembled, unsigned int currentPoint, unsigned int length) {
+	return handleLet(assembled, currentPoint, length, 1);
+}
+
+static unsigned int handleNativeStatement(char * assembled, unsigned int currentPoint, unsigned int length) {
+	return handleNative(assembled, currentPoint, length, NULL);
 }
 #endif
+#endif
 
 /**
  * Goto some absolute location in the byte code
@@ -226,7 +621,7 @@ static unsigned int handleGoto(char * assembled, unsigned int currentPoint, unsi
 #else
 static unsigned int handleGoto(char * assembled, unsigned int currentPoint, unsigned int length) {
 #endif
-	return getUShort(&assembled[currentPoint]);
+	return getCodeAddress(&assembled[currentPoint]);
 }
 
 #ifdef HOST_INTERPRETER
@@ -235,17 +630,43 @@ static unsigned int handleNative(char * assembled, unsigned int currentPoint, un
 static unsigned int handleNative(char * assembled, unsigned int currentPoint, unsigned int length, struct value_defn * returnValue) {
 #endif
     unsigned char fnCode=getUChar(&assembled[currentPoint]);
-	currentPoint+=sizeof(unsigned char);
+	currentPoint+=CODE_UCHAR_SIZE;
 	unsigned short numArgs=getUShort(&assembled[currentPoint]);
-	currentPoint+=sizeof(unsigned short);
+	currentPoint+=CODE_USHORT_SIZE;
 
     struct value_defn toPassValues[numArgs];
-	int i;
+	int i, heldTemporaries=0;
+	// Only what is displayed is known not to outlive the call, the arguments of any other native function might be kept
+	char * scratchMark=NULL;
+#ifdef HOST_INTERPRETER
+	char scratch=scratchValues[threadId];
+	if (fnCode == NATIVE_FN_RTL_PRINT || fnCode == NATIVE_FN_RTL_INPUTPRINT) {
+		scratchMark=beginScratchValues(threadId);
+	} else {
+		scratchValues[threadId]=0;
+	}
+#else
+	char scratch=scratchValues;
+	if (fnCode == NATIVE_FN_RTL_PRINT || fnCode == NATIVE_FN_RTL_INPUTPRINT) {
+		scratchMark=beginScratchValues();
+	} else {
+		scratchValues=0;
+	}
+#endif
+	// Strings and arrays passed are held until the call returns, so evaluating later arguments does not free or move them
 	for (i=0;i<numArgs;i++) {
 #ifdef HOST_INTERPRETER
         toPassValues[i]=getExpressionValue(assembled, &currentPoint, length, threadId);
+        if (toPassValues[i].type == STRING_TYPE || toPassValues[i].dtype == ARRAY) {
+            holdTemporary(getValuePointer(&toPassValues[i]), threadId);
+            heldTemporaries++;
+        }
 #else
         toPassValues[i]=getExpressionValue(assembled, &currentPoint, length);
+        if (toPassValues[i].type == STRING_TYPE || toPassValues[i].dtype == ARRAY) {
+            holdTemporary(getValuePointer(&toPassValues[i]));
+            heldTemporaries++;
+        }
 #endif
 	}
 	if (returnValue != NULL) {
@@ -260,60 +681,137 @@ static unsigned int handleNative(char * assembled, unsigned int currentPoint, un
         callNativeFunction(&dummy, fnCode, numArgs, toPassValues, numActiveCores[threadId], localCoreId[threadId], currentSymbolEntries[threadId], symbolTable[threadId], threadId);
 #else
         callNativeFunction(&dummy, fnCode, numArgs, toPassValues, numActiveCores, localCoreId, currentSymbolEntries, symbolTable);
+#endif
+	}
+#ifdef HOST_INTERPRETER
+	endScratchValues(scratchMark, threadId);
+	scratchValues[threadId]=scratch;
+#else
+	endScratchValues(scratchMark);
+	scratchValues=scratch;
+#endif
+	if (heldTemporaries > 0) {
+#ifdef HOST_INTERPRETER
+		releaseTemporaries(heldTemporaries, threadId);
+#else
+		releaseTemporaries(heldTemporaries);
 #endif
 	}
 	return currentPoint;
 }
 
 /**
- * Calls some function and stores the call point in the function call stack for returning from this function
+ * Calls some function, this pushes a record onto the call stack and a new frame for the function's variables onto the symbol
+ * table (after the caller's frame) and passes the arguments into it. Values are copied into parameters, apart from those which
+ * the function assigns to that alias the caller's variable passed. Returns the address of the function's code, the point to
+ * resume at in the caller is held in the call record and returned when the frame is popped
  */
 #ifdef HOST_INTERPRETER
-static unsigned int handleFnCall(char * assembled, unsigned int currentPoint, unsigned int * functionAddress, unsigned int length, char calledByVar, int threadId) {
+static unsigned int handleFnCall(char * assembled, unsigned int currentPoint, unsigned int length, char calledByVar, int threadId) {
 #else
-static unsigned int handleFnCall(char * assembled, unsigned int currentPoint, unsigned int * functionAddress, unsigned int length, char calledByVar) {
+static unsigned int handleFnCall(char * assembled, unsigned int currentPoint, unsigned int length, char calledByVar) {
 #endif
-	unsigned short fnAddress;
+	unsigned int fnAddress;
 	if (calledByVar) {
 #ifdef HOST_INTERPRETER
-        struct symbol_node* callVar=getVariableSymbol(getUShort(&assembled[currentPoint]), fnLevel[threadId], threadId, 1);
+        struct symbol_node* callVar=getVariableSymbol(getUShort(&assembled[currentPoint]), threadId, 1);
 #else
-        struct symbol_node* callVar=getVariableSymbol(getUShort(&assembled[currentPoint]), fnLevel, 1);
+        struct symbol_node* callVar=getVariableSymbol(getUShort(&assembled[currentPoint]), 1);
 #endif
         if (callVar->value.type != FN_ADDR_TYPE) raiseError(ERR_FNCALL_VAR_NOT_CONTAINING_FN_PTR);
-        char *ptr;
-        cpy(&ptr, callVar->value.data, sizeof(char*));
-        fnAddress=getUShort(ptr);
+        fnAddress=(unsigned int) getInt(callVar->value.data);
 	} else {
-        fnAddress=getUShort(&assembled[currentPoint]);
+        fnAddress=getCodeAddress(&assembled[currentPoint]);
 	}
-	currentPoint+=sizeof(unsigned short);
+	currentPoint+=CODE_USHORT_SIZE;
 
+	unsigned short fnNumLocals=getUShort(&assembled[fnAddress]);
+	fnAddress+=CODE_USHORT_SIZE;
 	unsigned short fnNumArgs=getUShort(&assembled[fnAddress]);
-	fnAddress+=sizeof(unsigned short);
+	fnAddress+=CODE_USHORT_SIZE;
+
+#ifdef HOST_INTERPRETER
+	int newFrameBase=currentSymbolEntries[threadId]+1;
+	if (callStackDepth[threadId] >= MAX_CALL_STACK_DEPTH || newFrameBase+fnNumLocals > symbolTableSize[threadId]) {
+		raiseError(ERR_CALL_STACK_DEPTH_EXCEEDED);
+		return currentPoint;
+	}
+	initialiseSymbolEntries(newFrameBase, fnNumLocals, threadId);
+#else
+	int newFrameBase=currentSymbolEntries+1;
+	if (callStackDepth >= MAX_CALL_STACK_DEPTH || newFrameBase+fnNumLocals > symbolTableSize) {
+		raiseError(ERR_CALL_STACK_DEPTH_EXCEEDED);
+		return currentPoint;
+	}
+	initialiseSymbolEntries(newFrameBase, fnNumLocals);
+#endif
 
 	unsigned short callerNumArgs=getUShort(&assembled[currentPoint]);
-	currentPoint+=sizeof(unsigned short);
-	struct symbol_node* srcSymbol, *targetSymbol;
-	int i, numArgs;
-	numArgs=fnNumArgs > callerNumArgs ? fnNumArgs : callerNumArgs;
-	for (i=0;i<numArgs;i++) {
-		if (i<callerNumArgs && i<fnNumArgs) {
+	currentPoint+=CODE_USHORT_SIZE;
+	// Expressions of arguments passed by value follow the argument slots and are evaluated in the caller's frame
+	unsigned int argumentPoint=currentPoint+(callerNumArgs*CODE_USHORT_SIZE);
+	unsigned short argumentSlot, parameterSlot=0;
+	struct symbol_node* targetSymbol;
+	struct value_defn argumentValue;
+	int i;
+	for (i=0;i<callerNumArgs;i++) {
+		argumentSlot=getUShort(&assembled[currentPoint+(i*CODE_USHORT_SIZE)]);
+		targetSymbol=NULL;
+		if (i<fnNumArgs) {
+			parameterSlot=getUShort(&assembled[fnAddress+(i*CODE_USHORT_SIZE)]);
+#ifdef HOST_INTERPRETER
+			targetSymbol=&symbolTable[threadId][newFrameBase + (parameterSlot & ~REFERENCE_PARAMETER_FLAG)];
+#else
+			targetSymbol=&symbolTable[newFrameBase + (parameterSlot & ~REFERENCE_PARAMETER_FLAG)];
+#endif
+		}
+		if (argumentSlot == VALUE_ARGUMENT_SLOT) {
+#ifdef HOST_INTERPRETER
+			argumentValue=getExpressionValue(assembled, &argumentPoint, length, threadId);
+#else
+			argumentValue=getExpressionValue(assembled, &argumentPoint, length);
+#endif
+		} else if (targetSymbol != NULL && parameterSlot & REFERENCE_PARAMETER_FLAG) {
+			// Assigned by the function so aliased, directly to the variable holding the value so there is at most one hop
 #ifdef HOST_INTERPRETER
-			srcSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), fnLevel[threadId], threadId, 0);
-			targetSymbol=getVariableSymbol(getUShort(&assembled[fnAddress]), fnLevel[threadId]+1, threadId, 0);
+			targetSymbol->alias=(unsigned short) (getVariableSymbol(argumentSlot, threadId, 1)-symbolTable[threadId]);
 #else
-			srcSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), fnLevel, 0);
-			targetSymbol=getVariableSymbol(getUShort(&assembled[fnAddress]), fnLevel+1, 0);
+			targetSymbol->alias=(unsigned short) (getVariableSymbol(argumentSlot, 1)-symbolTable);
 #endif
 			targetSymbol->state=ALIAS;
-			targetSymbol->alias=srcSymbol->id;
+			continue;
+		} else if (targetSymbol != NULL) {
+#ifdef HOST_INTERPRETER
+			argumentValue=getVariableSymbol(argumentSlot, threadId, 1)->value;
+#else
+			argumentValue=getVariableSymbol(argumentSlot, 1)->value;
+#endif
+		}
+		if (targetSymbol != NULL) {
+			targetSymbol->value=argumentValue;
+			targetSymbol->state=ARGUMENT;
+#ifdef INTERPRETER_REFERENCE_COUNTING
+#ifdef HOST_INTERPRETER
+			retainValue(&argumentValue, 0, threadId);
+#else
+			retainValue(&argumentValue, 0);
+#endif
+#endif
 		}
-		if (i<callerNumArgs) currentPoint+=sizeof(unsigned short);
-		if (i<fnNumArgs) fnAddress+=sizeof(unsigned short);
 	}
-	*functionAddress=fnAddress;
-	return currentPoint;
+	currentPoint=argumentPoint;
+	fnAddress+=fnNumArgs*CODE_USHORT_SIZE;
+#ifdef HOST_INTERPRETER
+	struct call_frame* callRecord=&callStack[threadId][callStackDepth[threadId]++];
+	callRecord->previousFrameBase=frameBase[threadId];
+	frameBase[threadId]=newFrameBase;
+#else
+	struct call_frame* callRecord=&callStack[callStackDepth++];
+	callRecord->previousFrameBase=frameBase;
+	frameBase=newFrameBase;
+#endif
+	callRecord->returnPoint=currentPoint;
+	return fnAddress;
 }
 
 /**
@@ -325,20 +823,24 @@ static unsigned int handleFor(char * assembled, unsigned int currentPoint, unsig
 static unsigned int handleFor(char * assembled, unsigned int currentPoint, unsigned int length) {
 #endif
 	unsigned short loopIncrementerId=getUShort(&assembled[currentPoint]);
-	currentPoint+=sizeof(unsigned short);
+	currentPoint+=CODE_USHORT_SIZE;
 	unsigned short loopVariantId=getUShort(&assembled[currentPoint]);
-	currentPoint+=sizeof(unsigned short);
+	currentPoint+=CODE_USHORT_SIZE;
+	// The loop's array is evaluated on each iteration only to read the next element from, so a literal is placed in the scratch arena
 #ifdef HOST_INTERPRETER
-	struct symbol_node* incrementVarSymbol=getVariableSymbol(loopIncrementerId, fnLevel[threadId], threadId, 1);
-	struct symbol_node* variantVarSymbol=getVariableSymbol(loopVariantId, fnLevel[threadId], threadId, 1);
+	struct symbol_node* incrementVarSymbol=getVariableSymbol(loopIncrementerId, threadId, 1);
+	struct symbol_node* variantVarSymbol=getVariableSymbol(loopVariantId, threadId, 1);
+	char * scratchMark=beginScratchValues(threadId);
 	struct value_defn expressionVal=getExpressionValue(assembled, &currentPoint, length, threadId);
 #else
-	struct symbol_node* incrementVarSymbol=getVariableSymbol(loopIncrementerId, fnLevel, 1);
-	struct symbol_node* variantVarSymbol=getVariableSymbol(loopVariantId, fnLevel, 1);
+	struct symbol_node* incrementVarSymbol=getVariableSymbol(loopIncrementerId, 1);
+	struct symbol_node* variantVarSymbol=getVariableSymbol(loopVariantId, 1);
+	char * scratchMark=beginScratchValues();
 	struct value_defn expressionVal=getExpressionValue(assembled, &currentPoint, length);
 #endif
-	unsigned short blockLen=getUShort(&assembled[currentPoint]);
-	currentPoint+=sizeof(unsigned short);
+	// The loop exits past its block and the goto at the end of it
+	unsigned int exitPoint=getBlockEnd(assembled, currentPoint, sizeof(unsigned char)+sizeof(unsigned short));
+	currentPoint+=CODE_USHORT_SIZE;
 
 	char * ptr;
 	int singleSize, arrSize=1, i, headersize;
@@ -356,12 +858,72 @@ static unsigned int handleFor(char * assembled, unsigned int currentPoint, unsig
 	if (incrementVal < arrSize) {
 		struct value_defn nextElement;
 		nextElement.type=expressionVal.type;
+		nextElement.dtype=SCALAR;
 		cpy(&nextElement.data, ptr+((incrementVal*sizeof(int)) + headersize), sizeof(int));
+#ifdef HOST_INTERPRETER
+		setVariableValue(variantVarSymbol, nextElement, -1, threadId);
+		endScratchValues(scratchMark, threadId);
+#else
 		setVariableValue(variantVarSymbol, nextElement, -1);
+		endScratchValues(scratchMark);
+#endif
 		return currentPoint;
 	}
-	currentPoint+=(blockLen+sizeof(unsigned short)+sizeof(unsigned char));
-	return currentPoint;
+#ifdef HOST_INTERPRETER
+	endScratchValues(scratchMark, threadId);
+#else
+	endScratchValues(scratchMark);
+#endif
+	return exitPoint;
+}
+
+/**
+ * Counted loop iteration over a range, the counter is tested against the stop (inclusive as with range, counting down if the
+ * step is negative) and if within it the loop variable is set to the counter which then moves on by the step
+ */
+#ifdef HOST_INTERPRETER
+static unsigned int handleForRange(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+	struct symbol_node* variantVarSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), threadId, 1);
+	struct symbol_node* counterVarSymbol=getVariableSymbol(getUShort(&assembled[currentPoint+CODE_USHORT_SIZE]), threadId, 1);
+	struct value_defn stopVal=getVariableSymbol(getUShort(&assembled[currentPoint+CODE_USHORT_SIZE*2]), threadId, 1)->value;
+	struct value_defn stepVal=getVariableSymbol(getUShort(&assembled[currentPoint+CODE_USHORT_SIZE*3]), threadId, 1)->value;
+#else
+static unsigned int handleForRange(char * assembled, unsigned int currentPoint, unsigned int length) {
+	struct symbol_node* variantVarSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), 1);
+	struct symbol_node* counterVarSymbol=getVariableSymbol(getUShort(&assembled[currentPoint+CODE_USHORT_SIZE]), 1);
+	struct value_defn stopVal=getVariableSymbol(getUShort(&assembled[currentPoint+CODE_USHORT_SIZE*2]), 1)->value;
+	struct value_defn stepVal=getVariableSymbol(getUShort(&assembled[currentPoint+CODE_USHORT_SIZE*3]), 1)->value;
+#endif
+	currentPoint+=CODE_USHORT_SIZE*4;
+	struct value_defn counterVal=counterVarSymbol->value;
+	if (counterVal.type == INT_TYPE && stopVal.type == INT_TYPE && stepVal.type == INT_TYPE) {
+		int counter=getInt(counterVal.data), stop=getInt(stopVal.data), step=getInt(stepVal.data);
+		if (step < 0 ? counter < stop : counter > stop) {
+			return getBlockEnd(assembled, currentPoint, sizeof(unsigned char)+sizeof(unsigned short));
+		}
+		counter+=step;
+		cpy(counterVarSymbol->value.data, &counter, sizeof(int));
+	} else {
+		struct value_defn zero;
+		int countsDown;
+		zero.type=INT_TYPE;
+		zero.dtype=SCALAR;
+		countsDown=0;
+		cpy(zero.data, &countsDown, sizeof(int));
+		countsDown=compareValues(LT_TOKEN, &stepVal, &zero);
+		if (compareValues(countsDown ? LT_TOKEN : GT_TOKEN, &counterVal, &stopVal)) {
+			return getBlockEnd(assembled, currentPoint, sizeof(unsigned char)+sizeof(unsigned short));
+		}
+#ifdef HOST_INTERPRETER
+		performArithmetic(ADD_TOKEN, &counterVal, &stepVal, &counterVarSymbol->value, threadId);
+#else
+		performArithmetic(ADD_TOKEN, &counterVal, &stepVal, &counterVarSymbol->value);
+#endif
+	}
+	variantVarSymbol->value.type=counterVal.type;
+	variantVarSymbol->value.dtype=SCALAR;
+	cpy(variantVarSymbol->value.data, counterVal.data, sizeof(char*));
+	return currentPoint+CODE_USHORT_SIZE;
 }
 
 /**
@@ -374,9 +936,8 @@ static unsigned int handleIf(char * assembled, unsigned int currentPoint, unsign
 static unsigned int handleIf(char * assembled, unsigned int currentPoint, unsigned int length) {
 	int conditionalResult=determine_logical_expression(assembled, &currentPoint, length);
 #endif
-	if (conditionalResult) return currentPoint+sizeof(unsigned short);
-	unsigned short blockLen=getUShort(&assembled[currentPoint]);
-	return currentPoint+sizeof(unsigned short)+blockLen;
+	if (conditionalResult) return currentPoint+CODE_USHORT_SIZE;
+	return getBlockEnd(assembled, currentPoint, 0);
 }
 
 /**
@@ -388,22 +949,26 @@ static unsigned int handleArraySet(char * assembled, unsigned int currentPoint,
 static unsigned int handleArraySet(char * assembled, unsigned int currentPoint, unsigned int length) {
 #endif
 	unsigned short varId=getUShort(&assembled[currentPoint]);
-	currentPoint+=sizeof(unsigned short);
+	currentPoint+=CODE_USHORT_SIZE;
 #ifdef HOST_INTERPRETER
-	struct symbol_node* variableSymbol=getVariableSymbol(varId, fnLevel[threadId], threadId, 1);
+	struct symbol_node* variableSymbol=getVariableSymbol(varId, threadId, 1);
 	int targetIndex=getArrayAccessorIndex(variableSymbol, assembled, &currentPoint, length, threadId);
 	struct value_defn value=getExpressionValue(assembled, &currentPoint, length, threadId);
 #else
-	struct symbol_node* variableSymbol=getVariableSymbol(varId, fnLevel, 1);
+	struct symbol_node* variableSymbol=getVariableSymbol(varId, 1);
 	int targetIndex=getArrayAccessorIndex(variableSymbol, assembled, &currentPoint, length);
 	struct value_defn value=getExpressionValue(assembled, &currentPoint, length);
 #endif
+#ifdef HOST_INTERPRETER
+	setVariableValue(variableSymbol, value, targetIndex, threadId);
+#else
 	setVariableValue(variableSymbol, value, targetIndex);
+#endif
 	return currentPoint;
 }
 
 /**
- * Set a scalar value (held in the symbol table)
+ * Set a variable's value, scalars are held directly in the symbol table and arrays/strings as a pointer to their memory
  */
 #ifdef HOST_INTERPRETER
 static unsigned int handleLet(char * assembled, unsigned int currentPoint, unsigned int length, char restrictNoAlias, int threadId) {
@@ -411,32 +976,237 @@ static unsigned int handleLet(char * assembled, unsigned int currentPoint, unsig
 static unsigned int handleLet(char * assembled, unsigned int currentPoint, unsigned int length, char restrictNoAlias) {
 #endif
 	unsigned short varId=getUShort(&assembled[currentPoint]);
-	currentPoint+=sizeof(unsigned short);
+	currentPoint+=CODE_USHORT_SIZE;
 #ifdef HOST_INTERPRETER
-	struct symbol_node* variableSymbol=getVariableSymbol(varId, fnLevel[threadId], threadId, 1);
+	struct symbol_node* variableSymbol=getVariableSymbol(varId, threadId, 1);
 	struct value_defn value=getExpressionValue(assembled, &currentPoint, length, threadId);
-	if (restrictNoAlias && getVariableSymbol(varId, fnLevel[threadId], threadId, 0)->state==ALIAS) return currentPoint;
+	if (restrictNoAlias) {
+		// A default only applies to a parameter that was not passed an argument
+		unsigned char parameterState=getVariableSymbol(varId, threadId, 0)->state;
+		if (parameterState == ALIAS || parameterState == ARGUMENT) return currentPoint;
+	}
 #else
-	struct symbol_node* variableSymbol=getVariableSymbol(varId, fnLevel, 1);
+	struct symbol_node* variableSymbol=getVariableSymbol(varId, 1);
 	struct value_defn value=getExpressionValue(assembled, &currentPoint, length);
-	if (restrictNoAlias && getVariableSymbol(varId, fnLevel, 0)->state==ALIAS) return currentPoint;
+	if (restrictNoAlias) {
+		// A default only applies to a parameter that was not passed an argument
+		unsigned char parameterState=getVariableSymbol(varId, 0)->state;
+		if (parameterState == ALIAS || parameterState == ARGUMENT) return currentPoint;
+	}
+#endif
+#ifdef INTERPRETER_REFERENCE_COUNTING
+	// The new value is counted first, as it might be the same memory that the variable already references
+	struct value_defn previousValue=variableSymbol->value;
+#ifdef HOST_INTERPRETER
+	retainValue(&value, 0, threadId);
+	releaseValue(&previousValue, 1, threadId);
+#else
+	retainValue(&value, 0);
+	releaseValue(&previousValue, 1);
+#endif
 #endif
 	variableSymbol->value.type=value.type;
 	variableSymbol->value.dtype=value.dtype;
-	if (value.dtype == ARRAY) {
-		cpy(variableSymbol->value.data, value.data, sizeof(char*));
-	} else if (value.type == STRING_TYPE) {
-		cpy(&variableSymbol->value.data, &value.data, sizeof(char*));
+	cpy(variableSymbol->value.data, value.data, sizeof(char*));
+	return currentPoint;
+}
+
+/**
+ * Superinstruction adding or subtracting an integer constant to or from a variable in place (i.e. i+=1), for anything other
+ * than an integer this falls back to the general arithmetic
+ */
+#ifdef HOST_INTERPRETER
+static unsigned int handleIncSlot(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), threadId, 1);
+#else
+static unsigned int handleIncSlot(char * assembled, unsigned int currentPoint, unsigned int length) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), 1);
+#endif
+	currentPoint+=CODE_USHORT_SIZE;
+	unsigned char operator=getUChar(&assembled[currentPoint]);
+	currentPoint+=CODE_UCHAR_SIZE;
+	int delta=getCodeInt(&assembled[currentPoint]);
+	currentPoint+=sizeof(int);
+	if (variableSymbol->value.type == INT_TYPE && variableSymbol->value.dtype == SCALAR) {
+		int result=getInt(variableSymbol->value.data);
+		result=operator == ADD_TOKEN ? result+delta : result-delta;
+		cpy(variableSymbol->value.data, &result, sizeof(int));
 	} else {
-		int currentAddress=getInt(variableSymbol->value.data);
-		if (currentAddress == 0) {
-			char * address=getStackMemory(sizeof(int), 0);
-			cpy(variableSymbol->value.data, &address, sizeof(char*));
-			cpy(address, value.data, sizeof(int));
-		} else {
-			setVariableValue(variableSymbol, value, -1);
+		struct value_defn v1=variableSymbol->value, v2;
+		v2.type=INT_TYPE;
+		v2.dtype=SCALAR;
+		cpy(v2.data, &delta, sizeof(int));
+#ifdef HOST_INTERPRETER
+		performArithmetic(operator, &v1, &v2, &variableSymbol->value, threadId);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+		retainValue(&variableSymbol->value, 0, threadId);
+		releaseValue(&v1, 1, threadId);
+#endif
+#else
+		performArithmetic(operator, &v1, &v2, &variableSymbol->value);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+		retainValue(&variableSymbol->value, 0);
+		releaseValue(&v1, 1);
+#endif
+#endif
+	}
+	return currentPoint;
+}
+
+/**
+ * Superinstruction for a variable being set to itself combined with some expression (i.e. x=x*y), the variable is read before
+ * the expression is evaluated as in the unfused form
+ */
+#ifdef HOST_INTERPRETER
+static unsigned int handleOpAssign(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), threadId, 1);
+#else
+static unsigned int handleOpAssign(char * assembled, unsigned int currentPoint, unsigned int length) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), 1);
+#endif
+	currentPoint+=CODE_USHORT_SIZE;
+	unsigned int operatorPoint=currentPoint;
+	unsigned char operator=getUChar(&assembled[currentPoint]);
+	currentPoint+=CODE_UCHAR_SIZE;
+	struct value_defn v1=variableSymbol->value;
+	// Whilst the expression is evaluated a string read from the variable is held, as the expression might set the variable. A
+	// string being added is consumed by the addition so, as with the operands of an addition in an expression, it is placed in the
+	// scratch arena
+#ifdef HOST_INTERPRETER
+	if (v1.type == STRING_TYPE) holdTemporary(getValuePointer(&v1), threadId);
+	char * scratchMark=operator == ADD_TOKEN ? beginScratchValues(threadId) : NULL;
+	struct value_defn v2=getExpressionValue(assembled, &currentPoint, length, threadId);
+	if (scratchMark != NULL) scratchValues[threadId]=0;
+	unsigned char quickened=performQuickenedArithmetic(operator, &v1, &v2, &variableSymbol->value, threadId);
+	endScratchValues(scratchMark, threadId);
+	if (v1.type == STRING_TYPE) releaseTemporaries(1, threadId);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+	retainValue(&variableSymbol->value, 0, threadId);
+	releaseValue(&v1, 1, threadId);
+#endif
+#else
+	if (v1.type == STRING_TYPE) holdTemporary(getValuePointer(&v1));
+	char * scratchMark=operator == ADD_TOKEN ? beginScratchValues() : NULL;
+	struct value_defn v2=getExpressionValue(assembled, &currentPoint, length);
+	if (scratchMark != NULL) scratchValues=0;
+	unsigned char quickened=performQuickenedArithmetic(operator, &v1, &v2, &variableSymbol->value);
+	endScratchValues(scratchMark);
+	if (v1.type == STRING_TYPE) releaseTemporaries(1);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+	retainValue(&variableSymbol->value, 0);
+	releaseValue(&v1, 1);
+#endif
+#endif
+	if (quickened != operator) assembled[operatorPoint]=quickened;
+	return currentPoint;
+}
+
+/**
+ * Superinstruction for a conditional (or loop test) comparing a variable against some expression, this has the same layout
+ * as the conditional it replaces, but the variable is read and compared directly rather than as a logical expression
+ */
+#ifdef HOST_INTERPRETER
+static unsigned int handleCmpJump(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+#else
+static unsigned int handleCmpJump(char * assembled, unsigned int currentPoint, unsigned int length) {
+#endif
+	unsigned int operatorPoint=currentPoint;
+	unsigned char operator=getUChar(&assembled[currentPoint]);
+	currentPoint+=CODE_UCHAR_SIZE*2;
+	// As with a comparison in a logical expression, a string or array read from the variable is held whilst the expression is
+	// evaluated and, unless quickened, the expression is consumed by the comparison so placed in the scratch arena
+	char generic=operator >= EQ_TOKEN && operator <= GEQ_TOKEN;
+#ifdef HOST_INTERPRETER
+	struct value_defn v1=getVariableSymbol(getUShort(&assembled[currentPoint]), threadId, 1)->value;
+	currentPoint+=CODE_USHORT_SIZE;
+	char heldFirst=v1.type == STRING_TYPE || v1.dtype == ARRAY;
+	if (heldFirst) holdTemporary(getValuePointer(&v1), threadId);
+	char * scratchMark=generic ? beginScratchValues(threadId) : NULL;
+	struct value_defn v2=getExpressionValue(assembled, &currentPoint, length, threadId);
+	if (heldFirst) releaseTemporaries(1, threadId);
+#else
+	struct value_defn v1=getVariableSymbol(getUShort(&assembled[currentPoint]), 1)->value;
+	currentPoint+=CODE_USHORT_SIZE;
+	char heldFirst=v1.type == STRING_TYPE || v1.dtype == ARRAY;
+	if (heldFirst) holdTemporary(getValuePointer(&v1));
+	char * scratchMark=generic ? beginScratchValues() : NULL;
+	struct value_defn v2=getExpressionValue(assembled, &currentPoint, length);
+	if (heldFirst) releaseTemporaries(1);
+#endif
+	int conditionalResult;
+	unsigned char quickened=performQuickenedComparison(operator, &v1, &v2, &conditionalResult);
+	if (quickened != operator) assembled[operatorPoint]=quickened;
+#ifdef HOST_INTERPRETER
+	endScratchValues(scratchMark, threadId);
+#else
+	endScratchValues(scratchMark);
+#endif
+	if (conditionalResult) return currentPoint+CODE_USHORT_SIZE;
+	return getBlockEnd(assembled, currentPoint, 0);
+}
+
+/**
+ * Selects the arm of an if/elif chain comparing a variable against integer constants, the constants are sorted so an integer
+ * is found by binary search. Each arm's location is held as a block length following the table of constants, with the
+ * location of the else arm (or the end of the chain if there is none) after these
+ */
+#ifdef HOST_INTERPRETER
+static unsigned int handleSwitch(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+	struct value_defn value=getVariableSymbol(getUShort(&assembled[currentPoint]), threadId, 1)->value;
+#else
+static unsigned int handleSwitch(char * assembled, unsigned int currentPoint, unsigned int length) {
+	struct value_defn value=getVariableSymbol(getUShort(&assembled[currentPoint]), 1)->value;
+#endif
+	currentPoint+=CODE_USHORT_SIZE;
+	int numberArms=getUShort(&assembled[currentPoint]);
+	currentPoint+=CODE_USHORT_SIZE;
+	unsigned int keysPoint=currentPoint, armsPoint=currentPoint+(numberArms*sizeof(int));
+	if (value.type == INT_TYPE) {
+		int key=getInt(value.data), low=0, high=numberArms-1;
+		while (low <= high) {
+			int mid=(low+high)/2;
+			int midKey=getCodeInt(&assembled[keysPoint+(mid*sizeof(int))]);
+			if (midKey == key) return getBlockEnd(assembled, armsPoint+(mid*CODE_USHORT_SIZE), 0);
+			if (midKey < key) {
+				low=mid+1;
+			} else {
+				high=mid-1;
+			}
+		}
+	} else if (value.type == REAL_TYPE) {
+		// As with the comparison this replaces, a real equals an integer constant which converts to the same value
+		float key=getFloat(value.data);
+		int i;
+		for (i=0;i<numberArms;i++) {
+			if ((float) getCodeInt(&assembled[keysPoint+(i*sizeof(int))]) == key) {
+				return getBlockEnd(assembled, armsPoint+(i*CODE_USHORT_SIZE), 0);
+			}
 		}
 	}
+	return getBlockEnd(assembled, armsPoint+(numberArms*CODE_USHORT_SIZE), 0);
+}
+
+/**
+ * Superinstruction setting an element of an array indexed by a single variable or constant
+ */
+#ifdef HOST_INTERPRETER
+static unsigned int handleArraySet1D(char * assembled, unsigned int currentPoint, unsigned int length, int threadId) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), threadId, 1);
+	currentPoint+=CODE_USHORT_SIZE;
+	int targetIndex=getArray1DAccessorIndex(variableSymbol, assembled, &currentPoint, length, threadId);
+	struct value_defn value=getExpressionValue(assembled, &currentPoint, length, threadId);
+#else
+static unsigned int handleArraySet1D(char * assembled, unsigned int currentPoint, unsigned int length) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[currentPoint]), 1);
+	currentPoint+=CODE_USHORT_SIZE;
+	int targetIndex=getArray1DAccessorIndex(variableSymbol, assembled, &currentPoint, length);
+	struct value_defn value=getExpressionValue(assembled, &currentPoint, length);
+#endif
+#ifdef HOST_INTERPRETER
+	setVariableValue(variableSymbol, value, targetIndex, threadId);
+#else
+	setVariableValue(variableSymbol, value, targetIndex);
+#endif
 	return currentPoint;
 }
 
@@ -448,18 +1218,26 @@ static int determine_logical_expression(char * assembled, unsigned int * current
 #else
 static int determine_logical_expression(char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
+	unsigned int tokenPoint=*currentPoint;
 	unsigned char expressionId=getUChar(&assembled[*currentPoint]);
-	*currentPoint+=sizeof(unsigned char);
+	*currentPoint+=CODE_UCHAR_SIZE;
 	if (expressionId == AND_TOKEN || expressionId == OR_TOKEN) {
+		// Short circuit, if the first operand decides the result then branch over the second without evaluating it
 #ifdef HOST_INTERPRETER
 		int s1=determine_logical_expression(assembled, currentPoint, length, threadId);
-		int s2=determine_logical_expression(assembled, currentPoint, length, threadId);
 #else
 		int s1=determine_logical_expression(assembled, currentPoint, length);
-		int s2=determine_logical_expression(assembled, currentPoint, length);
 #endif
-		if (expressionId == AND_TOKEN) return s1 && s2;
-		if (expressionId == OR_TOKEN) return s1 || s2;
+		if ((s1 && expressionId == OR_TOKEN) || (!s1 && expressionId == AND_TOKEN)) {
+			*currentPoint=getBlockEnd(assembled, *currentPoint, 0);
+			return s1 != 0;
+		}
+		*currentPoint+=CODE_USHORT_SIZE;
+#ifdef HOST_INTERPRETER
+		return determine_logical_expression(assembled, currentPoint, length, threadId);
+#else
+		return determine_logical_expression(assembled, currentPoint, length);
+#endif
 	} else if (expressionId == NOT_TOKEN) {
 #ifdef HOST_INTERPRETER
 		struct value_defn expression=getExpressionValue(assembled, currentPoint, length, threadId);
@@ -469,77 +1247,57 @@ static int determine_logical_expression(char * assembled, unsigned int * current
 		int value=getInt(expression.data);
 		if (value > 0) return 0;
 		return 1;
-	} else if (expressionId == EQ_TOKEN || expressionId == NEQ_TOKEN || expressionId == GT_TOKEN || expressionId == GEQ_TOKEN ||
-			expressionId == LT_TOKEN || expressionId == LEQ_TOKEN || expressionId == IS_TOKEN) {
+	} else if ((expressionId >= EQ_TOKEN && expressionId <= GEQ_TOKEN) || expressionId == IS_TOKEN ||
+			(expressionId >= INT_EQ_TOKEN && expressionId <= REAL_GEQ_TOKEN)) {
+		// Whilst the second value is evaluated the first, if a string or array, is held as it might be freed or moved otherwise. Unless
+		// quickened the values might be strings, these are consumed by the comparison so are placed in the scratch arena
+		char generic=expressionId <= GEQ_TOKEN || expressionId == IS_TOKEN;
 #ifdef HOST_INTERPRETER
+		char * scratchMark=generic ? beginScratchValues(threadId) : NULL;
 		struct value_defn expression1=getExpressionValue(assembled, currentPoint, length, threadId);
+		char heldFirst=expression1.type == STRING_TYPE || expression1.dtype == ARRAY;
+		if (heldFirst) holdTemporary(getValuePointer(&expression1), threadId);
 		struct value_defn expression2=getExpressionValue(assembled, currentPoint, length, threadId);
+		if (heldFirst) releaseTemporaries(1, threadId);
 #else
+		char * scratchMark=generic ? beginScratchValues() : NULL;
 		struct value_defn expression1=getExpressionValue(assembled, currentPoint, length);
+		char heldFirst=expression1.type == STRING_TYPE || expression1.dtype == ARRAY;
+		if (heldFirst) holdTemporary(getValuePointer(&expression1));
 		struct value_defn expression2=getExpressionValue(assembled, currentPoint, length);
+		if (heldFirst) releaseTemporaries(1);
 #endif
-		if (expressionId == IS_TOKEN) {
-			if (expression1.type == NONE_TYPE && expression2.type == NONE_TYPE) return 1;
-			if (expression1.type != expression2.type) return 0;
-			char *ptr1, *ptr2;
-			cpy(&ptr1, expression1.data, sizeof(char*));
-			cpy(&ptr2, expression2.data, sizeof(char*));
-			return ptr1 == ptr2;
-		}
-		if (expression1.type == expression2.type && expression1.type == INT_TYPE) {
-			int value1=getInt(expression1.data);
-			int value2=getInt(expression2.data);
-			if (expressionId == EQ_TOKEN) return value1 == value2;
-			if (expressionId == NEQ_TOKEN) return value1 != value2;
-			if (expressionId == GT_TOKEN) return value1 > value2;
-			if (expressionId == GEQ_TOKEN) return value1 >= value2;
-			if (expressionId == LT_TOKEN) return value1 < value2;
-			if (expressionId == LEQ_TOKEN) return value1 <= value2;
-		} else if ((expression1.type == REAL_TYPE || expression1.type == INT_TYPE) &&
-				(expression2.type == REAL_TYPE || expression2.type == INT_TYPE)) {
-			float value1=getFloat(expression1.data);
-			float value2=getFloat(expression2.data);
-			if (expression1.type==INT_TYPE) value1=(float) getInt(expression1.data);
-			if (expression2.type==INT_TYPE) value2=(float) getInt(expression2.data);
-			if (expressionId == EQ_TOKEN) return value1 == value2;
-			if (expressionId == NEQ_TOKEN) return value1 != value2;
-			if (expressionId == GT_TOKEN) return value1 > value2;
-			if (expressionId == GEQ_TOKEN) return value1 >= value2;
-			if (expressionId == LT_TOKEN) return value1 < value2;
-			if (expressionId == LEQ_TOKEN) return value1 <= value2;
-		} else if (expression1.type == expression2.type && expression1.type == STRING_TYPE) {
-			if (expressionId == EQ_TOKEN) {
-				return checkStringEquality(expression1, expression2);
-			} else if (expressionId == NEQ_TOKEN) {
-				return !checkStringEquality(expression1, expression2);
-			} else {
-				raiseError(ERR_STR_ONLYTEST_EQ);
-			}
-		} else if (expression1.type == expression2.type && expression1.type == NONE_TYPE) {
-			if (expressionId == EQ_TOKEN || expressionId == IS_TOKEN) {
-				return 1;
-			} else if (expressionId == NEQ_TOKEN) {
-				return 0;
-			} else {
-				raiseError(ERR_NONE_ONLYTEST_EQ);
-			}
-		}
+		int result;
+		unsigned char quickened=performQuickenedComparison(expressionId, &expression1, &expression2, &result);
+		if (quickened != expressionId) assembled[tokenPoint]=quickened;
+#ifdef HOST_INTERPRETER
+		endScratchValues(scratchMark, threadId);
+#else
+		endScratchValues(scratchMark);
+#endif
+		return result;
 	} else if (expressionId == BOOLEAN_TOKEN) {
-		struct value_defn value;
-		cpy(value.data, &assembled[*currentPoint], sizeof(int));
+		int value=getCodeInt(&assembled[*currentPoint]);
 		*currentPoint+=sizeof(int);
-		return getInt(value.data) > 0;
-	} else if (expressionId == IDENTIFIER_TOKEN || expressionId == ARRAYACCESS_TOKEN) {
+		return value > 0;
+	} else if (expressionId == LOAD_SLOT_TOKEN || expressionId == ARRAYACCESS_TOKEN || expressionId == ARRAYACCESS_1D_TOKEN ||
+			expressionId == ARRAYACCESS_OFFSET_TOKEN) {
 		struct value_defn value;
 		unsigned short variable_id=getUShort(&assembled[*currentPoint]);
-		*currentPoint+=sizeof(unsigned short);
+		*currentPoint+=CODE_USHORT_SIZE;
 #ifdef HOST_INTERPRETER
-		struct symbol_node* variableSymbol=getVariableSymbol(variable_id, fnLevel[threadId], threadId, 1);
+		struct symbol_node* variableSymbol=getVariableSymbol(variable_id, threadId, 1);
 #else
-		struct symbol_node* variableSymbol=getVariableSymbol(variable_id, fnLevel, 1);
+		struct symbol_node* variableSymbol=getVariableSymbol(variable_id, 1);
 #endif
 		value=getVariableValue(variableSymbol, -1);
-		if (expressionId == ARRAYACCESS_TOKEN) {
+		if (expressionId == ARRAYACCESS_OFFSET_TOKEN) {
+#ifdef HOST_INTERPRETER
+			value=getVariableValue(variableSymbol, getArrayOffsetAccessorIndex(variableSymbol, assembled, currentPoint, threadId));
+#else
+			value=getVariableValue(variableSymbol, getArrayOffsetAccessorIndex(variableSymbol, assembled, currentPoint));
+#endif
+		} else if (expressionId != LOAD_SLOT_TOKEN) {
 #ifdef HOST_INTERPRETER
             int targetIndex=getArrayAccessorIndex(variableSymbol, assembled, currentPoint, length, threadId);
 #else
@@ -552,7 +1310,7 @@ static int determine_logical_expression(char * assembled, unsigned int * current
 		}
 		return 0;
 	} else {
-		*currentPoint-=sizeof(unsigned char);
+		*currentPoint-=CODE_UCHAR_SIZE;
 		struct value_defn expValue;
 #ifdef HOST_INTERPRETER
 		expValue=getExpressionValue(assembled, currentPoint, length, threadId);
@@ -566,6 +1324,97 @@ static int determine_logical_expression(char * assembled, unsigned int * current
 	return 0;
 }
 
+/**
+ * Compares two values with some comparison operator, integers and reals may be compared with each other but strings and none
+ * only for equality
+ */
+static int compareValues(unsigned char operator, struct value_defn * v1, struct value_defn * v2) {
+	if (operator == IS_TOKEN) {
+		if (v1->type == NONE_TYPE && v2->type == NONE_TYPE) return 1;
+		if (v1->type != v2->type) return 0;
+		char *ptr1, *ptr2;
+		cpy(&ptr1, v1->data, sizeof(char*));
+		cpy(&ptr2, v2->data, sizeof(char*));
+		return ptr1 == ptr2;
+	}
+	if (v1->type == v2->type && v1->type == INT_TYPE) {
+		return compareIntegers(operator, getInt(v1->data), getInt(v2->data));
+	} else if ((v1->type == REAL_TYPE || v1->type == INT_TYPE) &&
+			(v2->type == REAL_TYPE || v2->type == INT_TYPE)) {
+		float value1=getFloat(v1->data);
+		float value2=getFloat(v2->data);
+		if (v1->type==INT_TYPE) value1=(float) getInt(v1->data);
+		if (v2->type==INT_TYPE) value2=(float) getInt(v2->data);
+		return compareReals(operator, value1, value2);
+	} else if (v1->type == v2->type && v1->type == STRING_TYPE) {
+		if (operator == EQ_TOKEN) {
+			return checkStringEquality(*v1, *v2);
+		} else if (operator == NEQ_TOKEN) {
+			return !checkStringEquality(*v1, *v2);
+		} else {
+			raiseError(ERR_STR_ONLYTEST_EQ);
+		}
+	} else if (v1->type == v2->type && v1->type == NONE_TYPE) {
+		if (operator == EQ_TOKEN || operator == IS_TOKEN) {
+			return 1;
+		} else if (operator == NEQ_TOKEN) {
+			return 0;
+		} else {
+			raiseError(ERR_NONE_ONLYTEST_EQ);
+		}
+	}
+	return 0;
+}
+
+/**
+ * Compares two values given a generic or quickened comparison token, returning the token that the comparison is to be held as
+ * from now on and setting the result. A generic comparison of integers or reals quickens to the matching variant and a quickened
+ * comparison whose operands are not of its types is done generically, reverting to the generic token
+ */
+static unsigned char performQuickenedComparison(unsigned char token, struct value_defn * v1, struct value_defn * v2, int * result) {
+	if (token >= INT_EQ_TOKEN && token <= INT_GEQ_TOKEN) {
+		token=EQ_TOKEN+(token-INT_EQ_TOKEN);
+		if (v1->type == INT_TYPE && v2->type == INT_TYPE) {
+			*result=compareIntegers(token, getInt(v1->data), getInt(v2->data));
+			return INT_EQ_TOKEN+(token-EQ_TOKEN);
+		}
+	} else if (token >= REAL_EQ_TOKEN && token <= REAL_GEQ_TOKEN) {
+		token=EQ_TOKEN+(token-REAL_EQ_TOKEN);
+		if (v1->type == REAL_TYPE && v2->type == REAL_TYPE) {
+			*result=compareReals(token, getFloat(v1->data), getFloat(v2->data));
+			return REAL_EQ_TOKEN+(token-EQ_TOKEN);
+		}
+	}
+	*result=compareValues(token, v1, v2);
+#ifndef INTERPRETER_NO_QUICKENING
+	if (token >= EQ_TOKEN && token <= GEQ_TOKEN) {
+		if (v1->type == INT_TYPE && v2->type == INT_TYPE) return INT_EQ_TOKEN+(token-EQ_TOKEN);
+		if (v1->type == REAL_TYPE && v2->type == REAL_TYPE) return REAL_EQ_TOKEN+(token-EQ_TOKEN);
+	}
+#endif
+	return token;
+}
+
+static int compareIntegers(unsigned char operator, int value1, int value2) {
+	if (operator == EQ_TOKEN) return value1 == value2;
+	if (operator == NEQ_TOKEN) return value1 != value2;
+	if (operator == GT_TOKEN) return value1 > value2;
+	if (operator == GEQ_TOKEN) return value1 >= value2;
+	if (operator == LT_TOKEN) return value1 < value2;
+	if (operator == LEQ_TOKEN) return value1 <= value2;
+	return 0;
+}
+
+static int compareReals(unsigned char operator, float value1, float value2) {
+	if (operator == EQ_TOKEN) return value1 == value2;
+	if (operator == NEQ_TOKEN) return value1 != value2;
+	if (operator == GT_TOKEN) return value1 > value2;
+	if (operator == GEQ_TOKEN) return value1 >= value2;
+	if (operator == LT_TOKEN) return value1 < value2;
+	if (operator == LEQ_TOKEN) return value1 <= value2;
+	return 0;
+}
+
 /**
  * Gets the value of an expression, which is number, string, identifier or mathematical
  */
@@ -575,155 +1424,493 @@ static struct value_defn getExpressionValue(char * assembled, unsigned int * cur
 static struct value_defn getExpressionValue(char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
 	struct value_defn value;
-
 	unsigned char expressionId=getUChar(&assembled[*currentPoint]);
-	*currentPoint+=sizeof(unsigned char);
-	if (expressionId == INTEGER_TOKEN) {
-		value.type=INT_TYPE;
-		value.dtype=SCALAR;
-		cpy(value.data, &assembled[*currentPoint], sizeof(int));
-		*currentPoint+=sizeof(int);
-	} else if (expressionId == REAL_TOKEN) {
-		value.type=REAL_TYPE;
-		value.dtype=SCALAR;
-		cpy(value.data, &assembled[*currentPoint], sizeof(float));
-		*currentPoint+=sizeof(float);
-	} else if (expressionId == BOOLEAN_TOKEN) {
-		value.type=BOOLEAN_TYPE;
-		value.dtype=SCALAR;
-		cpy(value.data, &assembled[*currentPoint], sizeof(int));
-		*currentPoint+=sizeof(int);
-	} else if (expressionId == STRING_TOKEN) {
-		value.type=STRING_TYPE;
-		char * strPtr=assembled + *currentPoint;
-		cpy(&value.data, &strPtr, sizeof(char*));
-		*currentPoint+=(slength(strPtr)+1);
-		value.dtype=SCALAR;
-	} else if (expressionId == NONE_TOKEN) {
-		value.type=NONE_TYPE;
-		value.dtype=SCALAR;
-	} else if (expressionId ==FN_ADDR_TOKEN) {
-        value.type=FN_ADDR_TYPE;
-		value.dtype=SCALAR;
-		cpy(value.data, &assembled[*currentPoint], sizeof(unsigned short));
-		*currentPoint+=sizeof(unsigned short);
-	} else if (expressionId == LET_TOKEN) {
+	*currentPoint+=CODE_UCHAR_SIZE;
+#ifdef INTERPRETER_COMPUTED_GOTO
+	static void * expressionLabels[NUMBER_TOKENS]={
+		[STORE_SLOT_TOKEN]=&&let, [STOP_TOKEN]=&&unknown, [OR_TOKEN]=&&logical, [AND_TOKEN]=&&logical, [EQ_TOKEN]=&&logical,
+		[NEQ_TOKEN]=&&logical, [LT_TOKEN]=&&logical, [GT_TOKEN]=&&logical, [LEQ_TOKEN]=&&logical, [GEQ_TOKEN]=&&logical,
+		[ADD_TOKEN]=&&arithmetic, [SUB_TOKEN]=&&arithmetic, [MUL_TOKEN]=&&arithmetic, [DIV_TOKEN]=&&arithmetic,
+		[MOD_TOKEN]=&&arithmetic, [LOAD_SLOT_TOKEN]=&&identifier, [REAL_TOKEN]=&&real, [STRING_TOKEN]=&&string,
+		[INTEGER_TOKEN]=&&integer, [IF_TOKEN]=&&unknown, [FOR_TOKEN]=&&unknown, [GOTO_TOKEN]=&&unknown,
+		[ARRAYACCESS_TOKEN]=&&arrayaccess, [ARRAYSET_TOKEN]=&&unknown, [IFELSE_TOKEN]=&&unknown, [POW_TOKEN]=&&arithmetic,
+		[RETURN_TOKEN]=&&unknown, [FNCALL_TOKEN]=&&fncall, [RETURN_EXP_TOKEN]=&&unknown, [BOOLEAN_TOKEN]=&&boolean,
+		[LETNOALIAS_TOKEN]=&&unknown, [NONE_TOKEN]=&&none, [IS_TOKEN]=&&logical, [ARRAY_TOKEN]=&&array,
+		[NOT_TOKEN]=&&logical, [NATIVE_TOKEN]=&&native, [FN_ADDR_TOKEN]=&&fnaddr, [FNCALL_BY_VAR_TOKEN]=&&fncall,
+		[POSTFIX_TOKEN]=&&postfix, [INC_SLOT_TOKEN]=&&unknown, [OP_ASSIGN_TOKEN]=&&unknown, [CMP_JUMP_TOKEN]=&&unknown,
+		[ARRAYACCESS_1D_TOKEN]=&&arrayaccess1d, [ARRAYSET_1D_TOKEN]=&&unknown, [INT_ADD_TOKEN ... REAL_DIV_TOKEN]=&&arithmetic,
+		[INT_EQ_TOKEN ... REAL_GEQ_TOKEN]=&&logical, [SWITCH_TOKEN]=&&unknown, [ARRAYACCESS_OFFSET_TOKEN]=&&arrayaccessoffset,
+		[FOR_RANGE_TOKEN]=&&unknown };
+	goto *expressionLabels[expressionId];
 #ifdef HOST_INTERPRETER
-		*currentPoint=handleLet(assembled, *currentPoint, length, 0, threadId);
-		value=getExpressionValue(assembled, currentPoint, length, threadId);
+integer:
+	return getIntegerValue(expressionId, assembled, currentPoint, length, threadId);
+real:
+	return getRealValue(expressionId, assembled, currentPoint, length, threadId);
+boolean:
+	return getBooleanValue(expressionId, assembled, currentPoint, length, threadId);
+string:
+	return getStringValue(expressionId, assembled, currentPoint, length, threadId);
+none:
+	return getNoneValue(expressionId, assembled, currentPoint, length, threadId);
+fnaddr:
+	return getFnAddrValue(expressionId, assembled, currentPoint, length, threadId);
+let:
+	return getLetValue(expressionId, assembled, currentPoint, length, threadId);
+array:
+	return getArrayLiteralValue(expressionId, assembled, currentPoint, length, threadId);
+fncall:
+	return getFnCallValue(expressionId, assembled, currentPoint, length, threadId);
+native:
+	return getNativeValue(expressionId, assembled, currentPoint, length, threadId);
+identifier:
+	return getIdentifierValue(expressionId, assembled, currentPoint, length, threadId);
+arrayaccess:
+	return getArrayAccessValue(expressionId, assembled, currentPoint, length, threadId);
+arrayaccess1d:
+	return getArrayAccess1DValue(expressionId, assembled, currentPoint, length, threadId);
+arrayaccessoffset:
+	return getArrayAccessOffsetValue(expressionId, assembled, currentPoint, length, threadId);
+arithmetic:
+	return computeExpressionResult(expressionId, assembled, currentPoint, length, threadId);
+logical:
+	return getLogicalValue(expressionId, assembled, currentPoint, length, threadId);
+postfix:
+	return getPostfixValue(expressionId, assembled, currentPoint, length, threadId);
 #else
-		*currentPoint=handleLet(assembled, *currentPoint, length, 0);
-		value=getExpressionValue(assembled, currentPoint, length);
+integer:
+	return getIntegerValue(expressionId, assembled, currentPoint, length);
+real:
+	return getRealValue(expressionId, assembled, currentPoint, length);
+boolean:
+	return getBooleanValue(expressionId, assembled, currentPoint, length);
+string:
+	return getStringValue(expressionId, assembled, currentPoint, length);
+none:
+	return getNoneValue(expressionId, assembled, currentPoint, length);
+fnaddr:
+	return getFnAddrValue(expressionId, assembled, currentPoint, length);
+let:
+	return getLetValue(expressionId, assembled, currentPoint, length);
+array:
+	return getArrayLiteralValue(expressionId, assembled, currentPoint, length);
+fncall:
+	return getFnCallValue(expressionId, assembled, currentPoint, length);
+native:
+	return getNativeValue(expressionId, assembled, currentPoint, length);
+identifier:
+	return getIdentifierValue(expressionId, assembled, currentPoint, length);
+arrayaccess:
+	return getArrayAccessValue(expressionId, assembled, currentPoint, length);
+arrayaccess1d:
+	return getArrayAccess1DValue(expressionId, assembled, currentPoint, length);
+arrayaccessoffset:
+	return getArrayAccessOffsetValue(expressionId, assembled, currentPoint, length);
+arithmetic:
+	return computeExpressionResult(expressionId, assembled, currentPoint, length);
+logical:
+	return getLogicalValue(expressionId, assembled, currentPoint, length);
+postfix:
+	return getPostfixValue(expressionId, assembled, currentPoint, length);
 #endif
-	} else if (expressionId == ARRAY_TOKEN) {
-		int i, j, repetitionMultiplier=1, numItems=getInt(&assembled[*currentPoint]), totalSize=numItems;
-		*currentPoint+=sizeof(int);
-		unsigned char hasRepetition=getUChar(&assembled[*currentPoint]), ndims=1;
-		*currentPoint+=sizeof(unsigned char);
-		if (hasRepetition) {
+unknown:
+#else
+	expression_handler handler=expressionHandlers[expressionId];
 #ifdef HOST_INTERPRETER
-			struct value_defn repetitionV=getExpressionValue(assembled, currentPoint, length, threadId);
+	if (handler != NULL) return handler(expressionId, assembled, currentPoint, length, threadId);
 #else
-			struct value_defn repetitionV=getExpressionValue(assembled, currentPoint, length);
+	if (handler != NULL) return handler(expressionId, assembled, currentPoint, length);
 #endif
-            cpy(&repetitionMultiplier, repetitionV.data, sizeof(int));
-            totalSize*=repetitionMultiplier;
-		}
+#endif
+	value.type=NONE_TYPE;
+	value.dtype=SCALAR;
+	return value;
+}
+
+/**
+ * Literal integer, real and boolean values
+ */
 #ifdef HOST_INTERPRETER
-        char * address=getHeapMemory(sizeof(unsigned char) + (sizeof(int)*(totalSize+1)), 0, threadId);
+static struct value_defn getIntegerValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
 #else
-        char * address=getHeapMemory(sizeof(unsigned char) + (sizeof(int)*(totalSize+1)), 0, currentSymbolEntries, symbolTable);
+static struct value_defn getIntegerValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
-		cpy(value.data, &address, sizeof(char*));
-		ndims=ndims | (1 << 4);
-		cpy(address, &ndims, sizeof(unsigned char));
-		address+=sizeof(unsigned char);
-		cpy(address, &totalSize, sizeof(int));
-		unsigned int prevCP=*currentPoint;
-		for (j=0;j<repetitionMultiplier;j++) {
-        *currentPoint=prevCP;
-            for (i=0;i<numItems;i++) {
+	struct value_defn value;
+	value.type=INT_TYPE;
+	value.dtype=SCALAR;
+	cpy(value.data, &assembled[*currentPoint], sizeof(int));
+	*currentPoint+=sizeof(int);
+	return value;
+}
+
 #ifdef HOST_INTERPRETER
-                struct value_defn itemV=getExpressionValue(assembled, currentPoint, length, threadId);
+static struct value_defn getRealValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
 #else
-                struct value_defn itemV=getExpressionValue(assembled, currentPoint, length);
+static struct value_defn getRealValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
-            cpy(address+((i+(j*numItems)+1) * sizeof(int)), itemV.data, sizeof(int));
-            value.type=itemV.type;
-            }
-		}
-		value.dtype=ARRAY;
-	} else if (expressionId == FNCALL_TOKEN || expressionId == FNCALL_BY_VAR_TOKEN) {
+	struct value_defn value;
+	value.type=REAL_TYPE;
+	value.dtype=SCALAR;
+	cpy(value.data, &assembled[*currentPoint], sizeof(float));
+	*currentPoint+=sizeof(float);
+	return value;
+}
+
 #ifdef HOST_INTERPRETER
-		unsigned int fnAddr;
-		*currentPoint=handleFnCall(assembled, *currentPoint, &fnAddr, length, expressionId == FNCALL_BY_VAR_TOKEN ? 1:0, threadId);
-		fnLevel[threadId]++;
-		value=processAssembledCode(assembled, fnAddr, length, threadId);
-		clearVariablesToLevel(fnLevel[threadId], threadId);
-		fnLevel[threadId]--;
+static struct value_defn getBooleanValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
 #else
-		unsigned int fnAddr;
-		*currentPoint=handleFnCall(assembled, *currentPoint, &fnAddr, length, expressionId == FNCALL_BY_VAR_TOKEN ? 1:0);
-		fnLevel++;
-		value=processAssembledCode(assembled, fnAddr, length);
-		clearVariablesToLevel(fnLevel);
-		fnLevel--;
+static struct value_defn getBooleanValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
-    } else if (expressionId == NATIVE_TOKEN) {
+	struct value_defn value;
+	value.type=BOOLEAN_TYPE;
+	value.dtype=SCALAR;
+	cpy(value.data, &assembled[*currentPoint], sizeof(int));
+	*currentPoint+=sizeof(int);
+	return value;
+}
+
+/**
+ * A string constant, which is held in the byte code and so the value just points to this
+ */
 #ifdef HOST_INTERPRETER
-        *currentPoint=handleNative(assembled, *currentPoint, length, &value, threadId);
+static struct value_defn getStringValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
 #else
-        *currentPoint=handleNative(assembled, *currentPoint, length, &value);
+static struct value_defn getStringValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
-	} else if (expressionId == IDENTIFIER_TOKEN || expressionId == ARRAYACCESS_TOKEN) {
-		unsigned short variable_id=getUShort(&assembled[*currentPoint]);
-		*currentPoint+=sizeof(unsigned short);
+	struct value_defn value;
+	value.type=STRING_TYPE;
+	char * strPtr=assembled + *currentPoint;
+	cpy(&value.data, &strPtr, sizeof(char*));
+	*currentPoint+=CODE_STRING_SIZE(slength(strPtr));
+	value.dtype=SCALAR;
+	return value;
+}
+
 #ifdef HOST_INTERPRETER
-		struct symbol_node* variableSymbol=getVariableSymbol(variable_id, fnLevel[threadId], threadId, 1);
+static struct value_defn getNoneValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
 #else
-		struct symbol_node* variableSymbol=getVariableSymbol(variable_id, fnLevel, 1);
+static struct value_defn getNoneValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
-		if (expressionId == IDENTIFIER_TOKEN) {
-			if (variableSymbol->value.dtype==SCALAR) {
-				value=getVariableValue(variableSymbol, -1);
-			} else if (variableSymbol->value.dtype==ARRAY) {
-				value.dtype=ARRAY;
-				value.type=variableSymbol->value.type;
-				cpy(value.data, variableSymbol->value.data, sizeof(char*));
-			}
-		} else if (expressionId == ARRAYACCESS_TOKEN) {
+	struct value_defn value;
+	value.type=NONE_TYPE;
+	value.dtype=SCALAR;
+	return value;
+}
+
+/**
+ * The address of a function, used for function pointers
+ */
 #ifdef HOST_INTERPRETER
-			int targetIndex=getArrayAccessorIndex(variableSymbol, assembled, currentPoint, length, threadId);
+static struct value_defn getFnAddrValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
 #else
-			int targetIndex=getArrayAccessorIndex(variableSymbol, assembled, currentPoint, length);
+static struct value_defn getFnAddrValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
-			value=getVariableValue(variableSymbol, targetIndex);
+	struct value_defn value;
+	unsigned int fnAddress=getCodeAddress(&assembled[*currentPoint]);
+	value.type=FN_ADDR_TYPE;
+	value.dtype=SCALAR;
+	cpy(value.data, &fnAddress, sizeof(unsigned int));
+	*currentPoint+=CODE_USHORT_SIZE;
+	return value;
+}
+
+/**
+ * A variable assignment embedded in an expression, the value of the following expression is returned
+ */
+#ifdef HOST_INTERPRETER
+static struct value_defn getLetValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+	// The value is kept by the variable, so is never placed in the scratch arena
+	char scratch=scratchValues[threadId];
+	scratchValues[threadId]=0;
+	*currentPoint=handleLet(assembled, *currentPoint, length, 0, threadId);
+	scratchValues[threadId]=scratch;
+	return getExpressionValue(assembled, currentPoint, length, threadId);
+}
+#else
+static struct value_defn getLetValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+	// The value is kept by the variable, so is never placed in the scratch arena
+	char scratch=scratchValues;
+	scratchValues=0;
+	*currentPoint=handleLet(assembled, *currentPoint, length, 0);
+	scratchValues=scratch;
+	return getExpressionValue(assembled, currentPoint, length);
+}
+#endif
+
+/**
+ * Array literal, optionally with a repetition multiplier, which is allocated in the heap
+ */
+#ifdef HOST_INTERPRETER
+static struct value_defn getArrayLiteralValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+#else
+static struct value_defn getArrayLiteralValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+#endif
+	struct value_defn value;
+	int i, j, repetitionMultiplier=1, numItems=getCodeInt(&assembled[*currentPoint]), totalSize=numItems;
+	*currentPoint+=sizeof(int);
+	unsigned char hasRepetition=getUChar(&assembled[*currentPoint]), ndims=1;
+	*currentPoint+=CODE_UCHAR_SIZE;
+	if (hasRepetition) {
+#ifdef HOST_INTERPRETER
+		struct value_defn repetitionV=getExpressionValue(assembled, currentPoint, length, threadId);
+#else
+		struct value_defn repetitionV=getExpressionValue(assembled, currentPoint, length);
+#endif
+		cpy(&repetitionMultiplier, repetitionV.data, sizeof(int));
+		totalSize*=repetitionMultiplier;
+	}
+	// An array consumed by the current statement, such as one iterated over by a for loop, is placed in the scratch arena. The items
+	// are kept by the array so are never placed there
+	int size=sizeof(unsigned char) + (sizeof(int)*(totalSize+1));
+#ifdef HOST_INTERPRETER
+	char scratch=scratchValues[threadId];
+	char * address=scratch ? getScratchMemory(size, threadId) : NULL;
+	if (address == NULL) address=getHeapMemory(size, 0, currentSymbolEntries[threadId], symbolTable[threadId], threadId);
+	scratchValues[threadId]=0;
+#else
+	char scratch=scratchValues;
+	char * address=scratch ? getScratchMemory(size) : NULL;
+	if (address == NULL) address=getHeapMemory(size, 0, currentSymbolEntries, symbolTable);
+	scratchValues=0;
+#endif
+	cpy(value.data, &address, sizeof(char*));
+	// The array, and any strings placed in it, are not held by a variable until returned so are held whilst the items are evaluated
+	int heldTemporaries=1;
+#ifdef HOST_INTERPRETER
+	holdTemporary(address, threadId);
+#else
+	holdTemporary(address);
+#endif
+	ndims=ndims | (1 << 4);
+	cpy(address, &ndims, sizeof(unsigned char));
+	address+=sizeof(unsigned char);
+	cpy(address, &totalSize, sizeof(int));
+	unsigned int prevCP=*currentPoint;
+	for (j=0;j<repetitionMultiplier;j++) {
+		*currentPoint=prevCP;
+		for (i=0;i<numItems;i++) {
+#ifdef HOST_INTERPRETER
+			struct value_defn itemV=getExpressionValue(assembled, currentPoint, length, threadId);
+#else
+			struct value_defn itemV=getExpressionValue(assembled, currentPoint, length);
+#endif
+			// An element is held in an int, which can not hold the address of a string where addresses are wider
+			if (itemV.type == STRING_TYPE && sizeof(char*) > sizeof(int)) raiseError(ERR_STR_IN_ARRAY_NOT_SUPPORTED);
+			cpy(address+((i+(j*numItems)+1) * sizeof(int)), itemV.data, sizeof(int));
+			value.type=itemV.type;
+			if (itemV.type == STRING_TYPE) {
+#ifdef HOST_INTERPRETER
+				holdTemporary(getValuePointer(&itemV), threadId);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+				retainValue(&itemV, 1, threadId);
+#endif
+#else
+				holdTemporary(getValuePointer(&itemV));
+#ifdef INTERPRETER_REFERENCE_COUNTING
+				retainValue(&itemV, 1);
+#endif
+#endif
+				heldTemporaries++;
+			}
 		}
-	} else if (expressionId == ADD_TOKEN || expressionId == SUB_TOKEN || expressionId == MUL_TOKEN ||
-			expressionId == DIV_TOKEN || expressionId == MOD_TOKEN || expressionId == POW_TOKEN) {
+	}
 #ifdef HOST_INTERPRETER
-		value=computeExpressionResult(expressionId, assembled, currentPoint, length, threadId);
+	releaseTemporaries(heldTemporaries, threadId);
+	scratchValues[threadId]=scratch;
 #else
-		value=computeExpressionResult(expressionId, assembled, currentPoint, length);
+	releaseTemporaries(heldTemporaries);
+	scratchValues=scratch;
 #endif
-	} else if (expressionId == EQ_TOKEN || expressionId == NEQ_TOKEN || expressionId == GT_TOKEN || expressionId == GEQ_TOKEN ||
-			expressionId == LT_TOKEN || expressionId == LEQ_TOKEN || expressionId == IS_TOKEN) {
-		*currentPoint-=sizeof(unsigned char);
+	value.dtype=ARRAY;
+	return value;
+}
+
+/**
+ * Calls a function (directly or via a function pointer) and returns the value that it returned. As the value is needed by the
+ * enclosing expression the function is run by a nested interpreter loop, which returns once the function does. So unlike a call
+ * statement, recursion through calls in expressions (such as return fib(n-1)+fib(n-2)) also nests the C stack at each level. On
+ * the host this is bounded by MAX_CALL_STACK_DEPTH, on a core the call is refused once its C stack is nearly full
+ */
 #ifdef HOST_INTERPRETER
-		int retVal=determine_logical_expression(assembled, currentPoint, length, threadId);
+static struct value_defn getFnCallValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+	struct value_defn value;
+	// The arguments are kept by the function, which runs its own statements, so none of these are within the scratch values of the caller
+	char scratch=scratchValues[threadId];
+	scratchValues[threadId]=0;
+	unsigned int fnAddr=handleFnCall(assembled, *currentPoint, length, expressionId == FNCALL_BY_VAR_TOKEN ? 1:0, threadId);
+	if (stopInterpreter[threadId]) {
+		value.type=NONE_TYPE;
+		value.dtype=SCALAR;
+		return value;
+	}
+	value=processAssembledCode(assembled, fnAddr, length, threadId);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+	// The value returned might be referenced only by a variable of the function, so is counted whilst its frame is popped
+	retainValue(&value, 0, threadId);
+	*currentPoint=popFrame(threadId);
+	releaseValue(&value, 0, threadId);
 #else
-		int retVal=determine_logical_expression(assembled, currentPoint, length);
+	*currentPoint=popFrame(threadId);
 #endif
-		value.type=BOOLEAN_TYPE;
+	scratchValues[threadId]=scratch;
+	return value;
+}
+#else
+static struct value_defn getFnCallValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+	struct value_defn value;
+	// The C stack of a core is only what is left of its memory above the interpreter, far less than the call stack allows for
+	// nested calls, so the call is refused whilst there is still room to report the error
+	if (!hasCStackSpace(EXPRESSION_CALL_C_STACK)) {
+		raiseError(ERR_CALL_STACK_DEPTH_EXCEEDED);
+		value.type=NONE_TYPE;
+		value.dtype=SCALAR;
+		return value;
+	}
+	// The arguments are kept by the function, which runs its own statements, so none of these are within the scratch values of the caller
+	char scratch=scratchValues;
+	scratchValues=0;
+	unsigned int fnAddr=handleFnCall(assembled, *currentPoint, length, expressionId == FNCALL_BY_VAR_TOKEN ? 1:0);
+	if (stopInterpreter) {
+		value.type=NONE_TYPE;
 		value.dtype=SCALAR;
-		cpy(value.data, &retVal, sizeof(int));
+		return value;
 	}
+	value=processAssembledCode(assembled, fnAddr, length);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+	// The value returned might be referenced only by a variable of the function, so is counted whilst its frame is popped
+	retainValue(&value, 0);
+	*currentPoint=popFrame();
+	releaseValue(&value, 0);
+#else
+	*currentPoint=popFrame();
+#endif
+	scratchValues=scratch;
+	return value;
+}
+#endif
+
+#ifdef HOST_INTERPRETER
+static struct value_defn getNativeValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+	struct value_defn value;
+	value.type=NONE_TYPE;
+	value.dtype=SCALAR;
+	*currentPoint=handleNative(assembled, *currentPoint, length, &value, threadId);
+	return value;
+}
+#else
+static struct value_defn getNativeValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+	struct value_defn value;
+	value.type=NONE_TYPE;
+	value.dtype=SCALAR;
+	*currentPoint=handleNative(assembled, *currentPoint, length, &value);
+	return value;
+}
+#endif
+
+/**
+ * The value of a variable, for an array this is the reference to the array rather than an element
+ */
+#ifdef HOST_INTERPRETER
+static struct value_defn getIdentifierValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+#else
+static struct value_defn getIdentifierValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+#endif
+	struct value_defn value;
+	unsigned short variable_id=getUShort(&assembled[*currentPoint]);
+	*currentPoint+=CODE_USHORT_SIZE;
+#ifdef HOST_INTERPRETER
+	struct symbol_node* variableSymbol=getVariableSymbol(variable_id, threadId, 1);
+#else
+	struct symbol_node* variableSymbol=getVariableSymbol(variable_id, 1);
+#endif
+	if (variableSymbol->value.dtype==SCALAR) {
+		value=getVariableValue(variableSymbol, -1);
+	} else {
+		value.dtype=ARRAY;
+		value.type=variableSymbol->value.type;
+		cpy(value.data, variableSymbol->value.data, sizeof(char*));
+	}
+	return value;
+}
+
+/**
+ * The value of an individual element of an array
+ */
+#ifdef HOST_INTERPRETER
+static struct value_defn getArrayAccessValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+#else
+static struct value_defn getArrayAccessValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+#endif
+	unsigned short variable_id=getUShort(&assembled[*currentPoint]);
+	*currentPoint+=CODE_USHORT_SIZE;
+#ifdef HOST_INTERPRETER
+	struct symbol_node* variableSymbol=getVariableSymbol(variable_id, threadId, 1);
+	int targetIndex=getArrayAccessorIndex(variableSymbol, assembled, currentPoint, length, threadId);
+#else
+	struct symbol_node* variableSymbol=getVariableSymbol(variable_id, 1);
+	int targetIndex=getArrayAccessorIndex(variableSymbol, assembled, currentPoint, length);
+#endif
+	return getVariableValue(variableSymbol, targetIndex);
+}
+
+/**
+ * Superinstruction for the value of an element of an array indexed by a single variable or constant
+ */
+#ifdef HOST_INTERPRETER
+static struct value_defn getArrayAccess1DValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[*currentPoint]), threadId, 1);
+	*currentPoint+=CODE_USHORT_SIZE;
+	return getVariableValue(variableSymbol, getArray1DAccessorIndex(variableSymbol, assembled, currentPoint, length, threadId));
+}
+#else
+static struct value_defn getArrayAccess1DValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[*currentPoint]), 1);
+	*currentPoint+=CODE_USHORT_SIZE;
+	return getVariableValue(variableSymbol, getArray1DAccessorIndex(variableSymbol, assembled, currentPoint, length));
+}
+#endif
+
+/**
+ * Superinstruction for the value of an element of an array indexed by an integer variable plus a constant
+ */
+#ifdef HOST_INTERPRETER
+static struct value_defn getArrayAccessOffsetValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[*currentPoint]), threadId, 1);
+	*currentPoint+=CODE_USHORT_SIZE;
+	return getVariableValue(variableSymbol, getArrayOffsetAccessorIndex(variableSymbol, assembled, currentPoint, threadId));
+}
+#else
+static struct value_defn getArrayAccessOffsetValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+	struct symbol_node* variableSymbol=getVariableSymbol(getUShort(&assembled[*currentPoint]), 1);
+	*currentPoint+=CODE_USHORT_SIZE;
+	return getVariableValue(variableSymbol, getArrayOffsetAccessorIndex(variableSymbol, assembled, currentPoint));
+}
+#endif
+
+/**
+ * Comparisons and boolean operators, the truth of which is returned as a boolean value
+ */
+#ifdef HOST_INTERPRETER
+static struct value_defn getLogicalValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+#else
+static struct value_defn getLogicalValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+#endif
+	struct value_defn value;
+	*currentPoint-=CODE_UCHAR_SIZE;
+#ifdef HOST_INTERPRETER
+	int retVal=determine_logical_expression(assembled, currentPoint, length, threadId);
+#else
+	int retVal=determine_logical_expression(assembled, currentPoint, length);
+#endif
+	value.type=BOOLEAN_TYPE;
+	value.dtype=SCALAR;
+	cpy(value.data, &retVal, sizeof(int));
 	return value;
 }
 
 /**
- * Computes the result of a simple mathematical expression, if one is a real and the other an integer
- * then raises to be a real
+ * Computes the result of a simple mathematical expression held as a prefix tree, evaluating both operands. The operator is
+ * generic or quickened and is rewritten if the operation quickens or reverts it
  */
 #ifdef HOST_INTERPRETER
 static struct value_defn computeExpressionResult(unsigned char operator, char * assembled, unsigned int * currentPoint,
@@ -733,17 +1920,170 @@ static struct value_defn computeExpressionResult(unsigned char operator, char *
 		unsigned int length) {
 #endif
 	struct value_defn value;
+	unsigned int operatorPoint=*currentPoint-CODE_UCHAR_SIZE;
+	// Operands of an addition might be strings, which are consumed by concatenating them so are placed in the scratch arena. The
+	// result is placed alongside the values of the enclosing expression and, unless this is in the arena too, the operands are
+	// then freed
 #ifdef HOST_INTERPRETER
+	char * scratchMark=operator == ADD_TOKEN ? beginScratchValues(threadId) : NULL;
 	struct value_defn v1=getExpressionValue(assembled, currentPoint, length, threadId);
+	// A string might not be held by a variable, so is held whilst the second value (which could allocate memory) is evaluated
+	if (v1.type == STRING_TYPE) holdTemporary(getValuePointer(&v1), threadId);
 	struct value_defn v2=getExpressionValue(assembled, currentPoint, length, threadId);
+	if (v1.type == STRING_TYPE) releaseTemporaries(1, threadId);
+	if (scratchMark != NULL) scratchValues[threadId]=0;
+	unsigned char quickened=performQuickenedArithmetic(operator, &v1, &v2, &value, threadId);
+	endScratchValues(scratchMark, threadId);
 #else
+	char * scratchMark=operator == ADD_TOKEN ? beginScratchValues() : NULL;
 	struct value_defn v1=getExpressionValue(assembled, currentPoint, length);
+	if (v1.type == STRING_TYPE) holdTemporary(getValuePointer(&v1));
 	struct value_defn v2=getExpressionValue(assembled, currentPoint, length);
+	if (v1.type == STRING_TYPE) releaseTemporaries(1);
+	if (scratchMark != NULL) scratchValues=0;
+	unsigned char quickened=performQuickenedArithmetic(operator, &v1, &v2, &value);
+	endScratchValues(scratchMark);
 #endif
-	value.type=v1.type==INT_TYPE && v2.type==INT_TYPE ? INT_TYPE : v1.type==STRING_TYPE || v2.type==STRING_TYPE ? STRING_TYPE : REAL_TYPE;
-	value.dtype=SCALAR;
-	if (value.type==INT_TYPE) {
-		int i, value1=getInt(v1.data), value2=getInt(v2.data), result;
+	if (quickened != operator) assembled[operatorPoint]=quickened;
+	return value;
+}
+
+/**
+ * Evaluates a postfix expression; a block of operands and arithmetic operators in evaluation order. Operands are pushed
+ * onto a small fixed operand stack and each operator replaces the top two entries with its result. Literals and variables
+ * are pushed directly and any other operand (such as a function call or array access) is evaluated as an expression
+ */
+#ifdef HOST_INTERPRETER
+static struct value_defn getPostfixValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
+#else
+static struct value_defn getPostfixValue(unsigned char expressionId, char * assembled, unsigned int * currentPoint, unsigned int length) {
+#endif
+	struct value_defn operandStack[POSTFIX_STACK_DEPTH];
+	struct symbol_node* variableSymbol;
+	int stackTop=-1;
+	unsigned char token, quickened;
+	*currentPoint+=CODE_UCHAR_SIZE;
+	unsigned int end=getBlockEnd(assembled, *currentPoint, 0);
+	*currentPoint+=CODE_USHORT_SIZE;
+	while (*currentPoint < end) {
+		token=getUChar(&assembled[*currentPoint]);
+		if ((token >= ADD_TOKEN && token <= MOD_TOKEN) || token == POW_TOKEN || (token >= INT_ADD_TOKEN && token <= REAL_DIV_TOKEN)) {
+#ifdef HOST_INTERPRETER
+			quickened=performQuickenedArithmetic(token, &operandStack[stackTop-1], &operandStack[stackTop], &operandStack[stackTop-1], threadId);
+#else
+			quickened=performQuickenedArithmetic(token, &operandStack[stackTop-1], &operandStack[stackTop], &operandStack[stackTop-1]);
+#endif
+			if (quickened != token) assembled[*currentPoint]=quickened;
+			*currentPoint+=CODE_UCHAR_SIZE;
+			stackTop--;
+		} else if (token == INTEGER_TOKEN || token == REAL_TOKEN) {
+			stackTop++;
+			operandStack[stackTop].type=token == INTEGER_TOKEN ? INT_TYPE : REAL_TYPE;
+			operandStack[stackTop].dtype=SCALAR;
+			cpy(operandStack[stackTop].data, &assembled[*currentPoint+CODE_UCHAR_SIZE], sizeof(int));
+			*currentPoint+=CODE_UCHAR_SIZE+sizeof(int);
+		} else if (token == LOAD_SLOT_TOKEN) {
+#ifdef HOST_INTERPRETER
+			variableSymbol=getVariableSymbol(getUShort(&assembled[*currentPoint+CODE_UCHAR_SIZE]), threadId, 1);
+#else
+			variableSymbol=getVariableSymbol(getUShort(&assembled[*currentPoint+CODE_UCHAR_SIZE]), 1);
+#endif
+			*currentPoint+=CODE_UCHAR_SIZE+CODE_USHORT_SIZE;
+			stackTop++;
+			operandStack[stackTop].type=variableSymbol->value.type;
+			operandStack[stackTop].dtype=variableSymbol->value.dtype;
+			cpy(operandStack[stackTop].data, variableSymbol->value.data, sizeof(char*));
+		} else {
+			// Strings already on the operand stack might not be held by a variable, so are held whilst the operand is evaluated
+			int i, heldTemporaries=0;
+			for (i=0;i<=stackTop;i++) {
+				if (operandStack[i].type == STRING_TYPE) {
+#ifdef HOST_INTERPRETER
+					holdTemporary(getValuePointer(&operandStack[i]), threadId);
+#else
+					holdTemporary(getValuePointer(&operandStack[i]));
+#endif
+					heldTemporaries++;
+				}
+			}
+#ifdef HOST_INTERPRETER
+			operandStack[++stackTop]=getExpressionValue(assembled, currentPoint, length, threadId);
+			if (heldTemporaries > 0) releaseTemporaries(heldTemporaries, threadId);
+#else
+			operandStack[++stackTop]=getExpressionValue(assembled, currentPoint, length);
+			if (heldTemporaries > 0) releaseTemporaries(heldTemporaries);
+#endif
+		}
+	}
+	return operandStack[0];
+}
+
+/**
+ * Performs an arithmetic operation given a generic or quickened operator token, returning the token that the operation is to be
+ * held as from now on. A generic add, subtract, multiply or divide of two integers or two reals quickens to the matching variant
+ * and a quickened operation whose operands are not of its types is done generically, reverting to the generic token. The result
+ * may be the same location as the first value
+ */
+#ifdef HOST_INTERPRETER
+static unsigned char performQuickenedArithmetic(unsigned char token, struct value_defn * v1, struct value_defn * v2, struct value_defn * value, int threadId) {
+#else
+static unsigned char performQuickenedArithmetic(unsigned char token, struct value_defn * v1, struct value_defn * v2, struct value_defn * value) {
+#endif
+	if (token >= INT_ADD_TOKEN && token <= INT_DIV_TOKEN) {
+		if (v1->type == INT_TYPE && v2->type == INT_TYPE) {
+			int value1=getInt(v1->data), value2=getInt(v2->data), result;
+			if (token == INT_ADD_TOKEN) result=value1+value2;
+			if (token == INT_SUB_TOKEN) result=value1-value2;
+			if (token == INT_MUL_TOKEN) result=value1*value2;
+			if (token == INT_DIV_TOKEN) result=value1/value2;
+			cpy(value->data, &result, sizeof(int));
+			value->type=INT_TYPE;
+			value->dtype=SCALAR;
+			return token;
+		}
+		token=ADD_TOKEN+(token-INT_ADD_TOKEN);
+	} else if (token >= REAL_ADD_TOKEN && token <= REAL_DIV_TOKEN) {
+		if (v1->type == REAL_TYPE && v2->type == REAL_TYPE) {
+			float value1=getFloat(v1->data), value2=getFloat(v2->data), result;
+			if (token == REAL_ADD_TOKEN) result=value1+value2;
+			if (token == REAL_SUB_TOKEN) result=value1-value2;
+			if (token == REAL_MUL_TOKEN) result=value1*value2;
+			if (token == REAL_DIV_TOKEN) result=value1/value2;
+			cpy(value->data, &result, sizeof(float));
+			value->type=REAL_TYPE;
+			value->dtype=SCALAR;
+			return token;
+		}
+		token=ADD_TOKEN+(token-REAL_ADD_TOKEN);
+	}
+	unsigned char quickened=token;
+#ifndef INTERPRETER_NO_QUICKENING
+	// Determined before the operation as the result may overwrite the first value
+	if (token >= ADD_TOKEN && token <= DIV_TOKEN) {
+		if (v1->type == INT_TYPE && v2->type == INT_TYPE) quickened=INT_ADD_TOKEN+(token-ADD_TOKEN);
+		if (v1->type == REAL_TYPE && v2->type == REAL_TYPE) quickened=REAL_ADD_TOKEN+(token-ADD_TOKEN);
+	}
+#endif
+#ifdef HOST_INTERPRETER
+	performArithmetic(token, v1, v2, value, threadId);
+#else
+	performArithmetic(token, v1, v2, value);
+#endif
+	return quickened;
+}
+
+/**
+ * Performs an arithmetic operation on two values, if one is a real and the other an integer then raises to be a real. The
+ * result may be the same location as the first value
+ */
+#ifdef HOST_INTERPRETER
+static void performArithmetic(unsigned char operator, struct value_defn * v1, struct value_defn * v2, struct value_defn * value, int threadId) {
+#else
+static void performArithmetic(unsigned char operator, struct value_defn * v1, struct value_defn * v2, struct value_defn * value) {
+#endif
+	char resultType=v1->type==INT_TYPE && v2->type==INT_TYPE ? INT_TYPE : v1->type==STRING_TYPE || v2->type==STRING_TYPE ? STRING_TYPE : REAL_TYPE;
+	if (resultType==INT_TYPE) {
+		int i, value1=getInt(v1->data), value2=getInt(v2->data), result;
 		if (operator==ADD_TOKEN) result=value1+value2;
 		if (operator==SUB_TOKEN) result=value1-value2;
 		if (operator==MUL_TOKEN) result=value1*value2;
@@ -753,14 +2093,14 @@ static struct value_defn computeExpressionResult(unsigned char operator, char *
 			result=value2 == 0 ? 1 : value1;
 			for (i=1;i<value2;i++) result=result*value1;
 		}
-		cpy(&value.data, &result, sizeof(int));
-	} else if (value.type==REAL_TYPE) {
-		float value1=getFloat(v1.data);
-		float value2=getFloat(v2.data);
+		cpy(&value->data, &result, sizeof(int));
+	} else if (resultType==REAL_TYPE) {
+		float value1=getFloat(v1->data);
+		float value2=getFloat(v2->data);
 		float result;
-		if (v1.type==INT_TYPE) value1=(float) getInt(v1.data);
-		if (v2.type==INT_TYPE) {
-			value2=(float) getInt(v2.data);
+		if (v1->type==INT_TYPE) value1=(float) getInt(v1->data);
+		if (v2->type==INT_TYPE) {
+			value2=(float) getInt(v2->data);
 			if (operator == POW_TOKEN) {
 				int i;
 				result=value2 == 0 ? 1 : value1;
@@ -771,19 +2111,21 @@ static struct value_defn computeExpressionResult(unsigned char operator, char *
 		if (operator == SUB_TOKEN) result=value1-value2;
 		if (operator == MUL_TOKEN) result=value1*value2;
 		if (operator == DIV_TOKEN) result=value1/value2;
-		cpy(&value.data, &result, sizeof(float));
-	} else if (value.type==STRING_TYPE) {
+		cpy(&value->data, &result, sizeof(float));
+	} else if (resultType==STRING_TYPE) {
 		if (operator == ADD_TOKEN) {
 #ifdef HOST_INTERPRETER
-        return performStringConcatenation(v1, v2, threadId);
+			*value=performStringConcatenation(*v1, *v2, scratchValues[threadId], currentSymbolEntries[threadId], symbolTable[threadId], threadId);
 #else
-        return performStringConcatenation(v1, v2, currentSymbolEntries, symbolTable);
+			*value=performStringConcatenation(*v1, *v2, scratchValues, currentSymbolEntries, symbolTable);
 #endif
+			return;
 		} else {
 			raiseError(ERR_ONLY_ADDITION_STR);
 		}
 	}
-	return value;
+	value->type=resultType;
+	value->dtype=SCALAR;
 }
 
 /**
@@ -796,10 +2138,43 @@ static int getArrayAccessorIndex(struct symbol_node* variableSymbol, char * asse
 static int getArrayAccessorIndex(struct symbol_node* variableSymbol, char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
     struct value_defn index;
+    int i, indexes[0xF];
+    unsigned char num_dims=getUChar(&assembled[*currentPoint]), array_dims;
+    *currentPoint+=CODE_UCHAR_SIZE;
+
+    char * arraymemory;
+    cpy(&arraymemory, variableSymbol->value.data, sizeof(char*));
+    cpy(&array_dims, arraymemory, sizeof(unsigned char));
+    // Kept even when unchecked, as the verifier can not know the rank of an array and extra indexes would read past its header
+    if (num_dims > (array_dims&0xF)) raiseError(ERR_TOO_MANY_ARR_INDEX);
+
+    for (i=0;i<num_dims;i++) {
+#ifdef HOST_INTERPRETER
+        index=getExpressionValue(assembled, currentPoint, length, threadId);
+#else
+        index=getExpressionValue(assembled, currentPoint, length);
+#endif
+        indexes[i]=getInt(index.data);
+    }
+#ifdef HOST_INTERPRETER
+    return getArrayElementIndex(variableSymbol, num_dims, indexes, threadId);
+#else
+    return getArrayElementIndex(variableSymbol, num_dims, indexes);
+#endif
+}
+
+/**
+ * Retrieves the absolute index of an array element from the values of its index(es), extending the array if it is
+ * extendable and an index is beyond its size
+ */
+#ifdef HOST_INTERPRETER
+static int getArrayElementIndex(struct symbol_node* variableSymbol, unsigned char num_dims, int * indexes, int threadId) {
+#else
+static int getArrayElementIndex(struct symbol_node* variableSymbol, unsigned char num_dims, int * indexes) {
+#endif
     int i, j, runningWeight, spec_weight, num_weights, specificIndex=0, provIdx;
     unsigned int totSize=1;
-    unsigned char num_dims=getUChar(&assembled[*currentPoint]), array_dims, needsExtension=0, allowedExtension;
-    *currentPoint+=sizeof(unsigned char);
+    unsigned char array_dims, needsExtension=0, allowedExtension;
 
     char * arraymemory;
     cpy(&arraymemory, variableSymbol->value.data, sizeof(char*));
@@ -808,8 +2183,6 @@ static int getArrayAccessorIndex(struct symbol_node* variableSymbol, char * asse
     array_dims=array_dims&0xF;
     arraymemory+=sizeof(unsigned char);
 
-    if (num_dims > array_dims) raiseError(ERR_TOO_MANY_ARR_INDEX);
-
     for (i=0;i<num_dims;i++) {
         num_weights=array_dims-(i+1);
         runningWeight=1;
@@ -817,18 +2190,18 @@ static int getArrayAccessorIndex(struct symbol_node* variableSymbol, char * asse
             cpy(&spec_weight, &arraymemory[sizeof(int) * (array_dims-j)], sizeof(int));
             runningWeight*=spec_weight;
         }
-#ifdef HOST_INTERPRETER
-        index=getExpressionValue(assembled, currentPoint, length, threadId);
-#else
-        index=getExpressionValue(assembled, currentPoint, length);
-#endif
         cpy(&spec_weight, &arraymemory[sizeof(int) * i], sizeof(int));
         totSize*=spec_weight;
-        provIdx=getInt(index.data);
+        provIdx=indexes[i];
+#ifdef INTERPRETER_UNCHECKED
+        // Indexes are not checked against the bounds of the array, an extendable array still grows to hold the index
+        if (allowedExtension && provIdx >= spec_weight) {
+#else
         if (provIdx < 0) {
             raiseError(ERR_NEG_ARR_INDEX);
         } else if (provIdx >= spec_weight) {
             if (!allowedExtension) raiseError(ERR_ARR_INDEX_EXCEED_SIZE);
+#endif
             spec_weight=provIdx+1;
             cpy(&arraymemory[sizeof(int) * i], &spec_weight, sizeof(int));
             needsExtension=1;
@@ -841,14 +2214,29 @@ static int getArrayAccessorIndex(struct symbol_node* variableSymbol, char * asse
             cpy(&spec_weight, &arraymemory[sizeof(int) * i], sizeof(int));
             newSize*=spec_weight;
         }
+        // The array is held whilst its replacement is allocated, so that it is not moved from under arraymemory
+        arraymemory-=sizeof(unsigned char);
 #ifdef HOST_INTERPRETER
-        char * newmem=getHeapMemory((sizeof(int) * newSize) + (sizeof(int) * num_dims) + sizeof(unsigned char), 0, threadId);
+        holdTemporary(arraymemory, threadId);
+        char * newmem=getHeapMemory((sizeof(int) * newSize) + (sizeof(int) * num_dims) + sizeof(unsigned char), 0,
+                currentSymbolEntries[threadId], symbolTable[threadId], threadId);
+        releaseTemporaries(1, threadId);
 #else
+        holdTemporary(arraymemory);
         char * newmem=getHeapMemory((sizeof(int) * newSize) + (sizeof(int) * num_dims) + sizeof(unsigned char), 0, currentSymbolEntries, symbolTable);
+        releaseTemporaries(1);
 #endif
-        arraymemory-=sizeof(unsigned char);
         cpy(newmem, arraymemory, (sizeof(int) * totSize) + (sizeof(int) * num_dims) + sizeof(unsigned char));
+#ifdef INTERPRETER_REFERENCE_COUNTING
+        // Another variable might still reference the array, in which case it keeps the array as it was
 #ifdef HOST_INTERPRETER
+        retainHeapMemory(newmem, 0, threadId);
+        releaseHeapMemory(arraymemory, 1, threadId);
+#else
+        retainHeapMemory(newmem, 0);
+        releaseHeapMemory(arraymemory, 1);
+#endif
+#elif defined(HOST_INTERPRETER)
         freeMemoryInHeap(arraymemory, threadId);
 #else
         freeMemoryInHeap(arraymemory);
@@ -859,170 +2247,361 @@ static int getArrayAccessorIndex(struct symbol_node* variableSymbol, char * asse
 }
 
 /**
- * Retrieves the symbol entry of a variable based upon its id
+ * Retrieves the index of an array element accessed with a single index which is a variable or constant. An integer index within
+ * the bounds of a one dimensional array is used directly and anything else (which may need an error or the array extending)
+ * is handled by the general accessor, as reading the index has no side effects this can simply re-read it
  */
 #ifdef HOST_INTERPRETER
-static struct symbol_node* getVariableSymbol(unsigned short id, unsigned char lvl, int threadId, int followAlias) {
+static int getArray1DAccessorIndex(struct symbol_node* variableSymbol, char * assembled, unsigned int * currentPoint, unsigned int length, int threadId) {
 #else
-static struct symbol_node* getVariableSymbol(unsigned short id, unsigned char lvl, int followAlias) {
+static int getArray1DAccessorIndex(struct symbol_node* variableSymbol, char * assembled, unsigned int * currentPoint, unsigned int length) {
 #endif
-	int i;
+	unsigned int indexPoint=*currentPoint+CODE_UCHAR_SIZE;
+	unsigned char indexToken=getUChar(&assembled[indexPoint]), array_dims;
+	int index, size;
+	char indexIsInteger;
+	if (indexToken == LOAD_SLOT_TOKEN) {
 #ifdef HOST_INTERPRETER
-	for (i=0;i<=currentSymbolEntries[threadId];i++) {
-		if (symbolTable[threadId][i].id == id && symbolTable[threadId][i].state != UNALLOCATED && (symbolTable[threadId][i].level == 0 || symbolTable[threadId][i].level==lvl)) {
-			if (followAlias && symbolTable[threadId][i].state == ALIAS) {
-				return getVariableSymbol(symbolTable[threadId][i].alias, lvl-1, threadId, 1);
-			} else {
-				return &(symbolTable[threadId])[i];
-			}
-		}
+		struct symbol_node* indexSymbol=getVariableSymbol(getUShort(&assembled[indexPoint+CODE_UCHAR_SIZE]), threadId, 1);
 #else
-	for (i=0;i<=currentSymbolEntries;i++) {
-		if (symbolTable[i].id == id && symbolTable[i].state != UNALLOCATED && (symbolTable[i].level == 0 || symbolTable[i].level==lvl)) {
-			if (followAlias && symbolTable[i].state == ALIAS) {
-				return getVariableSymbol(symbolTable[i].alias, lvl-1, 1);
-			} else {
-				return &symbolTable[i];
-			}
-		}
+		struct symbol_node* indexSymbol=getVariableSymbol(getUShort(&assembled[indexPoint+CODE_UCHAR_SIZE]), 1);
 #endif
+		indexIsInteger=indexSymbol->value.type == INT_TYPE && indexSymbol->value.dtype == SCALAR;
+		index=getInt(indexSymbol->value.data);
+		indexPoint+=CODE_UCHAR_SIZE+CODE_USHORT_SIZE;
+	} else {
+		indexIsInteger=1;
+		index=getCodeInt(&assembled[indexPoint+CODE_UCHAR_SIZE]);
+		indexPoint+=CODE_UCHAR_SIZE+sizeof(int);
+	}
+	if (indexIsInteger && variableSymbol->value.dtype == ARRAY && index >= 0) {
+		char * arraymemory;
+		cpy(&arraymemory, variableSymbol->value.data, sizeof(char*));
+		cpy(&array_dims, arraymemory, sizeof(unsigned char));
+		cpy(&size, &arraymemory[sizeof(unsigned char)], sizeof(int));
+		if ((array_dims & 0xF) == 1 && index < size) {
+			*currentPoint=indexPoint;
+			return index;
+		}
 	}
-	int zero=0;
 #ifdef HOST_INTERPRETER
-	int newEntryLocation=getSymbolTableEntryId(threadId);
-	symbolTable[threadId][newEntryLocation].id=id;
-	symbolTable[threadId][newEntryLocation].state=ALLOCATED;
-	symbolTable[threadId][newEntryLocation].level=lvl;
-	symbolTable[threadId][newEntryLocation].value.type=INT_TYPE;
-	cpy(symbolTable[threadId][newEntryLocation].value.data, &zero, sizeof(int));
-	return &symbolTable[threadId][newEntryLocation];
+	return getArrayAccessorIndex(variableSymbol, assembled, currentPoint, length, threadId);
 #else
-	int newEntryLocation=getSymbolTableEntryId();
-	symbolTable[newEntryLocation].id=id;
-	symbolTable[newEntryLocation].level=lvl;
-	symbolTable[newEntryLocation].state=ALLOCATED;
-	symbolTable[newEntryLocation].value.type=INT_TYPE;
-	symbolTable[newEntryLocation].value.dtype=SCALAR;
-	cpy(symbolTable[newEntryLocation].value.data, &zero, sizeof(int));
-	return &symbolTable[newEntryLocation];
+	return getArrayAccessorIndex(variableSymbol, assembled, currentPoint, length);
 #endif
 }
+
+/**
+ * Retrieves the index of an array element accessed at the value of an integer variable plus a constant. The optimiser only
+ * emits this when the variable is known to be an integer, but anything else is added generically as the index expression
+ * would have been. Within the bounds of a one dimensional array the index is used directly, otherwise it is checked (and
+ * the array extended) as a single index is by the general accessor
+ */
 #ifdef HOST_INTERPRETER
-static int getSymbolTableEntryId(int threadId) {
+static int getArrayOffsetAccessorIndex(struct symbol_node* variableSymbol, char * assembled, unsigned int * currentPoint, int threadId) {
+	struct symbol_node* indexSymbol=getVariableSymbol(getUShort(&assembled[*currentPoint]), threadId, 1);
 #else
-static int getSymbolTableEntryId(void) {
+static int getArrayOffsetAccessorIndex(struct symbol_node* variableSymbol, char * assembled, unsigned int * currentPoint) {
+	struct symbol_node* indexSymbol=getVariableSymbol(getUShort(&assembled[*currentPoint]), 1);
 #endif
-	int i;
+	int offset=getCodeInt(&assembled[*currentPoint+CODE_USHORT_SIZE]), index, size;
+	unsigned char array_dims;
+	*currentPoint+=CODE_USHORT_SIZE+sizeof(int);
+	if (indexSymbol->value.type == INT_TYPE && indexSymbol->value.dtype == SCALAR) {
+		index=(int) ((unsigned int) getInt(indexSymbol->value.data) + (unsigned int) offset);
+	} else {
+		struct value_defn indexValue=getVariableValue(indexSymbol, -1), offsetValue, result;
+		offsetValue.type=INT_TYPE;
+		offsetValue.dtype=SCALAR;
+		cpy(offsetValue.data, &offset, sizeof(int));
 #ifdef HOST_INTERPRETER
-	for (i=0;i<=currentSymbolEntries[threadId];i++) {
-			if (symbolTable[threadId][i].state == UNALLOCATED) return i;
-	}
-	return ++currentSymbolEntries[threadId];
+		performArithmetic(ADD_TOKEN, &indexValue, &offsetValue, &result, threadId);
 #else
-	for (i=0;i<=currentSymbolEntries;i++) {
-		if (symbolTable[i].state == UNALLOCATED) return i;
+		performArithmetic(ADD_TOKEN, &indexValue, &offsetValue, &result);
+#endif
+		index=getInt(result.data);
+	}
+	if (variableSymbol->value.dtype == ARRAY && index >= 0) {
+		char * arraymemory;
+		cpy(&arraymemory, variableSymbol->value.data, sizeof(char*));
+		cpy(&array_dims, arraymemory, sizeof(unsigned char));
+		cpy(&size, &arraymemory[sizeof(unsigned char)], sizeof(int));
+		if ((array_dims & 0xF) == 1 && index < size) return index;
 	}
-	return ++currentSymbolEntries;
+#ifdef HOST_INTERPRETER
+	return getArrayElementIndex(variableSymbol, 1, &index, threadId);
+#else
+	return getArrayElementIndex(variableSymbol, 1, &index);
 #endif
 }
 
+/**
+ * Retrieves the symbol entry of a variable based upon its slot, which is either global or relative to the current frame
+ */
+#ifdef HOST_INTERPRETER
+static struct symbol_node* getVariableSymbol(unsigned short slot, int threadId, int followAlias) {
+	struct symbol_node* variableSymbol=slot & LOCAL_SLOT_FLAG ? &symbolTable[threadId][frameBase[threadId] + (slot & ~LOCAL_SLOT_FLAG)] :
+			&symbolTable[threadId][slot];
+	if (followAlias) {
+		while (variableSymbol->state == ALIAS) variableSymbol=&symbolTable[threadId][variableSymbol->alias];
+	}
+	return variableSymbol;
+}
+#else
+static struct symbol_node* getVariableSymbol(unsigned short slot, int followAlias) {
+	struct symbol_node* variableSymbol=slot & LOCAL_SLOT_FLAG ? &symbolTable[frameBase + (slot & ~LOCAL_SLOT_FLAG)] : &symbolTable[slot];
+	if (followAlias) {
+		while (variableSymbol->state == ALIAS) variableSymbol=&symbolTable[variableSymbol->alias];
+	}
+	return variableSymbol;
+}
+#endif
+
+/**
+ * Initialises a number of symbol table entries, from some start point, to be allocated integers of value zero
+ */
 #ifdef HOST_INTERPRETER
-static void clearVariablesToLevel(unsigned char clearLevel, int threadId) {
+static void initialiseSymbolEntries(int start, int numberEntries, int threadId) {
+	struct symbol_node* entries=&symbolTable[threadId][start];
+	currentSymbolEntries[threadId]=start+numberEntries-1;
 #else
-static void clearVariablesToLevel(unsigned char clearLevel) {
+static void initialiseSymbolEntries(int start, int numberEntries) {
+	struct symbol_node* entries=&symbolTable[start];
+	currentSymbolEntries=start+numberEntries-1;
 #endif
+	int i, zero=0;
+	for (i=0;i<numberEntries;i++) {
+		entries[i].state=ALLOCATED;
+		entries[i].value.type=INT_TYPE;
+		entries[i].value.dtype=SCALAR;
+		cpy(entries[i].value.data, &zero, sizeof(int));
+	}
+}
+
+/**
+ * Pops the current function's frame and call record, as scalars are held in the symbol table this simply returns to the caller's
+ * frame. The point to resume at in the caller is returned
+ */
+#ifdef HOST_INTERPRETER
+static unsigned int popFrame(int threadId) {
+	struct call_frame* callRecord=&callStack[threadId][--callStackDepth[threadId]];
+#ifdef INTERPRETER_REFERENCE_COUNTING
 	int i;
-	char * smallestMemoryAddress=0, *ptr;
-#ifdef HOST_INTERPRETER
-	for (i=0;i<=currentSymbolEntries[threadId];i++) {
-		if (symbolTable[threadId][i].level >= clearLevel && symbolTable[threadId][i].state != UNALLOCATED) {
-			symbolTable[threadId][i].state=UNALLOCATED;
-			if (symbolTable[threadId][i].value.dtype==SCALAR && symbolTable[threadId][i].value.type != STRING_TYPE) {
-				cpy(&ptr, symbolTable[threadId][i].value.data, sizeof(int*));
-				if (ptr != 0 && (smallestMemoryAddress == 0 || smallestMemoryAddress > ptr)) smallestMemoryAddress=ptr;
-			}
-		}
+	for (i=frameBase[threadId];i<=currentSymbolEntries[threadId];i++) {
+		if (symbolTable[threadId][i].state != ALIAS) releaseValue(&symbolTable[threadId][i].value, 1, threadId);
 	}
+#endif
+	currentSymbolEntries[threadId]=frameBase[threadId]-1;
+	frameBase[threadId]=callRecord->previousFrameBase;
+	return callRecord->returnPoint;
+}
 #else
-	for (i=0;i<=currentSymbolEntries;i++) {
-		if (symbolTable[i].level >= clearLevel && symbolTable[i].state != UNALLOCATED) {
-			symbolTable[i].state=UNALLOCATED;
-			if (symbolTable[i].value.dtype==SCALAR && symbolTable[i].value.type != STRING_TYPE) {
-				cpy(&ptr, symbolTable[i].value.data, sizeof(char*));
-				if (ptr != 0 && (smallestMemoryAddress == 0 || smallestMemoryAddress > ptr)) smallestMemoryAddress=ptr;
-			}
-		}
+static unsigned int popFrame(void) {
+	struct call_frame* callRecord=&callStack[--callStackDepth];
+#ifdef INTERPRETER_REFERENCE_COUNTING
+	int i;
+	for (i=frameBase;i<=currentSymbolEntries;i++) {
+		if (symbolTable[i].state != ALIAS) releaseValue(&symbolTable[i].value, 1);
 	}
 #endif
-	if (smallestMemoryAddress != 0) clearFreedStackFrames(smallestMemoryAddress);
+	currentSymbolEntries=frameBase-1;
+	frameBase=callRecord->previousFrameBase;
+	return callRecord->returnPoint;
 }
+#endif
 
 /**
- * Sets a variables value in memory as pointed to by symbol table
+ * Begins evaluating values consumed by the current statement, strings and arrays created for these are placed in the scratch
+ * arena. Returns the mark to reset the arena to once they have been consumed, or NULL if the values are within scratch values
+ * already being evaluated, which reset the arena themselves
  */
+#ifdef HOST_INTERPRETER
+static char* beginScratchValues(int threadId) {
+	if (scratchValues[threadId]) return NULL;
+	scratchValues[threadId]=1;
+	return getScratchMark(threadId);
+}
+#else
+static char* beginScratchValues(void) {
+	if (scratchValues) return NULL;
+	scratchValues=1;
+	return getScratchMark();
+}
+#endif
+
+/**
+ * Ends evaluating the values begun with some mark, once these have been consumed, freeing everything placed in the scratch arena
+ * for them
+ */
+#ifdef HOST_INTERPRETER
+static void endScratchValues(char * scratchMark, int threadId) {
+	if (scratchMark == NULL) return;
+	scratchValues[threadId]=0;
+	resetScratchMemory(scratchMark, threadId);
+}
+#else
+static void endScratchValues(char * scratchMark) {
+	if (scratchMark == NULL) return;
+	scratchValues=0;
+	resetScratchMemory(scratchMark);
+}
+#endif
+
+/**
+ * Sets a variables value, either directly in the symbol table (an index of -1) or an element of the array pointed to. A string
+ * placed in an element is held by the array, which is not counted, so it is only freed once garbage is collected
+ */
+#ifdef HOST_INTERPRETER
+void setVariableValue(struct symbol_node* variableSymbol, struct value_defn value, int index, int threadId) {
+#else
 void setVariableValue(struct symbol_node* variableSymbol, struct value_defn value, int index) {
-	variableSymbol->value.type=value.type;
-	if (value.type == STRING_TYPE) {
-		cpy(&variableSymbol->value.data, &value.data, sizeof(char*));
+#endif
+	if (index < 0 || variableSymbol->value.dtype == SCALAR) {
+#ifdef INTERPRETER_REFERENCE_COUNTING
+		struct value_defn previousValue=variableSymbol->value;
+#ifdef HOST_INTERPRETER
+		retainValue(&value, 0, threadId);
+		releaseValue(&previousValue, 1, threadId);
+#else
+		retainValue(&value, 0);
+		releaseValue(&previousValue, 1);
+#endif
+#endif
+		variableSymbol->value.type=value.type;
+		variableSymbol->value.dtype=value.dtype;
+		cpy(variableSymbol->value.data, value.data, sizeof(char*));
 	} else {
-		int currentAddress=getInt(variableSymbol->value.data);
-		if (currentAddress == 0) {
-			char * address=getStackMemory(sizeof(int) * index, 0);
-			cpy(variableSymbol->value.data, &address, sizeof(char*));
-			cpy(address+((index+1) *4), value.data, sizeof(int));
-		} else {
-			char * ptr;
-			cpy(&ptr, variableSymbol->value.data, sizeof(char*));
-			if (variableSymbol->value.dtype == ARRAY) {
-                unsigned char num_dims;
-                cpy(&num_dims, ptr, sizeof(unsigned char));
-                num_dims=num_dims & 0xF;
-                ptr+=((index+num_dims)*sizeof(int)) + sizeof(unsigned char);
-            } else {
-                ptr+=(index+1)*sizeof(int);
-            }
-			cpy(ptr, value.data, sizeof(int));
+		if (value.type == STRING_TYPE) {
+			// An element is held in an int, which can not hold the address of a string where addresses are wider
+			if (sizeof(char*) > sizeof(int)) raiseError(ERR_STR_IN_ARRAY_NOT_SUPPORTED);
+#ifdef INTERPRETER_REFERENCE_COUNTING
+#ifdef HOST_INTERPRETER
+			retainValue(&value, 1, threadId);
+#else
+			retainValue(&value, 1);
+#endif
+#endif
 		}
+		char * ptr;
+		unsigned char num_dims;
+		cpy(&ptr, variableSymbol->value.data, sizeof(char*));
+		cpy(&num_dims, ptr, sizeof(unsigned char));
+		num_dims=num_dims & 0xF;
+		ptr+=((index+num_dims)*sizeof(int)) + sizeof(unsigned char);
+		variableSymbol->value.type=value.type;
+		cpy(ptr, value.data, sizeof(int));
 	}
 }
 
 /**
- * Retrieves a variable value from memory, which the symbol table points to
+ * Retrieves a variable value, either directly from the symbol table (an index of -1) or an element of the array pointed to
  */
 struct value_defn getVariableValue(struct symbol_node* variableSymbol, int index) {
 	struct value_defn val;
 	val.type=variableSymbol->value.type;
 	val.dtype=SCALAR;
-	if (variableSymbol->value.type == STRING_TYPE) {
-		cpy(&val.data, &variableSymbol->value.data, sizeof(int*));
+	if (index < 0 || variableSymbol->value.dtype == SCALAR) {
+		cpy(val.data, variableSymbol->value.data, sizeof(char*));
 	} else {
 		char * ptr;
+		unsigned char num_dims;
 		cpy(&ptr, variableSymbol->value.data, sizeof(char*));
-		if (variableSymbol->value.dtype == ARRAY) {
-            unsigned char num_dims;
-            cpy(&num_dims, ptr, sizeof(unsigned char));
-            num_dims=num_dims & 0xF;
-            ptr+=((index+num_dims)*sizeof(int)) + sizeof(unsigned char);
-		} else {
-		    ptr+=(index+1)*sizeof(int);
-		}
-		cpy(val.data, ptr, sizeof(char*));
+		cpy(&num_dims, ptr, sizeof(unsigned char));
+		num_dims=num_dims & 0xF;
+		ptr+=((index+num_dims)*sizeof(int)) + sizeof(unsigned char);
+		cpy(val.data, ptr, sizeof(int));
 	}
 	return val;
 }
 
+#ifdef INTERPRETER_REFERENCE_COUNTING
+/**
+ * Counts a further variable referencing the array or string of a value, or if permanently then the value is held somewhere that
+ * is not counted
+ */
+#ifdef HOST_INTERPRETER
+static void retainValue(struct value_defn * value, char permanently, int threadId) {
+	if (value->type == STRING_TYPE || value->dtype == ARRAY) retainHeapMemory(getValuePointer(value), permanently, threadId);
+}
+#else
+static void retainValue(struct value_defn * value, char permanently) {
+	if (value->type == STRING_TYPE || value->dtype == ARRAY) retainHeapMemory(getValuePointer(value), permanently);
+}
+#endif
+
+/**
+ * Counts a variable no longer referencing the array or string of a value, which if reclaim is set is freed once nothing
+ * references it
+ */
+#ifdef HOST_INTERPRETER
+static void releaseValue(struct value_defn * value, char reclaim, int threadId) {
+	if (value->type == STRING_TYPE || value->dtype == ARRAY) releaseHeapMemory(getValuePointer(value), reclaim, threadId);
+}
+#else
+static void releaseValue(struct value_defn * value, char reclaim) {
+	if (value->type == STRING_TYPE || value->dtype == ARRAY) releaseHeapMemory(getValuePointer(value), reclaim);
+}
+#endif
+#endif
+
 static unsigned char getUChar(void* data) {
-	unsigned char v;
-	cpy(&v, data, sizeof(unsigned char));
-	return v;
+	return *((unsigned char*) data);
 }
 
 /**
  * Helper method to get an unsigned short from data (needed as casting to integer directly requires 4 byte alignment
- * which we do not want to enforce as it wastes memory.)
+ * which we do not want to enforce as it wastes memory.) Predecoded byte code holds each of these in an aligned word
  */
 static unsigned short getUShort(void* data) {
+#ifdef INTERPRETER_PREDECODE
+	return (unsigned short) *((unsigned int*) data);
+#else
 	unsigned short v;
 	cpy(&v, data, sizeof(unsigned short));
 	return v;
+#endif
+}
+
+/**
+ * Gets an absolute address in the byte code, the location of a function or target of a goto, which in predecoded byte code
+ * may be beyond the range of an unsigned short
+ */
+static unsigned int getCodeAddress(void* data) {
+#ifdef INTERPRETER_PREDECODE
+	return *((unsigned int*) data);
+#else
+	return getUShort(data);
+#endif
+}
+
+/**
+ * Gets the address held by a value, such as a string or array
+ */
+static char* getValuePointer(struct value_defn * value) {
+	char * ptr;
+	cpy(&ptr, value->data, sizeof(char*));
+	return ptr;
+}
+
+/**
+ * Gets an integer literal from the byte code
+ */
+static int getCodeInt(void* data) {
+#ifdef INTERPRETER_PREDECODE
+	return *((int*) data);
+#else
+	return getInt(data);
+#endif
+}
+
+/**
+ * Gets the location that a block length at some point in the byte code leads to, which is past the block and then some number of
+ * bytes that follow it. In predecoded byte code this has already been resolved to an absolute location
+ */
+static unsigned int getBlockEnd(char * assembled, unsigned int point, unsigned int bytesAfterBlock) {
+#ifdef INTERPRETER_PREDECODE
+	return getCodeAddress(&assembled[point]);
+#else
+	return point+sizeof(unsigned short)+getUShort(&assembled[point])+bytesAfterBlock;
+#endif
 }
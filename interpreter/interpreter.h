@@ -42,6 +42,8 @@
 #define UNALLOCATED 1
 #define ALLOCATED 2
 #define ALIAS 3
+// A parameter holding the value passed for it, as allocated but not overwritten by the parameter's default
+#define ARGUMENT 4
 
 // The value in a symbol table; its type and data (which is integer/real or pointer to string
 // or array.) In host mode this is 8 bytes as often pointers are 64bit, but on Epiphany only 4 byte as 32 bit pointers
@@ -54,10 +56,11 @@ struct value_defn {
 #endif
 };
 
-// A node in the symbol table - its id and value
+// A node in the symbol table - its state, the entry it aliases (if an alias) and value. Scalars are held directly
+// in the value, arrays and strings as a pointer to their memory
 struct symbol_node {
-	unsigned short id, alias;
-	unsigned char state, level;
+	unsigned short alias;
+	unsigned char state;
 	struct value_defn value __attribute__((aligned(8)));
 };
 
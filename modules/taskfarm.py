@@ -64,12 +64,18 @@ def worker():
 	while num_args >= 0:
 		op=recv(_masterTask)
 		retVal=none
-		if (num_args == 0): retVal=op()
-		if (num_args == 1): retVal=op(recvArgument(_masterTask))
-		if (num_args == 2): retVal=op(recvArgument(_masterTask), recvArgument(_masterTask))
-		if (num_args == 3): retVal=op(recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask))
-		if (num_args == 4): retVal=op(recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask))
-		if (num_args == 5): retVal=op(recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask))
+		if (num_args == 0):
+			retVal=op()
+		elif (num_args == 1):
+			retVal=op(recvArgument(_masterTask))
+		elif (num_args == 2):
+			retVal=op(recvArgument(_masterTask), recvArgument(_masterTask))
+		elif (num_args == 3):
+			retVal=op(recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask))
+		elif (num_args == 4):
+			retVal=op(recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask))
+		elif (num_args == 5):
+			retVal=op(recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask), recvArgument(_masterTask))
 		if (retVal is none):
 			send(-1, _masterTask)
 		else:
@@ -32,12 +32,19 @@
 #define EXTERNAL_MEM_ABSOLUTE_START 0x01000000
 
 #define SHARED_HEAP_DATA_AREA_PER_CORE 0x6D600
+// The end of each core's shared heap data area is its scratch arena, for values which do not outlive the statement creating them
+#define SHARED_SCRATCH_AREA_PER_CORE 0x2000
 #define SHARED_STACK_DATA_AREA_PER_CORE 0xFA00
 #define SHARED_DATA_AREA_START 0x00200000
 #define SHARED_CODE_AREA_START 0x00100000
 #define SHARED_DATA_SIZE 0x01000000
 #define LOCAL_CORE_MEMORY_MAP_TOP 0x8000
 #define LOCAL_CORE_STACK_SIZE 0x400
+// Strings which the host writes for a core (input and concatenations) are written into memory the core has allocated in its shared
+// heap, the length of an input string is limited to this
+#define MAX_HOST_INPUT_LENGTH 1000
+// Most characters that the host writes for an integer or real concatenated with a string
+#define MAX_HOST_NUMBER_LENGTH 20
 
 struct core_ctrl {
 	unsigned int core_run, core_busy, core_command;
@@ -0,0 +1,42 @@
+/*
+Fragments the heap with arrays and strings that are kept, between others that become garbage, then allocates an array larger than
+any of the gaps left but smaller than the free memory in total. Built with make test COMPACT_GC=1 the heap is compacted to make
+room for it, moving the arrays and strings kept, otherwise the array is allocated elsewhere. The values are the same either way
+To run: epython compaction.py
+*/
+
+size=25000
+a1=[1]*size
+g1=[0]*size
+s1="kept "+str(1)
+t1="garbage "+str(1)
+a2=[2]*size
+g2=[0]*size
+s2="kept "+str(2)
+t2="garbage "+str(2)
+a3=[3]*size
+g3=[0]*size
+s3="kept "+str(3)
+t3="garbage "+str(3)
+a4=[4]*size
+g4=[0]*size
+a4[size-1]=44
+a5=[5]*size
+g1=0
+g2=0
+g3=0
+g4=0
+t1=0
+t2=0
+t3=0
+big=[7]*(size*3)
+i=0
+total=0
+while i<size:
+  total+=a1[i]+a2[i]+a3[i]+a4[i]+a5[i]
+  i+=1
+print total
+print a4[size-1]
+print s1+" "+s2+" "+s3
+big[size*3-1]=8
+print big[0]+big[size*3-1]
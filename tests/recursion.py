@@ -0,0 +1,20 @@
+/*
+Recursion to a depth of more than ten calls, each recursive call must be given a frame in the symbol table
+To run: epython recursion.py
+*/
+
+def r(n):
+  if n==0:
+    return 0
+  return 1+r(n-1)
+
+def count(n, total):
+  if n > 0:
+    count(n-1, total)
+    total+=1
+
+print r(10)
+print r(50)
+t=0
+count(40, t)
+print t
@@ -0,0 +1,23 @@
+/*
+Stores strings into the elements of an array that is held by a variable, which must replace only the element and never free the
+array (run with make test REFCOUNT=1 too.) Where an address does not fit in the int that an element is held in, as on 64 bit hosts,
+this is reported as an error
+To run: epython stringelements.py
+*/
+
+def ms(k):
+  return "s"+str(k)
+
+names=[0,0,0]
+k=0
+while k<3:
+  names[k]=k*2
+  k+=1
+print names[2]
+for n in names:
+  print n
+k=0
+while k<3:
+  names[k]=ms(k)
+  k+=1
+print names[0]+" "+names[1]+" "+names[2]